@@ -0,0 +1,170 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 2; tab-width: 2 -*-  */
+/*
+ * libgfbgraph - GObject library for Facebook Graph API
+ * Copyright (C) 2013 Álvaro Peña <alvaropg@gmail.com>
+ *               2020 Leesoo Ahn <yisooan@fedoraproject.org>
+ *
+ * GFBGraph is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GFBGraph is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GFBGraph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Contention benchmark of the authorizers: every thread signs its own calls
+ * with the same GFBGraphSimpleAuthorizer, as the request threads of an
+ * application sharing one account do. Reports the calls signed per second
+ * and the speedup over one thread, first with a fixed token and then with a
+ * writer replacing it every millisecond.
+ *
+ * Run it with "make benchmark".
+ */
+
+#include <glib.h>
+#include <rest/rest-proxy.h>
+
+#include <gfbgraph/gfbgraph.h>
+
+#define RUN_TIME (500 * G_TIME_SPAN_MILLISECOND)
+#define WRITER_INTERVAL (1 * G_TIME_SPAN_MILLISECOND)
+
+typedef struct {
+  GFBGraphAuthorizer *authorizer;
+  gint                stop;
+  gint                n_started;
+} BenchmarkData;
+
+typedef struct {
+  BenchmarkData *data;
+  guint64        n_calls;
+} ReaderData;
+
+static gpointer
+reader_thread (gpointer user_data)
+{
+  ReaderData *reader = user_data;
+  RestProxy *proxy;
+  RestProxyCall *call;
+
+  proxy = rest_proxy_new ("http://localhost", FALSE);
+  call = rest_proxy_new_call (proxy);
+
+  g_atomic_int_inc (&reader->data->n_started);
+  while (!g_atomic_int_get (&reader->data->stop)) {
+    gfbgraph_authorizer_process_call (reader->data->authorizer, call);
+    reader->n_calls++;
+  }
+
+  g_object_unref (call);
+  g_object_unref (proxy);
+
+  return NULL;
+}
+
+static gpointer
+writer_thread (gpointer user_data)
+{
+  BenchmarkData *data = user_data;
+  guint n_tokens = 0;
+
+  while (!g_atomic_int_get (&data->stop)) {
+    gchar *access_token;
+
+    access_token = g_strdup_printf ("access-token-%u", n_tokens++);
+    g_object_set (data->authorizer, "access-token", access_token, NULL);
+    g_free (access_token);
+
+    g_usleep (WRITER_INTERVAL);
+  }
+
+  return NULL;
+}
+
+/* Returns the calls signed per second */
+static gdouble
+run_case (guint    n_threads,
+          gboolean with_writer)
+{
+  BenchmarkData data;
+  ReaderData *readers;
+  GThread **threads;
+  GThread *writer = NULL;
+  GFBGraphSimpleAuthorizer *authorizer;
+  guint64 n_calls = 0;
+  gint64 start, elapsed;
+  guint i;
+
+  authorizer = gfbgraph_simple_authorizer_new ("access-token");
+  data.authorizer = GFBGRAPH_AUTHORIZER (authorizer);
+  data.stop = FALSE;
+  data.n_started = 0;
+
+  readers = g_new0 (ReaderData, n_threads);
+  threads = g_new0 (GThread *, n_threads);
+  for (i = 0; i < n_threads; i++) {
+    readers[i].data = &data;
+    threads[i] = g_thread_new ("reader", reader_thread, &readers[i]);
+  }
+  if (with_writer)
+    writer = g_thread_new ("writer", writer_thread, &data);
+
+  while (g_atomic_int_get (&data.n_started) < (gint) n_threads)
+    g_thread_yield ();
+
+  start = g_get_monotonic_time ();
+  g_usleep (RUN_TIME);
+  g_atomic_int_set (&data.stop, TRUE);
+
+  for (i = 0; i < n_threads; i++) {
+    g_thread_join (threads[i]);
+    n_calls += readers[i].n_calls;
+  }
+  elapsed = g_get_monotonic_time () - start;
+  if (writer != NULL)
+    g_thread_join (writer);
+
+  g_free (threads);
+  g_free (readers);
+  g_object_unref (authorizer);
+
+  return n_calls * (gdouble) G_USEC_PER_SEC / elapsed;
+}
+
+static void
+run_cases (const gchar *name,
+           gboolean     with_writer)
+{
+  guint max_threads;
+  guint n_threads;
+  gdouble base = 0;
+
+  max_threads = 2 * g_get_num_processors ();
+  for (n_threads = 1; n_threads <= max_threads; n_threads *= 2) {
+    gdouble rate;
+
+    rate = run_case (n_threads, with_writer);
+    if (n_threads == 1)
+      base = rate;
+
+    g_print ("%-24s threads=%-4u %14.0f calls/s %8.2fx\n",
+             name, n_threads, rate, rate / base);
+  }
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  run_cases ("process_call", FALSE);
+  run_cases ("process_call/writer", TRUE);
+
+  return 0;
+}
@@ -0,0 +1,400 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 2; tab-width: 2 -*-  */
+/*
+ * libgfbgraph - GObject library for Facebook Graph API
+ * Copyright (C) 2013 Álvaro Peña <alvaropg@gmail.com>
+ *               2020 Leesoo Ahn <yisooan@fedoraproject.org>
+ *
+ * GFBGraph is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GFBGraph is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GFBGraph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Benchmarks of the parsing hot path: node deserialization, connection pages
+ * and the image variants of the photos. Every case is repeated for at least
+ * MIN_RUN_TIME and reports the time and the allocations per node, and the
+ * peak RSS of the process once the case finished.
+ *
+ * Run it with "make benchmark", or ./parse-benchmark [filter] to run only the
+ * cases whose name contains filter.
+ */
+
+#include <glib.h>
+#include <json-glib/json-glib.h>
+#include <json-glib/json-gobject.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#include <gfbgraph/gfbgraph.h>
+
+#define MIN_RUN_TIME (200 * G_TIME_SPAN_MILLISECOND)
+
+/* glibc exports its allocator with these names, so the allocations of every
+ * library can be counted by overriding the public functions */
+#ifdef __GLIBC__
+#define HAVE_ALLOCATION_COUNT 1
+
+extern void *__libc_malloc  (size_t size);
+extern void *__libc_calloc  (size_t n_members, size_t size);
+extern void *__libc_realloc (void *ptr, size_t size);
+
+static guint64 n_allocations = 0;
+
+void *
+malloc (size_t size)
+{
+  __atomic_add_fetch (&n_allocations, 1, __ATOMIC_RELAXED);
+  return __libc_malloc (size);
+}
+
+void *
+calloc (size_t n_members,
+        size_t size)
+{
+  __atomic_add_fetch (&n_allocations, 1, __ATOMIC_RELAXED);
+  return __libc_calloc (n_members, size);
+}
+
+void *
+realloc (void   *ptr,
+         size_t  size)
+{
+  __atomic_add_fetch (&n_allocations, 1, __ATOMIC_RELAXED);
+  return __libc_realloc (ptr, size);
+}
+
+static guint64
+get_n_allocations (void)
+{
+  return __atomic_load_n (&n_allocations, __ATOMIC_RELAXED);
+}
+#else
+static guint64
+get_n_allocations (void)
+{
+  return 0;
+}
+#endif
+
+/* Runs one iteration of a case, returning the number of nodes processed */
+typedef guint (*BenchmarkFunc) (gpointer data);
+
+static const gchar *filter = NULL;
+
+static glong
+get_peak_rss (void)
+{
+  struct rusage usage;
+
+  if (getrusage (RUSAGE_SELF, &usage) != 0)
+    return -1;
+
+  /* KiB on Linux */
+  return usage.ru_maxrss;
+}
+
+static void
+run_case (const gchar   *name,
+          const gchar   *params,
+          BenchmarkFunc  func,
+          gpointer       data)
+{
+  guint64 n_nodes = 0;
+  guint64 allocations;
+  gint64 start, elapsed;
+
+  if (filter != NULL && strstr (name, filter) == NULL)
+    return;
+
+  /* Warm up the type system and the caches of the library */
+  func (data);
+
+  allocations = get_n_allocations ();
+  start = g_get_monotonic_time ();
+  do {
+    n_nodes += func (data);
+    elapsed = g_get_monotonic_time () - start;
+  } while (elapsed < MIN_RUN_TIME);
+  allocations = get_n_allocations () - allocations;
+
+#ifdef HAVE_ALLOCATION_COUNT
+  g_print ("%-24s %-22s %12.1f ns/node %10.1f allocs/node %8ld KiB peak RSS\n",
+           name, params,
+           elapsed * 1000.0 / n_nodes,
+           (gdouble) allocations / n_nodes,
+           get_peak_rss ());
+#else
+  g_print ("%-24s %-22s %12.1f ns/node %10s allocs/node %8ld KiB peak RSS\n",
+           name, params,
+           elapsed * 1000.0 / n_nodes,
+           "n/a",
+           get_peak_rss ());
+#endif
+}
+
+/* --- Synthetic payloads --- */
+
+static void
+append_photo (GString *payload,
+              guint    id,
+              guint    n_variants)
+{
+  guint i;
+
+  g_string_append_printf (payload,
+                          "{\"id\":\"%u\","
+                          "\"name\":\"Photo %u with a caption long enough to be realistic\","
+                          "\"link\":\"https://www.facebook.com/photo.php?fbid=%u\","
+                          "\"created_time\":\"2020-01-01T10:00:00+0000\","
+                          "\"updated_time\":\"2020-01-02T10:00:00+0000\","
+                          "\"width\":2048,\"height\":1536,"
+                          "\"source\":\"https://scontent.example.com/v/t1.0-9/%u_2048_n.jpg?oh=0123456789abcdef\","
+                          "\"images\":[",
+                          id, id, id, id);
+
+  /* From 2048 pixels wide down, in steps like the ones of the Graph API */
+  for (i = 0; i < n_variants; i++) {
+    guint width = 2048 - i * (1900 / MAX (n_variants, 1));
+
+    g_string_append_printf (payload,
+                            "%s{\"width\":%u,\"height\":%u,"
+                            "\"source\":\"https://scontent.example.com/v/t1.0-9/%u_%u_n.jpg?oh=0123456789abcdef\"}",
+                            i > 0 ? "," : "", width, width * 3 / 4, id, width);
+  }
+
+  g_string_append (payload, "]}");
+}
+
+static gchar *
+new_photo_payload (guint n_variants)
+{
+  GString *payload;
+
+  payload = g_string_new (NULL);
+  append_photo (payload, 1000, n_variants);
+
+  return g_string_free (payload, FALSE);
+}
+
+static gchar *
+new_page_payload (guint n_nodes,
+                  guint n_variants)
+{
+  GString *payload;
+  guint i;
+
+  payload = g_string_new ("{\"data\":[");
+  for (i = 0; i < n_nodes; i++) {
+    if (i > 0)
+      g_string_append_c (payload, ',');
+    append_photo (payload, 1000 + i, n_variants);
+  }
+  g_string_append (payload,
+                   "],\"paging\":{\"cursors\":{\"before\":\"QVFIUmxtbz\",\"after\":\"QVFIUjRxaH\"},"
+                   "\"next\":\"https://graph.facebook.com/v7.0/100/photos?limit=25&after=QVFIUjRxaH\"}}");
+
+  return g_string_free (payload, FALSE);
+}
+
+/* --- Cases --- */
+
+typedef struct {
+  gchar         *payload;
+  GFBGraphPhoto *photo;
+  guint          n_variants;
+} CaseData;
+
+static guint
+deserialize_photo (gpointer data)
+{
+  CaseData *case_data = data;
+  GObject *photo;
+
+  photo = json_gobject_from_data (GFBGRAPH_TYPE_PHOTO, case_data->payload, -1, NULL);
+  if (photo == NULL)
+    g_error ("Can't deserialize the photo");
+  g_object_unref (photo);
+
+  return 1;
+}
+
+static guint
+parse_page_array (gpointer data)
+{
+  CaseData *case_data = data;
+  GPtrArray *nodes;
+  guint n_nodes;
+
+  nodes = gfbgraph_connectable_default_parse_connected_data_array (GFBGRAPH_CONNECTABLE (case_data->photo),
+                                                                   case_data->payload,
+                                                                   NULL);
+  if (nodes == NULL)
+    g_error ("Can't parse the page");
+  n_nodes = nodes->len;
+  g_ptr_array_unref (nodes);
+
+  return n_nodes;
+}
+
+static guint
+parse_page_list (gpointer data)
+{
+  CaseData *case_data = data;
+  GList *nodes;
+  guint n_nodes;
+
+  nodes = gfbgraph_connectable_default_parse_connected_data (GFBGRAPH_CONNECTABLE (case_data->photo),
+                                                             case_data->payload,
+                                                             NULL);
+  n_nodes = g_list_length (nodes);
+  g_list_free_full (nodes, g_object_unref);
+
+  return n_nodes;
+}
+
+/* The selection cases count every lookup as a node */
+#define N_LOOKUPS 64
+
+static guint
+select_near_width (gpointer data)
+{
+  CaseData *case_data = data;
+  guint i;
+
+  for (i = 0; i < N_LOOKUPS; i++) {
+    if (gfbgraph_photo_get_image_near_width (case_data->photo, i * 32) == NULL)
+      g_error ("No image selected");
+  }
+
+  return N_LOOKUPS;
+}
+
+static guint
+select_for_size (gpointer data)
+{
+  CaseData *case_data = data;
+  guint i;
+
+  for (i = 0; i < N_LOOKUPS; i++) {
+    if (gfbgraph_photo_get_image_for_size (case_data->photo, i * 32, i * 24) == NULL)
+      g_error ("No image selected");
+  }
+
+  return N_LOOKUPS;
+}
+
+static guint
+select_near_area (gpointer data)
+{
+  CaseData *case_data = data;
+  guint i;
+
+  for (i = 0; i < N_LOOKUPS; i++) {
+    if (gfbgraph_photo_get_image_near_area (case_data->photo, i * 32, i * 24) == NULL)
+      g_error ("No image selected");
+  }
+
+  return N_LOOKUPS;
+}
+
+static guint
+select_near_aspect_ratio (gpointer data)
+{
+  CaseData *case_data = data;
+  guint i;
+
+  for (i = 0; i < N_LOOKUPS; i++) {
+    if (gfbgraph_photo_get_image_near_aspect_ratio (case_data->photo, 0.5 + i / 32.0) == NULL)
+      g_error ("No image selected");
+  }
+
+  return N_LOOKUPS;
+}
+
+static void
+run_deserialize_cases (void)
+{
+  static const guint variants[] = { 1, 5, 20 };
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (variants); i++) {
+    CaseData data = { NULL, };
+    gchar *params;
+
+    data.payload = new_photo_payload (variants[i]);
+    params = g_strdup_printf ("variants=%u", variants[i]);
+    run_case ("deserialize/photo", params, deserialize_photo, &data);
+    g_free (params);
+    g_free (data.payload);
+  }
+}
+
+static void
+run_connection_cases (void)
+{
+  static const guint sizes[] = { 25, 100, 1000, 5000 };
+  static const guint variants[] = { 1, 5, 20 };
+  guint i, j;
+
+  for (i = 0; i < G_N_ELEMENTS (sizes); i++) {
+    for (j = 0; j < G_N_ELEMENTS (variants); j++) {
+      CaseData data = { NULL, };
+      gchar *params;
+
+      data.payload = new_page_payload (sizes[i], variants[j]);
+      data.photo = gfbgraph_photo_new ();
+      params = g_strdup_printf ("nodes=%u variants=%u", sizes[i], variants[j]);
+      run_case ("connection/array", params, parse_page_array, &data);
+      run_case ("connection/list", params, parse_page_list, &data);
+      g_free (params);
+      g_object_unref (data.photo);
+      g_free (data.payload);
+    }
+  }
+}
+
+static void
+run_select_cases (void)
+{
+  static const guint variants[] = { 1, 5, 20 };
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (variants); i++) {
+    CaseData data = { NULL, };
+    gchar *payload, *params;
+
+    payload = new_photo_payload (variants[i]);
+    data.photo = GFBGRAPH_PHOTO (json_gobject_from_data (GFBGRAPH_TYPE_PHOTO, payload, -1, NULL));
+    params = g_strdup_printf ("variants=%u", variants[i]);
+    run_case ("select/near_width", params, select_near_width, &data);
+    run_case ("select/for_size", params, select_for_size, &data);
+    run_case ("select/near_area", params, select_near_area, &data);
+    run_case ("select/near_aspect_ratio", params, select_near_aspect_ratio, &data);
+    g_free (params);
+    g_object_unref (data.photo);
+    g_free (payload);
+  }
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  if (argc > 1)
+    filter = argv[1];
+
+  run_deserialize_cases ();
+  run_connection_cases ();
+  run_select_cases ();
+
+  return 0;
+}
@@ -34,6 +34,7 @@
 #include "gfbgraph-album.h"
 #include "gfbgraph-user.h"
 #include "gfbgraph-connectable.h"
+#include "gfbgraph-private.h"
 
 enum {
   PROP_O,
@@ -65,12 +66,9 @@ gfbgraph_album_finalize (GObject *obj)
 {
   GFBGraphAlbumPrivate *priv = GFBGRAPH_ALBUM_GET_PRIVATE (obj);
 
-  if (priv->name)
-    g_free (priv->name);
-  if (priv->description)
-    g_free (priv->description);
-  if (priv->cover_photo)
-    g_free (priv->cover_photo);
+  gfbgraph_node_clear_string (GFBGRAPH_NODE (obj), &priv->name);
+  gfbgraph_node_clear_string (GFBGRAPH_NODE (obj), &priv->description);
+  gfbgraph_node_clear_string (GFBGRAPH_NODE (obj), &priv->cover_photo);
 
   G_OBJECT_CLASS(parent_class)->finalize (obj);
 }
@@ -85,19 +83,13 @@ gfbgraph_album_set_property (GObject      *object,
 
   switch (prop_id) {
     case PROP_NAME:
-      if (priv->name)
-        g_free (priv->name);
-      priv->name = g_strdup (g_value_get_string (value));
+      gfbgraph_node_set_string (GFBGRAPH_NODE (object), &priv->name, g_value_get_string (value));
       break;
     case PROP_DESCRIPTION:
-      if (priv->description)
-        g_free (priv->description);
-      priv->description = g_strdup (g_value_get_string (value));
+      gfbgraph_node_set_string (GFBGRAPH_NODE (object), &priv->description, g_value_get_string (value));
       break;
     case PROP_COVER_PHOTO:
-      if (priv->cover_photo)
-        g_free (priv->cover_photo);
-      priv->cover_photo = g_strdup (g_value_get_string (value));
+      gfbgraph_node_set_string (GFBGRAPH_NODE (object), &priv->cover_photo, g_value_get_string (value));
       break;
     case PROP_COUNT:
       priv->count = g_value_get_uint (value);
@@ -236,6 +228,8 @@ connectable_iface_init (GFBGraphConnectableInterface *iface)
   iface->connections = connections;
   iface->get_connection_post_params = get_connection_post_params;
   iface->parse_connected_data = gfbgraph_connectable_default_parse_connected_data;
+  iface->parse_connected_data_array = gfbgraph_connectable_default_parse_connected_data_array;
+  iface->parse_connected_data_foreach = gfbgraph_connectable_default_parse_connected_data_foreach;
 }
 
 /**
@@ -32,9 +32,49 @@
 
 G_DEFINE_INTERFACE (GFBGraphAuthorizer, gfbgraph_authorizer, G_TYPE_OBJECT);
 
+static void
+default_refresh_authorization_thread (GTask        *task,
+                                      gpointer      source_object,
+                                      gpointer      task_data,
+                                      GCancellable *cancellable)
+{
+  GError *error = NULL;
+
+  if (gfbgraph_authorizer_refresh_authorization (GFBGRAPH_AUTHORIZER (source_object), cancellable, &error))
+    g_task_return_boolean (task, TRUE);
+  else
+    g_task_return_error (task, error);
+}
+
+static void
+default_refresh_authorization_async (GFBGraphAuthorizer  *iface,
+                                     GCancellable        *cancellable,
+                                     GAsyncReadyCallback  callback,
+                                     gpointer             user_data)
+{
+  GTask *task;
+
+  task = g_task_new (iface, cancellable, callback, user_data);
+  g_task_set_source_tag (task, default_refresh_authorization_async);
+  g_task_run_in_thread (task, default_refresh_authorization_thread);
+  g_object_unref (task);
+}
+
+static gboolean
+default_refresh_authorization_finish (GFBGraphAuthorizer  *iface,
+                                      GAsyncResult        *result,
+                                      GError             **error)
+{
+  g_return_val_if_fail (g_task_is_valid (result, iface), FALSE);
+
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
+
 static void
 gfbgraph_authorizer_default_init (GFBGraphAuthorizerInterface *iface)
 {
+  iface->refresh_authorization_async = default_refresh_authorization_async;
+  iface->refresh_authorization_finish = default_refresh_authorization_finish;
 }
 
 /**
@@ -83,6 +123,10 @@ gfbgraph_authorizer_process_message (GFBGraphAuthorizer *iface,
  * Synchronously forces @iface to refresh any authorization tokens
  * held by it.
  *
+ * The library calls it by itself when the Graph API rejects the token of a
+ * request, and sends the request once more with the new token, so there is
+ * no need to call it after such errors.
+ *
  * This method is thread safe.
  *
  * Returns: %TRUE if the authorizer now has a valid token.
@@ -98,3 +142,83 @@ gfbgraph_authorizer_refresh_authorization (GFBGraphAuthorizer  *iface,
                                                                        cancellable,
                                                                        error);
 }
+
+/**
+ * gfbgraph_authorizer_refresh_authorization_async:
+ * @iface: A #GFBGraphAuthorizer.
+ * @cancellable: (allow-none): An optional #GCancellable object, or %NULL.
+ * @callback: (scope async): A #GAsyncReadyCallback to call when the refresh is completed.
+ * @user_data: (closure): The data to pass to @callback.
+ *
+ * Asynchronously forces @iface to refresh any authorization tokens held by it.
+ * See gfbgraph_authorizer_refresh_authorization() for the synchronous version
+ * of this call.
+ *
+ * When the operation is finished, @callback will be called. You can then call
+ * gfbgraph_authorizer_refresh_authorization_async_finish() to get the result.
+ */
+void
+gfbgraph_authorizer_refresh_authorization_async (GFBGraphAuthorizer  *iface,
+                                                 GCancellable        *cancellable,
+                                                 GAsyncReadyCallback  callback,
+                                                 gpointer             user_data)
+{
+  g_return_if_fail (GFBGRAPH_IS_AUTHORIZER (iface));
+  g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+
+  GFBGRAPH_AUTHORIZER_GET_IFACE (iface)->refresh_authorization_async (iface,
+                                                                      cancellable,
+                                                                      callback,
+                                                                      user_data);
+}
+
+/**
+ * gfbgraph_authorizer_refresh_authorization_async_finish:
+ * @iface: A #GFBGraphAuthorizer.
+ * @result: A #GAsyncResult.
+ * @error: (allow-none): An optional #GError, or %NULL.
+ *
+ * Finishes an asynchronous operation started with
+ * gfbgraph_authorizer_refresh_authorization_async().
+ *
+ * Returns: %TRUE if the authorizer now has a valid token.
+ */
+gboolean
+gfbgraph_authorizer_refresh_authorization_async_finish (GFBGraphAuthorizer  *iface,
+                                                        GAsyncResult        *result,
+                                                        GError             **error)
+{
+  g_return_val_if_fail (GFBGRAPH_IS_AUTHORIZER (iface), FALSE);
+  g_return_val_if_fail (G_IS_ASYNC_RESULT (result), FALSE);
+
+  return GFBGRAPH_AUTHORIZER_GET_IFACE (iface)->refresh_authorization_finish (iface,
+                                                                              result,
+                                                                              error);
+}
+
+/**
+ * gfbgraph_authorizer_get_account_id:
+ * @iface: A #GFBGraphAuthorizer.
+ *
+ * Gets a stable identifier of the account of @iface, which stays the same
+ * when its tokens are refreshed. The responses cached by #GFBGraphCache are
+ * kept per account with it.
+ *
+ * This method is thread safe.
+ *
+ * Returns: (transfer full) (nullable): the identifier of the account, or %NULL
+ *  if @iface doesn't know it. Free with g_free().
+ */
+gchar *
+gfbgraph_authorizer_get_account_id (GFBGraphAuthorizer *iface)
+{
+  GFBGraphAuthorizerInterface *authorizer_iface;
+
+  g_return_val_if_fail (GFBGRAPH_IS_AUTHORIZER (iface), NULL);
+
+  authorizer_iface = GFBGRAPH_AUTHORIZER_GET_IFACE (iface);
+  if (authorizer_iface->get_account_id == NULL)
+    return NULL;
+
+  return authorizer_iface->get_account_id (iface);
+}
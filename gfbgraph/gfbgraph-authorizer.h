@@ -46,6 +46,11 @@ typedef struct _GFBGraphAuthorizerInterface GFBGraphAuthorizerInterface;
  * @process_message: A method to append authorization headers to a #SoupMessage.
  * @refresh_authorization: A synchronous method to force a refresh of any authorization
  *  tokes held by the authorizer. It should return %TRUE on succes.
+ * @refresh_authorization_async: An asynchronous version of @refresh_authorization. The
+ *  default implementation runs @refresh_authorization in a thread.
+ * @refresh_authorization_finish: Finishes @refresh_authorization_async.
+ * @get_account_id: A method returning a stable identifier of the account, which
+ *  doesn't change when the tokens are refreshed. Optional.
  *
  * Interface structure for #GFBGraphAuthorizer. All methos should be thread safe.
  **/
@@ -59,6 +64,14 @@ struct _GFBGraphAuthorizerInterface {
   gboolean  (*refresh_authorization)  (GFBGraphAuthorizer  *iface,
                                        GCancellable        *cancellable,
                                        GError             **error);
+  void      (*refresh_authorization_async)  (GFBGraphAuthorizer  *iface,
+                                             GCancellable        *cancellable,
+                                             GAsyncReadyCallback  callback,
+                                             gpointer             user_data);
+  gboolean  (*refresh_authorization_finish) (GFBGraphAuthorizer  *iface,
+                                             GAsyncResult        *result,
+                                             GError             **error);
+  gchar*    (*get_account_id)               (GFBGraphAuthorizer  *iface);
 };
 
 GType    gfbgraph_authorizer_get_type              (void) G_GNUC_CONST;
@@ -70,6 +83,14 @@ void     gfbgraph_authorizer_process_message       (GFBGraphAuthorizer *iface,
 gboolean gfbgraph_authorizer_refresh_authorization (GFBGraphAuthorizer  *iface,
                                                     GCancellable        *cancellable,
                                                     GError             **error);
+void     gfbgraph_authorizer_refresh_authorization_async        (GFBGraphAuthorizer  *iface,
+                                                                 GCancellable        *cancellable,
+                                                                 GAsyncReadyCallback  callback,
+                                                                 gpointer             user_data);
+gboolean gfbgraph_authorizer_refresh_authorization_async_finish (GFBGraphAuthorizer  *iface,
+                                                                 GAsyncResult        *result,
+                                                                 GError             **error);
+gchar*   gfbgraph_authorizer_get_account_id        (GFBGraphAuthorizer  *iface);
 
 G_END_DECLS
 
@@ -0,0 +1,784 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 2; tab-width: 2 -*-  */
+/*
+ * libgfbgraph - GObject library for Facebook Graph API
+ * Copyright (C) 2013 Álvaro Peña <alvaropg@gmail.com>
+ *               2020 Leesoo Ahn <yisooan@fedoraproject.org>
+ *
+ * GFBGraph is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GFBGraph is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GFBGraph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * SECTION:gfbgraph-cache
+ * @title: GFBGraphCache
+ * @short_description: Persistent cache of the Graph API responses
+ * @stability: Unstable
+ * @include: gfbgraph/gfbgraph.h
+ *
+ * #GFBGraphCache keeps the raw responses of the GET requests in a directory,
+ * together with the ETag returned by the Graph API. When a cached request is
+ * done again it's sent with an If-None-Match header, and if the Graph API
+ * answers 304 Not Modified the cached response is parsed instead, so unchanged
+ * nodes cost neither the transfer nor a new copy of the response.
+ *
+ * The responses are stored keyed by the requested path, its parameters (like
+ * the requested fields) and the account of the #GFBGraphAuthorizer (see
+ * gfbgraph_authorizer_get_account_id()), so different users never share an
+ * entry and the entries survive the refreshes of the access token. With
+ * authorizers not knowing their account the access token is used instead.
+ * Every entry is a single file which is mapped in memory when used.
+ *
+ * The directory is kept under #GFBGraphCache:max-size, removing the entries
+ * used the longest time ago when it grows over it. The directory is only
+ * scanned when the cache is created; from then on the cache keeps its size and
+ * the order of use of its entries in memory, so the entries stored by other
+ * processes sharing the directory are counted when they're first used.
+ *
+ * Set the cache in a #GFBGraphContext with gfbgraph_context_set_cache().
+ **/
+
+#include <errno.h>
+#include <string.h>
+#include <glib/gstdio.h>
+#include <rest/rest-proxy-call.h>
+
+#include "gfbgraph-cache.h"
+#include "gfbgraph-private.h"
+
+#define ENTRY_MAGIC        "GFBGRC1\n"
+#define ENTRY_MAGIC_LENGTH 8
+#define ENTRY_HEADER_SIZE  (ENTRY_MAGIC_LENGTH + sizeof (guint32))
+#define ENTRY_SUFFIX       ".entry"
+
+#define DEFAULT_MAX_SIZE   (64 * 1024 * 1024)
+
+enum {
+  PROP_0,
+  PROP_DIRECTORY,
+  PROP_MAX_AGE,
+  PROP_MAX_SIZE
+};
+
+struct _GFBGraphCachePrivate {
+  gchar      *directory;
+  guint       max_age;
+
+  GMutex      mutex;     /* Guards the sizes and the index */
+  guint64     max_size;
+  guint64     size;      /* Of the indexed entries */
+  GQueue      lru;       /* EntryFile, the least recently used first */
+  GHashTable *index;     /* Path -> link of the EntryFile in lru */
+};
+
+typedef struct {
+  gchar   *path;
+  guint64  size;
+  gint64   used_time;
+} EntryFile;
+
+#define GFBGRAPH_CACHE_GET_PRIVATE(o) \
+  (G_TYPE_INSTANCE_GET_PRIVATE((o), GFBGRAPH_TYPE_CACHE, GFBGraphCachePrivate))
+
+static GObjectClass *parent_class = NULL;
+
+static void entry_file_free (gpointer data);
+static void load_index     (GFBGraphCache *cache);
+
+G_DEFINE_TYPE (GFBGraphCache, gfbgraph_cache, G_TYPE_OBJECT);
+
+static void
+gfbgraph_cache_constructed (GObject *object)
+{
+  load_index (GFBGRAPH_CACHE (object));
+
+  G_OBJECT_CLASS (parent_class)->constructed (object);
+}
+
+static void
+gfbgraph_cache_finalize (GObject *object)
+{
+  GFBGraphCachePrivate *priv = GFBGRAPH_CACHE_GET_PRIVATE (object);
+
+  g_free (priv->directory);
+  g_hash_table_unref (priv->index);
+  g_queue_foreach (&priv->lru, (GFunc) entry_file_free, NULL);
+  g_queue_clear (&priv->lru);
+  g_mutex_clear (&priv->mutex);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static void
+gfbgraph_cache_set_property (GObject      *object,
+                             guint         prop_id,
+                             const GValue *value,
+                             GParamSpec   *pspec)
+{
+  GFBGraphCachePrivate *priv = GFBGRAPH_CACHE_GET_PRIVATE (object);
+
+  switch (prop_id) {
+    case PROP_DIRECTORY:
+      g_free (priv->directory);
+      priv->directory = g_value_dup_string (value);
+      break;
+    case PROP_MAX_AGE:
+      g_atomic_int_set (&priv->max_age, g_value_get_uint (value));
+      break;
+    case PROP_MAX_SIZE:
+      g_mutex_lock (&priv->mutex);
+      priv->max_size = g_value_get_uint64 (value);
+      g_mutex_unlock (&priv->mutex);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gfbgraph_cache_get_property (GObject    *object,
+                             guint       prop_id,
+                             GValue     *value,
+                             GParamSpec *pspec)
+{
+  GFBGraphCachePrivate *priv = GFBGRAPH_CACHE_GET_PRIVATE (object);
+
+  switch (prop_id) {
+    case PROP_DIRECTORY:
+      g_value_set_string (value, priv->directory);
+      break;
+    case PROP_MAX_AGE:
+      g_value_set_uint (value, g_atomic_int_get (&priv->max_age));
+      break;
+    case PROP_MAX_SIZE:
+      g_mutex_lock (&priv->mutex);
+      g_value_set_uint64 (value, priv->max_size);
+      g_mutex_unlock (&priv->mutex);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gfbgraph_cache_class_init (GFBGraphCacheClass *klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+
+  parent_class                 = g_type_class_peek_parent (klass);
+  gobject_class->constructed   = gfbgraph_cache_constructed;
+  gobject_class->finalize      = gfbgraph_cache_finalize;
+  gobject_class->set_property  = gfbgraph_cache_set_property;
+  gobject_class->get_property  = gfbgraph_cache_get_property;
+
+  g_type_class_add_private (gobject_class, sizeof(GFBGraphCachePrivate));
+
+  /**
+   * GFBGraphCache:directory:
+   *
+   * The directory where the cached responses are stored.
+   **/
+  g_object_class_install_property (gobject_class,
+                                   PROP_DIRECTORY,
+                                   g_param_spec_string ("directory",
+                                                        "Cache directory",
+                                                        "The directory of the cached responses",
+                                                        NULL,
+                                                        G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE));
+
+  /**
+   * GFBGraphCache:max-age:
+   *
+   * The number of seconds a cached response is used without asking the Graph
+   * API if it changed. With 0, the default, every cached response is revalidated.
+   **/
+  g_object_class_install_property (gobject_class,
+                                   PROP_MAX_AGE,
+                                   g_param_spec_uint ("max-age",
+                                                      "Maximum age",
+                                                      "The seconds a cached response is used without revalidation",
+                                                      0, G_MAXUINT, 0,
+                                                      G_PARAM_READWRITE));
+
+  /**
+   * GFBGraphCache:max-size:
+   *
+   * The maximum size in bytes of the cached responses. When the directory
+   * grows over it, the entries used the longest time ago are removed.
+   **/
+  g_object_class_install_property (gobject_class,
+                                   PROP_MAX_SIZE,
+                                   g_param_spec_uint64 ("max-size",
+                                                        "Maximum size",
+                                                        "The maximum size in bytes of the cached responses",
+                                                        0, G_MAXUINT64, DEFAULT_MAX_SIZE,
+                                                        G_PARAM_READWRITE));
+}
+
+static void
+gfbgraph_cache_init (GFBGraphCache *obj)
+{
+  obj->priv = GFBGRAPH_CACHE_GET_PRIVATE (obj);
+
+  g_mutex_init (&obj->priv->mutex);
+  obj->priv->max_size = DEFAULT_MAX_SIZE;
+  g_queue_init (&obj->priv->lru);
+  obj->priv->index = g_hash_table_new (g_str_hash, g_str_equal);
+}
+
+/* --- Private Functions --- */
+static gint
+compare_strings (gconstpointer a,
+                 gconstpointer b)
+{
+  return g_strcmp0 (*(const gchar **) a, *(const gchar **) b);
+}
+
+static gchar *
+get_entry_path (GFBGraphCache *cache,
+                const gchar   *key)
+{
+  gchar *checksum;
+  gchar *filename;
+  gchar *path;
+
+  checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA256, key, -1);
+  filename = g_strconcat (checksum, ENTRY_SUFFIX, NULL);
+  path = g_build_filename (cache->priv->directory, filename, NULL);
+  g_free (filename);
+  g_free (checksum);
+
+  return path;
+}
+
+static void
+entry_file_free (gpointer data)
+{
+  EntryFile *file = data;
+
+  g_free (file->path);
+  g_slice_free (EntryFile, file);
+}
+
+static gint
+compare_entry_files (gconstpointer a,
+                     gconstpointer b)
+{
+  const EntryFile *file_a = *(const EntryFile **) a;
+  const EntryFile *file_b = *(const EntryFile **) b;
+
+  return (file_a->used_time > file_b->used_time) - (file_a->used_time < file_b->used_time);
+}
+
+/* Fills the index with the entries in the directory, the least recently used
+ * first. The entries are touched when revalidated, so their modification time
+ * is the last time they were used. */
+static void
+load_index (GFBGraphCache *cache)
+{
+  GFBGraphCachePrivate *priv = cache->priv;
+  GPtrArray *files;
+  GDir *dir;
+  const gchar *filename;
+  guint i;
+
+  if (priv->directory == NULL)
+    return;
+
+  dir = g_dir_open (priv->directory, 0, NULL);
+  if (dir == NULL)
+    return;
+
+  files = g_ptr_array_new ();
+  while ((filename = g_dir_read_name (dir)) != NULL) {
+    GStatBuf stat_buf;
+    EntryFile *file;
+    gchar *path;
+
+    if (!g_str_has_suffix (filename, ENTRY_SUFFIX))
+      continue;
+
+    path = g_build_filename (priv->directory, filename, NULL);
+    if (g_stat (path, &stat_buf) != 0) {
+      g_free (path);
+      continue;
+    }
+
+    file = g_slice_new (EntryFile);
+    file->path = path;
+    file->size = stat_buf.st_size;
+    file->used_time = stat_buf.st_mtime;
+    g_ptr_array_add (files, file);
+  }
+  g_dir_close (dir);
+
+  g_ptr_array_sort (files, compare_entry_files);
+  for (i = 0; i < files->len; i++) {
+    EntryFile *file = g_ptr_array_index (files, i);
+
+    g_queue_push_tail (&priv->lru, file);
+    g_hash_table_insert (priv->index, file->path, priv->lru.tail);
+    priv->size += file->size;
+  }
+  g_ptr_array_free (files, TRUE);
+}
+
+/* Marks the entry at @path, of @size bytes, as the most recently used one,
+ * adding it to the index if needed */
+static void
+use_entry_locked (GFBGraphCache *cache,
+                  const gchar   *path,
+                  guint64        size)
+{
+  GFBGraphCachePrivate *priv = cache->priv;
+  EntryFile *file;
+  GList *link;
+
+  link = g_hash_table_lookup (priv->index, path);
+  if (link != NULL) {
+    file = link->data;
+    priv->size -= file->size;
+    g_queue_unlink (&priv->lru, link);
+    g_queue_push_tail_link (&priv->lru, link);
+  } else {
+    file = g_slice_new (EntryFile);
+    file->path = g_strdup (path);
+    g_queue_push_tail (&priv->lru, file);
+    g_hash_table_insert (priv->index, file->path, priv->lru.tail);
+  }
+
+  file->size = size;
+  file->used_time = g_get_real_time () / G_USEC_PER_SEC;
+  priv->size += size;
+}
+
+static void
+forget_entry_locked (GFBGraphCache *cache,
+                     GList         *link)
+{
+  GFBGraphCachePrivate *priv = cache->priv;
+  EntryFile *file = link->data;
+
+  priv->size -= file->size;
+  g_hash_table_remove (priv->index, file->path);
+  g_queue_delete_link (&priv->lru, link);
+  entry_file_free (file);
+}
+
+/* Removes the entries used the longest time ago until the directory is at
+ * three quarters of the maximum size, so it isn't trimmed on every store */
+static void
+trim_locked (GFBGraphCache *cache)
+{
+  GFBGraphCachePrivate *priv = cache->priv;
+
+  if (priv->size <= priv->max_size)
+    return;
+
+  while (priv->lru.head != NULL && priv->size > priv->max_size / 4 * 3) {
+    EntryFile *file = priv->lru.head->data;
+
+    if (g_unlink (file->path) != 0 && errno != ENOENT)
+      g_debug ("Unable to remove the cache entry %s: %s", file->path, g_strerror (errno));
+    forget_entry_locked (cache, priv->lru.head);
+  }
+}
+
+/* --- Internal API --- */
+
+/* Returns the cache key of a GET @call: its function and its parameters sorted
+ * by name, without the access token. The checksum of the account of the
+ * authorizer is added instead, so the responses of different users never share
+ * an entry and a refreshed token still finds them. The checksum of the access
+ * token is used if the authorizer doesn't know its account. */
+gchar *
+gfbgraph_cache_get_key (RestProxyCall *call)
+{
+  GFBGraphAuthorizer *authorizer;
+  RestParams *params;
+  RestParamsIter iter;
+  const gchar *name;
+  RestParam *param;
+  GPtrArray *parts;
+  GString *key;
+  gchar *account_id = NULL;
+  gboolean has_account;
+  guint i;
+
+  key = g_string_new (rest_proxy_call_get_function (call));
+
+  parts = g_ptr_array_new_with_free_func (g_free);
+
+  authorizer = gfbgraph_call_get_authorizer (call);
+  if (authorizer != NULL)
+    account_id = gfbgraph_authorizer_get_account_id (authorizer);
+  has_account = account_id != NULL;
+  if (has_account) {
+    gchar *account;
+
+    account = g_compute_checksum_for_string (G_CHECKSUM_SHA256, account_id, -1);
+    g_ptr_array_add (parts, g_strconcat ("account=", account, NULL));
+    g_free (account);
+    g_free (account_id);
+  }
+
+  params = rest_proxy_call_get_params (call);
+  rest_params_iter_init (&iter, params);
+  while (rest_params_iter_next (&iter, &name, &param)) {
+    const gchar *value;
+
+    if (!rest_param_is_string (param))
+      continue;
+
+    value = rest_param_get_content (param);
+    if (g_strcmp0 (name, "access_token") == 0) {
+      gchar *scope;
+
+      if (has_account)
+        continue;
+
+      scope = g_compute_checksum_for_string (G_CHECKSUM_SHA256, value, -1);
+      g_ptr_array_add (parts, g_strconcat ("scope=", scope, NULL));
+      g_free (scope);
+    } else {
+      g_ptr_array_add (parts, g_strconcat (name, "=", value, NULL));
+    }
+  }
+  g_ptr_array_sort (parts, compare_strings);
+
+  for (i = 0; i < parts->len; i++) {
+    g_string_append_c (key, i == 0 ? '?' : '&');
+    g_string_append (key, g_ptr_array_index (parts, i));
+  }
+  g_ptr_array_unref (parts);
+
+  return g_string_free (key, FALSE);
+}
+
+/* Returns the cached response for @key, or %NULL. The payload of the entry
+ * points to the mapped file. */
+GFBGraphCacheEntry *
+gfbgraph_cache_lookup (GFBGraphCache *cache,
+                       const gchar   *key)
+{
+  GFBGraphCacheEntry *entry = NULL;
+  GMappedFile *mapped_file;
+  GStatBuf stat_buf;
+  gchar *path;
+  const gchar *contents;
+  gsize length;
+  guint32 etag_length;
+
+  path = get_entry_path (cache, key);
+
+  if (g_stat (path, &stat_buf) != 0) {
+    GList *link;
+
+    /* Removed by another process */
+    g_mutex_lock (&cache->priv->mutex);
+    link = g_hash_table_lookup (cache->priv->index, path);
+    if (link != NULL)
+      forget_entry_locked (cache, link);
+    g_mutex_unlock (&cache->priv->mutex);
+
+    g_free (path);
+    return NULL;
+  }
+
+  mapped_file = g_mapped_file_new (path, FALSE, NULL);
+  if (mapped_file == NULL) {
+    g_free (path);
+    return NULL;
+  }
+
+  g_mutex_lock (&cache->priv->mutex);
+  use_entry_locked (cache, path, stat_buf.st_size);
+  g_mutex_unlock (&cache->priv->mutex);
+  g_free (path);
+
+  contents = g_mapped_file_get_contents (mapped_file);
+  length = g_mapped_file_get_length (mapped_file);
+  if (length >= ENTRY_HEADER_SIZE && memcmp (contents, ENTRY_MAGIC, ENTRY_MAGIC_LENGTH) == 0) {
+    memcpy (&etag_length, contents + ENTRY_MAGIC_LENGTH, sizeof (guint32));
+    etag_length = GUINT32_FROM_LE (etag_length);
+
+    if (etag_length <= length - ENTRY_HEADER_SIZE) {
+      GBytes *bytes;
+
+      bytes = g_mapped_file_get_bytes (mapped_file);
+
+      entry = g_slice_new0 (GFBGraphCacheEntry);
+      entry->etag = g_strndup (contents + ENTRY_HEADER_SIZE, etag_length);
+      entry->payload = g_bytes_new_from_bytes (bytes,
+                                               ENTRY_HEADER_SIZE + etag_length,
+                                               length - ENTRY_HEADER_SIZE - etag_length);
+      entry->stored_time = stat_buf.st_mtime;
+
+      g_bytes_unref (bytes);
+    }
+  }
+
+  g_mapped_file_unref (mapped_file);
+
+  return entry;
+}
+
+/* Whether @entry can be used without revalidating it */
+gboolean
+gfbgraph_cache_entry_is_fresh (GFBGraphCache      *cache,
+                               GFBGraphCacheEntry *entry)
+{
+  guint max_age;
+
+  max_age = g_atomic_int_get (&cache->priv->max_age);
+
+  return max_age > 0 && entry->stored_time + max_age > g_get_real_time () / G_USEC_PER_SEC;
+}
+
+void
+gfbgraph_cache_entry_free (GFBGraphCacheEntry *entry)
+{
+  if (entry == NULL)
+    return;
+
+  g_free (entry->etag);
+  g_bytes_unref (entry->payload);
+  g_slice_free (GFBGraphCacheEntry, entry);
+}
+
+/* Stores the response of a request. The file is replaced atomically, so
+ * concurrent readers see either the old or the new entry. */
+void
+gfbgraph_cache_store (GFBGraphCache *cache,
+                      const gchar   *key,
+                      const gchar   *etag,
+                      GBytes        *payload)
+{
+  GByteArray *contents;
+  GError *error = NULL;
+  gchar *path;
+  guint32 etag_length;
+  gsize payload_length;
+  gconstpointer payload_data;
+
+  payload_data = g_bytes_get_data (payload, &payload_length);
+  etag_length = strlen (etag);
+
+  contents = g_byte_array_sized_new (ENTRY_HEADER_SIZE + etag_length + payload_length);
+  g_byte_array_append (contents, (const guint8 *) ENTRY_MAGIC, ENTRY_MAGIC_LENGTH);
+  etag_length = GUINT32_TO_LE (etag_length);
+  g_byte_array_append (contents, (const guint8 *) &etag_length, sizeof (guint32));
+  g_byte_array_append (contents, (const guint8 *) etag, strlen (etag));
+  g_byte_array_append (contents, payload_data, payload_length);
+
+  path = get_entry_path (cache, key);
+  if (!g_file_set_contents (path, (const gchar *) contents->data, contents->len, &error)) {
+    g_debug ("Unable to store the cache entry %s: %s", path, error->message);
+    g_error_free (error);
+  } else {
+    g_mutex_lock (&cache->priv->mutex);
+    use_entry_locked (cache, path, contents->len);
+    trim_locked (cache);
+    g_mutex_unlock (&cache->priv->mutex);
+  }
+  g_free (path);
+
+  g_byte_array_unref (contents);
+}
+
+/* Marks the entry of @key as revalidated now */
+void
+gfbgraph_cache_touch (GFBGraphCache *cache,
+                      const gchar   *key)
+{
+  GStatBuf stat_buf;
+  gchar *path;
+
+  path = get_entry_path (cache, key);
+  if (g_utime (path, NULL) == 0 && g_stat (path, &stat_buf) == 0) {
+    g_mutex_lock (&cache->priv->mutex);
+    use_entry_locked (cache, path, stat_buf.st_size);
+    g_mutex_unlock (&cache->priv->mutex);
+  }
+  g_free (path);
+}
+
+/* --- Public API --- */
+
+/**
+ * gfbgraph_cache_new:
+ * @directory: the directory where the responses are stored. It's created if it doesn't exist.
+ * @error: (allow-none): a #GError or %NULL.
+ *
+ * Creates a new #GFBGraphCache storing the responses in @directory. The same
+ * directory can be used by several caches, even in different processes.
+ *
+ * Returns: (transfer full): a new #GFBGraphCache, or %NULL if @directory can't be created.
+ **/
+GFBGraphCache *
+gfbgraph_cache_new (const gchar  *directory,
+                    GError      **error)
+{
+  g_return_val_if_fail (directory != NULL, NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  if (g_mkdir_with_parents (directory, 0700) != 0) {
+    gint saved_errno = errno;
+
+    g_set_error (error, G_IO_ERROR, g_io_error_from_errno (saved_errno),
+                 "Unable to create the cache directory %s: %s",
+                 directory, g_strerror (saved_errno));
+    return NULL;
+  }
+
+  return GFBGRAPH_CACHE (g_object_new (GFBGRAPH_TYPE_CACHE,
+                                       "directory", directory,
+                                       NULL));
+}
+
+/**
+ * gfbgraph_cache_get_directory:
+ * @cache: a #GFBGraphCache.
+ *
+ * Returns: (transfer none): the directory where @cache stores the responses.
+ **/
+const gchar *
+gfbgraph_cache_get_directory (GFBGraphCache *cache)
+{
+  g_return_val_if_fail (GFBGRAPH_IS_CACHE (cache), NULL);
+
+  return cache->priv->directory;
+}
+
+/**
+ * gfbgraph_cache_get_max_age:
+ * @cache: a #GFBGraphCache.
+ *
+ * Returns: the number of seconds a cached response is used without revalidation.
+ **/
+guint
+gfbgraph_cache_get_max_age (GFBGraphCache *cache)
+{
+  guint max_age;
+
+  g_return_val_if_fail (GFBGRAPH_IS_CACHE (cache), 0);
+
+  g_object_get (G_OBJECT (cache),
+                "max-age", &max_age,
+                NULL);
+
+  return max_age;
+}
+
+/**
+ * gfbgraph_cache_set_max_age:
+ * @cache: a #GFBGraphCache.
+ * @max_age: the number of seconds, or 0 to revalidate every cached response.
+ *
+ * Sets the number of seconds a cached response is used without asking the
+ * Graph API if it changed.
+ **/
+void
+gfbgraph_cache_set_max_age (GFBGraphCache *cache,
+                            guint          max_age)
+{
+  g_return_if_fail (GFBGRAPH_IS_CACHE (cache));
+
+  g_object_set (G_OBJECT (cache),
+                "max-age", max_age,
+                NULL);
+}
+
+/**
+ * gfbgraph_cache_get_max_size:
+ * @cache: a #GFBGraphCache.
+ *
+ * Returns: the maximum size in bytes of the cached responses.
+ **/
+guint64
+gfbgraph_cache_get_max_size (GFBGraphCache *cache)
+{
+  guint64 max_size;
+
+  g_return_val_if_fail (GFBGRAPH_IS_CACHE (cache), 0);
+
+  g_object_get (G_OBJECT (cache),
+                "max-size", &max_size,
+                NULL);
+
+  return max_size;
+}
+
+/**
+ * gfbgraph_cache_set_max_size:
+ * @cache: a #GFBGraphCache.
+ * @max_size: the maximum size in bytes.
+ *
+ * Sets the maximum size of the cached responses. It's enforced when a new
+ * response is stored, removing the entries used the longest time ago.
+ **/
+void
+gfbgraph_cache_set_max_size (GFBGraphCache *cache,
+                             guint64        max_size)
+{
+  g_return_if_fail (GFBGRAPH_IS_CACHE (cache));
+
+  g_object_set (G_OBJECT (cache),
+                "max-size", max_size,
+                NULL);
+}
+
+/**
+ * gfbgraph_cache_clear:
+ * @cache: a #GFBGraphCache.
+ * @error: (allow-none): a #GError or %NULL.
+ *
+ * Removes all the cached responses.
+ *
+ * Returns: %TRUE on success, %FALSE if an error ocurred.
+ **/
+gboolean
+gfbgraph_cache_clear (GFBGraphCache  *cache,
+                      GError        **error)
+{
+  GDir *dir;
+  const gchar *filename;
+
+  g_return_val_if_fail (GFBGRAPH_IS_CACHE (cache), FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  dir = g_dir_open (cache->priv->directory, 0, error);
+  if (dir == NULL)
+    return FALSE;
+
+  while ((filename = g_dir_read_name (dir)) != NULL) {
+    gchar *path;
+
+    if (!g_str_has_suffix (filename, ENTRY_SUFFIX))
+      continue;
+
+    path = g_build_filename (cache->priv->directory, filename, NULL);
+    g_unlink (path);
+    g_free (path);
+  }
+
+  g_dir_close (dir);
+
+  g_mutex_lock (&cache->priv->mutex);
+  while (cache->priv->lru.head != NULL)
+    forget_entry_locked (cache, cache->priv->lru.head);
+  g_mutex_unlock (&cache->priv->mutex);
+
+  return TRUE;
+}
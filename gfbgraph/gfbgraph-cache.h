@@ -0,0 +1,73 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 2; tab-width: 2 -*-  */
+/*
+ * libgfbgraph - GObject library for Facebook Graph API
+ * Copyright (C) 2013 Álvaro Peña <alvaropg@gmail.com>
+ *               2020 Leesoo Ahn <yisooan@fedoraproject.org>
+ *
+ * GFBGraph is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GFBGraph is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GFBGraph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GFBGRAPH_CACHE_H__
+#define __GFBGRAPH_CACHE_H__
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define GFBGRAPH_TYPE_CACHE (gfbgraph_cache_get_type())
+#define GFBGRAPH_CACHE(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj),GFBGRAPH_TYPE_CACHE,GFBGraphCache))
+#define GFBGRAPH_CACHE_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass),GFBGRAPH_TYPE_CACHE,GFBGraphCacheClass))
+#define GFBGRAPH_IS_CACHE(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj),GFBGRAPH_TYPE_CACHE))
+#define GFBGRAPH_IS_CACHE_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass),GFBGRAPH_TYPE_CACHE))
+#define GFBGRAPH_CACHE_GET_CLASS(obj) \
+  (G_TYPE_INSTANCE_GET_CLASS((obj),GFBGRAPH_TYPE_CACHE,GFBGraphCacheClass))
+
+typedef struct _GFBGraphCache        GFBGraphCache;
+typedef struct _GFBGraphCacheClass   GFBGraphCacheClass;
+typedef struct _GFBGraphCachePrivate GFBGraphCachePrivate;
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (GFBGraphCache, g_object_unref)
+
+struct _GFBGraphCache {
+  GObject parent;
+
+  /*< private >*/
+  GFBGraphCachePrivate *priv;
+};
+
+struct _GFBGraphCacheClass {
+  GObjectClass parent_class;
+};
+
+GType          gfbgraph_cache_get_type      (void) G_GNUC_CONST;
+GFBGraphCache* gfbgraph_cache_new           (const gchar    *directory,
+                                             GError        **error);
+
+const gchar*   gfbgraph_cache_get_directory (GFBGraphCache  *cache);
+guint          gfbgraph_cache_get_max_age   (GFBGraphCache  *cache);
+void           gfbgraph_cache_set_max_age   (GFBGraphCache  *cache,
+                                             guint           max_age);
+guint64        gfbgraph_cache_get_max_size  (GFBGraphCache  *cache);
+void           gfbgraph_cache_set_max_size  (GFBGraphCache  *cache,
+                                             guint64         max_size);
+gboolean       gfbgraph_cache_clear         (GFBGraphCache  *cache,
+                                             GError        **error);
+
+G_END_DECLS
+
+#endif /* __GFBGRAPH_CACHE_H__ */
@@ -18,11 +18,12 @@
  * License along with GFBGraph.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include "gfbgraph-common.h"
-
+#include <json-glib/json-glib.h>
 #include <rest/rest-proxy.h>
 
-#define FACEBOOK_ENDPOINT "https://graph.facebook.com/v7.0"
+#include "gfbgraph-common.h"
+#include "gfbgraph-context.h"
+#include "gfbgraph-private.h"
 
 /**
  * gfbgraph_new_rest_call:
@@ -31,22 +32,1075 @@
  * Create a new #RestProxyCall pointing to the Facebook Graph API url (https://graph.facebook.com)
  * and processed by the authorizer to allow queries.
  *
+ * The call is created from the #GFBGraphContext used by @authorizer (see
+ * gfbgraph_context_get_for_authorizer()), so all the calls share the same proxy
+ * and their HTTP connections are reused.
+ *
  * Returns: (transfer full): a new #RestProxyCall or %NULL in case of error.
  **/
 RestProxyCall *
 gfbgraph_new_rest_call (GFBGraphAuthorizer *authorizer)
 {
-  RestProxy *proxy;
-  RestProxyCall *rest_call;
-
   g_return_val_if_fail (GFBGRAPH_IS_AUTHORIZER (authorizer), NULL);
 
-  proxy = rest_proxy_new (FACEBOOK_ENDPOINT, FALSE);
-  rest_call = rest_proxy_new_call (proxy);
+  return gfbgraph_context_new_call (gfbgraph_context_get_for_authorizer (authorizer),
+                                    authorizer);
+}
+
+/* Converts an array of nodes into a list, keeping the order. Takes the
+ * ownership of @nodes and moves its references to the returned list. */
+GList *
+gfbgraph_nodes_array_to_list (GPtrArray *nodes)
+{
+  GList *list = NULL;
+  guint i;
+
+  if (nodes == NULL)
+    return NULL;
+
+  for (i = nodes->len; i > 0; i--)
+    list = g_list_prepend (list, g_ptr_array_index (nodes, i - 1));
+
+  g_ptr_array_set_free_func (nodes, NULL);
+  g_ptr_array_unref (nodes);
+
+  return list;
+}
+
+/* The inverse of gfbgraph_nodes_array_to_list(), takes the ownership of
+ * @nodes and moves its references to the returned array. */
+GPtrArray *
+gfbgraph_nodes_list_to_array (GList *nodes)
+{
+  GPtrArray *array;
+  GList *l;
+
+  array = g_ptr_array_new_full (g_list_length (nodes), g_object_unref);
+  for (l = nodes; l != NULL; l = l->next)
+    g_ptr_array_add (array, l->data);
+
+  g_list_free (nodes);
+
+  return array;
+}
+
+/* --- Request layer --- */
+
+/* All the requests of the library are sent through gfbgraph_call_sync() or
+ * gfbgraph_call_async(). The payload is returned as a #GBytes which keeps the
+ * call alive, so the response is never copied. The _parsed() variants return
+ * the object built from the payload by a parse function instead.
+ *
+ * Calls created by a #GFBGraphContext wait in its #GFBGraphScheduler before
+ * being sent, and their GET requests are revalidated against its
+ * #GFBGraphCache, if any. A call rejected because its access token expired or
+ * was revoked is sent once more after refreshing the authorization, and the
+ * ones failed for a transient reason are sent again as told by the
+ * #GFBGraphRetryPolicy of the context.
+ *
+ * The synchronous calls can only be cancelled while they wait for the
+ * scheduler or a retry, as librest can't interrupt a synchronous exchange. */
+
+/* Graph API errors meaning that the access token isn't valid anymore */
+#define GRAPH_ERROR_API_SESSION     102
+#define GRAPH_ERROR_NO_ACCESS_TOKEN 104
+#define GRAPH_ERROR_ACCESS_TOKEN    190
+
+typedef struct {
+  GFBGraphCache      *cache;
+  gchar              *key;
+  GFBGraphCacheEntry *entry;
+  gboolean            reauthorized; /* Already sent again with a refreshed token */
+  GError             *auth_error;   /* The error of the call while refreshing */
+  GFBGraphRetryPolicy *retry_policy;
+  GFBGraphRetryState  retry_state;
+} CallData;
+
+static GFBGraphScheduler *
+call_get_scheduler (RestProxyCall *call)
+{
+  GFBGraphContext *context;
+
+  context = gfbgraph_call_get_context (call);
+  if (context == NULL || gfbgraph_call_get_authorizer (call) == NULL)
+    return NULL;
+
+  return gfbgraph_context_get_scheduler (context);
+}
+
+static GBytes *
+call_get_payload (RestProxyCall *call)
+{
+  return g_bytes_new_with_free_func (rest_proxy_call_get_payload (call),
+                                     rest_proxy_call_get_payload_length (call),
+                                     g_object_unref,
+                                     g_object_ref (call));
+}
+
+static void
+call_data_clear (CallData *data)
+{
+  g_clear_object (&data->cache);
+  g_free (data->key);
+  gfbgraph_cache_entry_free (data->entry);
+  g_clear_error (&data->auth_error);
+  g_clear_object (&data->retry_policy);
+}
+
+static void
+call_data_free (gpointer data)
+{
+  call_data_clear (data);
+  g_slice_free (CallData, data);
+}
+
+/* Looks for a cached response of a GET @call, making the request conditional
+ * when there is one */
+static void
+call_prepare_cache (RestProxyCall *call,
+                    CallData      *data)
+{
+  GFBGraphContext *context;
+
+  context = gfbgraph_call_get_context (call);
+  if (context == NULL || g_strcmp0 (rest_proxy_call_get_method (call), "GET") != 0)
+    return;
+
+  data->cache = gfbgraph_context_dup_cache (context);
+  if (data->cache == NULL)
+    return;
+
+  data->key = gfbgraph_cache_get_key (call);
+  data->entry = gfbgraph_cache_lookup (data->cache, data->key);
+  if (data->entry != NULL && data->entry->etag[0] != '\0')
+    rest_proxy_call_add_header (call, "If-None-Match", data->entry->etag);
+}
+
+/* Takes the retry policy of the context of @call, if any, and counts the
+ * call in its budget */
+static void
+call_prepare_retry (RestProxyCall *call,
+                    CallData      *data)
+{
+  GFBGraphContext *context;
+
+  context = gfbgraph_call_get_context (call);
+  if (context == NULL)
+    return;
+
+  data->retry_policy = gfbgraph_context_dup_retry_policy (context);
+  if (data->retry_policy != NULL)
+    gfbgraph_retry_policy_deposit (data->retry_policy);
+}
+
+/* Whether @call failed with @error because of its access token, and it can be
+ * sent again once the authorization is refreshed */
+static gboolean
+call_needs_reauthorization (RestProxyCall *call,
+                            CallData      *data,
+                            const GError  *error)
+{
+  gint error_code;
+
+  if (data->reauthorized
+      || error->domain != REST_PROXY_ERROR
+      || gfbgraph_call_get_authorizer (call) == NULL)
+    return FALSE;
+
+  error_code = gfbgraph_call_get_graph_error_code (call);
+
+  return error_code == GRAPH_ERROR_ACCESS_TOKEN
+    || error_code == GRAPH_ERROR_API_SESSION
+    || error_code == GRAPH_ERROR_NO_ACCESS_TOKEN;
+}
+
+/* Replaces the access token of @call with the one of its refreshed authorizer.
+ * The cache key follows the token when there is no account to key on. */
+static void
+call_reauthorize (RestProxyCall *call,
+                  CallData      *data)
+{
+  gfbgraph_authorizer_process_call (gfbgraph_call_get_authorizer (call), call);
+
+  if (data->cache != NULL) {
+    g_free (data->key);
+    data->key = gfbgraph_cache_get_key (call);
+  }
+}
+
+/* Whether @call failed with @error has to be sent again after @delay microseconds */
+static gboolean
+call_needs_retry (RestProxyCall *call,
+                  CallData      *data,
+                  const GError  *error,
+                  gint64        *delay)
+{
+  if (data->retry_policy == NULL)
+    return FALSE;
+
+  return gfbgraph_retry_policy_next_delay (data->retry_policy, call, error, &data->retry_state, delay);
+}
+
+/* Returns the payload of a sent @call, or the cached one when the Graph API
+ * answered 304 Not Modified. New responses with an ETag are cached. */
+static GBytes *
+call_complete (RestProxyCall  *call,
+               gboolean        success,
+               CallData       *data,
+               GError        **error)
+{
+  GBytes *payload;
+  gchar *etag;
+
+  if (!success) {
+    if (data->entry != NULL
+        && g_error_matches (*error, REST_PROXY_ERROR, REST_PROXY_ERROR_HTTP_NOT_MODIFIED)) {
+      g_clear_error (error);
+      gfbgraph_cache_touch (data->cache, data->key);
+      return g_bytes_ref (data->entry->payload);
+    }
+
+    return NULL;
+  }
+
+  payload = call_get_payload (call);
+
+  if (data->cache != NULL) {
+    etag = gfbgraph_call_lookup_response_header (call, "ETag");
+    if (etag != NULL)
+      gfbgraph_cache_store (data->cache, data->key, etag, payload);
+    g_free (etag);
+  }
+
+  return payload;
+}
+
+/* Sleeps @delay microseconds, or less if @cancellable is cancelled */
+static void
+call_sleep (gint64        delay,
+            GCancellable *cancellable)
+{
+  GPollFD pollfd;
+
+  if (cancellable == NULL || !g_cancellable_make_pollfd (cancellable, &pollfd)) {
+    g_usleep (delay);
+    return;
+  }
+
+  g_poll (&pollfd, 1, delay / 1000);
+  g_cancellable_release_fd (cancellable);
+}
+
+/* Sends @call blocking the calling thread. Returns the payload of the response
+ * or %NULL with @error set. */
+static GBytes *
+call_run_sync (RestProxyCall  *call,
+               GCancellable   *cancellable,
+               GError        **error)
+{
+  GFBGraphScheduler *scheduler;
+  CallData call_data = { NULL, };
+  GBytes *payload = NULL;
+  GError *call_error = NULL;
+  gboolean success;
+  gint64 delay;
+
+  call_prepare_cache (call, &call_data);
+  if (call_data.entry != NULL && gfbgraph_cache_entry_is_fresh (call_data.cache, call_data.entry)) {
+    payload = g_bytes_ref (call_data.entry->payload);
+    call_data_clear (&call_data);
+    return payload;
+  }
+
+  call_prepare_retry (call, &call_data);
+  scheduler = call_get_scheduler (call);
+
+  for (;;) {
+    if (g_cancellable_set_error_if_cancelled (cancellable, error)
+        || (scheduler != NULL
+            && !gfbgraph_scheduler_acquire (scheduler, gfbgraph_call_get_authorizer (call),
+                                            cancellable, error))) {
+      call_data_clear (&call_data);
+      return NULL;
+    }
+
+    success = rest_proxy_call_sync (call, &call_error);
+
+    if (scheduler != NULL)
+      gfbgraph_scheduler_release (scheduler, gfbgraph_call_get_authorizer (call), call, NULL);
+
+    if (success)
+      break;
+
+    if (call_needs_reauthorization (call, &call_data, call_error)) {
+      /* On failure the call fails with its own error, more useful than the
+       * one of the refresh */
+      call_data.reauthorized = TRUE;
+      if (!gfbgraph_authorizer_refresh_authorization (gfbgraph_call_get_authorizer (call), NULL, NULL))
+        break;
+      call_reauthorize (call, &call_data);
+    } else if (call_needs_retry (call, &call_data, call_error, &delay)) {
+      call_sleep (delay, cancellable);
+    } else {
+      break;
+    }
+
+    g_clear_error (&call_error);
+  }
+
+  payload = call_complete (call, success, &call_data, &call_error);
+  if (call_error != NULL)
+    g_propagate_error (error, call_error);
+
+  call_data_clear (&call_data);
+
+  return payload;
+}
+
+static void call_send_async (GTask *task);
+
+static void
+call_reauthorized_cb (GObject      *source_object,
+                      GAsyncResult *result,
+                      gpointer      user_data)
+{
+  GTask *task = G_TASK (user_data);
+  CallData *data = g_task_get_task_data (task);
+
+  /* Like in call_run_sync(), a failed refresh returns the error of the call */
+  if (!gfbgraph_authorizer_refresh_authorization_async_finish (GFBGRAPH_AUTHORIZER (source_object),
+                                                               result, NULL)) {
+    if (!g_task_return_error_if_cancelled (task))
+      g_task_return_error (task, g_steal_pointer (&data->auth_error));
+    g_object_unref (task);
+    return;
+  }
+
+  g_clear_error (&data->auth_error);
+  call_reauthorize (REST_PROXY_CALL (g_task_get_source_object (task)), data);
+  call_send_async (task);
+}
+
+/* Called when the delay before a retry elapses, or as soon as the call is
+ * cancelled meanwhile */
+static gboolean
+call_retry_cb (gpointer user_data)
+{
+  GTask *task = G_TASK (user_data);
+
+  if (g_task_return_error_if_cancelled (task))
+    g_object_unref (task);
+  else
+    call_send_async (task);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+call_invoked_cb (GObject      *source_object,
+                 GAsyncResult *result,
+                 gpointer      user_data)
+{
+  GTask *task = G_TASK (user_data);
+  RestProxyCall *call = REST_PROXY_CALL (source_object);
+  CallData *data = g_task_get_task_data (task);
+  GFBGraphScheduler *scheduler;
+  GBytes *payload;
+  GError *error = NULL;
+  gboolean success;
+  gint64 delay;
+
+  scheduler = call_get_scheduler (call);
+  if (scheduler != NULL)
+    gfbgraph_scheduler_release (scheduler, gfbgraph_call_get_authorizer (call), call,
+                                g_task_get_context (task));
+
+  success = rest_proxy_call_invoke_finish (call, result, &error);
+
+  if (!success && call_needs_reauthorization (call, data, error)) {
+    data->reauthorized = TRUE;
+    data->auth_error = error;
+    gfbgraph_authorizer_refresh_authorization_async (gfbgraph_call_get_authorizer (call),
+                                                     g_task_get_cancellable (task),
+                                                     call_reauthorized_cb,
+                                                     task);
+    return;
+  }
+
+  if (!success && call_needs_retry (call, data, error, &delay)) {
+    GCancellable *cancellable = g_task_get_cancellable (task);
+    GSource *source;
+
+    g_error_free (error);
+    if (g_task_return_error_if_cancelled (task)) {
+      g_object_unref (task);
+      return;
+    }
+
+    /* The cancellable source wakes the timeout up, so a cancelled call doesn't
+     * wait for the whole delay */
+    source = g_timeout_source_new (delay / 1000);
+    if (cancellable != NULL) {
+      GSource *cancellable_source;
+
+      cancellable_source = g_cancellable_source_new (cancellable);
+      g_source_set_dummy_callback (cancellable_source);
+      g_source_add_child_source (source, cancellable_source);
+      g_source_unref (cancellable_source);
+    }
+    g_task_attach_source (task, source, call_retry_cb);
+    g_source_unref (source);
+    return;
+  }
+
+  payload = call_complete (call, success, data, &error);
+  if (payload != NULL)
+    g_task_return_pointer (task, payload, (GDestroyNotify) g_bytes_unref);
+  else
+    g_task_return_error (task, error);
+
+  g_object_unref (task);
+}
+
+static void
+call_acquired_cb (GObject      *source_object,
+                  GAsyncResult *result,
+                  gpointer      user_data)
+{
+  GTask *task = G_TASK (user_data);
+  GError *error = NULL;
+
+  if (!gfbgraph_scheduler_acquire_finish (GFBGRAPH_SCHEDULER (source_object), result, &error)) {
+    g_task_return_error (task, error);
+    g_object_unref (task);
+    return;
+  }
+
+  rest_proxy_call_invoke_async (REST_PROXY_CALL (g_task_get_source_object (task)),
+                                g_task_get_cancellable (task),
+                                call_invoked_cb,
+                                task);
+}
+
+/* Sends the call of @task, once there is a slot for it in the scheduler */
+static void
+call_send_async (GTask *task)
+{
+  RestProxyCall *call = REST_PROXY_CALL (g_task_get_source_object (task));
+  GFBGraphScheduler *scheduler;
+
+  scheduler = call_get_scheduler (call);
+  if (scheduler != NULL)
+    gfbgraph_scheduler_acquire_async (scheduler,
+                                      gfbgraph_call_get_authorizer (call),
+                                      g_task_get_cancellable (task),
+                                      call_acquired_cb,
+                                      task);
+  else
+    rest_proxy_call_invoke_async (call, g_task_get_cancellable (task), call_invoked_cb, task);
+}
+
+/* Sends @call without blocking, the request is driven by the thread-default
+ * main context, where @callback is called. */
+static void
+call_run_async (RestProxyCall       *call,
+                GCancellable        *cancellable,
+                GAsyncReadyCallback  callback,
+                gpointer             user_data)
+{
+  GTask *task;
+  CallData *call_data;
+
+  task = g_task_new (call, cancellable, callback, user_data);
+  g_task_set_source_tag (task, call_run_async);
+
+  call_data = g_slice_new0 (CallData);
+  g_task_set_task_data (task, call_data, call_data_free);
+
+  call_prepare_cache (call, call_data);
+  if (call_data->entry != NULL && gfbgraph_cache_entry_is_fresh (call_data->cache, call_data->entry)) {
+    g_task_return_pointer (task, g_bytes_ref (call_data->entry->payload), (GDestroyNotify) g_bytes_unref);
+    g_object_unref (task);
+    return;
+  }
+
+  call_prepare_retry (call, call_data);
+  call_send_async (task);
+}
+
+static GBytes *
+call_run_finish (RestProxyCall  *call,
+                 GAsyncResult   *result,
+                 GError        **error)
+{
+  return g_task_propagate_pointer (G_TASK (result), error);
+}
+
+/* --- Single flight --- */
+
+/* Identical GET requests in progress at the same time, with the same
+ * authorizer, function, parameters and parse function, are sent only once: the
+ * first caller leads the flight and the other ones wait for its result, each
+ * getting a reference to the same payload or parsed object.
+ *
+ * The synchronous and asynchronous callers never share a flight. A flight led
+ * asynchronously could be driven by the main context of a blocked synchronous
+ * caller, and the request of a synchronous flight can't be cancelled, as it's
+ * sent with the cancellable of its leader. In an asynchronous flight, a
+ * cancelled caller leaves it and returns at once, and the request is cancelled
+ * with the cancellable of the flight once all its callers left. */
+
+typedef struct {
+  gchar                 *key;          /* NULL if not shared */
+  guint                  ref_count;    /* Guarded by flights_mutex */
+  gboolean               synchronous;
+  gboolean               done;         /* Guarded by flights_mutex */
+  GFBGraphCallParseFunc  parse_func;
+  GType                  parse_type;
+  gpointer               result;       /* Immutable once done */
+  GError                *error;        /* Immutable once done */
+  GCancellable          *cancellable;  /* Of the request, asynchronous flights only */
+  guint                  n_active;     /* Asynchronous callers not cancelled, guarded by flights_mutex */
+  GList                 *waiters;      /* FlightWaiter, guarded by flights_mutex */
+} CallFlight;
+
+typedef struct {
+  GTask   *task;
+  GSource *cancel_source;
+} FlightWaiter;
+
+/* The data of the cancel source of a waiter, which can outlive it */
+typedef struct {
+  GTask      *task;
+  CallFlight *flight;
+} FlightWaiterCancelData;
+
+static GMutex flights_mutex;
+static GCond flights_cond;
+static GHashTable *flights = NULL; /* Key -> CallFlight */
+
+/* Returns the key of the flight of @call, or %NULL if it can't be shared */
+static gchar *
+call_get_flight_key (RestProxyCall         *call,
+                     GFBGraphCallParseFunc  parse_func,
+                     GType                  parse_type)
+{
+  GFBGraphAuthorizer *authorizer;
+  gchar *request_key;
+  gchar *key;
+
+  authorizer = gfbgraph_call_get_authorizer (call);
+  if (authorizer == NULL || g_strcmp0 (rest_proxy_call_get_method (call), "GET") != 0)
+    return NULL;
+
+  request_key = gfbgraph_cache_get_key (call);
+  key = g_strdup_printf ("%p %p %" G_GSIZE_FORMAT " %s",
+                         authorizer, parse_func, (gsize) parse_type, request_key);
+  g_free (request_key);
+
+  return key;
+}
+
+static void
+call_flight_free_result (CallFlight *flight,
+                         gpointer    result)
+{
+  if (result == NULL)
+    return;
+
+  if (flight->parse_func != NULL)
+    g_object_unref (result);
+  else
+    g_bytes_unref (result);
+}
+
+/* Creates a flight, taking @key, and makes it the one joined by the next
+ * identical calls. Must be called with flights_mutex locked. */
+static CallFlight *
+call_flight_new_locked (gchar                 *key,
+                        gboolean               synchronous,
+                        GFBGraphCallParseFunc  parse_func,
+                        GType                  parse_type)
+{
+  CallFlight *flight;
+
+  flight = g_slice_new0 (CallFlight);
+  flight->key = key;
+  flight->ref_count = 1;
+  flight->synchronous = synchronous;
+  flight->parse_func = parse_func;
+  flight->parse_type = parse_type;
+  if (!synchronous) {
+    flight->cancellable = g_cancellable_new ();
+    flight->n_active = 1;
+  }
+
+  if (key != NULL) {
+    if (flights == NULL)
+      flights = g_hash_table_new (g_str_hash, g_str_equal);
+    g_hash_table_replace (flights, key, flight);
+  }
+
+  return flight;
+}
+
+/* Must be called with flights_mutex locked */
+static void
+call_flight_unref_locked (CallFlight *flight)
+{
+  if (--flight->ref_count > 0)
+    return;
+
+  call_flight_free_result (flight, flight->result);
+  g_clear_error (&flight->error);
+  g_clear_object (&flight->cancellable);
+  g_free (flight->key);
+  g_slice_free (CallFlight, flight);
+}
+
+/* Returns the running flight with @key that a caller can join, or %NULL.
+ * Must be called with flights_mutex locked. */
+static CallFlight *
+call_flight_lookup_locked (const gchar *key,
+                           gboolean     synchronous)
+{
+  CallFlight *flight;
+
+  if (key == NULL || flights == NULL)
+    return NULL;
+
+  flight = g_hash_table_lookup (flights, key);
+  if (flight == NULL || flight->synchronous != synchronous)
+    return NULL;
+
+  if (!synchronous) {
+    if (g_cancellable_is_cancelled (flight->cancellable))
+      return NULL;
+    flight->n_active++;
+  }
+
+  return flight;
+}
+
+/* Returns a new reference to the result of a done @flight, or sets @error */
+static gpointer
+call_flight_dup_result (CallFlight  *flight,
+                        GError     **error)
+{
+  if (flight->error != NULL) {
+    g_propagate_error (error, g_error_copy (flight->error));
+    return NULL;
+  }
+
+  if (flight->parse_func != NULL)
+    return g_object_ref (flight->result);
+
+  return g_bytes_ref (flight->result);
+}
+
+static void
+flight_waiter_free (FlightWaiter *waiter)
+{
+  if (waiter->cancel_source != NULL) {
+    g_source_destroy (waiter->cancel_source);
+    g_source_unref (waiter->cancel_source);
+  }
+  g_slice_free (FlightWaiter, waiter);
+}
+
+static void
+flight_waiter_cancel_data_free (gpointer user_data)
+{
+  FlightWaiterCancelData *data = user_data;
+
+  g_mutex_lock (&flights_mutex);
+  call_flight_unref_locked (data->flight);
+  g_mutex_unlock (&flights_mutex);
+
+  g_object_unref (data->task);
+  g_slice_free (FlightWaiterCancelData, data);
+}
+
+/* Called in the context of the task of a cancelled waiter, which leaves the
+ * flight unless it's already done */
+static gboolean
+flight_waiter_cancelled_cb (gpointer user_data)
+{
+  FlightWaiterCancelData *data = user_data;
+  CallFlight *flight = data->flight;
+  FlightWaiter *waiter = NULL;
+  gboolean cancel_request = FALSE;
+  GList *l;
+
+  g_mutex_lock (&flights_mutex);
+  for (l = flight->waiters; l != NULL; l = l->next) {
+    if (((FlightWaiter *) l->data)->task == data->task) {
+      waiter = l->data;
+      flight->waiters = g_list_delete_link (flight->waiters, l);
+      break;
+    }
+  }
+  if (waiter != NULL && --flight->n_active == 0) {
+    cancel_request = TRUE;
+    /* The next identical calls start a new flight */
+    if (flight->key != NULL && g_hash_table_lookup (flights, flight->key) == flight)
+      g_hash_table_remove (flights, flight->key);
+  }
+  g_mutex_unlock (&flights_mutex);
+
+  if (waiter == NULL)
+    return G_SOURCE_REMOVE;
+
+  if (cancel_request)
+    g_cancellable_cancel (flight->cancellable);
+
+  /* The source is the one being dispatched, destroyed once this returns */
+  g_clear_pointer (&waiter->cancel_source, g_source_unref);
+  flight_waiter_free (waiter);
+
+  g_task_return_error_if_cancelled (data->task);
+  g_object_unref (data->task);
+
+  return G_SOURCE_REMOVE;
+}
+
+/* Adds the asynchronous @task to the waiters of @flight, taking it. Must be
+ * called with flights_mutex locked. */
+static void
+call_flight_add_waiter_locked (CallFlight *flight,
+                               GTask      *task)
+{
+  FlightWaiter *waiter;
+  GCancellable *cancellable;
+
+  waiter = g_slice_new0 (FlightWaiter);
+  waiter->task = task;
+
+  cancellable = g_task_get_cancellable (task);
+  if (cancellable != NULL) {
+    FlightWaiterCancelData *data;
+
+    data = g_slice_new (FlightWaiterCancelData);
+    data->task = g_object_ref (task);
+    data->flight = flight;
+    flight->ref_count++;
+
+    waiter->cancel_source = g_cancellable_source_new (cancellable);
+    g_source_set_callback (waiter->cancel_source,
+                           flight_waiter_cancelled_cb,
+                           data,
+                           flight_waiter_cancel_data_free);
+    g_source_attach (waiter->cancel_source, g_task_get_context (task));
+  }
+
+  flight->waiters = g_list_prepend (flight->waiters, waiter);
+}
+
+/* Returns the result of @flight from @payload, taking it */
+static gpointer
+call_flight_parse (CallFlight     *flight,
+                   RestProxyCall  *call,
+                   GBytes         *payload,
+                   GError        **error)
+{
+  gpointer result;
+
+  if (payload == NULL || flight->parse_func == NULL)
+    return payload;
+
+  result = flight->parse_func (call, flight->parse_type, payload, error);
+  g_bytes_unref (payload);
+
+  return result;
+}
+
+static void call_flight_dispatch (GTask                 *task,
+                                  GFBGraphCallParseFunc  parse_func,
+                                  GType                  parse_type);
+
+/* Sets the result of @flight, taking @result and @error, and returns it to the
+ * asynchronous waiters. The caller keeps its reference to @flight. */
+static void
+call_flight_complete (CallFlight *flight,
+                      gpointer    result,
+                      GError     *error)
+{
+  GList *waiters, *l;
+
+  g_mutex_lock (&flights_mutex);
+  flight->done = TRUE;
+  flight->result = result;
+  flight->error = error;
+  if (flight->key != NULL && g_hash_table_lookup (flights, flight->key) == flight)
+    g_hash_table_remove (flights, flight->key);
+  waiters = g_list_reverse (flight->waiters);
+  flight->waiters = NULL;
+  g_cond_broadcast (&flights_cond);
+  g_mutex_unlock (&flights_mutex);
+
+  for (l = waiters; l != NULL; l = l->next) {
+    FlightWaiter *waiter = l->data;
+    GTask *task = waiter->task;
+    GError *task_error = NULL;
+    gpointer task_result;
+
+    flight_waiter_free (waiter);
+
+    if (g_task_return_error_if_cancelled (task)) {
+      g_object_unref (task);
+    } else if (g_error_matches (flight->error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+      /* Joined just as the other callers cancelled the request */
+      call_flight_dispatch (task, flight->parse_func, flight->parse_type);
+    } else {
+      task_result = call_flight_dup_result (flight, &task_error);
+      if (task_error != NULL)
+        g_task_return_error (task, task_error);
+      else if (flight->parse_func != NULL)
+        g_task_return_pointer (task, task_result, g_object_unref);
+      else
+        g_task_return_pointer (task, task_result, (GDestroyNotify) g_bytes_unref);
+      g_object_unref (task);
+    }
+  }
+  g_list_free (waiters);
+}
+
+static void
+call_flight_invoked_cb (GObject      *source_object,
+                        GAsyncResult *result,
+                        gpointer      user_data)
+{
+  CallFlight *flight = user_data;
+  RestProxyCall *call = REST_PROXY_CALL (source_object);
+  GError *error = NULL;
+  GBytes *payload;
+
+  payload = call_run_finish (call, result, &error);
+  call_flight_complete (flight, call_flight_parse (flight, call, payload, &error), error);
+
+  g_mutex_lock (&flights_mutex);
+  call_flight_unref_locked (flight);
+  g_mutex_unlock (&flights_mutex);
+}
+
+/* Joins or starts the flight of the call of @task, taking it */
+static void
+call_flight_dispatch (GTask                 *task,
+                      GFBGraphCallParseFunc  parse_func,
+                      GType                  parse_type)
+{
+  RestProxyCall *call = g_task_get_source_object (task);
+  CallFlight *flight;
+  gchar *key;
+
+  key = call_get_flight_key (call, parse_func, parse_type);
+
+  g_mutex_lock (&flights_mutex);
+  flight = call_flight_lookup_locked (key, FALSE);
+  if (flight != NULL) {
+    g_free (key);
+    call_flight_add_waiter_locked (flight, task);
+    g_mutex_unlock (&flights_mutex);
+    return;
+  }
+
+  flight = call_flight_new_locked (key, FALSE, parse_func, parse_type);
+  call_flight_add_waiter_locked (flight, task);
+  g_mutex_unlock (&flights_mutex);
+
+  call_run_async (call, flight->cancellable, call_flight_invoked_cb, flight);
+}
+
+static gpointer
+call_flight_run_sync (RestProxyCall          *call,
+                      GFBGraphCallParseFunc   parse_func,
+                      GType                   parse_type,
+                      GCancellable           *cancellable,
+                      GError                **error)
+{
+  CallFlight *flight;
+  GError *local_error = NULL;
+  GBytes *payload;
+  gpointer result;
+  gchar *key;
+
+  /* The waits for a flight can't be cancelled, so the cancellable calls
+   * don't share theirs */
+  key = cancellable == NULL ? call_get_flight_key (call, parse_func, parse_type) : NULL;
+
+  g_mutex_lock (&flights_mutex);
+  flight = call_flight_lookup_locked (key, TRUE);
+  if (flight != NULL) {
+    g_free (key);
+    flight->ref_count++;
+    while (!flight->done)
+      g_cond_wait (&flights_cond, &flights_mutex);
+  } else {
+    flight = call_flight_new_locked (key, TRUE, parse_func, parse_type);
+    g_mutex_unlock (&flights_mutex);
+
+    payload = call_run_sync (call, cancellable, &local_error);
+    call_flight_complete (flight, call_flight_parse (flight, call, payload, &local_error),
+                          local_error);
+
+    g_mutex_lock (&flights_mutex);
+  }
+
+  result = call_flight_dup_result (flight, error);
+  call_flight_unref_locked (flight);
+  g_mutex_unlock (&flights_mutex);
+
+  return result;
+}
+
+/* --- Internal API --- */
+
+/* Sends @call blocking the calling thread, sharing the request with the
+ * identical ones in progress. Returns the payload of the response or %NULL
+ * with @error set. */
+GBytes *
+gfbgraph_call_sync (RestProxyCall  *call,
+                    GCancellable   *cancellable,
+                    GError        **error)
+{
+  g_return_val_if_fail (REST_IS_PROXY_CALL (call), NULL);
+
+  return call_flight_run_sync (call, NULL, G_TYPE_INVALID, cancellable, error);
+}
+
+/* Like gfbgraph_call_sync(), but returns the object built by @parse_func from
+ * the payload, shared by the identical calls in progress. */
+gpointer
+gfbgraph_call_sync_parsed (RestProxyCall          *call,
+                           GFBGraphCallParseFunc   parse_func,
+                           GType                   node_type,
+                           GCancellable           *cancellable,
+                           GError                **error)
+{
+  g_return_val_if_fail (REST_IS_PROXY_CALL (call), NULL);
+  g_return_val_if_fail (parse_func != NULL, NULL);
+
+  return call_flight_run_sync (call, parse_func, node_type, cancellable, error);
+}
+
+/* Sends @call without blocking, sharing the request with the identical ones in
+ * progress. The request is driven by the thread-default main context of the
+ * first caller, @callback by the one of the caller. */
+void
+gfbgraph_call_async (RestProxyCall       *call,
+                     GCancellable        *cancellable,
+                     GAsyncReadyCallback  callback,
+                     gpointer             user_data)
+{
+  GTask *task;
+
+  g_return_if_fail (REST_IS_PROXY_CALL (call));
+
+  task = g_task_new (call, cancellable, callback, user_data);
+  g_task_set_source_tag (task, gfbgraph_call_async);
+  call_flight_dispatch (task, NULL, G_TYPE_INVALID);
+}
+
+GBytes *
+gfbgraph_call_finish (RestProxyCall  *call,
+                      GAsyncResult   *result,
+                      GError        **error)
+{
+  g_return_val_if_fail (g_task_is_valid (result, call), NULL);
+  g_return_val_if_fail (g_task_get_source_tag (G_TASK (result)) == gfbgraph_call_async, NULL);
+
+  return g_task_propagate_pointer (G_TASK (result), error);
+}
+
+/* Like gfbgraph_call_async(), but the result is the object built by
+ * @parse_func from the payload. */
+void
+gfbgraph_call_async_parsed (RestProxyCall         *call,
+                            GFBGraphCallParseFunc  parse_func,
+                            GType                  node_type,
+                            GCancellable          *cancellable,
+                            GAsyncReadyCallback    callback,
+                            gpointer               user_data)
+{
+  GTask *task;
+
+  g_return_if_fail (REST_IS_PROXY_CALL (call));
+  g_return_if_fail (parse_func != NULL);
+
+  task = g_task_new (call, cancellable, callback, user_data);
+  g_task_set_source_tag (task, gfbgraph_call_async_parsed);
+  call_flight_dispatch (task, parse_func, node_type);
+}
+
+gpointer
+gfbgraph_call_finish_parsed (RestProxyCall  *call,
+                             GAsyncResult   *result,
+                             GError        **error)
+{
+  g_return_val_if_fail (g_task_is_valid (result, call), NULL);
+  g_return_val_if_fail (g_task_get_source_tag (G_TASK (result)) == gfbgraph_call_async_parsed, NULL);
+
+  return g_task_propagate_pointer (G_TASK (result), error);
+}
+
+/* Returns a newly allocated copy of the value of the response header
+ * @header_name of @call, compared without case, or %NULL */
+gchar *
+gfbgraph_call_lookup_response_header (RestProxyCall *call,
+                                      const gchar   *header_name)
+{
+  GHashTable *headers;
+  GHashTableIter iter;
+  const gchar *name;
+  const gchar *value;
+  gchar *found = NULL;
+
+  g_return_val_if_fail (REST_IS_PROXY_CALL (call), NULL);
+
+  headers = rest_proxy_call_get_response_headers (call);
+  if (headers == NULL)
+    return NULL;
+
+  g_hash_table_iter_init (&iter, headers);
+  while (g_hash_table_iter_next (&iter, (gpointer *) &name, (gpointer *) &value)) {
+    if (g_ascii_strcasecmp (name, header_name) == 0) {
+      found = g_strdup (value);
+      break;
+    }
+  }
+  g_hash_table_unref (headers);
+
+  return found;
+}
+
+/* Returns the code of the Graph API error in the payload of a failed @call,
+ * like {"error":{"message":"...","type":"OAuthException","code":190}}, or 0. */
+gint
+gfbgraph_call_get_graph_error_code (RestProxyCall *call)
+{
+  const gchar *payload;
+  const gchar *error_json;
+  gsize error_length;
+  JsonParser *parser;
+  gint code = 0;
+
+  g_return_val_if_fail (REST_IS_PROXY_CALL (call), 0);
+
+  payload = rest_proxy_call_get_payload (call);
+  if (payload == NULL
+      || !gfbgraph_json_get_member (payload, rest_proxy_call_get_payload_length (call),
+                                    "error", &error_json, &error_length, NULL))
+    return 0;
 
-  gfbgraph_authorizer_process_call (authorizer, rest_call);
+  parser = json_parser_new ();
+  if (json_parser_load_from_data (parser, error_json, error_length, NULL)) {
+    JsonNode *root = json_parser_get_root (parser);
 
-  g_object_unref (proxy);
+    if (JSON_NODE_HOLDS_OBJECT (root)
+        && json_object_has_member (json_node_get_object (root), "code"))
+      code = json_object_get_int_member (json_node_get_object (root), "code");
+  }
+  g_object_unref (parser);
 
-  return rest_call;
+  return code;
 }
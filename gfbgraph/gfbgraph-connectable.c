@@ -32,6 +32,7 @@
 
 #include "gfbgraph-connectable.h"
 #include "gfbgraph-node.h"
+#include "gfbgraph-private.h"
 
 #include <json-glib/json-glib.h>
 
@@ -44,23 +45,282 @@ gfbgraph_connectable_default_init (GFBGraphConnectableInterface *iface)
 
   iface->get_connection_post_params = NULL;
   iface->parse_connected_data = NULL;
+  iface->parse_connected_data_array = NULL;
+  iface->parse_connected_data_foreach = NULL;
 }
 
-static GHashTable *
-get_connections (GFBGraphConnectableInterface *iface)
+typedef struct {
+  GType                node_type;
+  JsonParser          *jparser;
+  GFBGraphStringArena *arena;
+  GFBGraphNodeFunc     func;
+  gpointer             user_data;
+} ParseElementData;
+
+/* Parses a single element of the "data" array, so only one node tree is alive at a time */
+static gboolean
+parse_data_element (const gchar  *name,
+                    gsize         name_length,
+                    const gchar  *value,
+                    gsize         value_length,
+                    gpointer      user_data,
+                    GError      **error)
 {
-  /* The GHashTable contains the connections for a node.
-   * The key must be the g_type_name() of a GFBGRAPH_TYPE_NODE, and the value
-   * must be the function name to call in order to retrieve the nodes connected
-   * to the GFBGraphNode indicated by GFBGRAPH_TYPE_NODE.
-   */
-  GHashTable *connections;
+  ParseElementData *data = user_data;
+  JsonNode *jnode;
+  GFBGraphNode *node;
+  gboolean keep_going;
+
+  if (!json_parser_load_from_data (data->jparser, value, value_length, error))
+    return FALSE;
+
+  jnode = json_parser_get_root (data->jparser);
+  if (!JSON_NODE_HOLDS_OBJECT (jnode)) {
+    g_set_error (error, JSON_PARSER_ERROR, JSON_PARSER_ERROR_INVALID_DATA,
+                 "The connected node isn't a JSON object");
+    return FALSE;
+  }
+
+  node = gfbgraph_node_deserialize (data->node_type, jnode, data->arena);
+  keep_going = data->func (node, data->user_data);
+  g_object_unref (node);
+
+  return keep_going;
+}
+
+static gboolean
+get_data_array (const gchar  *payload,
+                gssize        length,
+                const gchar **data_array,
+                gsize        *data_length,
+                GError      **error)
+{
+  GError *scan_error = NULL;
+
+  if (gfbgraph_json_get_member (payload, length, "data", data_array, data_length, &scan_error))
+    return TRUE;
+
+  if (scan_error != NULL) {
+    g_propagate_error (error, scan_error);
+    return FALSE;
+  }
+
+  /* Without a "data" member there are no connected nodes */
+  *data_array = NULL;
+  *data_length = 0;
+
+  return TRUE;
+}
+
+static gboolean
+parse_data_elements (GType                 node_type,
+                     const gchar          *data_array,
+                     gsize                 data_length,
+                     GFBGraphNodeFunc      func,
+                     gpointer              user_data,
+                     GError              **error)
+{
+  ParseElementData data;
+  gboolean success;
+
+  data.node_type = node_type;
+  data.jparser = json_parser_new ();
+  data.arena = gfbgraph_string_arena_new ();
+  data.func = func;
+  data.user_data = user_data;
+
+  success = gfbgraph_json_foreach_element (data_array, data_length, parse_data_element, &data, error);
+
+  gfbgraph_string_arena_unref (data.arena);
+  g_object_unref (data.jparser);
+
+  return success;
+}
+
+static gboolean
+add_node_to_array (GFBGraphNode *node,
+                   gpointer      user_data)
+{
+  g_ptr_array_add ((GPtrArray *) user_data, g_object_ref (node));
+
+  return TRUE;
+}
+
+static gboolean
+parse_foreach_for_type (GType              node_type,
+                        const gchar       *payload,
+                        gssize             length,
+                        GFBGraphNodeFunc   func,
+                        gpointer           user_data,
+                        GError           **error)
+{
+  const gchar *data_array;
+  gsize data_length;
+
+  if (!get_data_array (payload, length, &data_array, &data_length, error))
+    return FALSE;
+
+  if (data_array == NULL)
+    return TRUE;
+
+  return parse_data_elements (node_type, data_array, data_length, func, user_data, error);
+}
+
+static GPtrArray *
+parse_array_for_type (GType         node_type,
+                      const gchar  *payload,
+                      gssize        length,
+                      GError      **error)
+{
+  GPtrArray *nodes;
+  const gchar *data_array;
+  gsize data_length;
+
+  if (!get_data_array (payload, length, &data_array, &data_length, error))
+    return NULL;
+
+  if (data_array == NULL)
+    return g_ptr_array_new_with_free_func (g_object_unref);
+
+  nodes = g_ptr_array_new_full (gfbgraph_json_count_elements (data_array, data_length), g_object_unref);
+  if (!parse_data_elements (node_type, data_array, data_length, add_node_to_array, nodes, error)) {
+    g_ptr_array_unref (nodes);
+    return NULL;
+  }
+
+  return nodes;
+}
+
+/* --- Connection registry --- */
+
+/* The connection infos, keyed by the source and target types, are resolved the first
+ * time a connection is used and never released, like the classes they point to */
+static GMutex      registry_mutex;
+static GHashTable *registry = NULL;
+
+static guint
+connection_info_hash (gconstpointer key)
+{
+  const GFBGraphConnectionInfo *info = key;
+
+  return (guint) (info->source_type * 31 + info->target_type);
+}
+
+static gboolean
+connection_info_equal (gconstpointer a,
+                       gconstpointer b)
+{
+  const GFBGraphConnectionInfo *info_a = a;
+  const GFBGraphConnectionInfo *info_b = b;
+
+  return info_a->source_type == info_b->source_type && info_a->target_type == info_b->target_type;
+}
+
+static GFBGraphConnectionInfo *
+connection_info_new (GType source_type,
+                     GType target_type)
+{
+  GFBGraphConnectionInfo *info;
+  GFBGraphConnectableInterface *iface;
+
+  info = g_new0 (GFBGraphConnectionInfo, 1);
+  info->source_type = source_type;
+  info->target_type = target_type;
+
+  if (!G_TYPE_IS_INSTANTIATABLE (target_type) || !g_type_is_a (target_type, GFBGRAPH_TYPE_CONNECTABLE))
+    return info;
+
+  /* The reference keeps the class, and so the interface, alive while the info exists */
+  iface = g_type_interface_peek (g_type_class_ref (target_type), GFBGRAPH_TYPE_CONNECTABLE);
+  info->iface = iface;
 
-  connections = iface->connections;
   /* If no connections... Why you implement this iface? */
-  g_assert (g_hash_table_size (connections) > 0);
+  g_assert (iface->connections != NULL && g_hash_table_size (iface->connections) > 0);
+  info->path = g_hash_table_lookup (iface->connections, g_type_name (source_type));
+
+  /* Implementers with their own parse functions need an instance to call them,
+   * it's created once here instead of in every request */
+  if (info->path != NULL
+      && (iface->parse_connected_data_foreach != gfbgraph_connectable_default_parse_connected_data_foreach
+          || iface->parse_connected_data_array != gfbgraph_connectable_default_parse_connected_data_array))
+    info->parser = g_object_new (target_type, NULL);
+
+  return info;
+}
+
+/* Returns the information to connect the @target_type nodes to a @source_type node,
+ * or %NULL with @error set if they can't be connected. */
+const GFBGraphConnectionInfo *
+gfbgraph_connection_info_lookup (GType    source_type,
+                                 GType    target_type,
+                                 GError **error)
+{
+  GFBGraphConnectionInfo key;
+  GFBGraphConnectionInfo *info;
+
+  key.source_type = source_type;
+  key.target_type = target_type;
+
+  g_mutex_lock (&registry_mutex);
+
+  if (registry == NULL)
+    registry = g_hash_table_new (connection_info_hash, connection_info_equal);
+
+  info = g_hash_table_lookup (registry, &key);
+  if (info == NULL) {
+    info = connection_info_new (source_type, target_type);
+    g_hash_table_add (registry, info);
+  }
+
+  g_mutex_unlock (&registry_mutex);
+
+  if (info->iface == NULL) {
+    g_set_error (error, GFBGRAPH_NODE_ERROR,
+                 GFBGRAPH_NODE_ERROR_NO_CONNECTABLE,
+                 "The given node type (%s) doesn't implement connectable interface",
+                 g_type_name (target_type));
+    return NULL;
+  }
+
+  if (info->path == NULL) {
+    g_set_error (error, GFBGRAPH_NODE_ERROR,
+                 GFBGRAPH_NODE_ERROR_NO_CONNECTABLE,
+                 "The given node type (%s) can't connect with a %s node",
+                 g_type_name (target_type),
+                 g_type_name (source_type));
+    return NULL;
+  }
+
+  return info;
+}
+
+/* Parses a connection response with the parser of @info, see
+ * gfbgraph_connectable_parse_connected_data_array() */
+GPtrArray *
+gfbgraph_connection_info_parse_array (const GFBGraphConnectionInfo  *info,
+                                      const gchar                   *payload,
+                                      gssize                         length,
+                                      GError                       **error)
+{
+  if (info->parser == NULL)
+    return parse_array_for_type (info->target_type, payload, length, error);
+
+  return gfbgraph_connectable_parse_connected_data_array (info->parser, payload, error);
+}
+
+/* Like gfbgraph_connection_info_parse_array(), but streams the nodes to @func */
+gboolean
+gfbgraph_connection_info_parse_foreach (const GFBGraphConnectionInfo  *info,
+                                        const gchar                   *payload,
+                                        gssize                         length,
+                                        GFBGraphNodeFunc               func,
+                                        gpointer                       user_data,
+                                        GError                       **error)
+{
+  if (info->parser == NULL)
+    return parse_foreach_for_type (info->target_type, payload, length, func, user_data, error);
 
-  return connections;
+  return gfbgraph_connectable_parse_connected_data_foreach (info->parser, payload, length, func, user_data, error);
 }
 
 /**
@@ -115,6 +375,99 @@ gfbgraph_connectable_parse_connected_data (GFBGraphConnectable  *self,
   return iface->parse_connected_data (self, payload, error);
 }
 
+/**
+ * gfbgraph_connectable_parse_connected_data_array:
+ * @self: a #GFBGraphConnectable.
+ * @payload: a const #gchar with the response string from the Facebook Graph API.
+ * @error: (allow-none): a #GError.
+ *
+ * Like gfbgraph_connectable_parse_connected_data(), but the nodes are returned in a #GPtrArray.
+ * Implementers without a parse_connected_data_array function fall back to the #GList one.
+ *
+ * Returns: (element-type GFBGraphNode) (transfer full): a newly-allocated #GPtrArray of #GFBGraphNode
+ * created from the @payload or %NULL in case of error.
+ **/
+GPtrArray *
+gfbgraph_connectable_parse_connected_data_array (GFBGraphConnectable  *self,
+                                                 const gchar          *payload,
+                                                 GError              **error)
+{
+  GFBGraphConnectableInterface *iface;
+  GError *parse_error = NULL;
+  GList *nodes;
+
+  g_return_val_if_fail (GFBGRAPH_IS_CONNECTABLE (self), NULL);
+
+  iface = GFBGRAPH_CONNECTABLE_GET_IFACE (self);
+  if (iface->parse_connected_data_array != NULL)
+    return iface->parse_connected_data_array (self, payload, error);
+
+  g_assert (iface->parse_connected_data != NULL);
+
+  nodes = iface->parse_connected_data (self, payload, &parse_error);
+  if (parse_error != NULL) {
+    g_list_free_full (nodes, g_object_unref);
+    g_propagate_error (error, parse_error);
+    return NULL;
+  }
+
+  return gfbgraph_nodes_list_to_array (nodes);
+}
+
+/**
+ * gfbgraph_connectable_parse_connected_data_foreach:
+ * @self: a #GFBGraphConnectable.
+ * @payload: a const #gchar with the response string from the Facebook Graph API.
+ * @length: the length of @payload in bytes, or -1 if it's nul-terminated.
+ * @func: (scope call): a #GFBGraphNodeFunc called for every parsed node.
+ * @user_data: (closure): the data to pass to @func.
+ * @error: (allow-none): a #GError.
+ *
+ * Parses the response contained in @payload like gfbgraph_connectable_parse_connected_data(),
+ * but every node is handed to @func as soon as it's created instead of collecting all of them.
+ * Implementers without a parse_connected_data_foreach function fall back to the #GPtrArray one.
+ *
+ * Returns: %TRUE on success, %FALSE in case of error.
+ **/
+gboolean
+gfbgraph_connectable_parse_connected_data_foreach (GFBGraphConnectable  *self,
+                                                   const gchar          *payload,
+                                                   gssize                length,
+                                                   GFBGraphNodeFunc      func,
+                                                   gpointer              user_data,
+                                                   GError              **error)
+{
+  GFBGraphConnectableInterface *iface;
+  GPtrArray *nodes;
+  gchar *payload_copy = NULL;
+  guint i;
+
+  g_return_val_if_fail (GFBGRAPH_IS_CONNECTABLE (self), FALSE);
+  g_return_val_if_fail (func != NULL, FALSE);
+
+  iface = GFBGRAPH_CONNECTABLE_GET_IFACE (self);
+  if (iface->parse_connected_data_foreach != NULL)
+    return iface->parse_connected_data_foreach (self, payload, length, func, user_data, error);
+
+  /* The other parsers need a nul-terminated payload */
+  if (length >= 0)
+    payload = payload_copy = g_strndup (payload, length);
+
+  nodes = gfbgraph_connectable_parse_connected_data_array (self, payload, error);
+  g_free (payload_copy);
+  if (nodes == NULL)
+    return FALSE;
+
+  for (i = 0; i < nodes->len; i++) {
+    if (!func (g_ptr_array_index (nodes, i), user_data))
+      break;
+  }
+
+  g_ptr_array_unref (nodes);
+
+  return TRUE;
+}
+
 
 /**
  * gfbgraph_connectable_is_connectable_to:
@@ -131,16 +484,10 @@ gboolean
 gfbgraph_connectable_is_connectable_to (GFBGraphConnectable *self,
                                         GType                node_type)
 {
-  GFBGraphConnectableInterface *iface;
-  GHashTable *connections;
-
   g_return_val_if_fail (GFBGRAPH_IS_CONNECTABLE (self), FALSE);
   g_return_val_if_fail (g_type_is_a (node_type, GFBGRAPH_TYPE_NODE), FALSE);
 
-  iface = GFBGRAPH_CONNECTABLE_GET_IFACE (self);
-  connections = get_connections (iface);
-
-  return g_hash_table_contains (connections, g_type_name (node_type));
+  return gfbgraph_connection_info_lookup (node_type, G_OBJECT_TYPE (self), NULL) != NULL;
 }
 
 /**
@@ -157,17 +504,15 @@ const gchar *
 gfbgraph_connectable_get_connection_path (GFBGraphConnectable *self,
                                           GType                node_type)
 {
-  GFBGraphConnectableInterface *iface;
-  GHashTable *connections;
+  const GFBGraphConnectionInfo *info;
 
   g_return_val_if_fail (GFBGRAPH_IS_CONNECTABLE (self), NULL);
   g_return_val_if_fail (g_type_is_a (node_type, GFBGRAPH_TYPE_NODE), NULL);
-  g_return_val_if_fail (gfbgraph_connectable_is_connectable_to (self, node_type), NULL);
 
-  iface = GFBGRAPH_CONNECTABLE_GET_IFACE (self);
-  connections = get_connections (iface);
+  info = gfbgraph_connection_info_lookup (node_type, G_OBJECT_TYPE (self), NULL);
+  g_return_val_if_fail (info != NULL, NULL);
 
-  return (const gchar *) g_hash_table_lookup (connections, g_type_name (node_type));
+  return info->path;
 }
 
 /**
@@ -190,33 +535,57 @@ gfbgraph_connectable_default_parse_connected_data (GFBGraphConnectable  *self,
                                                    const gchar          *payload,
                                                    GError              **error)
 {
-  GList *nodes_list = NULL;
-  JsonParser *jparser;
-  GType node_type;
-
-  node_type = G_OBJECT_TYPE (self);
-
-  jparser = json_parser_new ();
-  if (json_parser_load_from_data (jparser, payload, -1, error)) {
-    JsonNode *root_jnode;
-    JsonObject *main_jobject;
-    JsonArray *nodes_jarray;
-    int i = 0;
-
-    root_jnode = json_parser_get_root (jparser);
-    main_jobject = json_node_get_object (root_jnode);
-    nodes_jarray = json_object_get_array_member (main_jobject, "data");
-    for (i = 0; i < json_array_get_length (nodes_jarray); i++) {
-      JsonNode *jnode;
-      GFBGraphNode *node;
-
-      jnode = json_array_get_element (nodes_jarray, i);
-      node = GFBGRAPH_NODE (json_gobject_deserialize (node_type, jnode));
-      nodes_list = g_list_append (nodes_list, node);
-    }
-  }
+  return gfbgraph_nodes_array_to_list (gfbgraph_connectable_default_parse_connected_data_array (self, payload, error));
+}
+
+/**
+ * gfbgraph_connectable_default_parse_connected_data_array:
+ * @self: a #GFBGraphConnectable.
+ * @payload: a const #gchar with the response string from the Facebook Graph API.
+ * @error: (allow-none): a #GError or %NULL.
+ *
+ * Like gfbgraph_connectable_default_parse_connected_data(), but the nodes are returned
+ * in a #GPtrArray sized from the "data" array of the response. Like
+ * gfbgraph_connectable_default_parse_connected_data_foreach(), the nodes are parsed one by one.
+ *
+ * Returns: (element-type GFBGraphNode) (transfer full): a newly-allocated #GPtrArray of #GFBGraphNode
+ * with the same #GType as @self, or %NULL in case of error.
+ **/
+GPtrArray *
+gfbgraph_connectable_default_parse_connected_data_array (GFBGraphConnectable  *self,
+                                                         const gchar          *payload,
+                                                         GError              **error)
+{
+  g_return_val_if_fail (GFBGRAPH_IS_CONNECTABLE (self), NULL);
 
-  g_clear_object (&jparser);
+  return parse_array_for_type (G_OBJECT_TYPE (self), payload, -1, error);
+}
+
+/**
+ * gfbgraph_connectable_default_parse_connected_data_foreach:
+ * @self: a #GFBGraphConnectable.
+ * @payload: a const #gchar with the response string from the Facebook Graph API.
+ * @length: the length of @payload in bytes, or -1 if it's nul-terminated.
+ * @func: (scope call): a #GFBGraphNodeFunc called for every parsed node.
+ * @user_data: (closure): the data to pass to @func.
+ * @error: (allow-none): a #GError or %NULL.
+ *
+ * Default implementation of gfbgraph_connectable_parse_connected_data_foreach(). The
+ * elements of the "data" array are located directly in @payload and deserialized one
+ * by one, so the memory used doesn't depend on the number of nodes in the response.
+ *
+ * Returns: %TRUE on success, %FALSE in case of error.
+ **/
+gboolean
+gfbgraph_connectable_default_parse_connected_data_foreach (GFBGraphConnectable  *self,
+                                                           const gchar          *payload,
+                                                           gssize                length,
+                                                           GFBGraphNodeFunc      func,
+                                                           gpointer              user_data,
+                                                           GError              **error)
+{
+  g_return_val_if_fail (GFBGRAPH_IS_CONNECTABLE (self), FALSE);
+  g_return_val_if_fail (func != NULL, FALSE);
 
-  return nodes_list;
+  return parse_foreach_for_type (G_OBJECT_TYPE (self), payload, length, func, user_data, error);
 }
@@ -22,6 +22,7 @@
 #define __GFBGRAPH_CONNECTABLE_H__
 
 #include <glib-object.h>
+#include <gfbgraph/gfbgraph-node.h>
 
 G_BEGIN_DECLS
 
@@ -48,6 +49,15 @@ struct _GFBGraphConnectableInterface {
   GList *       (*parse_connected_data)       (GFBGraphConnectable  *self,
                                                const gchar          *payload,
                                                GError              **error);
+  GPtrArray *   (*parse_connected_data_array) (GFBGraphConnectable  *self,
+                                               const gchar          *payload,
+                                               GError              **error);
+  gboolean      (*parse_connected_data_foreach) (GFBGraphConnectable  *self,
+                                                 const gchar          *payload,
+                                                 gssize                length,
+                                                 GFBGraphNodeFunc      func,
+                                                 gpointer              user_data,
+                                                 GError              **error);
 };
 
 GType gfbgraph_connectable_get_type (void) G_GNUC_CONST;
@@ -57,6 +67,15 @@ GHashTable*  gfbgraph_connectable_get_connection_post_params   (GFBGraphConnecta
 GList*       gfbgraph_connectable_parse_connected_data         (GFBGraphConnectable  *self,
                                                                 const gchar          *payload,
                                                                 GError              **error);
+GPtrArray*   gfbgraph_connectable_parse_connected_data_array   (GFBGraphConnectable  *self,
+                                                                const gchar          *payload,
+                                                                GError              **error);
+gboolean     gfbgraph_connectable_parse_connected_data_foreach (GFBGraphConnectable  *self,
+                                                                const gchar          *payload,
+                                                                gssize                length,
+                                                                GFBGraphNodeFunc      func,
+                                                                gpointer              user_data,
+                                                                GError              **error);
 gboolean     gfbgraph_connectable_is_connectable_to            (GFBGraphConnectable *self,
                                                                 GType                node_type);
 const gchar* gfbgraph_connectable_get_connection_path          (GFBGraphConnectable *self,
@@ -64,6 +83,15 @@ const gchar* gfbgraph_connectable_get_connection_path          (GFBGraphConnecta
 GList*       gfbgraph_connectable_default_parse_connected_data (GFBGraphConnectable  *self,
                                                                 const gchar          *payload,
                                                                 GError              **error);
+GPtrArray*   gfbgraph_connectable_default_parse_connected_data_array (GFBGraphConnectable  *self,
+                                                                      const gchar          *payload,
+                                                                      GError              **error);
+gboolean     gfbgraph_connectable_default_parse_connected_data_foreach (GFBGraphConnectable  *self,
+                                                                        const gchar          *payload,
+                                                                        gssize                length,
+                                                                        GFBGraphNodeFunc      func,
+                                                                        gpointer              user_data,
+                                                                        GError              **error);
 
 G_END_DECLS
 
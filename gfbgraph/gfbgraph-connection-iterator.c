@@ -0,0 +1,1197 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 2; tab-width: 2 -*-  */
+/*
+ * libgfbgraph - GObject library for Facebook Graph API
+ * Copyright (C) 2013 Álvaro Peña <alvaropg@gmail.com>
+ *               2020 Leesoo Ahn <yisooan@fedoraproject.org>
+ *
+ * GFBGraph is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GFBGraph is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GFBGraph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * SECTION:gfbgraph-connection-iterator
+ * @title: GFBGraphConnectionIterator
+ * @short_description: Page by page retrieval of connected nodes
+ * @stability: Unstable
+ * @include: gfbgraph/gfbgraph.h
+ *
+ * The Graph API returns the connected nodes (for example the photos of an album)
+ * split in pages. #GFBGraphConnectionIterator follows the paging cursors returned
+ * by the Graph API, so all the connected nodes can be processed one page at time
+ * instead of keeping them all in memory.
+ *
+ * While the caller is consuming a page, the next one is requested in the background,
+ * see #GFBGraphConnectionIterator:prefetch. Pages prefetched after a
+ * gfbgraph_connection_iterator_next_page_async() call are requested asynchronously
+ * in the thread-default main context of the caller, pages prefetched after a
+ * gfbgraph_connection_iterator_next_page() call are requested in a worker thread.
+ * The prefetch is cancelled with the #GCancellable of the call that started it,
+ * and the page is then requested again by the next call.
+ *
+ * The connected nodes can be restricted to a time range with
+ * #GFBGraphConnectionIterator:since and #GFBGraphConnectionIterator:until, which
+ * are sent to the Graph API, so an incremental sync only retrieves the nodes
+ * published after the previous one.
+ *
+ * Only one gfbgraph_connection_iterator_next_page() or
+ * gfbgraph_connection_iterator_next_page_async() can be in progress at the same time.
+ **/
+
+#include <json-glib/json-glib.h>
+#include <libsoup/soup.h>
+
+#include "gfbgraph-common.h"
+#include "gfbgraph-connectable.h"
+#include "gfbgraph-connection-iterator.h"
+#include "gfbgraph-private.h"
+
+#define MAX_PREFETCH_THREADS 10
+
+enum {
+  PROP_0,
+  PROP_NODE,
+  PROP_NODE_TYPE,
+  PROP_AUTHORIZER,
+  PROP_LIMIT,
+  PROP_FIELDS,
+  PROP_PREFETCH,
+  PROP_SINCE,
+  PROP_UNTIL
+};
+
+struct _GFBGraphConnectionIteratorPrivate {
+  GFBGraphNode        *node;
+  GType                node_type;
+  GFBGraphAuthorizer  *authorizer;
+  const GFBGraphConnectionInfo *connection;
+  gchar               *function_path;
+
+  GMutex    mutex;
+  GCond     cond;
+  guint     limit;
+  GFBGraphFieldSet *fields;
+  gboolean  prefetch;
+  gint64    since;        /* Microseconds since the epoch, 0 if not set */
+  gint64    until;
+  GHashTable *next_params; /* Paging params of the next page */
+  gboolean  finished;     /* The last page was already requested */
+  gboolean  fetching;     /* A page request is in progress */
+  gboolean  fetching_async; /* The request in progress runs in a main context */
+  GCancellable *fetch_cancellable; /* Of the request in progress */
+  gboolean  page_ready;   /* page and page_error hold a requested page */
+  GPtrArray *page;
+  GError   *page_error;
+  GTask    *waiting_task; /* next_page_async() waiting for the request in progress */
+};
+
+#define GFBGRAPH_CONNECTION_ITERATOR_GET_PRIVATE(o) \
+  (G_TYPE_INSTANCE_GET_PRIVATE((o), GFBGRAPH_TYPE_CONNECTION_ITERATOR, GFBGraphConnectionIteratorPrivate))
+
+static GObjectClass *parent_class = NULL;
+
+G_DEFINE_TYPE (GFBGraphConnectionIterator, gfbgraph_connection_iterator, G_TYPE_OBJECT);
+
+static void
+gfbgraph_connection_iterator_constructed (GObject *object)
+{
+  GFBGraphConnectionIteratorPrivate *priv = GFBGRAPH_CONNECTION_ITERATOR_GET_PRIVATE (object);
+  gchar id_buffer[GFBGRAPH_NODE_ID_BUFFER_SIZE];
+
+  if (priv->node != NULL) {
+    priv->connection = gfbgraph_connection_info_lookup (G_OBJECT_TYPE (priv->node), priv->node_type, NULL);
+    if (priv->connection != NULL)
+      priv->function_path = g_strdup_printf ("%s/%s",
+                                             gfbgraph_node_peek_id (priv->node, id_buffer),
+                                             priv->connection->path);
+  }
+
+  G_OBJECT_CLASS (parent_class)->constructed (object);
+}
+
+static void
+gfbgraph_connection_iterator_dispose (GObject *object)
+{
+  GFBGraphConnectionIteratorPrivate *priv = GFBGRAPH_CONNECTION_ITERATOR_GET_PRIVATE (object);
+
+  g_clear_object (&priv->node);
+  g_clear_object (&priv->authorizer);
+
+  G_OBJECT_CLASS (parent_class)->dispose (object);
+}
+
+static void
+gfbgraph_connection_iterator_finalize (GObject *object)
+{
+  GFBGraphConnectionIteratorPrivate *priv = GFBGRAPH_CONNECTION_ITERATOR_GET_PRIVATE (object);
+
+  g_free (priv->function_path);
+  if (priv->fields)
+    gfbgraph_field_set_unref (priv->fields);
+  if (priv->next_params)
+    g_hash_table_unref (priv->next_params);
+  if (priv->page)
+    g_ptr_array_unref (priv->page);
+  g_clear_error (&priv->page_error);
+  g_clear_object (&priv->fetch_cancellable);
+  g_mutex_clear (&priv->mutex);
+  g_cond_clear (&priv->cond);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static void
+gfbgraph_connection_iterator_set_property (GObject      *object,
+                                           guint         prop_id,
+                                           const GValue *value,
+                                           GParamSpec   *pspec)
+{
+  GFBGraphConnectionIteratorPrivate *priv = GFBGRAPH_CONNECTION_ITERATOR_GET_PRIVATE (object);
+
+  switch (prop_id) {
+    case PROP_NODE:
+      priv->node = g_value_dup_object (value);
+      break;
+    case PROP_NODE_TYPE:
+      priv->node_type = g_value_get_gtype (value);
+      break;
+    case PROP_AUTHORIZER:
+      priv->authorizer = g_value_dup_object (value);
+      break;
+    case PROP_LIMIT:
+      g_mutex_lock (&priv->mutex);
+      priv->limit = g_value_get_uint (value);
+      g_mutex_unlock (&priv->mutex);
+      break;
+    case PROP_FIELDS:
+      g_mutex_lock (&priv->mutex);
+      if (priv->fields)
+        gfbgraph_field_set_unref (priv->fields);
+      priv->fields = g_value_dup_boxed (value);
+      g_mutex_unlock (&priv->mutex);
+      break;
+    case PROP_PREFETCH:
+      g_mutex_lock (&priv->mutex);
+      priv->prefetch = g_value_get_boolean (value);
+      g_mutex_unlock (&priv->mutex);
+      break;
+    case PROP_SINCE:
+      g_mutex_lock (&priv->mutex);
+      priv->since = g_value_get_int64 (value);
+      g_mutex_unlock (&priv->mutex);
+      break;
+    case PROP_UNTIL:
+      g_mutex_lock (&priv->mutex);
+      priv->until = g_value_get_int64 (value);
+      g_mutex_unlock (&priv->mutex);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gfbgraph_connection_iterator_get_property (GObject    *object,
+                                           guint       prop_id,
+                                           GValue     *value,
+                                           GParamSpec *pspec)
+{
+  GFBGraphConnectionIteratorPrivate *priv = GFBGRAPH_CONNECTION_ITERATOR_GET_PRIVATE (object);
+
+  switch (prop_id) {
+    case PROP_NODE:
+      g_value_set_object (value, priv->node);
+      break;
+    case PROP_NODE_TYPE:
+      g_value_set_gtype (value, priv->node_type);
+      break;
+    case PROP_AUTHORIZER:
+      g_value_set_object (value, priv->authorizer);
+      break;
+    case PROP_LIMIT:
+      g_value_set_uint (value, priv->limit);
+      break;
+    case PROP_FIELDS:
+      g_mutex_lock (&priv->mutex);
+      g_value_set_boxed (value, priv->fields);
+      g_mutex_unlock (&priv->mutex);
+      break;
+    case PROP_PREFETCH:
+      g_value_set_boolean (value, priv->prefetch);
+      break;
+    case PROP_SINCE:
+      g_value_set_int64 (value, priv->since);
+      break;
+    case PROP_UNTIL:
+      g_value_set_int64 (value, priv->until);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gfbgraph_connection_iterator_class_init (GFBGraphConnectionIteratorClass *klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+
+  parent_class                = g_type_class_peek_parent (klass);
+  gobject_class->constructed  = gfbgraph_connection_iterator_constructed;
+  gobject_class->dispose      = gfbgraph_connection_iterator_dispose;
+  gobject_class->finalize     = gfbgraph_connection_iterator_finalize;
+  gobject_class->set_property = gfbgraph_connection_iterator_set_property;
+  gobject_class->get_property = gfbgraph_connection_iterator_get_property;
+
+  g_type_class_add_private (gobject_class, sizeof(GFBGraphConnectionIteratorPrivate));
+
+  /**
+   * GFBGraphConnectionIterator:node:
+   *
+   * The node which connected nodes are retrieved.
+   **/
+  g_object_class_install_property (gobject_class,
+                                   PROP_NODE,
+                                   g_param_spec_object ("node",
+                                                        "Source node",
+                                                        "The node which connected nodes are retrieved",
+                                                        GFBGRAPH_TYPE_NODE,
+                                                        G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE));
+
+  /**
+   * GFBGraphConnectionIterator:node-type:
+   *
+   * The #GType of the connected nodes, it must implement the #GFBGraphConnectable interface.
+   **/
+  g_object_class_install_property (gobject_class,
+                                   PROP_NODE_TYPE,
+                                   g_param_spec_gtype ("node-type",
+                                                       "Connected nodes type",
+                                                       "The GType of the connected nodes",
+                                                       GFBGRAPH_TYPE_NODE,
+                                                       G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE));
+
+  /**
+   * GFBGraphConnectionIterator:authorizer:
+   *
+   * The #GFBGraphAuthorizer used to request the pages.
+   **/
+  g_object_class_install_property (gobject_class,
+                                   PROP_AUTHORIZER,
+                                   g_param_spec_object ("authorizer",
+                                                        "Authorizer",
+                                                        "The authorizer used to request the pages",
+                                                        GFBGRAPH_TYPE_AUTHORIZER,
+                                                        G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE));
+
+  /**
+   * GFBGraphConnectionIterator:limit:
+   *
+   * The maximum number of nodes in every page, or 0 to let the Graph API decide it.
+   * Changes are applied to the next requested page.
+   **/
+  g_object_class_install_property (gobject_class,
+                                   PROP_LIMIT,
+                                   g_param_spec_uint ("limit",
+                                                      "Page size",
+                                                      "The maximum number of nodes in every page",
+                                                      0, G_MAXUINT, 0,
+                                                      G_PARAM_READWRITE));
+
+  /**
+   * GFBGraphConnectionIterator:fields:
+   *
+   * The fields requested for every connected node, or %NULL to let the Graph API decide them.
+   * Changes are applied to the next requested page.
+   **/
+  g_object_class_install_property (gobject_class,
+                                   PROP_FIELDS,
+                                   g_param_spec_boxed ("fields",
+                                                       "Fields",
+                                                       "The fields requested for every connected node",
+                                                       GFBGRAPH_TYPE_FIELD_SET,
+                                                       G_PARAM_READWRITE));
+
+  /**
+   * GFBGraphConnectionIterator:prefetch:
+   *
+   * Whether the next page is requested in the background once the current one
+   * has been returned.
+   **/
+  g_object_class_install_property (gobject_class,
+                                   PROP_PREFETCH,
+                                   g_param_spec_boolean ("prefetch",
+                                                         "Prefetch",
+                                                         "Whether the next page is requested in background",
+                                                         TRUE,
+                                                         G_PARAM_CONSTRUCT | G_PARAM_READWRITE));
+
+  /**
+   * GFBGraphConnectionIterator:since:
+   *
+   * Only the nodes published from this time are requested, in microseconds
+   * since the epoch, or 0 for no lower bound. The Graph API uses second
+   * precision. Changes are applied to the next requested page.
+   **/
+  g_object_class_install_property (gobject_class,
+                                   PROP_SINCE,
+                                   g_param_spec_int64 ("since",
+                                                       "Since",
+                                                       "The lower bound of the publishing time of the nodes",
+                                                       0, G_MAXINT64, 0,
+                                                       G_PARAM_READWRITE));
+
+  /**
+   * GFBGraphConnectionIterator:until:
+   *
+   * Only the nodes published until this time are requested, in microseconds
+   * since the epoch, or 0 for no upper bound. The Graph API uses second
+   * precision. Changes are applied to the next requested page.
+   **/
+  g_object_class_install_property (gobject_class,
+                                   PROP_UNTIL,
+                                   g_param_spec_int64 ("until",
+                                                       "Until",
+                                                       "The upper bound of the publishing time of the nodes",
+                                                       0, G_MAXINT64, 0,
+                                                       G_PARAM_READWRITE));
+}
+
+static void
+gfbgraph_connection_iterator_init (GFBGraphConnectionIterator *obj)
+{
+  obj->priv = GFBGRAPH_CONNECTION_ITERATOR_GET_PRIVATE (obj);
+
+  g_mutex_init (&obj->priv->mutex);
+  g_cond_init (&obj->priv->cond);
+}
+
+/* --- Private Functions --- */
+static JsonObject *
+get_object_member (JsonObject  *jobject,
+                   const gchar *member_name)
+{
+  JsonNode *jnode;
+
+  jnode = json_object_get_member (jobject, member_name);
+  if (jnode == NULL || !JSON_NODE_HOLDS_OBJECT (jnode))
+    return NULL;
+
+  return json_node_get_object (jnode);
+}
+
+/* Takes the time based paging params from the "next" link */
+static GHashTable *
+parse_next_link (const gchar *next)
+{
+  static const gchar *paging_params[] = { "since", "until", "__paging_token" };
+  GHashTable *next_params = NULL;
+  GHashTable *form;
+  SoupURI *uri;
+  guint i;
+
+  if (next == NULL)
+    return NULL;
+
+  uri = soup_uri_new (next);
+  if (uri == NULL)
+    return NULL;
+
+  if (soup_uri_get_query (uri) != NULL) {
+    form = soup_form_decode (soup_uri_get_query (uri));
+    for (i = 0; i < G_N_ELEMENTS (paging_params); i++) {
+      const gchar *value = g_hash_table_lookup (form, paging_params[i]);
+
+      if (value == NULL)
+        continue;
+
+      if (next_params == NULL)
+        next_params = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, g_free);
+      g_hash_table_insert (next_params, (gpointer) paging_params[i], g_strdup (value));
+    }
+    g_hash_table_unref (form);
+  }
+  soup_uri_free (uri);
+
+  return next_params;
+}
+
+/* Returns the paging params of the next page, or %NULL in the last page.
+ * Connections with cursor based paging give the "after" cursor, the ones
+ * with time based paging (used when since or until are set) only give the
+ * "next" link. Only the "paging" member is parsed, the nodes were already
+ * parsed apart. */
+static GHashTable *
+parse_next_params (const gchar *payload,
+                   gssize       length)
+{
+  JsonParser *jparser;
+  const gchar *paging;
+  gsize paging_length;
+  GHashTable *next_params = NULL;
+
+  if (!gfbgraph_json_get_member (payload, length, "paging", &paging, &paging_length, NULL))
+    return NULL;
+
+  jparser = json_parser_new ();
+  if (json_parser_load_from_data (jparser, paging, paging_length, NULL)) {
+    JsonNode *paging_jnode;
+
+    paging_jnode = json_parser_get_root (jparser);
+    /* Without a "next" link this is the last page */
+    if (JSON_NODE_HOLDS_OBJECT (paging_jnode)
+        && json_object_has_member (json_node_get_object (paging_jnode), "next")) {
+      JsonObject *paging_jobject = json_node_get_object (paging_jnode);
+      JsonObject *cursors_jobject;
+
+      cursors_jobject = get_object_member (paging_jobject, "cursors");
+      if (cursors_jobject != NULL && json_object_has_member (cursors_jobject, "after")) {
+        next_params = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, g_free);
+        g_hash_table_insert (next_params, "after",
+                             g_strdup (json_object_get_string_member (cursors_jobject, "after")));
+      } else {
+        next_params = parse_next_link (json_object_get_string_member (paging_jobject, "next"));
+      }
+    }
+  }
+
+  g_object_unref (jparser);
+
+  return next_params;
+}
+
+static void
+add_time_param (RestProxyCall *call,
+                const gchar   *name,
+                gint64         time)
+{
+  gchar *time_str;
+
+  time_str = g_strdup_printf ("%" G_GINT64_FORMAT, time);
+  rest_proxy_call_add_param (call, name, time_str);
+  g_free (time_str);
+}
+
+/* Must be called with the mutex locked */
+static RestProxyCall *
+new_page_call_locked (GFBGraphConnectionIterator *iterator)
+{
+  GFBGraphConnectionIteratorPrivate *priv = iterator->priv;
+  RestProxyCall *rest_call;
+
+  rest_call = gfbgraph_new_rest_call (priv->authorizer);
+  rest_proxy_call_set_method (rest_call, "GET");
+  rest_proxy_call_set_function (rest_call, priv->function_path);
+  if (priv->limit > 0) {
+    gchar *limit_str;
+
+    limit_str = g_strdup_printf ("%u", priv->limit);
+    rest_proxy_call_add_param (rest_call, "limit", limit_str);
+    g_free (limit_str);
+  }
+  /* The params of the next page narrow the time range, so they win */
+  if (priv->next_params != NULL) {
+    GHashTableIter iter;
+    gpointer name, value;
+
+    g_hash_table_iter_init (&iter, priv->next_params);
+    while (g_hash_table_iter_next (&iter, &name, &value))
+      rest_proxy_call_add_param (rest_call, name, value);
+  }
+  if (priv->since > 0 && (priv->next_params == NULL || !g_hash_table_contains (priv->next_params, "since")))
+    add_time_param (rest_call, "since", priv->since / G_USEC_PER_SEC);
+  if (priv->until > 0 && (priv->next_params == NULL || !g_hash_table_contains (priv->next_params, "until")))
+    add_time_param (rest_call, "until", (priv->until + G_USEC_PER_SEC - 1) / G_USEC_PER_SEC);
+  if (priv->fields != NULL)
+    rest_proxy_call_add_param (rest_call, "fields", gfbgraph_field_set_to_string (priv->fields));
+
+  return rest_call;
+}
+
+/* Parses the response of @call. The fields are taken from @call instead of
+ * the iterator, as they can be changed while the request is in progress. */
+static GPtrArray *
+parse_page (GFBGraphConnectionIterator  *iterator,
+            RestProxyCall               *call,
+            GBytes                      *payload,
+            GHashTable                 **next_params,
+            GError                     **error)
+{
+  GPtrArray *nodes;
+  GError *parse_error = NULL;
+  RestParam *fields_param;
+  const gchar *data;
+  gsize length;
+
+  data = g_bytes_get_data (payload, &length);
+  nodes = gfbgraph_connection_info_parse_array (iterator->priv->connection,
+                                                data,
+                                                length,
+                                                &parse_error);
+  if (parse_error != NULL) {
+    g_propagate_error (error, parse_error);
+  } else {
+    *next_params = parse_next_params (data, length);
+
+    fields_param = rest_proxy_call_lookup_param (call, "fields");
+    gfbgraph_identity_map_canonicalize_array (iterator->priv->authorizer,
+                                              nodes,
+                                              fields_param != NULL ?
+                                              rest_param_get_content (fields_param) : NULL);
+  }
+
+  return nodes;
+}
+
+static void fetch_next_page (GFBGraphConnectionIterator *iterator,
+                             GCancellable               *cancellable);
+static void start_fetch_locked (GFBGraphConnectionIterator *iterator,
+                                gboolean                    async,
+                                GCancellable               *cancellable);
+
+static void
+prefetch_page_func (gpointer data,
+                    gpointer user_data)
+{
+  GFBGraphConnectionIterator *iterator = GFBGRAPH_CONNECTION_ITERATOR (data);
+  GCancellable *cancellable;
+
+  g_mutex_lock (&iterator->priv->mutex);
+  cancellable = iterator->priv->fetch_cancellable ? g_object_ref (iterator->priv->fetch_cancellable) : NULL;
+  g_mutex_unlock (&iterator->priv->mutex);
+
+  fetch_next_page (iterator, cancellable);
+  g_clear_object (&cancellable);
+  g_object_unref (iterator);
+}
+
+static GThreadPool *
+get_prefetch_pool (void)
+{
+  static GThreadPool *pool = NULL;
+
+  if (g_once_init_enter (&pool)) {
+    GThreadPool *new_pool;
+
+    new_pool = g_thread_pool_new (prefetch_page_func, NULL, MAX_PREFETCH_THREADS, FALSE, NULL);
+    g_once_init_leave (&pool, new_pool);
+  }
+
+  return pool;
+}
+
+static void
+wake_waiters_cb (GCancellable *cancellable,
+                 gpointer      user_data)
+{
+  GFBGraphConnectionIteratorPrivate *priv = GFBGRAPH_CONNECTION_ITERATOR (user_data)->priv;
+
+  g_mutex_lock (&priv->mutex);
+  g_cond_broadcast (&priv->cond);
+  g_mutex_unlock (&priv->mutex);
+}
+
+/* Must be called with the mutex locked and a page ready */
+static void
+take_page_locked (GFBGraphConnectionIterator  *iterator,
+                  gboolean                     async,
+                  GCancellable                *cancellable,
+                  GPtrArray                  **page,
+                  GError                     **error)
+{
+  GFBGraphConnectionIteratorPrivate *priv = iterator->priv;
+
+  *page = priv->page;
+  *error = priv->page_error;
+  priv->page = NULL;
+  priv->page_error = NULL;
+  priv->page_ready = FALSE;
+
+  if (*error == NULL && priv->prefetch && !priv->finished)
+    start_fetch_locked (iterator, async, cancellable);
+}
+
+static void
+return_page (GTask     *task,
+             GPtrArray *page,
+             GError    *error)
+{
+  if (error != NULL)
+    g_task_return_error (task, error);
+  else
+    g_task_return_pointer (task, page, (GDestroyNotify) g_ptr_array_unref);
+}
+
+/* Stores the requested page as the ready page, or hands it to the waiting
+ * next_page_async() call. */
+static void
+complete_fetch (GFBGraphConnectionIterator *iterator,
+                GPtrArray                  *page,
+                GHashTable                 *next_params,
+                GError                     *error)
+{
+  GFBGraphConnectionIteratorPrivate *priv = iterator->priv;
+  GTask *task;
+  gboolean async;
+
+  g_mutex_lock (&priv->mutex);
+
+  /* The next prefetch keeps running in the same mode */
+  async = priv->fetching_async;
+  priv->fetching = FALSE;
+  priv->fetching_async = FALSE;
+  g_clear_object (&priv->fetch_cancellable);
+
+  /* A cancelled page isn't kept, the next call requests it again */
+  if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+    task = priv->waiting_task;
+    if (task != NULL && !g_cancellable_is_cancelled (g_task_get_cancellable (task))) {
+      /* Cancelled by the call that started the prefetch, not by this one */
+      start_fetch_locked (iterator, async, g_task_get_cancellable (task));
+      task = NULL;
+    } else {
+      priv->waiting_task = NULL;
+    }
+
+    g_cond_broadcast (&priv->cond);
+    g_mutex_unlock (&priv->mutex);
+
+    if (task != NULL) {
+      g_task_return_error (task, error);
+      g_object_unref (task);
+    } else {
+      g_error_free (error);
+    }
+    return;
+  }
+
+  /* On error the paging params are kept, so the same page is requested again */
+  if (error == NULL) {
+    if (priv->next_params != NULL)
+      g_hash_table_unref (priv->next_params);
+    priv->next_params = next_params;
+    priv->finished = (next_params == NULL);
+  }
+
+  priv->page = page;
+  priv->page_error = error;
+  priv->page_ready = TRUE;
+
+  task = priv->waiting_task;
+  priv->waiting_task = NULL;
+  if (task != NULL)
+    take_page_locked (iterator, async, g_task_get_cancellable (task), &page, &error);
+
+  g_cond_broadcast (&priv->cond);
+  g_mutex_unlock (&priv->mutex);
+
+  if (task != NULL) {
+    return_page (task, page, error);
+    g_object_unref (task);
+  }
+}
+
+/* Requests the next page blocking the calling thread.
+ * The caller must set the fetching flag. */
+static void
+fetch_next_page (GFBGraphConnectionIterator *iterator,
+                 GCancellable               *cancellable)
+{
+  GFBGraphConnectionIteratorPrivate *priv = iterator->priv;
+  RestProxyCall *rest_call;
+  GBytes *payload;
+  GPtrArray *page = NULL;
+  GError *error = NULL;
+  GHashTable *next_params = NULL;
+
+  g_mutex_lock (&priv->mutex);
+  rest_call = new_page_call_locked (iterator);
+  g_mutex_unlock (&priv->mutex);
+
+  payload = gfbgraph_call_sync (rest_call, cancellable, &error);
+  if (payload != NULL) {
+    page = parse_page (iterator, rest_call, payload, &next_params, &error);
+    g_bytes_unref (payload);
+  }
+  g_object_unref (rest_call);
+
+  complete_fetch (iterator, page, next_params, error);
+}
+
+static void
+page_call_cb (GObject      *source_object,
+              GAsyncResult *result,
+              gpointer      user_data)
+{
+  GFBGraphConnectionIterator *iterator = GFBGRAPH_CONNECTION_ITERATOR (user_data);
+  GBytes *payload;
+  GPtrArray *page = NULL;
+  GError *error = NULL;
+  GHashTable *next_params = NULL;
+
+  payload = gfbgraph_call_finish (REST_PROXY_CALL (source_object), result, &error);
+  if (payload != NULL) {
+    page = parse_page (iterator, REST_PROXY_CALL (source_object), payload, &next_params, &error);
+    g_bytes_unref (payload);
+  }
+
+  complete_fetch (iterator, page, next_params, error);
+  g_object_unref (iterator);
+}
+
+/* Must be called with the mutex locked and no request in progress. Asynchronous
+ * requests are sent from the thread-default main context of the caller. */
+static void
+start_fetch_locked (GFBGraphConnectionIterator *iterator,
+                    gboolean                    async,
+                    GCancellable               *cancellable)
+{
+  GFBGraphConnectionIteratorPrivate *priv = iterator->priv;
+
+  priv->fetching = TRUE;
+  priv->fetching_async = async;
+  g_set_object (&priv->fetch_cancellable, cancellable);
+
+  if (async) {
+    RestProxyCall *rest_call;
+
+    rest_call = new_page_call_locked (iterator);
+    gfbgraph_call_async (rest_call, cancellable, page_call_cb, g_object_ref (iterator));
+    g_object_unref (rest_call);
+  } else {
+    g_thread_pool_push (get_prefetch_pool (), g_object_ref (iterator), NULL);
+  }
+}
+
+/**
+ * gfbgraph_connection_iterator_new:
+ * @node: a #GFBGraphNode object which retrieve the connected nodes.
+ * @node_type: a #GFBGraphNode type #GType that determines the kind of nodes to retrieve.
+ * @authorizer: a #GFBGraphAuthorizer.
+ * @error: (allow-none): a #GError or %NULL.
+ *
+ * Creates a new #GFBGraphConnectionIterator to retrieve, page by page, the nodes of type
+ * @node_type connected to @node. The @node_type object must implement the
+ * #GFBGraphConnectionable interface and be connectable to @node type object.
+ *
+ * Returns: (transfer full): a new #GFBGraphConnectionIterator or %NULL in case of error.
+ **/
+GFBGraphConnectionIterator *
+gfbgraph_connection_iterator_new (GFBGraphNode        *node,
+                                  GType                node_type,
+                                  GFBGraphAuthorizer  *authorizer,
+                                  GError             **error)
+{
+  GFBGraphConnectionIterator *iterator;
+
+  g_return_val_if_fail (GFBGRAPH_IS_NODE (node), NULL);
+  g_return_val_if_fail (g_type_is_a (node_type, GFBGRAPH_TYPE_NODE), NULL);
+  g_return_val_if_fail (GFBGRAPH_IS_AUTHORIZER (authorizer), NULL);
+
+  iterator = GFBGRAPH_CONNECTION_ITERATOR (g_object_new (GFBGRAPH_TYPE_CONNECTION_ITERATOR,
+                                                         "node", node,
+                                                         "node-type", node_type,
+                                                         "authorizer", authorizer,
+                                                         NULL));
+  if (iterator->priv->connection == NULL) {
+    /* Repeated to get the reason */
+    gfbgraph_connection_info_lookup (G_OBJECT_TYPE (node), node_type, error);
+    g_object_unref (iterator);
+    return NULL;
+  }
+
+  return iterator;
+}
+
+/**
+ * gfbgraph_connection_iterator_get_limit:
+ * @iterator: a #GFBGraphConnectionIterator.
+ *
+ * Returns: the maximum number of nodes requested in every page, or 0 if not set.
+ **/
+guint
+gfbgraph_connection_iterator_get_limit (GFBGraphConnectionIterator *iterator)
+{
+  g_return_val_if_fail (GFBGRAPH_IS_CONNECTION_ITERATOR (iterator), 0);
+
+  return iterator->priv->limit;
+}
+
+/**
+ * gfbgraph_connection_iterator_set_limit:
+ * @iterator: a #GFBGraphConnectionIterator.
+ * @limit: the maximum number of nodes in every page, or 0 to use the Graph API default.
+ *
+ * Sets the page size of the next requested pages.
+ **/
+void
+gfbgraph_connection_iterator_set_limit (GFBGraphConnectionIterator *iterator,
+                                        guint                       limit)
+{
+  g_return_if_fail (GFBGRAPH_IS_CONNECTION_ITERATOR (iterator));
+
+  g_object_set (G_OBJECT (iterator),
+                "limit", limit,
+                NULL);
+}
+
+/**
+ * gfbgraph_connection_iterator_get_since:
+ * @iterator: a #GFBGraphConnectionIterator.
+ *
+ * Returns: the lower bound of the publishing time of the requested nodes, in
+ * microseconds since the epoch, or 0 if not set.
+ **/
+gint64
+gfbgraph_connection_iterator_get_since (GFBGraphConnectionIterator *iterator)
+{
+  g_return_val_if_fail (GFBGRAPH_IS_CONNECTION_ITERATOR (iterator), 0);
+
+  return iterator->priv->since;
+}
+
+/**
+ * gfbgraph_connection_iterator_set_since:
+ * @iterator: a #GFBGraphConnectionIterator.
+ * @since: the lower bound in microseconds since the epoch, or 0 for none.
+ *
+ * Requests only the nodes published from @since in the next pages, for
+ * example the gfbgraph_node_get_created_timestamp() of the newest node
+ * retrieved in a previous sync.
+ **/
+void
+gfbgraph_connection_iterator_set_since (GFBGraphConnectionIterator *iterator,
+                                        gint64                      since)
+{
+  g_return_if_fail (GFBGRAPH_IS_CONNECTION_ITERATOR (iterator));
+
+  g_object_set (G_OBJECT (iterator),
+                "since", since,
+                NULL);
+}
+
+/**
+ * gfbgraph_connection_iterator_get_until:
+ * @iterator: a #GFBGraphConnectionIterator.
+ *
+ * Returns: the upper bound of the publishing time of the requested nodes, in
+ * microseconds since the epoch, or 0 if not set.
+ **/
+gint64
+gfbgraph_connection_iterator_get_until (GFBGraphConnectionIterator *iterator)
+{
+  g_return_val_if_fail (GFBGRAPH_IS_CONNECTION_ITERATOR (iterator), 0);
+
+  return iterator->priv->until;
+}
+
+/**
+ * gfbgraph_connection_iterator_set_until:
+ * @iterator: a #GFBGraphConnectionIterator.
+ * @until: the upper bound in microseconds since the epoch, or 0 for none.
+ *
+ * Requests only the nodes published until @until in the next pages.
+ **/
+void
+gfbgraph_connection_iterator_set_until (GFBGraphConnectionIterator *iterator,
+                                        gint64                      until)
+{
+  g_return_if_fail (GFBGRAPH_IS_CONNECTION_ITERATOR (iterator));
+
+  g_object_set (G_OBJECT (iterator),
+                "until", until,
+                NULL);
+}
+
+/**
+ * gfbgraph_connection_iterator_get_fields:
+ * @iterator: a #GFBGraphConnectionIterator.
+ *
+ * Returns: (transfer full) (allow-none): the #GFBGraphFieldSet requested for every
+ * connected node, or %NULL if not set. Use gfbgraph_field_set_unref() when done.
+ **/
+GFBGraphFieldSet *
+gfbgraph_connection_iterator_get_fields (GFBGraphConnectionIterator *iterator)
+{
+  GFBGraphFieldSet *fields;
+
+  g_return_val_if_fail (GFBGRAPH_IS_CONNECTION_ITERATOR (iterator), NULL);
+
+  g_object_get (G_OBJECT (iterator),
+                "fields", &fields,
+                NULL);
+
+  return fields;
+}
+
+/**
+ * gfbgraph_connection_iterator_set_fields:
+ * @iterator: a #GFBGraphConnectionIterator.
+ * @fields: (allow-none): a #GFBGraphFieldSet, or %NULL to use the Graph API default fields.
+ *
+ * Sets the fields requested for every connected node in the next requested pages.
+ **/
+void
+gfbgraph_connection_iterator_set_fields (GFBGraphConnectionIterator *iterator,
+                                         GFBGraphFieldSet           *fields)
+{
+  g_return_if_fail (GFBGRAPH_IS_CONNECTION_ITERATOR (iterator));
+
+  g_object_set (G_OBJECT (iterator),
+                "fields", fields,
+                NULL);
+}
+
+/**
+ * gfbgraph_connection_iterator_is_finished:
+ * @iterator: a #GFBGraphConnectionIterator.
+ *
+ * Returns: %TRUE if all the pages have been returned.
+ **/
+gboolean
+gfbgraph_connection_iterator_is_finished (GFBGraphConnectionIterator *iterator)
+{
+  GFBGraphConnectionIteratorPrivate *priv;
+  gboolean finished;
+
+  g_return_val_if_fail (GFBGRAPH_IS_CONNECTION_ITERATOR (iterator), TRUE);
+
+  priv = iterator->priv;
+
+  g_mutex_lock (&priv->mutex);
+  finished = priv->finished && !priv->fetching && !priv->page_ready;
+  g_mutex_unlock (&priv->mutex);
+
+  return finished;
+}
+
+/**
+ * gfbgraph_connection_iterator_next_page:
+ * @iterator: a #GFBGraphConnectionIterator.
+ * @cancellable: (allow-none): An optional #GCancellable object, or %NULL.
+ * @error: (allow-none): a #GError or %NULL.
+ *
+ * Retrieves the next page of connected nodes. If the page was already prefetched it's
+ * returned immediately, otherwise this call blocks until it's received.
+ * If a page is being requested asynchronously after a previous
+ * gfbgraph_connection_iterator_next_page_async() call, %G_IO_ERROR_PENDING is returned.
+ * See gfbgraph_connection_iterator_next_page_async() for the asynchronous version of this call.
+ *
+ * When an error is returned, the next call requests the same page again.
+ *
+ * Returns: (element-type GFBGraphNode) (transfer full): a newly-allocated #GList with the nodes
+ * of the page, or %NULL when there are no more pages or in case of error.
+ **/
+GList *
+gfbgraph_connection_iterator_next_page (GFBGraphConnectionIterator  *iterator,
+                                        GCancellable                *cancellable,
+                                        GError                     **error)
+{
+  return gfbgraph_nodes_array_to_list (gfbgraph_connection_iterator_next_page_array (iterator,
+                                                                                     cancellable,
+                                                                                     error));
+}
+
+/**
+ * gfbgraph_connection_iterator_next_page_array:
+ * @iterator: a #GFBGraphConnectionIterator.
+ * @cancellable: (allow-none): An optional #GCancellable object, or %NULL.
+ * @error: (allow-none): a #GError or %NULL.
+ *
+ * Like gfbgraph_connection_iterator_next_page(), but the nodes are returned in a #GPtrArray.
+ *
+ * Returns: (element-type GFBGraphNode) (transfer full): a newly-allocated #GPtrArray with the nodes
+ * of the page, or %NULL when there are no more pages or in case of error.
+ **/
+GPtrArray *
+gfbgraph_connection_iterator_next_page_array (GFBGraphConnectionIterator  *iterator,
+                                              GCancellable                *cancellable,
+                                              GError                     **error)
+{
+  GFBGraphConnectionIteratorPrivate *priv;
+  GPtrArray *page = NULL;
+  GError *page_error = NULL;
+  gulong cancelled_id = 0;
+
+  g_return_val_if_fail (GFBGRAPH_IS_CONNECTION_ITERATOR (iterator), NULL);
+  g_return_val_if_fail (iterator->priv->connection != NULL, NULL);
+  g_return_val_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable), NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  priv = iterator->priv;
+
+  if (cancellable != NULL)
+    cancelled_id = g_cancellable_connect (cancellable, G_CALLBACK (wake_waiters_cb), iterator, NULL);
+
+  g_mutex_lock (&priv->mutex);
+
+  g_warn_if_fail (priv->waiting_task == NULL);
+
+  /* Waiting here could block the main context that completes the request */
+  if (priv->fetching_async) {
+    g_mutex_unlock (&priv->mutex);
+    g_cancellable_disconnect (cancellable, cancelled_id);
+    g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_PENDING,
+                         "A page is being requested asynchronously");
+    return NULL;
+  }
+
+  /* A page cancelled while waiting for it is requested again */
+  while (!g_cancellable_is_cancelled (cancellable) && !priv->page_ready && !priv->finished) {
+    if (priv->fetching) {
+      g_cond_wait (&priv->cond, &priv->mutex);
+      continue;
+    }
+
+    priv->fetching = TRUE;
+    g_mutex_unlock (&priv->mutex);
+
+    fetch_next_page (iterator, cancellable);
+
+    g_mutex_lock (&priv->mutex);
+  }
+
+  /* When cancelled, the ready page, if any, is kept for the next call */
+  if (!g_cancellable_set_error_if_cancelled (cancellable, &page_error) && priv->page_ready)
+    take_page_locked (iterator, FALSE, cancellable, &page, &page_error);
+
+  g_mutex_unlock (&priv->mutex);
+
+  g_cancellable_disconnect (cancellable, cancelled_id);
+
+  if (page_error != NULL)
+    g_propagate_error (error, page_error);
+
+  return page;
+}
+
+/**
+ * gfbgraph_connection_iterator_next_page_async:
+ * @iterator: a #GFBGraphConnectionIterator.
+ * @cancellable: (allow-none): An optional #GCancellable object, or %NULL.
+ * @callback: (scope async): A #GAsyncReadyCallback to call when the request is completed.
+ * @user_data: (closure): The data to pass to @callback.
+ *
+ * Asynchronously retrieves the next page of connected nodes. See
+ * gfbgraph_connection_iterator_next_page() for the synchronous version of this call.
+ *
+ * When the operation is finished, @callback will be called. You can then call
+ * gfbgraph_connection_iterator_next_page_finish() or
+ * gfbgraph_connection_iterator_next_page_array_finish() to get the nodes of the page.
+ **/
+void
+gfbgraph_connection_iterator_next_page_async (GFBGraphConnectionIterator  *iterator,
+                                              GCancellable                *cancellable,
+                                              GAsyncReadyCallback          callback,
+                                              gpointer                     user_data)
+{
+  GFBGraphConnectionIteratorPrivate *priv;
+  GPtrArray *page = NULL;
+  GError *page_error = NULL;
+  GTask *task;
+
+  g_return_if_fail (GFBGRAPH_IS_CONNECTION_ITERATOR (iterator));
+  g_return_if_fail (iterator->priv->connection != NULL);
+  g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+  g_return_if_fail (callback != NULL);
+
+  priv = iterator->priv;
+
+  task = g_task_new (iterator, cancellable, callback, user_data);
+  g_task_set_source_tag (task, gfbgraph_connection_iterator_next_page_async);
+  /* Once requested, the page is always returned so it isn't lost */
+  g_task_set_check_cancellable (task, FALSE);
+
+  if (g_task_return_error_if_cancelled (task)) {
+    g_object_unref (task);
+    return;
+  }
+
+  g_mutex_lock (&priv->mutex);
+
+  if (priv->waiting_task != NULL) {
+    g_mutex_unlock (&priv->mutex);
+    g_task_return_new_error (task, G_IO_ERROR, G_IO_ERROR_PENDING,
+                             "Another page request is already in progress");
+    g_object_unref (task);
+    return;
+  }
+
+  if (priv->page_ready) {
+    take_page_locked (iterator, TRUE, cancellable, &page, &page_error);
+    g_mutex_unlock (&priv->mutex);
+    return_page (task, page, page_error);
+    g_object_unref (task);
+    return;
+  }
+
+  if (!priv->fetching && priv->finished) {
+    g_mutex_unlock (&priv->mutex);
+    g_task_return_pointer (task, NULL, NULL);
+    g_object_unref (task);
+    return;
+  }
+
+  /* The reference is released when the page is returned */
+  priv->waiting_task = task;
+  if (!priv->fetching)
+    start_fetch_locked (iterator, TRUE, cancellable);
+
+  g_mutex_unlock (&priv->mutex);
+}
+
+/**
+ * gfbgraph_connection_iterator_next_page_finish:
+ * @iterator: a #GFBGraphConnectionIterator.
+ * @result: A #GAsyncResult.
+ * @error: (allow-none): An optional #GError, or %NULL.
+ *
+ * Finishes an asynchronous operation started with
+ * gfbgraph_connection_iterator_next_page_async().
+ *
+ * Returns: (element-type GFBGraphNode) (transfer full): a newly-allocated #GList with the nodes
+ * of the page, or %NULL when there are no more pages or in case of error.
+ **/
+GList *
+gfbgraph_connection_iterator_next_page_finish (GFBGraphConnectionIterator  *iterator,
+                                               GAsyncResult                *result,
+                                               GError                     **error)
+{
+  g_return_val_if_fail (g_task_is_valid (result, iterator), NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  return gfbgraph_nodes_array_to_list (g_task_propagate_pointer (G_TASK (result), error));
+}
+
+/**
+ * gfbgraph_connection_iterator_next_page_array_finish:
+ * @iterator: a #GFBGraphConnectionIterator.
+ * @result: A #GAsyncResult.
+ * @error: (allow-none): An optional #GError, or %NULL.
+ *
+ * Finishes an asynchronous operation started with
+ * gfbgraph_connection_iterator_next_page_async(), returning the nodes in a #GPtrArray.
+ *
+ * Returns: (element-type GFBGraphNode) (transfer full): a newly-allocated #GPtrArray with the nodes
+ * of the page, or %NULL when there are no more pages or in case of error.
+ **/
+GPtrArray *
+gfbgraph_connection_iterator_next_page_array_finish (GFBGraphConnectionIterator  *iterator,
+                                                     GAsyncResult                *result,
+                                                     GError                     **error)
+{
+  g_return_val_if_fail (g_task_is_valid (result, iterator), NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  return g_task_propagate_pointer (G_TASK (result), error);
+}
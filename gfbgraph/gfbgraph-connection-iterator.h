@@ -0,0 +1,101 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 2; tab-width: 2 -*-  */
+/*
+ * libgfbgraph - GObject library for Facebook Graph API
+ * Copyright (C) 2013 Álvaro Peña <alvaropg@gmail.com>
+ *               2020 Leesoo Ahn <yisooan@fedoraproject.org>
+ *
+ * GFBGraph is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GFBGraph is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GFBGraph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GFBGRAPH_CONNECTION_ITERATOR_H__
+#define __GFBGRAPH_CONNECTION_ITERATOR_H__
+
+#include <gio/gio.h>
+#include <glib-object.h>
+
+#include <gfbgraph/gfbgraph-authorizer.h>
+#include <gfbgraph/gfbgraph-field-set.h>
+#include <gfbgraph/gfbgraph-node.h>
+
+G_BEGIN_DECLS
+
+#define GFBGRAPH_TYPE_CONNECTION_ITERATOR (gfbgraph_connection_iterator_get_type())
+#define GFBGRAPH_CONNECTION_ITERATOR(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj),GFBGRAPH_TYPE_CONNECTION_ITERATOR,GFBGraphConnectionIterator))
+#define GFBGRAPH_CONNECTION_ITERATOR_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass),GFBGRAPH_TYPE_CONNECTION_ITERATOR,GFBGraphConnectionIteratorClass))
+#define GFBGRAPH_IS_CONNECTION_ITERATOR(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj),GFBGRAPH_TYPE_CONNECTION_ITERATOR))
+#define GFBGRAPH_IS_CONNECTION_ITERATOR_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass),GFBGRAPH_TYPE_CONNECTION_ITERATOR))
+#define GFBGRAPH_CONNECTION_ITERATOR_GET_CLASS(obj) \
+  (G_TYPE_INSTANCE_GET_CLASS((obj),GFBGRAPH_TYPE_CONNECTION_ITERATOR,GFBGraphConnectionIteratorClass))
+
+typedef struct _GFBGraphConnectionIterator        GFBGraphConnectionIterator;
+typedef struct _GFBGraphConnectionIteratorClass   GFBGraphConnectionIteratorClass;
+typedef struct _GFBGraphConnectionIteratorPrivate GFBGraphConnectionIteratorPrivate;
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (GFBGraphConnectionIterator, g_object_unref)
+
+struct _GFBGraphConnectionIterator {
+  GObject parent;
+
+  /*< private >*/
+  GFBGraphConnectionIteratorPrivate *priv;
+};
+
+struct _GFBGraphConnectionIteratorClass {
+  GObjectClass parent_class;
+};
+
+GType                       gfbgraph_connection_iterator_get_type  (void) G_GNUC_CONST;
+GFBGraphConnectionIterator* gfbgraph_connection_iterator_new       (GFBGraphNode        *node,
+                                                                    GType                node_type,
+                                                                    GFBGraphAuthorizer  *authorizer,
+                                                                    GError             **error);
+
+guint     gfbgraph_connection_iterator_get_limit    (GFBGraphConnectionIterator *iterator);
+void      gfbgraph_connection_iterator_set_limit    (GFBGraphConnectionIterator *iterator,
+                                                     guint                       limit);
+gint64    gfbgraph_connection_iterator_get_since    (GFBGraphConnectionIterator *iterator);
+void      gfbgraph_connection_iterator_set_since    (GFBGraphConnectionIterator *iterator,
+                                                     gint64                      since);
+gint64    gfbgraph_connection_iterator_get_until    (GFBGraphConnectionIterator *iterator);
+void      gfbgraph_connection_iterator_set_until    (GFBGraphConnectionIterator *iterator,
+                                                     gint64                      until);
+GFBGraphFieldSet* gfbgraph_connection_iterator_get_fields (GFBGraphConnectionIterator *iterator);
+void      gfbgraph_connection_iterator_set_fields   (GFBGraphConnectionIterator *iterator,
+                                                     GFBGraphFieldSet           *fields);
+gboolean  gfbgraph_connection_iterator_is_finished  (GFBGraphConnectionIterator *iterator);
+
+GList*    gfbgraph_connection_iterator_next_page        (GFBGraphConnectionIterator  *iterator,
+                                                         GCancellable                *cancellable,
+                                                         GError                     **error);
+GPtrArray* gfbgraph_connection_iterator_next_page_array (GFBGraphConnectionIterator  *iterator,
+                                                         GCancellable                *cancellable,
+                                                         GError                     **error);
+void      gfbgraph_connection_iterator_next_page_async  (GFBGraphConnectionIterator  *iterator,
+                                                         GCancellable                *cancellable,
+                                                         GAsyncReadyCallback          callback,
+                                                         gpointer                     user_data);
+GList*    gfbgraph_connection_iterator_next_page_finish (GFBGraphConnectionIterator  *iterator,
+                                                         GAsyncResult                *result,
+                                                         GError                     **error);
+GPtrArray* gfbgraph_connection_iterator_next_page_array_finish (GFBGraphConnectionIterator  *iterator,
+                                                                GAsyncResult                *result,
+                                                                GError                     **error);
+
+G_END_DECLS
+
+#endif /* __GFBGRAPH_CONNECTION_ITERATOR_H__ */
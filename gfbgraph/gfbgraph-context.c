@@ -0,0 +1,731 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 2; tab-width: 2 -*-  */
+/*
+ * libgfbgraph - GObject library for Facebook Graph API
+ * Copyright (C) 2013 Álvaro Peña <alvaropg@gmail.com>
+ *               2020 Leesoo Ahn <yisooan@fedoraproject.org>
+ *
+ * GFBGraph is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GFBGraph is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GFBGraph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * SECTION:gfbgraph-context
+ * @title: GFBGraphContext
+ * @short_description: Shared connection context for the Graph API
+ * @stability: Unstable
+ * @include: gfbgraph/gfbgraph.h
+ *
+ * #GFBGraphContext keeps a single #RestProxy and #SoupSession alive, so the
+ * requests done by the library can reuse the HTTP connections (keep-alive and
+ * TLS sessions) instead of doing a full handshake for every node. The Graph API
+ * calls go through the #RestProxy, which keeps the default connection limits
+ * of libsoup; the #SoupSession is only used for the downloads, and its limits
+ * can be set with #GFBGraphContext:max-connections and
+ * #GFBGraphContext:max-connections-per-host. The concurrency of the Graph API
+ * calls is bounded by the #GFBGraphScheduler instead.
+ *
+ * All the node functions use the context returned by
+ * gfbgraph_context_get_for_authorizer(), which is the process-wide context
+ * from gfbgraph_context_get_default() unless another one was set for the
+ * authorizer with gfbgraph_context_set_for_authorizer().
+ *
+ * The requests of the context are paced by its #GFBGraphScheduler, see
+ * #GFBGraphContext:scheduler. Optionally, the responses can be kept in a
+ * #GFBGraphCache, see gfbgraph_context_set_cache(), and the parsed nodes in a
+ * #GFBGraphIdentityMap, see gfbgraph_context_set_identity_map(), and the
+ * requests failed for a transient reason retried following a
+ * #GFBGraphRetryPolicy, see gfbgraph_context_set_retry_policy().
+ *
+ * The contexts created without an endpoint, like the default one, use the URL
+ * in the <envar>GFBGRAPH_ENDPOINT</envar> environment variable if it's set, so
+ * the library can be pointed to a local server for testing without changes in
+ * the application.
+ **/
+
+#include "gfbgraph-context.h"
+#include "gfbgraph-private.h"
+
+#define FACEBOOK_ENDPOINT "https://graph.facebook.com/v7.0"
+#define ENDPOINT_ENV_VAR  "GFBGRAPH_ENDPOINT"
+
+#define DEFAULT_MAX_CONNS          10
+#define DEFAULT_MAX_CONNS_PER_HOST 4
+
+enum {
+  PROP_0,
+  PROP_ENDPOINT,
+  PROP_MAX_CONNECTIONS,
+  PROP_MAX_CONNECTIONS_PER_HOST,
+  PROP_SCHEDULER,
+  PROP_CACHE,
+  PROP_IDENTITY_MAP,
+  PROP_RETRY_POLICY
+};
+
+struct _GFBGraphContextPrivate {
+  gchar       *endpoint;
+  guint        max_conns;
+  guint        max_conns_per_host;
+  RestProxy   *proxy;
+  SoupSession *session;
+  GFBGraphScheduler *scheduler;
+  GMutex       cache_mutex;  /* Guards the cache, the identity map and the retry policy */
+  GFBGraphCache *cache;
+  GFBGraphIdentityMap *identity_map;
+  GFBGraphRetryPolicy *retry_policy;
+};
+
+#define GFBGRAPH_CONTEXT_GET_PRIVATE(o) \
+  (G_TYPE_INSTANCE_GET_PRIVATE((o), GFBGRAPH_TYPE_CONTEXT, GFBGraphContextPrivate))
+
+static GObjectClass *parent_class = NULL;
+
+G_DEFINE_TYPE (GFBGraphContext, gfbgraph_context, G_TYPE_OBJECT);
+
+static GQuark
+context_quark (void)
+{
+  return g_quark_from_static_string ("gfbgraph-context");
+}
+
+static GQuark
+call_context_quark (void)
+{
+  return g_quark_from_static_string ("gfbgraph-call-context");
+}
+
+static GQuark
+call_authorizer_quark (void)
+{
+  return g_quark_from_static_string ("gfbgraph-call-authorizer");
+}
+
+static void
+gfbgraph_context_constructed (GObject *object)
+{
+  GFBGraphContextPrivate *priv = GFBGRAPH_CONTEXT_GET_PRIVATE (object);
+
+  if (priv->endpoint == NULL) {
+    const gchar *env_endpoint = g_getenv (ENDPOINT_ENV_VAR);
+
+    priv->endpoint = g_strdup (env_endpoint != NULL && *env_endpoint != '\0' ? env_endpoint : FACEBOOK_ENDPOINT);
+  }
+
+  priv->proxy = rest_proxy_new (priv->endpoint, FALSE);
+  priv->session = soup_session_new_with_options (SOUP_SESSION_MAX_CONNS, priv->max_conns,
+                                                 SOUP_SESSION_MAX_CONNS_PER_HOST, priv->max_conns_per_host,
+                                                 NULL);
+  if (priv->scheduler == NULL)
+    priv->scheduler = gfbgraph_scheduler_new ();
+
+  G_OBJECT_CLASS (parent_class)->constructed (object);
+}
+
+static void
+gfbgraph_context_dispose (GObject *object)
+{
+  GFBGraphContextPrivate *priv = GFBGRAPH_CONTEXT_GET_PRIVATE (object);
+
+  g_clear_object (&priv->proxy);
+  g_clear_object (&priv->session);
+  g_clear_object (&priv->scheduler);
+  g_clear_object (&priv->cache);
+  g_clear_object (&priv->identity_map);
+  g_clear_object (&priv->retry_policy);
+
+  G_OBJECT_CLASS (parent_class)->dispose (object);
+}
+
+static void
+gfbgraph_context_finalize (GObject *object)
+{
+  GFBGraphContextPrivate *priv = GFBGRAPH_CONTEXT_GET_PRIVATE (object);
+
+  g_free (priv->endpoint);
+  g_mutex_clear (&priv->cache_mutex);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static void
+gfbgraph_context_set_property (GObject      *object,
+                               guint         prop_id,
+                               const GValue *value,
+                               GParamSpec   *pspec)
+{
+  GFBGraphContextPrivate *priv = GFBGRAPH_CONTEXT_GET_PRIVATE (object);
+
+  switch (prop_id) {
+    case PROP_ENDPOINT:
+      g_free (priv->endpoint);
+      priv->endpoint = g_value_dup_string (value);
+      break;
+    case PROP_MAX_CONNECTIONS:
+      priv->max_conns = g_value_get_uint (value);
+      break;
+    case PROP_MAX_CONNECTIONS_PER_HOST:
+      priv->max_conns_per_host = g_value_get_uint (value);
+      break;
+    case PROP_SCHEDULER:
+      priv->scheduler = g_value_dup_object (value);
+      break;
+    case PROP_CACHE:
+      g_mutex_lock (&priv->cache_mutex);
+      g_clear_object (&priv->cache);
+      priv->cache = g_value_dup_object (value);
+      g_mutex_unlock (&priv->cache_mutex);
+      break;
+    case PROP_IDENTITY_MAP:
+      g_mutex_lock (&priv->cache_mutex);
+      g_clear_object (&priv->identity_map);
+      priv->identity_map = g_value_dup_object (value);
+      g_mutex_unlock (&priv->cache_mutex);
+      break;
+    case PROP_RETRY_POLICY:
+      g_mutex_lock (&priv->cache_mutex);
+      g_clear_object (&priv->retry_policy);
+      priv->retry_policy = g_value_dup_object (value);
+      g_mutex_unlock (&priv->cache_mutex);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gfbgraph_context_get_property (GObject    *object,
+                               guint       prop_id,
+                               GValue     *value,
+                               GParamSpec *pspec)
+{
+  GFBGraphContextPrivate *priv = GFBGRAPH_CONTEXT_GET_PRIVATE (object);
+
+  switch (prop_id) {
+    case PROP_ENDPOINT:
+      g_value_set_string (value, priv->endpoint);
+      break;
+    case PROP_MAX_CONNECTIONS:
+      g_value_set_uint (value, priv->max_conns);
+      break;
+    case PROP_MAX_CONNECTIONS_PER_HOST:
+      g_value_set_uint (value, priv->max_conns_per_host);
+      break;
+    case PROP_SCHEDULER:
+      g_value_set_object (value, priv->scheduler);
+      break;
+    case PROP_CACHE:
+      g_mutex_lock (&priv->cache_mutex);
+      g_value_set_object (value, priv->cache);
+      g_mutex_unlock (&priv->cache_mutex);
+      break;
+    case PROP_IDENTITY_MAP:
+      g_mutex_lock (&priv->cache_mutex);
+      g_value_set_object (value, priv->identity_map);
+      g_mutex_unlock (&priv->cache_mutex);
+      break;
+    case PROP_RETRY_POLICY:
+      g_mutex_lock (&priv->cache_mutex);
+      g_value_set_object (value, priv->retry_policy);
+      g_mutex_unlock (&priv->cache_mutex);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gfbgraph_context_class_init (GFBGraphContextClass *klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+
+  parent_class                 = g_type_class_peek_parent (klass);
+  gobject_class->constructed   = gfbgraph_context_constructed;
+  gobject_class->dispose       = gfbgraph_context_dispose;
+  gobject_class->finalize      = gfbgraph_context_finalize;
+  gobject_class->set_property  = gfbgraph_context_set_property;
+  gobject_class->get_property  = gfbgraph_context_get_property;
+
+  g_type_class_add_private (gobject_class, sizeof(GFBGraphContextPrivate));
+
+  /**
+   * GFBGraphContext:endpoint:
+   *
+   * The base URL of the Facebook Graph API used by the calls created from this context.
+   * If it's %NULL, the value of the <envar>GFBGRAPH_ENDPOINT</envar> environment
+   * variable is used, or the public Graph API if it isn't set.
+   **/
+  g_object_class_install_property (gobject_class,
+                                   PROP_ENDPOINT,
+                                   g_param_spec_string ("endpoint",
+                                                        "Graph API endpoint",
+                                                        "The base URL of the Facebook Graph API",
+                                                        FACEBOOK_ENDPOINT,
+                                                        G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE));
+
+  /**
+   * GFBGraphContext:max-connections:
+   *
+   * The maximum number of simultaneous connections of the #SoupSession of the
+   * context, see gfbgraph_context_get_session(). It only bounds the downloads
+   * and the other requests sent with that session, not the Graph API calls,
+   * which go through the #RestProxy of the context.
+   **/
+  g_object_class_install_property (gobject_class,
+                                   PROP_MAX_CONNECTIONS,
+                                   g_param_spec_uint ("max-connections",
+                                                      "Maximum connections",
+                                                      "The maximum number of connections in the pool",
+                                                      1, G_MAXUINT, DEFAULT_MAX_CONNS,
+                                                      G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE));
+
+  /**
+   * GFBGraphContext:max-connections-per-host:
+   *
+   * The maximum number of simultaneous connections of the #SoupSession of the
+   * context to the same host. Like #GFBGraphContext:max-connections, it doesn't
+   * apply to the Graph API calls.
+   **/
+  g_object_class_install_property (gobject_class,
+                                   PROP_MAX_CONNECTIONS_PER_HOST,
+                                   g_param_spec_uint ("max-connections-per-host",
+                                                      "Maximum connections per host",
+                                                      "The maximum number of connections to a single host",
+                                                      1, G_MAXUINT, DEFAULT_MAX_CONNS_PER_HOST,
+                                                      G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE));
+
+  /**
+   * GFBGraphContext:scheduler:
+   *
+   * The #GFBGraphScheduler every request of the context waits in. A new one is
+   * created if not set, pass the same scheduler to several contexts to share
+   * their concurrency and rate limits.
+   **/
+  g_object_class_install_property (gobject_class,
+                                   PROP_SCHEDULER,
+                                   g_param_spec_object ("scheduler",
+                                                        "Scheduler",
+                                                        "The scheduler of the requests",
+                                                        GFBGRAPH_TYPE_SCHEDULER,
+                                                        G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE));
+
+  /**
+   * GFBGraphContext:cache:
+   *
+   * The #GFBGraphCache of the GET requests of the context, or %NULL to not cache them.
+   **/
+  g_object_class_install_property (gobject_class,
+                                   PROP_CACHE,
+                                   g_param_spec_object ("cache",
+                                                        "Cache",
+                                                        "The cache of the responses",
+                                                        GFBGRAPH_TYPE_CACHE,
+                                                        G_PARAM_READWRITE));
+
+  /**
+   * GFBGraphContext:identity-map:
+   *
+   * The #GFBGraphIdentityMap where the nodes parsed from the responses of the
+   * context are merged, or %NULL to always create new instances.
+   **/
+  g_object_class_install_property (gobject_class,
+                                   PROP_IDENTITY_MAP,
+                                   g_param_spec_object ("identity-map",
+                                                        "Identity map",
+                                                        "The map of the nodes by their ID",
+                                                        GFBGRAPH_TYPE_IDENTITY_MAP,
+                                                        G_PARAM_READWRITE));
+
+  /**
+   * GFBGraphContext:retry-policy:
+   *
+   * The #GFBGraphRetryPolicy of the requests of the context, or %NULL to not
+   * retry the failed ones.
+   **/
+  g_object_class_install_property (gobject_class,
+                                   PROP_RETRY_POLICY,
+                                   g_param_spec_object ("retry-policy",
+                                                        "Retry policy",
+                                                        "The policy of the retries of the failed requests",
+                                                        GFBGRAPH_TYPE_RETRY_POLICY,
+                                                        G_PARAM_READWRITE));
+}
+
+static void
+gfbgraph_context_init (GFBGraphContext *obj)
+{
+  obj->priv = GFBGRAPH_CONTEXT_GET_PRIVATE (obj);
+  g_mutex_init (&obj->priv->cache_mutex);
+}
+
+/**
+ * gfbgraph_context_new:
+ * @endpoint: (allow-none): the Graph API base URL, or %NULL to use the default one,
+ *   see #GFBGraphContext:endpoint.
+ *
+ * Creates a new #GFBGraphContext. Most applications don't need this and can use
+ * the shared context returned by gfbgraph_context_get_default().
+ *
+ * Returns: (transfer full): a new #GFBGraphContext; unref with g_object_unref()
+ **/
+GFBGraphContext *
+gfbgraph_context_new (const gchar *endpoint)
+{
+  return GFBGRAPH_CONTEXT (g_object_new (GFBGRAPH_TYPE_CONTEXT,
+                                         "endpoint", endpoint,
+                                         NULL));
+}
+
+/**
+ * gfbgraph_context_get_default:
+ *
+ * Gets the process-wide #GFBGraphContext. It's created on the first call and
+ * lives until the process ends. This function is thread safe.
+ *
+ * Returns: (transfer none): the default #GFBGraphContext.
+ **/
+GFBGraphContext *
+gfbgraph_context_get_default (void)
+{
+  static GFBGraphContext *default_context = NULL;
+
+  if (g_once_init_enter (&default_context)) {
+    GFBGraphContext *context;
+
+    context = gfbgraph_context_new (NULL);
+    g_once_init_leave (&default_context, context);
+  }
+
+  return default_context;
+}
+
+/**
+ * gfbgraph_context_get_for_authorizer:
+ * @authorizer: a #GFBGraphAuthorizer.
+ *
+ * Gets the context used by the calls done with @authorizer.
+ *
+ * Returns: (transfer none): the #GFBGraphContext set with gfbgraph_context_set_for_authorizer()
+ * or the default one.
+ **/
+GFBGraphContext *
+gfbgraph_context_get_for_authorizer (GFBGraphAuthorizer *authorizer)
+{
+  GFBGraphContext *context;
+
+  g_return_val_if_fail (GFBGRAPH_IS_AUTHORIZER (authorizer), NULL);
+
+  context = g_object_get_qdata (G_OBJECT (authorizer), context_quark ());
+  if (context == NULL)
+    context = gfbgraph_context_get_default ();
+
+  return context;
+}
+
+/**
+ * gfbgraph_context_set_for_authorizer:
+ * @context: (allow-none): a #GFBGraphContext, or %NULL to go back to the default one.
+ * @authorizer: a #GFBGraphAuthorizer.
+ *
+ * Makes every call done with @authorizer go through @context. Useful to keep a
+ * separated connection pool per account.
+ **/
+void
+gfbgraph_context_set_for_authorizer (GFBGraphContext    *context,
+                                     GFBGraphAuthorizer *authorizer)
+{
+  g_return_if_fail (context == NULL || GFBGRAPH_IS_CONTEXT (context));
+  g_return_if_fail (GFBGRAPH_IS_AUTHORIZER (authorizer));
+
+  g_object_set_qdata_full (G_OBJECT (authorizer),
+                           context_quark (),
+                           context ? g_object_ref (context) : NULL,
+                           g_object_unref);
+}
+
+/**
+ * gfbgraph_context_get_endpoint:
+ * @context: a #GFBGraphContext.
+ *
+ * Returns: (transfer none): the Graph API base URL used by @context.
+ **/
+const gchar *
+gfbgraph_context_get_endpoint (GFBGraphContext *context)
+{
+  g_return_val_if_fail (GFBGRAPH_IS_CONTEXT (context), NULL);
+
+  return context->priv->endpoint;
+}
+
+/**
+ * gfbgraph_context_get_proxy:
+ * @context: a #GFBGraphContext.
+ *
+ * Returns: (transfer none): the #RestProxy shared by all the calls of @context.
+ **/
+RestProxy *
+gfbgraph_context_get_proxy (GFBGraphContext *context)
+{
+  g_return_val_if_fail (GFBGRAPH_IS_CONTEXT (context), NULL);
+
+  return context->priv->proxy;
+}
+
+/**
+ * gfbgraph_context_get_session:
+ * @context: a #GFBGraphContext.
+ *
+ * Gets the pooled #SoupSession of @context, used to download photos and for any
+ * other plain HTTP request. It can be used both in synchronous and asynchronous way.
+ * It's bounded by #GFBGraphContext:max-connections and
+ * #GFBGraphContext:max-connections-per-host, unlike the #RestProxy of the
+ * Graph API calls.
+ *
+ * Returns: (transfer none): a #SoupSession.
+ **/
+SoupSession *
+gfbgraph_context_get_session (GFBGraphContext *context)
+{
+  g_return_val_if_fail (GFBGRAPH_IS_CONTEXT (context), NULL);
+
+  return context->priv->session;
+}
+
+/**
+ * gfbgraph_context_get_scheduler:
+ * @context: a #GFBGraphContext.
+ *
+ * Returns: (transfer none): the #GFBGraphScheduler of the requests done through @context.
+ **/
+GFBGraphScheduler *
+gfbgraph_context_get_scheduler (GFBGraphContext *context)
+{
+  g_return_val_if_fail (GFBGRAPH_IS_CONTEXT (context), NULL);
+
+  return context->priv->scheduler;
+}
+
+/**
+ * gfbgraph_context_get_cache:
+ * @context: a #GFBGraphContext.
+ *
+ * Returns: (transfer none) (allow-none): the #GFBGraphCache of @context, or %NULL
+ * if the responses aren't cached.
+ **/
+GFBGraphCache *
+gfbgraph_context_get_cache (GFBGraphContext *context)
+{
+  GFBGraphCache *cache;
+
+  g_return_val_if_fail (GFBGRAPH_IS_CONTEXT (context), NULL);
+
+  g_mutex_lock (&context->priv->cache_mutex);
+  cache = context->priv->cache;
+  g_mutex_unlock (&context->priv->cache_mutex);
+
+  return cache;
+}
+
+/**
+ * gfbgraph_context_set_cache:
+ * @context: a #GFBGraphContext.
+ * @cache: (allow-none): a #GFBGraphCache, or %NULL to stop caching.
+ *
+ * Makes the GET requests done through @context use @cache. It can be changed
+ * at any time, the requests in progress keep the previous cache. This function
+ * is thread safe.
+ **/
+void
+gfbgraph_context_set_cache (GFBGraphContext *context,
+                            GFBGraphCache   *cache)
+{
+  g_return_if_fail (GFBGRAPH_IS_CONTEXT (context));
+  g_return_if_fail (cache == NULL || GFBGRAPH_IS_CACHE (cache));
+
+  g_object_set (G_OBJECT (context),
+                "cache", cache,
+                NULL);
+}
+
+/* Returns a reference to the cache of @context, or %NULL */
+GFBGraphCache *
+gfbgraph_context_dup_cache (GFBGraphContext *context)
+{
+  GFBGraphCache *cache = NULL;
+
+  g_mutex_lock (&context->priv->cache_mutex);
+  if (context->priv->cache != NULL)
+    cache = g_object_ref (context->priv->cache);
+  g_mutex_unlock (&context->priv->cache_mutex);
+
+  return cache;
+}
+
+/**
+ * gfbgraph_context_get_identity_map:
+ * @context: a #GFBGraphContext.
+ *
+ * Returns: (transfer none) (allow-none): the #GFBGraphIdentityMap of @context,
+ * or %NULL if the nodes aren't shared.
+ **/
+GFBGraphIdentityMap *
+gfbgraph_context_get_identity_map (GFBGraphContext *context)
+{
+  GFBGraphIdentityMap *identity_map;
+
+  g_return_val_if_fail (GFBGRAPH_IS_CONTEXT (context), NULL);
+
+  g_mutex_lock (&context->priv->cache_mutex);
+  identity_map = context->priv->identity_map;
+  g_mutex_unlock (&context->priv->cache_mutex);
+
+  return identity_map;
+}
+
+/**
+ * gfbgraph_context_set_identity_map:
+ * @context: a #GFBGraphContext.
+ * @identity_map: (allow-none): a #GFBGraphIdentityMap, or %NULL to stop sharing the nodes.
+ *
+ * Makes the nodes parsed from the responses of @context be merged into
+ * @identity_map, so every node ID has a single instance. It's disabled by
+ * default. This function is thread safe.
+ **/
+void
+gfbgraph_context_set_identity_map (GFBGraphContext     *context,
+                                   GFBGraphIdentityMap *identity_map)
+{
+  g_return_if_fail (GFBGRAPH_IS_CONTEXT (context));
+  g_return_if_fail (identity_map == NULL || GFBGRAPH_IS_IDENTITY_MAP (identity_map));
+
+  g_object_set (G_OBJECT (context),
+                "identity-map", identity_map,
+                NULL);
+}
+
+/* Returns a reference to the identity map of @context, or %NULL */
+GFBGraphIdentityMap *
+gfbgraph_context_dup_identity_map (GFBGraphContext *context)
+{
+  GFBGraphIdentityMap *identity_map = NULL;
+
+  g_mutex_lock (&context->priv->cache_mutex);
+  if (context->priv->identity_map != NULL)
+    identity_map = g_object_ref (context->priv->identity_map);
+  g_mutex_unlock (&context->priv->cache_mutex);
+
+  return identity_map;
+}
+
+/**
+ * gfbgraph_context_get_retry_policy:
+ * @context: a #GFBGraphContext.
+ *
+ * Returns: (transfer none) (allow-none): the #GFBGraphRetryPolicy of @context,
+ * or %NULL if the failed requests aren't retried.
+ **/
+GFBGraphRetryPolicy *
+gfbgraph_context_get_retry_policy (GFBGraphContext *context)
+{
+  GFBGraphRetryPolicy *retry_policy;
+
+  g_return_val_if_fail (GFBGRAPH_IS_CONTEXT (context), NULL);
+
+  g_mutex_lock (&context->priv->cache_mutex);
+  retry_policy = context->priv->retry_policy;
+  g_mutex_unlock (&context->priv->cache_mutex);
+
+  return retry_policy;
+}
+
+/**
+ * gfbgraph_context_set_retry_policy:
+ * @context: a #GFBGraphContext.
+ * @retry_policy: (allow-none): a #GFBGraphRetryPolicy, or %NULL to stop retrying.
+ *
+ * Makes the requests done through @context that fail for a transient reason be
+ * sent again following @retry_policy. It's disabled by default. It can be
+ * changed at any time, the requests in progress keep the previous policy. This
+ * function is thread safe.
+ **/
+void
+gfbgraph_context_set_retry_policy (GFBGraphContext     *context,
+                                   GFBGraphRetryPolicy *retry_policy)
+{
+  g_return_if_fail (GFBGRAPH_IS_CONTEXT (context));
+  g_return_if_fail (retry_policy == NULL || GFBGRAPH_IS_RETRY_POLICY (retry_policy));
+
+  g_object_set (G_OBJECT (context),
+                "retry-policy", retry_policy,
+                NULL);
+}
+
+/* Returns a reference to the retry policy of @context, or %NULL */
+GFBGraphRetryPolicy *
+gfbgraph_context_dup_retry_policy (GFBGraphContext *context)
+{
+  GFBGraphRetryPolicy *retry_policy = NULL;
+
+  g_mutex_lock (&context->priv->cache_mutex);
+  if (context->priv->retry_policy != NULL)
+    retry_policy = g_object_ref (context->priv->retry_policy);
+  g_mutex_unlock (&context->priv->cache_mutex);
+
+  return retry_policy;
+}
+
+/**
+ * gfbgraph_context_new_call:
+ * @context: a #GFBGraphContext.
+ * @authorizer: a #GFBGraphAuthorizer.
+ *
+ * Creates a new #RestProxyCall using the shared proxy of @context and processed
+ * by @authorizer to allow queries.
+ *
+ * Returns: (transfer full): a new #RestProxyCall.
+ **/
+RestProxyCall *
+gfbgraph_context_new_call (GFBGraphContext    *context,
+                           GFBGraphAuthorizer *authorizer)
+{
+  RestProxyCall *rest_call;
+
+  g_return_val_if_fail (GFBGRAPH_IS_CONTEXT (context), NULL);
+  g_return_val_if_fail (GFBGRAPH_IS_AUTHORIZER (authorizer), NULL);
+
+  rest_call = rest_proxy_new_call (context->priv->proxy);
+  gfbgraph_authorizer_process_call (authorizer, rest_call);
+
+  /* Used by the request layer to schedule the call */
+  g_object_set_qdata_full (G_OBJECT (rest_call), call_context_quark (),
+                           g_object_ref (context), g_object_unref);
+  g_object_set_qdata_full (G_OBJECT (rest_call), call_authorizer_quark (),
+                           g_object_ref (authorizer), g_object_unref);
+
+  return rest_call;
+}
+
+/* Returns the context @call was created from with gfbgraph_context_new_call(),
+ * or %NULL for calls created in any other way */
+GFBGraphContext *
+gfbgraph_call_get_context (RestProxyCall *call)
+{
+  return g_object_get_qdata (G_OBJECT (call), call_context_quark ());
+}
+
+GFBGraphAuthorizer *
+gfbgraph_call_get_authorizer (RestProxyCall *call)
+{
+  return g_object_get_qdata (G_OBJECT (call), call_authorizer_quark ());
+}
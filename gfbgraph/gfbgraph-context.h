@@ -0,0 +1,89 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 2; tab-width: 2 -*-  */
+/*
+ * libgfbgraph - GObject library for Facebook Graph API
+ * Copyright (C) 2013 Álvaro Peña <alvaropg@gmail.com>
+ *               2020 Leesoo Ahn <yisooan@fedoraproject.org>
+ *
+ * GFBGraph is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GFBGraph is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GFBGraph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GFBGRAPH_CONTEXT_H__
+#define __GFBGRAPH_CONTEXT_H__
+
+#include <glib-object.h>
+#include <libsoup/soup.h>
+#include <rest/rest-proxy.h>
+#include <gfbgraph/gfbgraph-authorizer.h>
+#include <gfbgraph/gfbgraph-cache.h>
+#include <gfbgraph/gfbgraph-identity-map.h>
+#include <gfbgraph/gfbgraph-retry-policy.h>
+#include <gfbgraph/gfbgraph-scheduler.h>
+
+G_BEGIN_DECLS
+
+#define GFBGRAPH_TYPE_CONTEXT (gfbgraph_context_get_type())
+#define GFBGRAPH_CONTEXT(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj),GFBGRAPH_TYPE_CONTEXT,GFBGraphContext))
+#define GFBGRAPH_CONTEXT_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass),GFBGRAPH_TYPE_CONTEXT,GFBGraphContextClass))
+#define GFBGRAPH_IS_CONTEXT(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj),GFBGRAPH_TYPE_CONTEXT))
+#define GFBGRAPH_IS_CONTEXT_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass),GFBGRAPH_TYPE_CONTEXT))
+#define GFBGRAPH_CONTEXT_GET_CLASS(obj) \
+  (G_TYPE_INSTANCE_GET_CLASS((obj),GFBGRAPH_TYPE_CONTEXT,GFBGraphContextClass))
+
+typedef struct _GFBGraphContext        GFBGraphContext;
+typedef struct _GFBGraphContextClass   GFBGraphContextClass;
+typedef struct _GFBGraphContextPrivate GFBGraphContextPrivate;
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (GFBGraphContext, g_object_unref)
+
+struct _GFBGraphContext {
+  GObject parent;
+
+  /*< private >*/
+  GFBGraphContextPrivate *priv;
+};
+
+struct _GFBGraphContextClass {
+  GObjectClass parent_class;
+};
+
+GType            gfbgraph_context_get_type          (void) G_GNUC_CONST;
+GFBGraphContext* gfbgraph_context_new               (const gchar        *endpoint);
+GFBGraphContext* gfbgraph_context_get_default       (void);
+GFBGraphContext* gfbgraph_context_get_for_authorizer (GFBGraphAuthorizer *authorizer);
+void             gfbgraph_context_set_for_authorizer (GFBGraphContext    *context,
+                                                      GFBGraphAuthorizer *authorizer);
+
+const gchar*     gfbgraph_context_get_endpoint      (GFBGraphContext    *context);
+RestProxy*       gfbgraph_context_get_proxy         (GFBGraphContext    *context);
+SoupSession*     gfbgraph_context_get_session       (GFBGraphContext    *context);
+GFBGraphScheduler* gfbgraph_context_get_scheduler   (GFBGraphContext    *context);
+GFBGraphCache*   gfbgraph_context_get_cache         (GFBGraphContext    *context);
+void             gfbgraph_context_set_cache         (GFBGraphContext    *context,
+                                                     GFBGraphCache      *cache);
+GFBGraphIdentityMap* gfbgraph_context_get_identity_map (GFBGraphContext     *context);
+void             gfbgraph_context_set_identity_map  (GFBGraphContext    *context,
+                                                     GFBGraphIdentityMap *identity_map);
+GFBGraphRetryPolicy* gfbgraph_context_get_retry_policy (GFBGraphContext     *context);
+void             gfbgraph_context_set_retry_policy  (GFBGraphContext    *context,
+                                                     GFBGraphRetryPolicy *retry_policy);
+RestProxyCall*   gfbgraph_context_new_call          (GFBGraphContext    *context,
+                                                     GFBGraphAuthorizer *authorizer);
+
+G_END_DECLS
+
+#endif /* __GFBGRAPH_CONTEXT_H__ */
@@ -0,0 +1,1198 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 2; tab-width: 2 -*-  */
+/*
+ * libgfbgraph - GObject library for Facebook Graph API
+ * Copyright (C) 2013 Álvaro Peña <alvaropg@gmail.com>
+ *               2020 Leesoo Ahn <yisooan@fedoraproject.org>
+ *
+ * GFBGraph is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GFBGraph is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GFBGraph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * SECTION:gfbgraph-downloader
+ * @title: GFBGraphDownloader
+ * @short_description: Concurrent and resumable downloads of photos
+ * @stability: Unstable
+ * @include: gfbgraph/gfbgraph.h
+ *
+ * #GFBGraphDownloader downloads files, like the images of a #GFBGraphPhoto,
+ * using the pooled #SoupSession of a #GFBGraphContext, so bulk downloads reuse
+ * the connections to the content servers instead of doing a TLS handshake for
+ * every file.
+ *
+ * Up to #GFBGraphDownloader:max-downloads downloads run at once, the rest wait
+ * in order. Every download has its own #GCancellable and progress callback, and
+ * writes into a #GOutputStream or appends to a #GFile. A download interrupted
+ * by a network error is resumed from the last written byte with an HTTP range
+ * request, as long as the response had a validator (its ETag or Last-Modified
+ * date) to send in the If-Range header. If the content changed since the
+ * interrupted response, a #GFile is written again from the start, while a
+ * download into a #GOutputStream fails.
+ *
+ * The validator of a download into a #GFile is stored next to it, in a file
+ * with the same name and the VALIDATOR_SUFFIX suffix, removed once the
+ * download is complete. So a partially downloaded file is completed instead of
+ * downloaded again, even by another process, unless the content changed. A
+ * partial file without a validator is downloaded again from the start.
+ **/
+
+#include <string.h>
+#include <libsoup/soup.h>
+
+#include "gfbgraph-downloader.h"
+#include "gfbgraph-private.h"
+
+#define DEFAULT_MAX_DOWNLOADS 4
+
+/* Size of every read from the response */
+#define CHUNK_SIZE            (64 * 1024)
+
+/* Times an interrupted download is resumed before failing */
+#define MAX_RESUME_ATTEMPTS   3
+
+/* Suffix of the file storing the validator of a partially downloaded file */
+#define VALIDATOR_SUFFIX      ".gfbgraph-validator"
+
+enum {
+  PROP_0,
+  PROP_CONTEXT,
+  PROP_MAX_DOWNLOADS
+};
+
+struct _GFBGraphDownloaderPrivate {
+  GFBGraphContext *context;
+  GMutex           mutex;
+  guint            max_downloads;
+  guint            n_downloads;   /* Downloads in progress */
+  GQueue           queue;         /* Tasks waiting for a free download slot */
+};
+
+typedef struct {
+  gchar                 *uri;
+  GOutputStream         *stream;
+  GFile                 *file;
+  goffset                offset;      /* Bytes of the file already written */
+  goffset                skip;        /* Bytes of the response to discard */
+  goffset                total;       /* Size of the file, -1 if unknown */
+  gchar                 *validator;   /* Sent in If-Range to resume */
+  GFile                 *validator_file;
+  guint                  attempts;
+  SoupMessage           *msg;
+  GInputStream          *body;
+  GBytes                *chunk;
+  GFileProgressCallback  progress_callback;
+  gpointer               progress_data;
+  GSource               *cancel_source;
+  GList                  link;        /* Link in the queue while waiting */
+  gboolean               queued;
+} DownloadItem;
+
+#define GFBGRAPH_DOWNLOADER_GET_PRIVATE(o) \
+  (G_TYPE_INSTANCE_GET_PRIVATE((o), GFBGRAPH_TYPE_DOWNLOADER, GFBGraphDownloaderPrivate))
+
+static GObjectClass *parent_class = NULL;
+
+G_DEFINE_TYPE (GFBGraphDownloader, gfbgraph_downloader, G_TYPE_OBJECT);
+
+static void start_queued_locked (GFBGraphDownloader  *downloader,
+                                 GSList             **started);
+static void start_download      (GTask               *task);
+
+static void
+gfbgraph_downloader_constructed (GObject *object)
+{
+  GFBGraphDownloaderPrivate *priv = GFBGRAPH_DOWNLOADER_GET_PRIVATE (object);
+
+  if (priv->context == NULL)
+    priv->context = g_object_ref (gfbgraph_context_get_default ());
+
+  G_OBJECT_CLASS (parent_class)->constructed (object);
+}
+
+static void
+gfbgraph_downloader_finalize (GObject *object)
+{
+  GFBGraphDownloaderPrivate *priv = GFBGRAPH_DOWNLOADER_GET_PRIVATE (object);
+
+  g_clear_object (&priv->context);
+  g_mutex_clear (&priv->mutex);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static void
+gfbgraph_downloader_set_property (GObject      *object,
+                                  guint         prop_id,
+                                  const GValue *value,
+                                  GParamSpec   *pspec)
+{
+  GFBGraphDownloaderPrivate *priv = GFBGRAPH_DOWNLOADER_GET_PRIVATE (object);
+  GSList *started = NULL;
+
+  switch (prop_id) {
+    case PROP_CONTEXT:
+      priv->context = g_value_dup_object (value);
+      break;
+    case PROP_MAX_DOWNLOADS:
+      g_mutex_lock (&priv->mutex);
+      priv->max_downloads = g_value_get_uint (value);
+      start_queued_locked (GFBGRAPH_DOWNLOADER (object), &started);
+      g_mutex_unlock (&priv->mutex);
+      g_slist_free_full (started, (GDestroyNotify) start_download);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gfbgraph_downloader_get_property (GObject    *object,
+                                  guint       prop_id,
+                                  GValue     *value,
+                                  GParamSpec *pspec)
+{
+  GFBGraphDownloaderPrivate *priv = GFBGRAPH_DOWNLOADER_GET_PRIVATE (object);
+
+  switch (prop_id) {
+    case PROP_CONTEXT:
+      g_value_set_object (value, priv->context);
+      break;
+    case PROP_MAX_DOWNLOADS:
+      g_mutex_lock (&priv->mutex);
+      g_value_set_uint (value, priv->max_downloads);
+      g_mutex_unlock (&priv->mutex);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gfbgraph_downloader_class_init (GFBGraphDownloaderClass *klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+
+  parent_class                 = g_type_class_peek_parent (klass);
+  gobject_class->constructed   = gfbgraph_downloader_constructed;
+  gobject_class->finalize      = gfbgraph_downloader_finalize;
+  gobject_class->set_property  = gfbgraph_downloader_set_property;
+  gobject_class->get_property  = gfbgraph_downloader_get_property;
+
+  g_type_class_add_private (gobject_class, sizeof(GFBGraphDownloaderPrivate));
+
+  /**
+   * GFBGraphDownloader:context:
+   *
+   * The #GFBGraphContext whose #SoupSession is used for the downloads. The
+   * default context is used if not set.
+   **/
+  g_object_class_install_property (gobject_class,
+                                   PROP_CONTEXT,
+                                   g_param_spec_object ("context",
+                                                        "Context",
+                                                        "The context of the HTTP session",
+                                                        GFBGRAPH_TYPE_CONTEXT,
+                                                        G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE));
+
+  /**
+   * GFBGraphDownloader:max-downloads:
+   *
+   * The maximum number of downloads in progress at the same time. Note that
+   * the #GFBGraphContext:max-connections-per-host of the context also limits
+   * the downloads from the same server.
+   **/
+  g_object_class_install_property (gobject_class,
+                                   PROP_MAX_DOWNLOADS,
+                                   g_param_spec_uint ("max-downloads",
+                                                      "Maximum downloads",
+                                                      "The maximum number of simultaneous downloads",
+                                                      1, G_MAXUINT, DEFAULT_MAX_DOWNLOADS,
+                                                      G_PARAM_CONSTRUCT | G_PARAM_READWRITE));
+}
+
+static void
+gfbgraph_downloader_init (GFBGraphDownloader *obj)
+{
+  obj->priv = GFBGRAPH_DOWNLOADER_GET_PRIVATE (obj);
+
+  g_mutex_init (&obj->priv->mutex);
+  g_queue_init (&obj->priv->queue);
+}
+
+/* --- Private Functions --- */
+static void
+download_item_free (DownloadItem *item)
+{
+  g_free (item->uri);
+  g_clear_object (&item->stream);
+  g_clear_object (&item->file);
+  g_free (item->validator);
+  g_clear_object (&item->validator_file);
+  g_clear_object (&item->msg);
+  g_clear_object (&item->body);
+  if (item->chunk != NULL)
+    g_bytes_unref (item->chunk);
+  if (item->cancel_source != NULL) {
+    g_source_destroy (item->cancel_source);
+    g_source_unref (item->cancel_source);
+  }
+  g_slice_free (DownloadItem, item);
+}
+
+static void
+clear_cancel_source (DownloadItem *item)
+{
+  if (item->cancel_source != NULL) {
+    g_source_destroy (item->cancel_source);
+    g_clear_pointer (&item->cancel_source, g_source_unref);
+  }
+}
+
+/* Moves the waiting tasks which fit in the free slots to @started. They must
+ * be started with start_download() after unlocking the mutex. */
+static void
+start_queued_locked (GFBGraphDownloader  *downloader,
+                     GSList             **started)
+{
+  GFBGraphDownloaderPrivate *priv = downloader->priv;
+
+  while (priv->n_downloads < priv->max_downloads && priv->queue.head != NULL) {
+    GList *link = priv->queue.head;
+    GTask *task = link->data;
+    DownloadItem *item = g_task_get_task_data (task);
+
+    g_queue_unlink (&priv->queue, link);
+    item->queued = FALSE;
+    priv->n_downloads++;
+    *started = g_slist_append (*started, task);
+  }
+}
+
+/* Returns the slot of a finished download and starts the next waiting one */
+static void
+release_slot (GFBGraphDownloader *downloader)
+{
+  GFBGraphDownloaderPrivate *priv = downloader->priv;
+  GSList *started = NULL;
+
+  g_mutex_lock (&priv->mutex);
+  priv->n_downloads--;
+  start_queued_locked (downloader, &started);
+  g_mutex_unlock (&priv->mutex);
+
+  g_slist_free_full (started, (GDestroyNotify) start_download);
+}
+
+static void
+complete_download (GTask  *task,
+                   GError *error)
+{
+  GFBGraphDownloader *downloader = g_task_get_source_object (task);
+  DownloadItem *item = g_task_get_task_data (task);
+
+  g_clear_object (&item->body);
+  g_clear_object (&item->msg);
+
+  release_slot (downloader);
+
+  /* The size is read from the item, a gssize can't hold it in 32 bits */
+  if (error != NULL)
+    g_task_return_error (task, error);
+  else
+    g_task_return_boolean (task, TRUE);
+
+  g_object_unref (task);
+}
+
+static void send_request (GTask *task);
+static void restart_file (GTask *task);
+
+/* Resumes a download interrupted by @error from the last written byte, if the
+ * error isn't a cancellation and there are attempts left. Without a validator
+ * the rest of the content can't be checked, so a file is downloaded again from
+ * the start and a stream fails. */
+static gboolean
+resume_download (GTask  *task,
+                 GError *error)
+{
+  DownloadItem *item = g_task_get_task_data (task);
+
+  if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)
+      || g_cancellable_is_cancelled (g_task_get_cancellable (task))
+      || item->attempts >= MAX_RESUME_ATTEMPTS
+      || (item->validator == NULL && item->offset > 0 && item->file == NULL))
+    return FALSE;
+
+  g_debug ("Resuming the download of %s at %" G_GOFFSET_FORMAT ": %s",
+           item->uri, item->offset, error->message);
+
+  item->attempts++;
+  g_clear_object (&item->body);
+  g_clear_object (&item->msg);
+  g_error_free (error);
+  if (item->validator == NULL && item->offset > 0)
+    restart_file (task);
+  else
+    send_request (task);
+
+  return TRUE;
+}
+
+static void read_chunk (GTask *task);
+
+/* The file is complete, so its validator isn't needed anymore */
+static void
+validator_deleted_cb (GObject      *source_object,
+                      GAsyncResult *result,
+                      gpointer      user_data)
+{
+  GTask *task = G_TASK (user_data);
+
+  g_file_delete_finish (G_FILE (source_object), result, NULL);
+  complete_download (task, NULL);
+}
+
+static void
+file_closed_cb (GObject      *source_object,
+                GAsyncResult *result,
+                gpointer      user_data)
+{
+  GTask *task = G_TASK (user_data);
+  DownloadItem *item = g_task_get_task_data (task);
+  GError *error = NULL;
+
+  if (!g_output_stream_close_finish (G_OUTPUT_STREAM (source_object), result, &error)
+      || item->validator_file == NULL) {
+    complete_download (task, error);
+    return;
+  }
+
+  g_file_delete_async (item->validator_file,
+                       G_PRIORITY_DEFAULT,
+                       NULL,
+                       validator_deleted_cb,
+                       task);
+}
+
+/* The whole response was written */
+static void
+finish_download (GTask *task)
+{
+  DownloadItem *item = g_task_get_task_data (task);
+
+  /* The streams given by the caller are left open */
+  if (item->file != NULL) {
+    g_output_stream_close_async (item->stream,
+                                 G_PRIORITY_DEFAULT,
+                                 g_task_get_cancellable (task),
+                                 file_closed_cb,
+                                 task);
+  } else {
+    complete_download (task, NULL);
+  }
+}
+
+static void
+chunk_written_cb (GObject      *source_object,
+                  GAsyncResult *result,
+                  gpointer      user_data)
+{
+  GTask *task = G_TASK (user_data);
+  DownloadItem *item = g_task_get_task_data (task);
+  gsize written;
+  GError *error = NULL;
+
+  if (!g_output_stream_write_all_finish (G_OUTPUT_STREAM (source_object), result, &written, &error)) {
+    complete_download (task, error);
+    return;
+  }
+
+  item->offset += written;
+  g_clear_pointer (&item->chunk, g_bytes_unref);
+
+  if (item->progress_callback != NULL)
+    item->progress_callback (item->offset, item->total, item->progress_data);
+
+  read_chunk (task);
+}
+
+static void
+chunk_read_cb (GObject      *source_object,
+               GAsyncResult *result,
+               gpointer      user_data)
+{
+  GTask *task = G_TASK (user_data);
+  DownloadItem *item = g_task_get_task_data (task);
+  GBytes *chunk;
+  gsize size;
+  GError *error = NULL;
+
+  chunk = g_input_stream_read_bytes_finish (G_INPUT_STREAM (source_object), result, &error);
+  if (chunk == NULL) {
+    if (!resume_download (task, error))
+      complete_download (task, error);
+    return;
+  }
+
+  size = g_bytes_get_size (chunk);
+  if (size == 0) {
+    g_bytes_unref (chunk);
+
+    if (item->total >= 0 && item->offset < item->total) {
+      error = g_error_new (G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT,
+                           "The download of %s was interrupted", item->uri);
+      if (!resume_download (task, error))
+        complete_download (task, error);
+    } else {
+      finish_download (task);
+    }
+    return;
+  }
+
+  /* A server ignoring the range sends the bytes already written again */
+  if (item->skip > 0) {
+    gsize skipped = MIN ((goffset) size, item->skip);
+
+    item->skip -= skipped;
+    if (skipped == size) {
+      g_bytes_unref (chunk);
+      read_chunk (task);
+      return;
+    }
+
+    item->chunk = g_bytes_new_from_bytes (chunk, skipped, size - skipped);
+    g_bytes_unref (chunk);
+  } else {
+    item->chunk = chunk;
+  }
+
+  g_output_stream_write_all_async (item->stream,
+                                   g_bytes_get_data (item->chunk, NULL),
+                                   g_bytes_get_size (item->chunk),
+                                   G_PRIORITY_DEFAULT,
+                                   g_task_get_cancellable (task),
+                                   chunk_written_cb,
+                                   task);
+}
+
+static void
+read_chunk (GTask *task)
+{
+  DownloadItem *item = g_task_get_task_data (task);
+
+  g_input_stream_read_bytes_async (item->body,
+                                   CHUNK_SIZE,
+                                   G_PRIORITY_DEFAULT,
+                                   g_task_get_cancellable (task),
+                                   chunk_read_cb,
+                                   task);
+}
+
+/* Checks that the response continues the download at the current offset. A
+ * file which changed since the first response has to be written again from
+ * the start, with @restart set. */
+static gboolean
+check_response (DownloadItem  *item,
+                gboolean      *complete,
+                gboolean      *restart,
+                GError       **error)
+{
+  SoupMessageHeaders *headers = item->msg->response_headers;
+  const gchar *validator;
+  gboolean changed;
+  goffset start, end, total;
+
+  *complete = FALSE;
+  *restart = FALSE;
+
+  /* A weak ETag can't be used in If-Range */
+  validator = soup_message_headers_get_one (headers, "ETag");
+  if (validator == NULL || g_str_has_prefix (validator, "W/"))
+    validator = soup_message_headers_get_one (headers, "Last-Modified");
+
+  changed = item->validator != NULL && g_strcmp0 (validator, item->validator) != 0;
+  if (item->validator == NULL)
+    item->validator = g_strdup (validator);
+
+  switch (item->msg->status_code) {
+    case SOUP_STATUS_PARTIAL_CONTENT:
+      if (!soup_message_headers_get_content_range (headers, &start, &end, &total)
+          || start != item->offset) {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                     "Unexpected range received for %s", item->uri);
+        return FALSE;
+      }
+      item->skip = 0;
+      item->total = total;
+      return TRUE;
+
+    case SOUP_STATUS_OK:
+      /* The If-Range didn't match, so the file changed after the response the
+       * written bytes came from. Unlike the stream of the caller, a file can be
+       * truncated and written again. */
+      if (item->offset > 0 && changed) {
+        if (item->file == NULL) {
+          g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                       "%s changed while it was downloaded", item->uri);
+          return FALSE;
+        }
+        g_free (item->validator);
+        item->validator = g_strdup (validator);
+        *restart = TRUE;
+      }
+      item->skip = *restart ? 0 : item->offset;
+      if (soup_message_headers_get_encoding (headers) == SOUP_ENCODING_CONTENT_LENGTH)
+        item->total = soup_message_headers_get_content_length (headers);
+      return TRUE;
+
+    case SOUP_STATUS_REQUESTED_RANGE_NOT_SATISFIABLE:
+      /* The file was already complete */
+      if (item->offset > 0
+          && soup_message_headers_get_content_range (headers, &start, &end, &total)
+          && total == item->offset) {
+        item->total = total;
+        *complete = TRUE;
+        return TRUE;
+      }
+      /* Fall through */
+
+    default:
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                   "Error downloading %s (HTTP %u): %s",
+                   item->uri, item->msg->status_code, item->msg->reason_phrase);
+      return FALSE;
+  }
+}
+
+static void
+validator_stored_cb (GObject      *source_object,
+                     GAsyncResult *result,
+                     gpointer      user_data)
+{
+  GTask *task = G_TASK (user_data);
+  GError *error = NULL;
+
+  if (!g_file_replace_contents_finish (G_FILE (source_object), result, NULL, &error)) {
+    complete_download (task, error);
+    return;
+  }
+
+  read_chunk (task);
+}
+
+static void
+stale_validator_deleted_cb (GObject      *source_object,
+                            GAsyncResult *result,
+                            gpointer      user_data)
+{
+  GTask *task = G_TASK (user_data);
+  GError *error = NULL;
+
+  if (!g_file_delete_finish (G_FILE (source_object), result, &error)
+      && !g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND)) {
+    complete_download (task, error);
+    return;
+  }
+  g_clear_error (&error);
+
+  read_chunk (task);
+}
+
+/* A file is about to be written from the start: stores the validator of the
+ * response before its first byte, so the file can be resumed later */
+static void
+store_validator (GTask *task)
+{
+  DownloadItem *item = g_task_get_task_data (task);
+
+  if (item->validator_file == NULL) {
+    read_chunk (task);
+  } else if (item->validator != NULL) {
+    g_file_replace_contents_async (item->validator_file,
+                                   item->validator,
+                                   strlen (item->validator),
+                                   NULL,
+                                   FALSE,
+                                   G_FILE_CREATE_NONE,
+                                   g_task_get_cancellable (task),
+                                   validator_stored_cb,
+                                   task);
+  } else {
+    g_file_delete_async (item->validator_file,
+                         G_PRIORITY_DEFAULT,
+                         g_task_get_cancellable (task),
+                         stale_validator_deleted_cb,
+                         task);
+  }
+}
+
+static void
+file_replaced_cb (GObject      *source_object,
+                  GAsyncResult *result,
+                  gpointer      user_data)
+{
+  GTask *task = G_TASK (user_data);
+  DownloadItem *item = g_task_get_task_data (task);
+  GFileOutputStream *stream;
+  GError *error = NULL;
+
+  stream = g_file_replace_finish (G_FILE (source_object), result, &error);
+  if (stream == NULL) {
+    complete_download (task, error);
+    return;
+  }
+
+  item->stream = G_OUTPUT_STREAM (stream);
+
+  /* Without a response yet, the file couldn't be resumed */
+  if (item->body != NULL)
+    store_validator (task);
+  else
+    send_request (task);
+}
+
+/* The partial content of the file is stale, write the new one from the start */
+static void
+restart_file_closed_cb (GObject      *source_object,
+                        GAsyncResult *result,
+                        gpointer      user_data)
+{
+  GTask *task = G_TASK (user_data);
+  DownloadItem *item = g_task_get_task_data (task);
+  GError *error = NULL;
+
+  if (!g_output_stream_close_finish (G_OUTPUT_STREAM (source_object), result, &error)) {
+    complete_download (task, error);
+    return;
+  }
+
+  g_clear_object (&item->stream);
+  item->offset = 0;
+  g_file_replace_async (item->file,
+                        NULL,
+                        FALSE,
+                        G_FILE_CREATE_NONE,
+                        G_PRIORITY_DEFAULT,
+                        g_task_get_cancellable (task),
+                        file_replaced_cb,
+                        task);
+}
+
+static void
+restart_file (GTask *task)
+{
+  DownloadItem *item = g_task_get_task_data (task);
+
+  g_output_stream_close_async (item->stream,
+                               G_PRIORITY_DEFAULT,
+                               g_task_get_cancellable (task),
+                               restart_file_closed_cb,
+                               task);
+}
+
+static void
+request_sent_cb (GObject      *source_object,
+                 GAsyncResult *result,
+                 gpointer      user_data)
+{
+  GTask *task = G_TASK (user_data);
+  DownloadItem *item = g_task_get_task_data (task);
+  gboolean complete, restart;
+  GError *error = NULL;
+
+  item->body = soup_session_send_finish (SOUP_SESSION (source_object), result, &error);
+  if (item->body == NULL) {
+    if (!resume_download (task, error))
+      complete_download (task, error);
+    return;
+  }
+
+  if (!check_response (item, &complete, &restart, &error)) {
+    complete_download (task, error);
+    return;
+  }
+
+  if (complete)
+    finish_download (task);
+  else if (restart)
+    restart_file (task);
+  else if (item->file != NULL && item->offset == 0)
+    store_validator (task);
+  else
+    read_chunk (task);
+}
+
+static void
+send_request (GTask *task)
+{
+  GFBGraphDownloader *downloader = g_task_get_source_object (task);
+  DownloadItem *item = g_task_get_task_data (task);
+
+  item->msg = soup_message_new (SOUP_METHOD_GET, item->uri);
+  if (item->msg == NULL) {
+    complete_download (task, g_error_new (G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                                          "Invalid URI: %s", item->uri));
+    return;
+  }
+
+  if (item->offset > 0) {
+    soup_message_headers_set_range (item->msg->request_headers, item->offset, -1);
+    /* Only resume if the file didn't change since the written bytes were
+     * received. A file is never resumed without a validator, and a stream
+     * only at the offset given by the caller. */
+    if (item->validator != NULL)
+      soup_message_headers_replace (item->msg->request_headers, "If-Range", item->validator);
+  }
+
+  soup_session_send_async (gfbgraph_context_get_session (downloader->priv->context),
+                           item->msg,
+                           g_task_get_cancellable (task),
+                           request_sent_cb,
+                           task);
+}
+
+/* Resumes the partial file if it has the validator of its content, or
+ * downloads it again from the start */
+static void
+validator_loaded_cb (GObject      *source_object,
+                     GAsyncResult *result,
+                     gpointer      user_data)
+{
+  GTask *task = G_TASK (user_data);
+  DownloadItem *item = g_task_get_task_data (task);
+  gchar *contents;
+  gsize length;
+  GError *error = NULL;
+
+  if (!g_file_load_contents_finish (G_FILE (source_object), result, &contents, &length, NULL, &error)) {
+    if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+      complete_download (task, error);
+      return;
+    }
+    g_error_free (error);
+    restart_file (task);
+    return;
+  }
+
+  if (length > 0 && memchr (contents, '\0', length) == NULL) {
+    item->validator = g_strndup (contents, length);
+    send_request (task);
+  } else {
+    restart_file (task);
+  }
+  g_free (contents);
+}
+
+static void
+file_opened_cb (GObject      *source_object,
+                GAsyncResult *result,
+                gpointer      user_data)
+{
+  GTask *task = G_TASK (user_data);
+  DownloadItem *item = g_task_get_task_data (task);
+  GFileOutputStream *stream;
+  GFileInfo *info;
+  GError *error = NULL;
+
+  stream = g_file_append_to_finish (G_FILE (source_object), result, &error);
+  if (stream == NULL) {
+    complete_download (task, error);
+    return;
+  }
+
+  item->stream = G_OUTPUT_STREAM (stream);
+
+  /* Complete the data of a previous download */
+  info = g_file_output_stream_query_info (stream, G_FILE_ATTRIBUTE_STANDARD_SIZE, NULL, &error);
+  if (info == NULL) {
+    complete_download (task, error);
+    return;
+  }
+  item->offset = g_file_info_get_size (info);
+  g_object_unref (info);
+
+  if (item->offset == 0)
+    send_request (task);
+  else if (item->validator_file != NULL)
+    g_file_load_contents_async (item->validator_file,
+                                g_task_get_cancellable (task),
+                                validator_loaded_cb,
+                                task);
+  else
+    restart_file (task);
+}
+
+static gboolean
+start_download_cb (gpointer user_data)
+{
+  GTask *task = G_TASK (user_data);
+  DownloadItem *item = g_task_get_task_data (task);
+
+  if (g_task_return_error_if_cancelled (task)) {
+    release_slot (g_task_get_source_object (task));
+    g_object_unref (task);
+    return G_SOURCE_REMOVE;
+  }
+
+  if (item->file != NULL)
+    g_file_append_to_async (item->file,
+                            G_FILE_CREATE_NONE,
+                            G_PRIORITY_DEFAULT,
+                            g_task_get_cancellable (task),
+                            file_opened_cb,
+                            task);
+  else
+    send_request (task);
+
+  return G_SOURCE_REMOVE;
+}
+
+/* Starts a task which got a slot, in the main context it was created in */
+static void
+start_download (GTask *task)
+{
+  DownloadItem *item = g_task_get_task_data (task);
+
+  clear_cancel_source (item);
+  g_main_context_invoke (g_task_get_context (task), start_download_cb, task);
+}
+
+static gboolean
+queued_cancelled_cb (GCancellable *cancellable,
+                     gpointer      user_data)
+{
+  GTask *task = G_TASK (user_data);
+  GFBGraphDownloader *downloader = g_task_get_source_object (task);
+  DownloadItem *item = g_task_get_task_data (task);
+  gboolean removed = FALSE;
+
+  g_mutex_lock (&downloader->priv->mutex);
+  if (item->queued) {
+    g_queue_unlink (&downloader->priv->queue, &item->link);
+    item->queued = FALSE;
+    removed = TRUE;
+  }
+  g_mutex_unlock (&downloader->priv->mutex);
+
+  if (removed) {
+    g_task_return_error_if_cancelled (task);
+    /* The reference of the queue */
+    g_object_unref (task);
+  }
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+queue_download (GFBGraphDownloader *downloader,
+                GTask              *task)
+{
+  GFBGraphDownloaderPrivate *priv = downloader->priv;
+  DownloadItem *item = g_task_get_task_data (task);
+  GCancellable *cancellable;
+  gboolean start = FALSE;
+
+  item->link.data = task;
+
+  g_mutex_lock (&priv->mutex);
+  if (priv->n_downloads < priv->max_downloads) {
+    priv->n_downloads++;
+    start = TRUE;
+  } else {
+    /* Cancelled while waiting, the task is returned without waiting for a slot */
+    cancellable = g_task_get_cancellable (task);
+    if (cancellable != NULL) {
+      item->cancel_source = g_cancellable_source_new (cancellable);
+      g_source_set_callback (item->cancel_source,
+                             (GSourceFunc) queued_cancelled_cb,
+                             g_object_ref (task),
+                             g_object_unref);
+      g_source_attach (item->cancel_source, g_task_get_context (task));
+    }
+    item->queued = TRUE;
+    g_queue_push_tail_link (&priv->queue, &item->link);
+  }
+  g_mutex_unlock (&priv->mutex);
+
+  if (start)
+    start_download (task);
+}
+
+static GTask *
+new_download_task (GFBGraphDownloader     *downloader,
+                   const gchar            *uri,
+                   GCancellable           *cancellable,
+                   GFileProgressCallback   progress_callback,
+                   gpointer                progress_data,
+                   GAsyncReadyCallback     callback,
+                   gpointer                user_data)
+{
+  DownloadItem *item;
+  GTask *task;
+
+  item = g_slice_new0 (DownloadItem);
+  item->uri = g_strdup (uri);
+  item->total = -1;
+  item->progress_callback = progress_callback;
+  item->progress_data = progress_data;
+
+  task = g_task_new (downloader, cancellable, callback, user_data);
+  g_task_set_task_data (task, item, (GDestroyNotify) download_item_free);
+
+  return task;
+}
+
+/* --- Public API --- */
+
+/**
+ * gfbgraph_downloader_new:
+ * @context: (allow-none): the #GFBGraphContext to use its session, or %NULL for the default one.
+ * @max_downloads: the maximum number of downloads in progress at the same time.
+ *
+ * Creates a new #GFBGraphDownloader.
+ *
+ * Returns: (transfer full): a new #GFBGraphDownloader; unref with g_object_unref()
+ **/
+GFBGraphDownloader *
+gfbgraph_downloader_new (GFBGraphContext *context,
+                         guint            max_downloads)
+{
+  g_return_val_if_fail (context == NULL || GFBGRAPH_IS_CONTEXT (context), NULL);
+  g_return_val_if_fail (max_downloads > 0, NULL);
+
+  return GFBGRAPH_DOWNLOADER (g_object_new (GFBGRAPH_TYPE_DOWNLOADER,
+                                            "context", context,
+                                            "max-downloads", max_downloads,
+                                            NULL));
+}
+
+/**
+ * gfbgraph_downloader_get_context:
+ * @downloader: a #GFBGraphDownloader.
+ *
+ * Returns: (transfer none): the #GFBGraphContext of @downloader.
+ **/
+GFBGraphContext *
+gfbgraph_downloader_get_context (GFBGraphDownloader *downloader)
+{
+  g_return_val_if_fail (GFBGRAPH_IS_DOWNLOADER (downloader), NULL);
+
+  return downloader->priv->context;
+}
+
+/**
+ * gfbgraph_downloader_get_max_downloads:
+ * @downloader: a #GFBGraphDownloader.
+ *
+ * Returns: the maximum number of downloads in progress at the same time.
+ **/
+guint
+gfbgraph_downloader_get_max_downloads (GFBGraphDownloader *downloader)
+{
+  guint max_downloads;
+
+  g_return_val_if_fail (GFBGRAPH_IS_DOWNLOADER (downloader), 0);
+
+  g_object_get (G_OBJECT (downloader),
+                "max-downloads", &max_downloads,
+                NULL);
+
+  return max_downloads;
+}
+
+/**
+ * gfbgraph_downloader_set_max_downloads:
+ * @downloader: a #GFBGraphDownloader.
+ * @max_downloads: the maximum number of downloads in progress at the same time.
+ *
+ * Sets the maximum number of simultaneous downloads. Raising it starts the
+ * waiting downloads, lowering it lets the ones in progress finish.
+ **/
+void
+gfbgraph_downloader_set_max_downloads (GFBGraphDownloader *downloader,
+                                       guint               max_downloads)
+{
+  g_return_if_fail (GFBGRAPH_IS_DOWNLOADER (downloader));
+  g_return_if_fail (max_downloads > 0);
+
+  g_object_set (G_OBJECT (downloader),
+                "max-downloads", max_downloads,
+                NULL);
+}
+
+/**
+ * gfbgraph_downloader_get_n_downloads:
+ * @downloader: a #GFBGraphDownloader.
+ *
+ * Returns: the number of downloads in progress, without the waiting ones.
+ **/
+guint
+gfbgraph_downloader_get_n_downloads (GFBGraphDownloader *downloader)
+{
+  guint n_downloads;
+
+  g_return_val_if_fail (GFBGRAPH_IS_DOWNLOADER (downloader), 0);
+
+  g_mutex_lock (&downloader->priv->mutex);
+  n_downloads = downloader->priv->n_downloads;
+  g_mutex_unlock (&downloader->priv->mutex);
+
+  return n_downloads;
+}
+
+/**
+ * gfbgraph_downloader_download_to_stream_async:
+ * @downloader: a #GFBGraphDownloader.
+ * @uri: the URI to download, like the source of a #GFBGraphPhotoImage.
+ * @stream: the #GOutputStream where the content is written.
+ * @offset: the number of bytes of the content already in @stream, to resume a
+ *   previous download, or 0.
+ * @cancellable: (allow-none): An optional #GCancellable object, or %NULL.
+ * @progress_callback: (allow-none): a #GFileProgressCallback
+ *   called after every written chunk, or %NULL.
+ * @progress_data: (closure progress_callback): the data to pass to @progress_callback.
+ * @callback: (scope async): A #GAsyncReadyCallback to call when the download is completed.
+ * @user_data: (closure): The data to pass to @callback.
+ *
+ * Downloads @uri writing it into @stream, when a download slot is free. With
+ * a non zero @offset, only the rest of the content is requested. @stream isn't
+ * closed when the download finishes.
+ *
+ * The callbacks are called in the thread-default main context of the caller.
+ * Call gfbgraph_downloader_download_finish() from @callback to get the result.
+ **/
+void
+gfbgraph_downloader_download_to_stream_async (GFBGraphDownloader     *downloader,
+                                              const gchar            *uri,
+                                              GOutputStream          *stream,
+                                              goffset                 offset,
+                                              GCancellable           *cancellable,
+                                              GFileProgressCallback   progress_callback,
+                                              gpointer                progress_data,
+                                              GAsyncReadyCallback     callback,
+                                              gpointer                user_data)
+{
+  DownloadItem *item;
+  GTask *task;
+
+  g_return_if_fail (GFBGRAPH_IS_DOWNLOADER (downloader));
+  g_return_if_fail (uri != NULL);
+  g_return_if_fail (G_IS_OUTPUT_STREAM (stream));
+  g_return_if_fail (offset >= 0);
+  g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+
+  task = new_download_task (downloader, uri, cancellable,
+                            progress_callback, progress_data,
+                            callback, user_data);
+  g_task_set_source_tag (task, gfbgraph_downloader_download_to_stream_async);
+
+  item = g_task_get_task_data (task);
+  item->stream = g_object_ref (stream);
+  item->offset = offset;
+
+  queue_download (downloader, task);
+}
+
+/**
+ * gfbgraph_downloader_download_to_file_async:
+ * @downloader: a #GFBGraphDownloader.
+ * @uri: the URI to download, like the source of a #GFBGraphPhotoImage.
+ * @file: the #GFile where the content is stored.
+ * @cancellable: (allow-none): An optional #GCancellable object, or %NULL.
+ * @progress_callback: (allow-none): a #GFileProgressCallback
+ *   called after every written chunk, or %NULL.
+ * @progress_data: (closure progress_callback): the data to pass to @progress_callback.
+ * @callback: (scope async): A #GAsyncReadyCallback to call when the download is completed.
+ * @user_data: (closure): The data to pass to @callback.
+ *
+ * Downloads @uri into @file, when a download slot is free. If @file exists
+ * with the validator of a previous download of @uri, only the rest of the
+ * content is requested, so a cancelled or failed download can be resumed
+ * calling this function again. Otherwise, or if the content changed since,
+ * @file is written again from the start.
+ *
+ * Call gfbgraph_downloader_download_finish() from @callback to get the result.
+ **/
+void
+gfbgraph_downloader_download_to_file_async (GFBGraphDownloader     *downloader,
+                                            const gchar            *uri,
+                                            GFile                  *file,
+                                            GCancellable           *cancellable,
+                                            GFileProgressCallback   progress_callback,
+                                            gpointer                progress_data,
+                                            GAsyncReadyCallback     callback,
+                                            gpointer                user_data)
+{
+  DownloadItem *item;
+  GTask *task;
+  GFile *parent;
+  gchar *basename;
+  gchar *validator_name;
+
+  g_return_if_fail (GFBGRAPH_IS_DOWNLOADER (downloader));
+  g_return_if_fail (uri != NULL);
+  g_return_if_fail (G_IS_FILE (file));
+  g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+
+  task = new_download_task (downloader, uri, cancellable,
+                            progress_callback, progress_data,
+                            callback, user_data);
+  g_task_set_source_tag (task, gfbgraph_downloader_download_to_file_async);
+
+  item = g_task_get_task_data (task);
+  item->file = g_object_ref (file);
+
+  parent = g_file_get_parent (file);
+  if (parent != NULL) {
+    basename = g_file_get_basename (file);
+    validator_name = g_strconcat (basename, VALIDATOR_SUFFIX, NULL);
+    item->validator_file = g_file_get_child (parent, validator_name);
+    g_free (validator_name);
+    g_free (basename);
+    g_object_unref (parent);
+  }
+
+  queue_download (downloader, task);
+}
+
+/**
+ * gfbgraph_downloader_download_finish:
+ * @downloader: a #GFBGraphDownloader.
+ * @result: A #GAsyncResult.
+ * @error: (allow-none): An optional #GError, or %NULL.
+ *
+ * Finishes a download started with gfbgraph_downloader_download_to_stream_async()
+ * or gfbgraph_downloader_download_to_file_async().
+ *
+ * Returns: the size of the downloaded content, including the bytes written
+ * before resuming it, or -1 in case of error.
+ **/
+goffset
+gfbgraph_downloader_download_finish (GFBGraphDownloader  *downloader,
+                                     GAsyncResult        *result,
+                                     GError             **error)
+{
+  DownloadItem *item;
+
+  g_return_val_if_fail (g_task_is_valid (result, downloader), -1);
+  g_return_val_if_fail (error == NULL || *error == NULL, -1);
+
+  if (!g_task_propagate_boolean (G_TASK (result), error))
+    return -1;
+
+  item = g_task_get_task_data (G_TASK (result));
+
+  return item->offset;
+}
@@ -0,0 +1,92 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 2; tab-width: 2 -*-  */
+/*
+ * libgfbgraph - GObject library for Facebook Graph API
+ * Copyright (C) 2013 Álvaro Peña <alvaropg@gmail.com>
+ *               2020 Leesoo Ahn <yisooan@fedoraproject.org>
+ *
+ * GFBGraph is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GFBGraph is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GFBGraph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GFBGRAPH_DOWNLOADER_H__
+#define __GFBGRAPH_DOWNLOADER_H__
+
+#include <gio/gio.h>
+#include <glib-object.h>
+#include <gfbgraph/gfbgraph-context.h>
+
+G_BEGIN_DECLS
+
+#define GFBGRAPH_TYPE_DOWNLOADER (gfbgraph_downloader_get_type())
+#define GFBGRAPH_DOWNLOADER(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj),GFBGRAPH_TYPE_DOWNLOADER,GFBGraphDownloader))
+#define GFBGRAPH_DOWNLOADER_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass),GFBGRAPH_TYPE_DOWNLOADER,GFBGraphDownloaderClass))
+#define GFBGRAPH_IS_DOWNLOADER(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj),GFBGRAPH_TYPE_DOWNLOADER))
+#define GFBGRAPH_IS_DOWNLOADER_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass),GFBGRAPH_TYPE_DOWNLOADER))
+#define GFBGRAPH_DOWNLOADER_GET_CLASS(obj) \
+  (G_TYPE_INSTANCE_GET_CLASS((obj),GFBGRAPH_TYPE_DOWNLOADER,GFBGraphDownloaderClass))
+
+typedef struct _GFBGraphDownloader        GFBGraphDownloader;
+typedef struct _GFBGraphDownloaderClass   GFBGraphDownloaderClass;
+typedef struct _GFBGraphDownloaderPrivate GFBGraphDownloaderPrivate;
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (GFBGraphDownloader, g_object_unref)
+
+struct _GFBGraphDownloader {
+  GObject parent;
+
+  /*< private >*/
+  GFBGraphDownloaderPrivate *priv;
+};
+
+struct _GFBGraphDownloaderClass {
+  GObjectClass parent_class;
+};
+
+GType               gfbgraph_downloader_get_type           (void) G_GNUC_CONST;
+GFBGraphDownloader* gfbgraph_downloader_new                (GFBGraphContext        *context,
+                                                            guint                   max_downloads);
+
+GFBGraphContext*    gfbgraph_downloader_get_context        (GFBGraphDownloader     *downloader);
+guint               gfbgraph_downloader_get_max_downloads  (GFBGraphDownloader     *downloader);
+void                gfbgraph_downloader_set_max_downloads  (GFBGraphDownloader     *downloader,
+                                                            guint                   max_downloads);
+guint               gfbgraph_downloader_get_n_downloads    (GFBGraphDownloader     *downloader);
+
+void                gfbgraph_downloader_download_to_stream_async (GFBGraphDownloader     *downloader,
+                                                                  const gchar            *uri,
+                                                                  GOutputStream          *stream,
+                                                                  goffset                 offset,
+                                                                  GCancellable           *cancellable,
+                                                                  GFileProgressCallback   progress_callback,
+                                                                  gpointer                progress_data,
+                                                                  GAsyncReadyCallback     callback,
+                                                                  gpointer                user_data);
+void                gfbgraph_downloader_download_to_file_async   (GFBGraphDownloader     *downloader,
+                                                                  const gchar            *uri,
+                                                                  GFile                  *file,
+                                                                  GCancellable           *cancellable,
+                                                                  GFileProgressCallback   progress_callback,
+                                                                  gpointer                progress_data,
+                                                                  GAsyncReadyCallback     callback,
+                                                                  gpointer                user_data);
+goffset             gfbgraph_downloader_download_finish          (GFBGraphDownloader     *downloader,
+                                                                  GAsyncResult           *result,
+                                                                  GError                **error);
+
+G_END_DECLS
+
+#endif /* __GFBGRAPH_DOWNLOADER_H__ */
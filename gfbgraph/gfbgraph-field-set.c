@@ -0,0 +1,246 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 2; tab-width: 2 -*-  */
+/*
+ * libgfbgraph - GObject library for Facebook Graph API
+ * Copyright (C) 2013 Álvaro Peña <alvaropg@gmail.com>
+ *               2020 Leesoo Ahn <yisooan@fedoraproject.org>
+ *
+ * GFBGraph is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GFBGraph is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GFBGraph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * SECTION:gfbgraph-field-set
+ * @title: GFBGraphFieldSet
+ * @short_description: Set of node fields to retrieve
+ * @stability: Unstable
+ * @include: gfbgraph/gfbgraph.h
+ *
+ * A #GFBGraphFieldSet is the list of fields requested to the Graph API with the
+ * "fields" parameter, so the responses only include those properties. For example,
+ * when only the photo IDs are needed, the "images" array can be skipped, reducing
+ * a lot the size of the response and the time to parse it.
+ *
+ * The fields must be added before the set is shared with other threads.
+ **/
+
+#include <string.h>
+
+#include "gfbgraph-field-set.h"
+
+struct _GFBGraphFieldSet {
+  gint        ref_count;
+  GPtrArray  *fields;
+  gchar      *fields_string;
+};
+
+G_DEFINE_BOXED_TYPE (GFBGraphFieldSet, gfbgraph_field_set, gfbgraph_field_set_ref, gfbgraph_field_set_unref);
+
+static GFBGraphFieldSet *
+field_set_new (void)
+{
+  GFBGraphFieldSet *field_set;
+
+  field_set = g_slice_new0 (GFBGraphFieldSet);
+  field_set->ref_count = 1;
+  field_set->fields = g_ptr_array_new_with_free_func (g_free);
+  field_set->fields_string = g_strdup ("");
+
+  return field_set;
+}
+
+/**
+ * gfbgraph_field_set_new:
+ * @first_field: (allow-none): the name of the first field.
+ * @...: more field names, followed by %NULL.
+ *
+ * Creates a new #GFBGraphFieldSet with the given fields.
+ *
+ * Returns: (transfer full): a new #GFBGraphFieldSet; unref with gfbgraph_field_set_unref()
+ **/
+GFBGraphFieldSet *
+gfbgraph_field_set_new (const gchar *first_field,
+                        ...)
+{
+  GFBGraphFieldSet *field_set;
+  const gchar *field;
+  va_list args;
+
+  field_set = field_set_new ();
+
+  va_start (args, first_field);
+  for (field = first_field; field != NULL; field = va_arg (args, const gchar *))
+    gfbgraph_field_set_add (field_set, field);
+  va_end (args);
+
+  return field_set;
+}
+
+/**
+ * gfbgraph_field_set_new_from_string:
+ * @fields: a comma separated list of fields, like "id,name,images{source,width}".
+ *
+ * Creates a new #GFBGraphFieldSet from a string in the same format used
+ * by the Graph API. The commas inside a field expansion don't split it.
+ *
+ * Returns: (transfer full): a new #GFBGraphFieldSet; unref with gfbgraph_field_set_unref()
+ **/
+GFBGraphFieldSet *
+gfbgraph_field_set_new_from_string (const gchar *fields)
+{
+  GFBGraphFieldSet *field_set;
+  const gchar *start, *p;
+  gint depth = 0;
+
+  g_return_val_if_fail (fields != NULL, NULL);
+
+  field_set = field_set_new ();
+
+  /* The commas inside field expansions, like "images{source,width}" or
+   * "photos.limit(5){id,name}", don't separate fields */
+  for (start = p = fields; ; p++) {
+    if (*p == '\0' || (*p == ',' && depth == 0)) {
+      gchar *field;
+
+      field = g_strstrip (g_strndup (start, p - start));
+      if (*field != '\0')
+        gfbgraph_field_set_add (field_set, field);
+      g_free (field);
+
+      if (*p == '\0')
+        break;
+      start = p + 1;
+    } else if (*p == '{' || *p == '(') {
+      depth++;
+    } else if ((*p == '}' || *p == ')') && depth > 0) {
+      depth--;
+    }
+  }
+
+  return field_set;
+}
+
+/**
+ * gfbgraph_field_set_ref:
+ * @field_set: a #GFBGraphFieldSet.
+ *
+ * Increases the reference count of @field_set.
+ *
+ * Returns: (transfer full): the same @field_set.
+ **/
+GFBGraphFieldSet *
+gfbgraph_field_set_ref (GFBGraphFieldSet *field_set)
+{
+  g_return_val_if_fail (field_set != NULL, NULL);
+
+  g_atomic_int_inc (&field_set->ref_count);
+
+  return field_set;
+}
+
+/**
+ * gfbgraph_field_set_unref:
+ * @field_set: a #GFBGraphFieldSet.
+ *
+ * Decreases the reference count of @field_set, freeing it when it reaches zero.
+ **/
+void
+gfbgraph_field_set_unref (GFBGraphFieldSet *field_set)
+{
+  g_return_if_fail (field_set != NULL);
+
+  if (g_atomic_int_dec_and_test (&field_set->ref_count)) {
+    g_ptr_array_unref (field_set->fields);
+    g_free (field_set->fields_string);
+    g_slice_free (GFBGraphFieldSet, field_set);
+  }
+}
+
+/**
+ * gfbgraph_field_set_add:
+ * @field_set: a #GFBGraphFieldSet.
+ * @field: the name of a node field, like "name", or a field expansion like "images{source}".
+ *
+ * Adds @field to @field_set. Adding a field twice has no effect.
+ **/
+void
+gfbgraph_field_set_add (GFBGraphFieldSet *field_set,
+                        const gchar      *field)
+{
+  g_return_if_fail (field_set != NULL);
+  g_return_if_fail (field != NULL && *field != '\0');
+
+  if (gfbgraph_field_set_contains (field_set, field))
+    return;
+
+  g_ptr_array_add (field_set->fields, g_strdup (field));
+
+  /* Built here, so it can be read from any thread */
+  g_ptr_array_add (field_set->fields, NULL);
+  g_free (field_set->fields_string);
+  field_set->fields_string = g_strjoinv (",", (gchar **) field_set->fields->pdata);
+  g_ptr_array_set_size (field_set->fields, field_set->fields->len - 1);
+}
+
+/**
+ * gfbgraph_field_set_contains:
+ * @field_set: a #GFBGraphFieldSet.
+ * @field: the name of a node field.
+ *
+ * Returns: %TRUE if @field is in @field_set.
+ **/
+gboolean
+gfbgraph_field_set_contains (GFBGraphFieldSet *field_set,
+                             const gchar      *field)
+{
+  guint i;
+
+  g_return_val_if_fail (field_set != NULL, FALSE);
+  g_return_val_if_fail (field != NULL, FALSE);
+
+  for (i = 0; i < field_set->fields->len; i++) {
+    if (strcmp (g_ptr_array_index (field_set->fields, i), field) == 0)
+      return TRUE;
+  }
+
+  return FALSE;
+}
+
+/**
+ * gfbgraph_field_set_get_size:
+ * @field_set: a #GFBGraphFieldSet.
+ *
+ * Returns: the number of fields in @field_set.
+ **/
+guint
+gfbgraph_field_set_get_size (GFBGraphFieldSet *field_set)
+{
+  g_return_val_if_fail (field_set != NULL, 0);
+
+  return field_set->fields->len;
+}
+
+/**
+ * gfbgraph_field_set_to_string:
+ * @field_set: a #GFBGraphFieldSet.
+ *
+ * Gets the value for the "fields" parameter of a Graph API request.
+ *
+ * Returns: (transfer none): the comma separated list of fields.
+ **/
+const gchar *
+gfbgraph_field_set_to_string (GFBGraphFieldSet *field_set)
+{
+  g_return_val_if_fail (field_set != NULL, NULL);
+
+  return field_set->fields_string;
+}
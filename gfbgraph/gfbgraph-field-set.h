@@ -0,0 +1,50 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 2; tab-width: 2 -*-  */
+/*
+ * libgfbgraph - GObject library for Facebook Graph API
+ * Copyright (C) 2013 Álvaro Peña <alvaropg@gmail.com>
+ *               2020 Leesoo Ahn <yisooan@fedoraproject.org>
+ *
+ * GFBGraph is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GFBGraph is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GFBGraph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GFBGRAPH_FIELD_SET_H__
+#define __GFBGRAPH_FIELD_SET_H__
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define GFBGRAPH_TYPE_FIELD_SET (gfbgraph_field_set_get_type())
+
+typedef struct _GFBGraphFieldSet GFBGraphFieldSet;
+
+GType             gfbgraph_field_set_get_type        (void) G_GNUC_CONST;
+GFBGraphFieldSet* gfbgraph_field_set_new             (const gchar      *first_field,
+                                                      ...) G_GNUC_NULL_TERMINATED;
+GFBGraphFieldSet* gfbgraph_field_set_new_from_string (const gchar      *fields);
+GFBGraphFieldSet* gfbgraph_field_set_ref             (GFBGraphFieldSet *field_set);
+void              gfbgraph_field_set_unref           (GFBGraphFieldSet *field_set);
+
+void              gfbgraph_field_set_add             (GFBGraphFieldSet *field_set,
+                                                      const gchar      *field);
+gboolean          gfbgraph_field_set_contains        (GFBGraphFieldSet *field_set,
+                                                      const gchar      *field);
+guint             gfbgraph_field_set_get_size        (GFBGraphFieldSet *field_set);
+const gchar*      gfbgraph_field_set_to_string       (GFBGraphFieldSet *field_set);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (GFBGraphFieldSet, gfbgraph_field_set_unref)
+
+G_END_DECLS
+
+#endif /* __GFBGRAPH_FIELD_SET_H__ */
@@ -26,10 +26,26 @@
  *
  * #GFBGraphGoaAuthorizer provides an implementation of the #GFBGraphAuthorizer interface
  * for authorization using GNOME Online Accounts (GOA).
+ *
+ * Refreshing the token takes two D-Bus round trips to GOA. They're done without
+ * any lock held, so the requests keep using the current token meanwhile, and the
+ * new token replaces it at once when it arrives. The refreshes requested while
+ * another one is in progress, synchronous or asynchronous, wait for it and share
+ * its result instead of asking GOA again. The asynchronous refreshes run in the
+ * thread pool of #GTask; a cancelled caller returns at once, and the D-Bus calls
+ * are cancelled too when no other caller waits for them.
+ *
+ * When GOA tells when the token expires, a refresh is started in the
+ * background by the first request made during the last minute of its life, so
+ * the requests don't have to fail and be sent again with the new token.
  **/
 
 #include "gfbgraph-authorizer.h"
 #include "gfbgraph-goa-authorizer.h"
+#include "gfbgraph-private.h"
+
+/* Seconds before the expiration of the token when it's refreshed */
+#define REFRESH_MARGIN 60
 
 enum {
   PROP_O,
@@ -37,11 +53,37 @@ enum {
 };
 
 struct _GFBGraphGoaAuthorizerPrivate {
-  GMutex mutex;
+  GMutex mutex;           /* Guards the refresh in flight */
+  GCond refresh_cond;
   GoaObject *goa_object;
-  gchar *access_token;
+  GFBGraphTokenCell access_token;
+  gint expiry_time;       /* Monotonic seconds, 0 if unknown, atomic */
+  struct _RefreshFlight *flight;
 };
 
+/* A refresh in progress, shared by all the callers asking for a refresh
+ * meanwhile. Its result is immutable once done is set. */
+typedef struct _RefreshFlight {
+  gint          ref_count;     /* Atomic */
+  gboolean      done;          /* The fields below are guarded by the mutex */
+  gboolean      success;       /* of the authorizer */
+  GError       *error;
+  GList        *tasks;         /* The asynchronous callers waiting for it */
+  guint         n_sync;        /* The synchronous callers waiting for it */
+  GCancellable *cancellable;   /* Only for the refreshes started asynchronously */
+} RefreshFlight;
+
+typedef struct {
+  GFBGraphGoaAuthorizer *authorizer;
+  RefreshFlight         *flight;
+} RefreshThreadData;
+
+/* The task data of an asynchronous caller */
+typedef struct {
+  RefreshFlight *flight;
+  GSource       *cancel_source;
+} RefreshWaiter;
+
 #define GFBGRAPH_GOA_AUTHORIZER_GET_PRIVATE(o) \
   (G_TYPE_INSTANCE_GET_PRIVATE((o), GFBGRAPH_TYPE_GOA_AUTHORIZER, GFBGraphGoaAuthorizerPrivate))
 
@@ -55,6 +97,12 @@ G_DEFINE_TYPE_WITH_CODE (GFBGraphGoaAuthorizer, gfbgraph_goa_authorizer, G_TYPE_
 static void
 gfbgraph_goa_authorizer_finalize (GObject *object)
 {
+  GFBGraphGoaAuthorizerPrivate *priv = GFBGRAPH_GOA_AUTHORIZER_GET_PRIVATE (object);
+
+  gfbgraph_token_cell_clear (&priv->access_token);
+  g_mutex_clear (&priv->mutex);
+  g_cond_clear (&priv->refresh_cond);
+
   G_OBJECT_CLASS(parent_class)->finalize (object);
 }
 
@@ -158,23 +206,267 @@ gfbgraph_goa_authorizer_init (GFBGraphGoaAuthorizer *object)
 {
   object->priv = GFBGRAPH_GOA_AUTHORIZER_GET_PRIVATE(object);
   g_mutex_init (&object->priv->mutex);
+  g_cond_init (&object->priv->refresh_cond);
+  gfbgraph_token_cell_init (&object->priv->access_token);
+}
+
+/* --- Private Functions --- */
+static RefreshFlight *
+refresh_flight_new (gboolean cancellable)
+{
+  RefreshFlight *flight;
+
+  flight = g_slice_new0 (RefreshFlight);
+  flight->ref_count = 1;
+  if (cancellable)
+    flight->cancellable = g_cancellable_new ();
+
+  return flight;
+}
+
+static RefreshFlight *
+refresh_flight_ref (RefreshFlight *flight)
+{
+  g_atomic_int_inc (&flight->ref_count);
+
+  return flight;
 }
 
-/* --- Authorizer Interface --- */
 static void
-process_call (GFBGraphAuthorizer *iface,
-              RestProxyCall      *call)
+refresh_flight_unref (RefreshFlight *flight)
 {
-  GFBGraphGoaAuthorizerPrivate *priv = GFBGRAPH_GOA_AUTHORIZER_GET_PRIVATE (GFBGRAPH_GOA_AUTHORIZER (iface));
+  if (!g_atomic_int_dec_and_test (&flight->ref_count))
+    return;
+
+  g_clear_error (&flight->error);
+  g_clear_object (&flight->cancellable);
+  g_slice_free (RefreshFlight, flight);
+}
+
+static void
+clear_cancel_source (RefreshWaiter *waiter)
+{
+  if (waiter->cancel_source != NULL) {
+    g_source_destroy (waiter->cancel_source);
+    g_clear_pointer (&waiter->cancel_source, g_source_unref);
+  }
+}
+
+static void
+refresh_waiter_free (RefreshWaiter *waiter)
+{
+  clear_cancel_source (waiter);
+  refresh_flight_unref (waiter->flight);
+  g_slice_free (RefreshWaiter, waiter);
+}
+
+/* Asks GOA for a new token, without any lock held. @expires_in is set to
+ * the seconds the token is valid, or 0 if unknown. */
+static gchar *
+fetch_access_token (GoaObject     *goa_object,
+                    gint          *expires_in,
+                    GCancellable  *cancellable,
+                    GError       **error)
+{
+  GoaAccount *account;
+  GoaOAuth2Based *oauth2_based;
+  gchar *access_token = NULL;
+
+  account = goa_object_peek_account (goa_object);
+  oauth2_based = goa_object_peek_oauth2_based (goa_object);
+
+  if (!goa_account_call_ensure_credentials_sync (account, NULL, cancellable, error))
+    return NULL;
+  if (!goa_oauth2_based_call_get_access_token_sync (oauth2_based, &access_token, expires_in,
+                                                    cancellable, error))
+    return NULL;
+
+  return access_token;
+}
+
+static void
+complete_refresh_task (GTask         *task,
+                       RefreshFlight *flight)
+{
+  clear_cancel_source (g_task_get_task_data (task));
+
+  if (g_task_return_error_if_cancelled (task))
+    ;
+  else if (flight->success)
+    g_task_return_boolean (task, TRUE);
+  else
+    g_task_return_error (task, g_error_copy (flight->error));
+
+  g_object_unref (task);
+}
+
+/* Does the refresh of @flight, by its leader. The current token is kept until
+ * the new one arrives, and it's kept if the refresh fails. */
+static void
+run_refresh_flight (GFBGraphGoaAuthorizer *self,
+                    RefreshFlight         *flight)
+{
+  GFBGraphGoaAuthorizerPrivate *priv = self->priv;
+  GError *error = NULL;
+  gchar *access_token;
+  gint expires_in = 0;
+  GList *tasks, *l;
+
+  access_token = fetch_access_token (priv->goa_object, &expires_in, flight->cancellable, &error);
+  if (access_token != NULL) {
+    gfbgraph_token_cell_set (&priv->access_token, access_token);
+    g_atomic_int_set (&priv->expiry_time,
+                      expires_in > 0 ? g_get_monotonic_time () / G_USEC_PER_SEC + expires_in : 0);
+  }
+  g_free (access_token);
+
+  g_mutex_lock (&priv->mutex);
+  if (access_token != NULL)
+    flight->success = TRUE;
+  else
+    flight->error = error;
+  flight->done = TRUE;
+  tasks = g_list_reverse (flight->tasks);
+  flight->tasks = NULL;
+  /* A cancelled flight was already replaced */
+  if (priv->flight == flight)
+    priv->flight = NULL;
+  g_cond_broadcast (&priv->refresh_cond);
+  g_mutex_unlock (&priv->mutex);
+
+  /* The leader keeps its reference, so the result can be read unlocked */
+  for (l = tasks; l != NULL; l = l->next)
+    complete_refresh_task (l->data, flight);
+  g_list_free (tasks);
+}
+
+/* The references are dropped here rather than with the task, which is only
+ * finalized once its main context is iterated */
+static void
+refresh_thread (GTask        *task,
+                gpointer      source_object,
+                gpointer      task_data,
+                GCancellable *cancellable)
+{
+  RefreshThreadData *data = task_data;
+
+  run_refresh_flight (data->authorizer, data->flight);
+
+  refresh_flight_unref (data->flight);
+  g_object_unref (data->authorizer);
+  g_slice_free (RefreshThreadData, data);
+
+  g_task_return_boolean (task, TRUE);
+}
+
+/* Runs @flight in the thread pool of GTask, taking its reference */
+static void
+start_refresh_thread (GFBGraphGoaAuthorizer *self,
+                      RefreshFlight         *flight)
+{
+  RefreshThreadData *data;
+  GTask *task;
+
+  data = g_slice_new (RefreshThreadData);
+  data->authorizer = g_object_ref (self);
+  data->flight = flight;
+
+  task = g_task_new (NULL, NULL, NULL, NULL);
+  g_task_set_source_tag (task, start_refresh_thread);
+  g_task_set_task_data (task, data, NULL);
+  g_task_run_in_thread (task, refresh_thread);
+  g_object_unref (task);
+}
+
+/* Starts a refresh in the background, with nobody waiting for it, unless
+ * there is already one in progress */
+static void
+start_background_refresh (GFBGraphGoaAuthorizer *self)
+{
+  GFBGraphGoaAuthorizerPrivate *priv = self->priv;
+  RefreshFlight *flight = NULL;
+
+  g_mutex_lock (&priv->mutex);
+  if (priv->flight == NULL)
+    flight = priv->flight = refresh_flight_new (FALSE);
+  g_mutex_unlock (&priv->mutex);
+
+  if (flight != NULL)
+    start_refresh_thread (self, flight);
+}
+
+/* An asynchronous caller was cancelled: it returns at once, and the D-Bus
+ * calls are cancelled if nobody else is waiting for them */
+static gboolean
+refresh_waiter_cancelled_cb (gpointer user_data)
+{
+  GTask *task = G_TASK (user_data);
+  GFBGraphGoaAuthorizer *self = g_task_get_source_object (task);
+  GFBGraphGoaAuthorizerPrivate *priv = self->priv;
+  RefreshWaiter *waiter = g_task_get_task_data (task);
+  RefreshFlight *flight = waiter->flight;
+  GList *link;
+  gboolean cancel_flight = FALSE;
 
   g_mutex_lock (&priv->mutex);
+  link = g_list_find (flight->tasks, task);
+  if (link != NULL) {
+    flight->tasks = g_list_delete_link (flight->tasks, link);
+    if (flight->cancellable != NULL && flight->tasks == NULL && flight->n_sync == 0) {
+      cancel_flight = TRUE;
+      /* The next refresh starts a new flight */
+      if (priv->flight == flight)
+        priv->flight = NULL;
+    }
+  }
+  g_mutex_unlock (&priv->mutex);
+
+  if (link != NULL) {
+    if (cancel_flight)
+      g_cancellable_cancel (flight->cancellable);
+    g_task_return_error_if_cancelled (task);
+    /* The reference of the flight */
+    g_object_unref (task);
+  }
 
-  if (priv->access_token != NULL)
-    rest_proxy_call_add_param (call, "access_token", priv->access_token);
+  return G_SOURCE_REMOVE;
+}
+
+static void
+wake_refresh_waiters_cb (GCancellable *cancellable,
+                         gpointer      user_data)
+{
+  GFBGraphGoaAuthorizerPrivate *priv = user_data;
 
+  g_mutex_lock (&priv->mutex);
+  g_cond_broadcast (&priv->refresh_cond);
   g_mutex_unlock (&priv->mutex);
 }
 
+/* --- Authorizer Interface --- */
+static void
+process_call (GFBGraphAuthorizer *iface,
+              RestProxyCall      *call)
+{
+  GFBGraphGoaAuthorizerPrivate *priv = GFBGRAPH_GOA_AUTHORIZER_GET_PRIVATE (GFBGRAPH_GOA_AUTHORIZER (iface));
+  const gchar *access_token;
+  guint slot;
+  gint expiry_time;
+
+  access_token = gfbgraph_token_cell_read_begin (&priv->access_token, &slot);
+  if (access_token != NULL)
+    rest_proxy_call_add_param (call, "access_token", access_token);
+  gfbgraph_token_cell_read_end (&priv->access_token, slot);
+
+  /* Only the request clearing the expiry time starts the refresh, which sets
+   * it again if GOA tells it */
+  expiry_time = g_atomic_int_get (&priv->expiry_time);
+  if (expiry_time != 0
+      && g_get_monotonic_time () / G_USEC_PER_SEC >= expiry_time - REFRESH_MARGIN
+      && g_atomic_int_compare_and_exchange (&priv->expiry_time, expiry_time, 0))
+    start_background_refresh (GFBGRAPH_GOA_AUTHORIZER (iface));
+}
+
 static void
 process_message (GFBGraphAuthorizer *iface,
                  SoupMessage        *message)
@@ -182,16 +474,18 @@ process_message (GFBGraphAuthorizer *iface,
   gchar *auth_value;
   SoupURI *uri;
   GFBGraphGoaAuthorizerPrivate *priv = GFBGRAPH_GOA_AUTHORIZER_GET_PRIVATE (GFBGRAPH_GOA_AUTHORIZER (iface));
+  const gchar *access_token;
+  guint slot;
 
-  g_mutex_lock (&priv->mutex);
-
-  uri = soup_message_get_uri (message);
-  auth_value = g_strconcat ("access_token=", priv->access_token, NULL);
-  soup_uri_set_query (uri, auth_value);
-
-  g_free (auth_value);
+  access_token = gfbgraph_token_cell_read_begin (&priv->access_token, &slot);
+  auth_value = access_token ? g_strconcat ("access_token=", access_token, NULL) : NULL;
+  gfbgraph_token_cell_read_end (&priv->access_token, slot);
 
-  g_mutex_unlock (&priv->mutex);
+  if (auth_value != NULL) {
+    uri = soup_message_get_uri (message);
+    soup_uri_set_query (uri, auth_value);
+    g_free (auth_value);
+  }
 }
 
 static gboolean
@@ -199,26 +493,118 @@ refresh_authorization (GFBGraphAuthorizer  *iface,
                        GCancellable        *cancellable,
                        GError             **error)
 {
-  GoaAccount *account;
-  GoaOAuth2Based *oauth2_based;
-  gboolean ret_val = FALSE;
-  GFBGraphGoaAuthorizerPrivate *priv = GFBGRAPH_GOA_AUTHORIZER_GET_PRIVATE (GFBGRAPH_GOA_AUTHORIZER (iface));
+  GFBGraphGoaAuthorizer *self = GFBGRAPH_GOA_AUTHORIZER (iface);
+  GFBGraphGoaAuthorizerPrivate *priv = self->priv;
+  RefreshFlight *flight;
+  gboolean leader = FALSE;
+  gboolean success = FALSE;
+  gulong cancelled_id = 0;
+
+  if (g_cancellable_set_error_if_cancelled (cancellable, error))
+    return FALSE;
+
+  /* Connected before locking, the handler is run at once if it's already cancelled */
+  if (cancellable != NULL)
+    cancelled_id = g_cancellable_connect (cancellable, G_CALLBACK (wake_refresh_waiters_cb), priv, NULL);
 
   g_mutex_lock (&priv->mutex);
+  flight = priv->flight;
+  if (flight == NULL) {
+    flight = priv->flight = refresh_flight_new (FALSE);
+    leader = TRUE;
+  } else {
+    refresh_flight_ref (flight);
+  }
+  flight->n_sync++;
+
+  if (leader) {
+    /* The D-Bus calls are shared with other callers, so they aren't cancellable */
+    g_mutex_unlock (&priv->mutex);
+    run_refresh_flight (self, flight);
+    g_mutex_lock (&priv->mutex);
+  } else {
+    while (!flight->done && !g_cancellable_is_cancelled (cancellable))
+      g_cond_wait (&priv->refresh_cond, &priv->mutex);
+  }
+
+  flight->n_sync--;
+  if (!flight->done)
+    g_cancellable_set_error_if_cancelled (cancellable, error);
+  else if (flight->success)
+    success = TRUE;
+  else
+    g_propagate_error (error, g_error_copy (flight->error));
+  g_mutex_unlock (&priv->mutex);
+
+  refresh_flight_unref (flight);
 
-  g_free (priv->access_token);
-  priv->access_token = NULL;
+  if (cancelled_id != 0)
+    g_cancellable_disconnect (cancellable, cancelled_id);
 
-  account = goa_object_peek_account (priv->goa_object);
-  oauth2_based = goa_object_peek_oauth2_based (priv->goa_object);
+  return success;
+}
+
+static void
+refresh_authorization_async (GFBGraphAuthorizer  *iface,
+                             GCancellable        *cancellable,
+                             GAsyncReadyCallback  callback,
+                             gpointer             user_data)
+{
+  GFBGraphGoaAuthorizer *self = GFBGRAPH_GOA_AUTHORIZER (iface);
+  GFBGraphGoaAuthorizerPrivate *priv = self->priv;
+  RefreshFlight *flight = NULL;
+  RefreshWaiter *waiter;
+  GTask *task;
+
+  task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_source_tag (task, refresh_authorization_async);
+
+  if (g_task_return_error_if_cancelled (task)) {
+    g_object_unref (task);
+    return;
+  }
 
-  if (goa_account_call_ensure_credentials_sync (account, NULL, cancellable, error))
-    if (goa_oauth2_based_call_get_access_token_sync (oauth2_based, &priv->access_token, NULL, cancellable, error))
-      ret_val = TRUE;
+  waiter = g_slice_new0 (RefreshWaiter);
+  g_task_set_task_data (task, waiter, (GDestroyNotify) refresh_waiter_free);
 
+  g_mutex_lock (&priv->mutex);
+  if (priv->flight == NULL)
+    flight = priv->flight = refresh_flight_new (TRUE);
+  waiter->flight = refresh_flight_ref (priv->flight);
+  /* The task reference goes to the flight */
+  priv->flight->tasks = g_list_prepend (priv->flight->tasks, task);
+  if (cancellable != NULL) {
+    waiter->cancel_source = g_cancellable_source_new (cancellable);
+    g_source_set_callback (waiter->cancel_source,
+                           refresh_waiter_cancelled_cb,
+                           g_object_ref (task),
+                           g_object_unref);
+    g_source_attach (waiter->cancel_source, g_task_get_context (task));
+  }
   g_mutex_unlock (&priv->mutex);
 
-  return ret_val;
+  /* The synchronous D-Bus calls in a pooled thread are simpler than chaining
+   * the asynchronous ones, and don't need a main loop in the thread of the caller */
+  if (flight != NULL)
+    start_refresh_thread (self, flight);
+}
+
+static gboolean
+refresh_authorization_finish (GFBGraphAuthorizer  *iface,
+                              GAsyncResult        *result,
+                              GError             **error)
+{
+  g_return_val_if_fail (g_task_is_valid (result, iface), FALSE);
+
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
+
+static gchar *
+get_account_id (GFBGraphAuthorizer *iface)
+{
+  GFBGraphGoaAuthorizerPrivate *priv = GFBGRAPH_GOA_AUTHORIZER (iface)->priv;
+
+  return goa_account_dup_id (goa_object_peek_account (priv->goa_object));
 }
 
 static void
@@ -227,6 +613,9 @@ authorizer_iface_init (GFBGraphAuthorizerInterface *iface)
   iface->process_call = process_call;
   iface->process_message = process_message;
   iface->refresh_authorization = refresh_authorization;
+  iface->refresh_authorization_async = refresh_authorization_async;
+  iface->refresh_authorization_finish = refresh_authorization_finish;
+  iface->get_account_id = get_account_id;
 }
 
 /**
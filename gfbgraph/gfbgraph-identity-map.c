@@ -0,0 +1,802 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 2; tab-width: 2 -*-  */
+/*
+ * libgfbgraph - GObject library for Facebook Graph API
+ * Copyright (C) 2013 Álvaro Peña <alvaropg@gmail.com>
+ *               2020 Leesoo Ahn <yisooan@fedoraproject.org>
+ *
+ * GFBGraph is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GFBGraph is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GFBGraph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * SECTION:gfbgraph-identity-map
+ * @title: GFBGraphIdentityMap
+ * @short_description: In-memory map of the nodes by their ID
+ * @stability: Unstable
+ * @include: gfbgraph/gfbgraph.h
+ *
+ * #GFBGraphIdentityMap keeps a single #GFBGraphNode instance for every node ID
+ * and #GFBGraphAuthorizer. When it's set in a #GFBGraphContext with
+ * gfbgraph_context_set_identity_map(), every node parsed from a response of the
+ * context is looked up by its ID: if a node with the same ID and type retrieved
+ * with the same authorizer is still alive, the new data is merged into it with
+ * gfbgraph_node_merge() and that instance is returned instead. So the same album
+ * or photo retrieved from different connections or pages is a single object,
+ * and the application sees the updates of any of them.
+ *
+ * The nodes of different authorizers are kept apart, as every account can see
+ * different fields of the same node, so a node retrieved with an account is
+ * never returned for another one.
+ *
+ * The map only keeps a reference to the @max-size most recently used nodes,
+ * the older ones are tracked with weak references while the application keeps
+ * them alive. A node retrieved less than #GFBGraphIdentityMap:ttl seconds ago
+ * with the same fields is returned by gfbgraph_node_new_from_id_with_fields()
+ * without a request.
+ *
+ * The nodes of the map are modified in place, maybe from the threads of the
+ * library. The merges into the nodes of a map are serialized, their notify
+ * signals are emitted once the merge is done, and the strings and images
+ * returned by the getters of a node stay valid while the node is alive, even
+ * if a merge replaces them. An application modifying the nodes itself from
+ * several threads must still serialize its access.
+ **/
+
+#include "gfbgraph-identity-map.h"
+#include "gfbgraph-private.h"
+
+#define DEFAULT_MAX_SIZE 1000
+#define DEFAULT_TTL      300
+
+/* Minimum number of entries before the dead ones are swept */
+#define SWEEP_MIN_SIZE   64
+
+enum {
+  PROP_0,
+  PROP_MAX_SIZE,
+  PROP_TTL
+};
+
+typedef struct {
+  GFBGraphAuthorizer *authorizer; /* Weak, %NULL for the nodes added by the application */
+  gchar              *id;
+} EntryKey;
+
+typedef struct {
+  EntryKey      key;
+  GWeakRef      node;
+  GFBGraphNode *strong;       /* Reference held while the entry is in the LRU list */
+  GList         lru_link;     /* Link of the entry in the LRU list */
+  gint64        fetched_time; /* Monotonic time of the last response merged */
+  gchar        *fields;       /* Fields of the last response, NULL for the default ones */
+  gboolean      fields_known; /* FALSE if the node was added by the application */
+} Entry;
+
+struct _GFBGraphIdentityMapPrivate {
+  GMutex      mutex;
+  GMutex      merge_mutex;    /* Serializes the merges into the nodes */
+  GHashTable *entries;        /* EntryKey -> Entry */
+  GHashTable *authorizers;    /* Set of the authorizers with a weak reference */
+  GQueue      lru;            /* Entries with a strong reference, most recent first */
+  guint       sweep_size;     /* Number of entries which triggers the next sweep */
+  guint       max_size;
+  guint       ttl;
+};
+
+#define GFBGRAPH_IDENTITY_MAP_GET_PRIVATE(o) \
+  (G_TYPE_INSTANCE_GET_PRIVATE((o), GFBGRAPH_TYPE_IDENTITY_MAP, GFBGraphIdentityMapPrivate))
+
+static GObjectClass *parent_class = NULL;
+
+G_DEFINE_TYPE (GFBGraphIdentityMap, gfbgraph_identity_map, G_TYPE_OBJECT);
+
+static void trim_lru_locked (GFBGraphIdentityMapPrivate *priv,
+                             GSList                    **garbage);
+static void authorizer_finalized_cb (gpointer  data,
+                                     GObject  *where_the_object_was);
+
+static guint
+entry_key_hash (gconstpointer data)
+{
+  const EntryKey *key = data;
+
+  return g_str_hash (key->id) ^ g_direct_hash (key->authorizer);
+}
+
+static gboolean
+entry_key_equal (gconstpointer a,
+                 gconstpointer b)
+{
+  const EntryKey *key_a = a;
+  const EntryKey *key_b = b;
+
+  return key_a->authorizer == key_b->authorizer && g_str_equal (key_a->id, key_b->id);
+}
+
+static void
+entry_free (Entry *entry)
+{
+  g_warn_if_fail (entry->strong == NULL);
+
+  g_weak_ref_clear (&entry->node);
+  g_free (entry->key.id);
+  g_free (entry->fields);
+  g_slice_free (Entry, entry);
+}
+
+static void
+gfbgraph_identity_map_finalize (GObject *object)
+{
+  GFBGraphIdentityMapPrivate *priv = GFBGRAPH_IDENTITY_MAP_GET_PRIVATE (object);
+  GHashTableIter iter;
+  gpointer authorizer;
+  GList *link;
+
+  g_hash_table_iter_init (&iter, priv->authorizers);
+  while (g_hash_table_iter_next (&iter, &authorizer, NULL))
+    g_object_weak_unref (G_OBJECT (authorizer), authorizer_finalized_cb, object);
+  g_hash_table_unref (priv->authorizers);
+
+  for (link = priv->lru.head; link != NULL; link = link->next) {
+    Entry *entry = link->data;
+
+    g_clear_object (&entry->strong);
+  }
+  g_hash_table_unref (priv->entries);
+  g_mutex_clear (&priv->mutex);
+  g_mutex_clear (&priv->merge_mutex);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static void
+gfbgraph_identity_map_set_property (GObject      *object,
+                                    guint         prop_id,
+                                    const GValue *value,
+                                    GParamSpec   *pspec)
+{
+  GFBGraphIdentityMapPrivate *priv = GFBGRAPH_IDENTITY_MAP_GET_PRIVATE (object);
+  GSList *garbage = NULL;
+
+  g_mutex_lock (&priv->mutex);
+  switch (prop_id) {
+    case PROP_MAX_SIZE:
+      priv->max_size = g_value_get_uint (value);
+      trim_lru_locked (priv, &garbage);
+      break;
+    case PROP_TTL:
+      priv->ttl = g_value_get_uint (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+  g_mutex_unlock (&priv->mutex);
+
+  g_slist_free_full (garbage, g_object_unref);
+}
+
+static void
+gfbgraph_identity_map_get_property (GObject    *object,
+                                    guint       prop_id,
+                                    GValue     *value,
+                                    GParamSpec *pspec)
+{
+  GFBGraphIdentityMapPrivate *priv = GFBGRAPH_IDENTITY_MAP_GET_PRIVATE (object);
+
+  g_mutex_lock (&priv->mutex);
+  switch (prop_id) {
+    case PROP_MAX_SIZE:
+      g_value_set_uint (value, priv->max_size);
+      break;
+    case PROP_TTL:
+      g_value_set_uint (value, priv->ttl);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+  g_mutex_unlock (&priv->mutex);
+}
+
+static void
+gfbgraph_identity_map_class_init (GFBGraphIdentityMapClass *klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+
+  parent_class                 = g_type_class_peek_parent (klass);
+  gobject_class->finalize      = gfbgraph_identity_map_finalize;
+  gobject_class->set_property  = gfbgraph_identity_map_set_property;
+  gobject_class->get_property  = gfbgraph_identity_map_get_property;
+
+  g_type_class_add_private (gobject_class, sizeof(GFBGraphIdentityMapPrivate));
+
+  /**
+   * GFBGraphIdentityMap:max-size:
+   *
+   * The maximum number of nodes the map keeps alive. The least recently used
+   * nodes over this limit are only kept while the application references them.
+   **/
+  g_object_class_install_property (gobject_class,
+                                   PROP_MAX_SIZE,
+                                   g_param_spec_uint ("max-size",
+                                                      "Maximum size",
+                                                      "The maximum number of nodes kept alive by the map",
+                                                      0, G_MAXUINT, DEFAULT_MAX_SIZE,
+                                                      G_PARAM_CONSTRUCT | G_PARAM_READWRITE));
+
+  /**
+   * GFBGraphIdentityMap:ttl:
+   *
+   * The number of seconds a node is returned by the map without retrieving it
+   * again. With 0 the nodes never expire.
+   **/
+  g_object_class_install_property (gobject_class,
+                                   PROP_TTL,
+                                   g_param_spec_uint ("ttl",
+                                                      "Time to live",
+                                                      "The seconds a node is valid after it was retrieved",
+                                                      0, G_MAXUINT, DEFAULT_TTL,
+                                                      G_PARAM_CONSTRUCT | G_PARAM_READWRITE));
+}
+
+static void
+gfbgraph_identity_map_init (GFBGraphIdentityMap *obj)
+{
+  obj->priv = GFBGRAPH_IDENTITY_MAP_GET_PRIVATE (obj);
+
+  g_mutex_init (&obj->priv->mutex);
+  g_mutex_init (&obj->priv->merge_mutex);
+  obj->priv->entries = g_hash_table_new_full (entry_key_hash, entry_key_equal,
+                                              NULL, (GDestroyNotify) entry_free);
+  obj->priv->authorizers = g_hash_table_new (g_direct_hash, g_direct_equal);
+  g_queue_init (&obj->priv->lru);
+  obj->priv->sweep_size = SWEEP_MIN_SIZE;
+}
+
+/* --- Private Functions --- */
+
+/* The references dropped with the mutex locked are collected in @garbage and
+ * released after unlocking it, as the last one runs the node finalizers. */
+static void
+lru_drop_locked (GFBGraphIdentityMapPrivate  *priv,
+                 Entry                       *entry,
+                 GSList                     **garbage)
+{
+  if (entry->strong == NULL)
+    return;
+
+  g_queue_unlink (&priv->lru, &entry->lru_link);
+  *garbage = g_slist_prepend (*garbage, entry->strong);
+  entry->strong = NULL;
+}
+
+static void
+trim_lru_locked (GFBGraphIdentityMapPrivate  *priv,
+                 GSList                     **garbage)
+{
+  while (priv->lru.length > priv->max_size)
+    lru_drop_locked (priv, priv->lru.tail->data, garbage);
+}
+
+static void
+lru_touch_locked (GFBGraphIdentityMapPrivate  *priv,
+                  Entry                       *entry,
+                  GFBGraphNode                *node,
+                  GSList                     **garbage)
+{
+  if (entry->strong != NULL) {
+    g_queue_unlink (&priv->lru, &entry->lru_link);
+  } else {
+    if (priv->max_size == 0)
+      return;
+    entry->strong = g_object_ref (node);
+  }
+
+  g_queue_push_head_link (&priv->lru, &entry->lru_link);
+  trim_lru_locked (priv, garbage);
+}
+
+static gboolean
+entry_is_expired (GFBGraphIdentityMapPrivate *priv,
+                  Entry                      *entry)
+{
+  if (priv->ttl == 0)
+    return FALSE;
+
+  return g_get_monotonic_time () - entry->fetched_time > (gint64) priv->ttl * G_USEC_PER_SEC;
+}
+
+/* Removes the entries whose node was finalized */
+static void
+sweep_locked (GFBGraphIdentityMapPrivate  *priv,
+              GSList                     **garbage)
+{
+  GHashTableIter iter;
+  Entry *entry;
+
+  g_hash_table_iter_init (&iter, priv->entries);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &entry)) {
+    GFBGraphNode *node;
+
+    if (entry->strong != NULL)
+      continue;
+
+    node = g_weak_ref_get (&entry->node);
+    if (node == NULL)
+      g_hash_table_iter_remove (&iter);
+    else
+      *garbage = g_slist_prepend (*garbage, node);
+  }
+
+  priv->sweep_size = MAX (SWEEP_MIN_SIZE, 2 * g_hash_table_size (priv->entries));
+}
+
+/* The nodes of a finalized authorizer can't be requested anymore, and its
+ * address could be reused by a new authorizer */
+static void
+authorizer_finalized_cb (gpointer  data,
+                         GObject  *where_the_object_was)
+{
+  GFBGraphIdentityMapPrivate *priv = GFBGRAPH_IDENTITY_MAP (data)->priv;
+  GHashTableIter iter;
+  GSList *garbage = NULL;
+  Entry *entry;
+
+  g_mutex_lock (&priv->mutex);
+
+  g_hash_table_remove (priv->authorizers, where_the_object_was);
+  g_hash_table_iter_init (&iter, priv->entries);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &entry)) {
+    if (entry->key.authorizer == (GFBGraphAuthorizer *) where_the_object_was) {
+      lru_drop_locked (priv, entry, &garbage);
+      g_hash_table_iter_remove (&iter);
+    }
+  }
+
+  g_mutex_unlock (&priv->mutex);
+
+  g_slist_free_full (garbage, g_object_unref);
+}
+
+/* Returns the alive node of @authorizer with @id, or %NULL. With @check_fields,
+ * the node is only returned if it's of @node_type and was retrieved with @fields. */
+static GFBGraphNode *
+lookup_node (GFBGraphIdentityMap *map,
+             GFBGraphAuthorizer  *authorizer,
+             const gchar         *id,
+             gboolean             check_fields,
+             GType                node_type,
+             const gchar         *fields)
+{
+  GFBGraphIdentityMapPrivate *priv = map->priv;
+  EntryKey key = { authorizer, (gchar *) id };
+  GFBGraphNode *node = NULL;
+  GSList *garbage = NULL;
+  Entry *entry;
+
+  g_mutex_lock (&priv->mutex);
+
+  entry = g_hash_table_lookup (priv->entries, &key);
+  if (entry != NULL) {
+    node = g_weak_ref_get (&entry->node);
+    if (node == NULL) {
+      g_hash_table_remove (priv->entries, &key);
+    } else if (entry_is_expired (priv, entry)) {
+      /* Still the canonical instance, but it's not served anymore */
+      lru_drop_locked (priv, entry, &garbage);
+      garbage = g_slist_prepend (garbage, node);
+      node = NULL;
+    } else if (check_fields && (!entry->fields_known ||
+                                G_OBJECT_TYPE (node) != node_type ||
+                                g_strcmp0 (entry->fields, fields) != 0)) {
+      garbage = g_slist_prepend (garbage, node);
+      node = NULL;
+    } else {
+      lru_touch_locked (priv, entry, node, &garbage);
+    }
+  }
+
+  g_mutex_unlock (&priv->mutex);
+
+  g_slist_free_full (garbage, g_object_unref);
+
+  return node;
+}
+
+static GFBGraphNode *
+add_node (GFBGraphIdentityMap *map,
+          GFBGraphAuthorizer  *authorizer,
+          GFBGraphNode        *node,
+          gboolean             fields_known,
+          const gchar         *fields)
+{
+  GFBGraphIdentityMapPrivate *priv = map->priv;
+  GFBGraphNode *canonical = NULL;
+  gchar id_buffer[GFBGRAPH_NODE_ID_BUFFER_SIZE];
+  GSList *garbage = NULL;
+  EntryKey key;
+  Entry *entry;
+
+  key.authorizer = authorizer;
+  key.id = (gchar *) gfbgraph_node_peek_id (node, id_buffer);
+  if (key.id == NULL || *key.id == '\0')
+    return g_object_ref (node);
+
+  g_mutex_lock (&priv->mutex);
+
+  entry = g_hash_table_lookup (priv->entries, &key);
+  if (entry != NULL)
+    canonical = g_weak_ref_get (&entry->node);
+
+  if (canonical == NULL || G_OBJECT_TYPE (canonical) != G_OBJECT_TYPE (node)) {
+    /* @node becomes the canonical instance of the ID */
+    if (entry == NULL) {
+      if (g_hash_table_size (priv->entries) >= priv->sweep_size)
+        sweep_locked (priv, &garbage);
+
+      entry = g_slice_new0 (Entry);
+      entry->key.authorizer = authorizer;
+      entry->key.id = g_strdup (key.id);
+      entry->lru_link.data = entry;
+      g_weak_ref_init (&entry->node, node);
+      g_hash_table_insert (priv->entries, &entry->key, entry);
+
+      if (authorizer != NULL && g_hash_table_add (priv->authorizers, authorizer))
+        g_object_weak_ref (G_OBJECT (authorizer), authorizer_finalized_cb, map);
+    } else {
+      lru_drop_locked (priv, entry, &garbage);
+      g_weak_ref_set (&entry->node, node);
+    }
+
+    if (canonical != NULL)
+      garbage = g_slist_prepend (garbage, canonical);
+    canonical = g_object_ref (node);
+  }
+
+  entry->fetched_time = g_get_monotonic_time ();
+  entry->fields_known = fields_known;
+  g_free (entry->fields);
+  entry->fields = g_strdup (fields);
+  lru_touch_locked (priv, entry, canonical, &garbage);
+
+  g_mutex_unlock (&priv->mutex);
+
+  /* Merged without the lock of the entries, and the notify signals are only
+   * emitted once the merge lock is released, so their handlers can use the map */
+  if (canonical != node) {
+    g_object_freeze_notify (G_OBJECT (canonical));
+    g_mutex_lock (&priv->merge_mutex);
+    gfbgraph_node_merge (canonical, node);
+    g_mutex_unlock (&priv->merge_mutex);
+    g_object_thaw_notify (G_OBJECT (canonical));
+  }
+
+  g_slist_free_full (garbage, g_object_unref);
+
+  return canonical;
+}
+
+static GFBGraphIdentityMap *
+dup_identity_map (GFBGraphAuthorizer *authorizer)
+{
+  return gfbgraph_context_dup_identity_map (gfbgraph_context_get_for_authorizer (authorizer));
+}
+
+/* --- Internal API --- */
+
+/* Returns the canonical instance of @node, just parsed from a response with
+ * @fields, taking the reference of @node. Without an identity map set in the
+ * context of @authorizer, @node is returned as is. */
+GFBGraphNode *
+gfbgraph_identity_map_canonicalize (GFBGraphAuthorizer *authorizer,
+                                    GFBGraphNode       *node,
+                                    const gchar        *fields)
+{
+  GFBGraphIdentityMap *map;
+  GFBGraphNode *canonical;
+
+  map = dup_identity_map (authorizer);
+  if (map == NULL)
+    return node;
+
+  canonical = add_node (map, authorizer, node, TRUE, fields);
+  g_object_unref (node);
+  g_object_unref (map);
+
+  return canonical;
+}
+
+/* Like gfbgraph_identity_map_canonicalize(), for every node of @nodes */
+void
+gfbgraph_identity_map_canonicalize_array (GFBGraphAuthorizer *authorizer,
+                                          GPtrArray          *nodes,
+                                          const gchar        *fields)
+{
+  GFBGraphIdentityMap *map;
+  guint i;
+
+  if (nodes == NULL)
+    return;
+
+  map = dup_identity_map (authorizer);
+  if (map == NULL)
+    return;
+
+  for (i = 0; i < nodes->len; i++) {
+    GFBGraphNode *node = g_ptr_array_index (nodes, i);
+
+    nodes->pdata[i] = add_node (map, authorizer, node, TRUE, fields);
+    g_object_unref (node);
+  }
+
+  g_object_unref (map);
+}
+
+/* Returns the node with @id retrieved with @fields before its TTL expired, so
+ * it can be returned without a request, or %NULL. */
+GFBGraphNode *
+gfbgraph_identity_map_lookup_fetched (GFBGraphAuthorizer *authorizer,
+                                      const gchar        *id,
+                                      GType               node_type,
+                                      const gchar        *fields)
+{
+  GFBGraphIdentityMap *map;
+  GFBGraphNode *node;
+
+  map = dup_identity_map (authorizer);
+  if (map == NULL)
+    return NULL;
+
+  node = lookup_node (map, authorizer, id, TRUE, node_type, fields);
+  g_object_unref (map);
+
+  return node;
+}
+
+/* --- Public API --- */
+
+/**
+ * gfbgraph_identity_map_new:
+ * @max_size: the maximum number of nodes kept alive by the map.
+ * @ttl: the seconds a node is valid after it was retrieved, or 0 to never expire.
+ *
+ * Creates a new #GFBGraphIdentityMap. Set it in a #GFBGraphContext with
+ * gfbgraph_context_set_identity_map() to use it.
+ *
+ * Returns: (transfer full): a new #GFBGraphIdentityMap; unref with g_object_unref()
+ **/
+GFBGraphIdentityMap *
+gfbgraph_identity_map_new (guint max_size,
+                           guint ttl)
+{
+  return GFBGRAPH_IDENTITY_MAP (g_object_new (GFBGRAPH_TYPE_IDENTITY_MAP,
+                                              "max-size", max_size,
+                                              "ttl", ttl,
+                                              NULL));
+}
+
+/**
+ * gfbgraph_identity_map_get_max_size:
+ * @map: a #GFBGraphIdentityMap.
+ *
+ * Returns: the maximum number of nodes kept alive by @map.
+ **/
+guint
+gfbgraph_identity_map_get_max_size (GFBGraphIdentityMap *map)
+{
+  guint max_size;
+
+  g_return_val_if_fail (GFBGRAPH_IS_IDENTITY_MAP (map), 0);
+
+  g_object_get (G_OBJECT (map),
+                "max-size", &max_size,
+                NULL);
+
+  return max_size;
+}
+
+/**
+ * gfbgraph_identity_map_set_max_size:
+ * @map: a #GFBGraphIdentityMap.
+ * @max_size: the maximum number of nodes kept alive by @map.
+ *
+ * Sets the maximum number of nodes kept alive by @map, releasing the least
+ * recently used ones if there are more.
+ **/
+void
+gfbgraph_identity_map_set_max_size (GFBGraphIdentityMap *map,
+                                    guint                max_size)
+{
+  g_return_if_fail (GFBGRAPH_IS_IDENTITY_MAP (map));
+
+  g_object_set (G_OBJECT (map),
+                "max-size", max_size,
+                NULL);
+}
+
+/**
+ * gfbgraph_identity_map_get_ttl:
+ * @map: a #GFBGraphIdentityMap.
+ *
+ * Returns: the seconds a node of @map is valid after it was retrieved.
+ **/
+guint
+gfbgraph_identity_map_get_ttl (GFBGraphIdentityMap *map)
+{
+  guint ttl;
+
+  g_return_val_if_fail (GFBGRAPH_IS_IDENTITY_MAP (map), 0);
+
+  g_object_get (G_OBJECT (map),
+                "ttl", &ttl,
+                NULL);
+
+  return ttl;
+}
+
+/**
+ * gfbgraph_identity_map_set_ttl:
+ * @map: a #GFBGraphIdentityMap.
+ * @ttl: the seconds a node is valid after it was retrieved, or 0 to never expire.
+ *
+ * Sets the time to live of the nodes of @map.
+ **/
+void
+gfbgraph_identity_map_set_ttl (GFBGraphIdentityMap *map,
+                               guint                ttl)
+{
+  g_return_if_fail (GFBGRAPH_IS_IDENTITY_MAP (map));
+
+  g_object_set (G_OBJECT (map),
+                "ttl", ttl,
+                NULL);
+}
+
+/**
+ * gfbgraph_identity_map_lookup:
+ * @map: a #GFBGraphIdentityMap.
+ * @authorizer: (allow-none): the #GFBGraphAuthorizer the node was retrieved
+ *   with, or %NULL for the nodes added without one.
+ * @id: a node ID.
+ *
+ * Looks up the node of @authorizer with @id. Expired nodes aren't returned.
+ *
+ * Returns: (transfer full) (allow-none): the #GFBGraphNode with @id, or %NULL.
+ **/
+GFBGraphNode *
+gfbgraph_identity_map_lookup (GFBGraphIdentityMap *map,
+                              GFBGraphAuthorizer  *authorizer,
+                              const gchar         *id)
+{
+  g_return_val_if_fail (GFBGRAPH_IS_IDENTITY_MAP (map), NULL);
+  g_return_val_if_fail (authorizer == NULL || GFBGRAPH_IS_AUTHORIZER (authorizer), NULL);
+  g_return_val_if_fail (id != NULL, NULL);
+
+  return lookup_node (map, authorizer, id, FALSE, G_TYPE_INVALID, NULL);
+}
+
+/**
+ * gfbgraph_identity_map_add:
+ * @map: a #GFBGraphIdentityMap.
+ * @authorizer: (allow-none): the #GFBGraphAuthorizer @node was retrieved with, or %NULL.
+ * @node: a #GFBGraphNode with an ID.
+ *
+ * Adds @node to the nodes of @authorizer in @map. If @map already has an alive
+ * node of @authorizer of the same type with the same ID, the properties set in
+ * @node are merged into it with gfbgraph_node_merge() and that node is returned.
+ *
+ * Returns: (transfer full): the node of @map with the ID of @node.
+ **/
+GFBGraphNode *
+gfbgraph_identity_map_add (GFBGraphIdentityMap *map,
+                           GFBGraphAuthorizer  *authorizer,
+                           GFBGraphNode        *node)
+{
+  g_return_val_if_fail (GFBGRAPH_IS_IDENTITY_MAP (map), NULL);
+  g_return_val_if_fail (authorizer == NULL || GFBGRAPH_IS_AUTHORIZER (authorizer), NULL);
+  g_return_val_if_fail (GFBGRAPH_IS_NODE (node), NULL);
+
+  return add_node (map, authorizer, node, FALSE, NULL);
+}
+
+/**
+ * gfbgraph_identity_map_remove:
+ * @map: a #GFBGraphIdentityMap.
+ * @id: a node ID.
+ *
+ * Removes the nodes with @id of every authorizer from @map, so the next
+ * response with it creates a new instance.
+ **/
+void
+gfbgraph_identity_map_remove (GFBGraphIdentityMap *map,
+                              const gchar         *id)
+{
+  GFBGraphIdentityMapPrivate *priv;
+  GHashTableIter iter;
+  GSList *garbage = NULL;
+  Entry *entry;
+
+  g_return_if_fail (GFBGRAPH_IS_IDENTITY_MAP (map));
+  g_return_if_fail (id != NULL);
+
+  priv = map->priv;
+
+  g_mutex_lock (&priv->mutex);
+  g_hash_table_iter_init (&iter, priv->entries);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &entry)) {
+    if (g_str_equal (entry->key.id, id)) {
+      lru_drop_locked (priv, entry, &garbage);
+      g_hash_table_iter_remove (&iter);
+    }
+  }
+  g_mutex_unlock (&priv->mutex);
+
+  g_slist_free_full (garbage, g_object_unref);
+}
+
+/**
+ * gfbgraph_identity_map_clear:
+ * @map: a #GFBGraphIdentityMap.
+ *
+ * Removes all the nodes from @map.
+ **/
+void
+gfbgraph_identity_map_clear (GFBGraphIdentityMap *map)
+{
+  GFBGraphIdentityMapPrivate *priv;
+  GSList *garbage = NULL;
+
+  g_return_if_fail (GFBGRAPH_IS_IDENTITY_MAP (map));
+
+  priv = map->priv;
+
+  g_mutex_lock (&priv->mutex);
+  while (priv->lru.head != NULL)
+    lru_drop_locked (priv, priv->lru.head->data, &garbage);
+  g_hash_table_remove_all (priv->entries);
+  priv->sweep_size = SWEEP_MIN_SIZE;
+  g_mutex_unlock (&priv->mutex);
+
+  g_slist_free_full (garbage, g_object_unref);
+}
+
+/**
+ * gfbgraph_identity_map_get_size:
+ * @map: a #GFBGraphIdentityMap.
+ *
+ * Gets the number of alive nodes in @map, including the ones only referenced
+ * by the application.
+ *
+ * Returns: the number of nodes in @map.
+ **/
+guint
+gfbgraph_identity_map_get_size (GFBGraphIdentityMap *map)
+{
+  GFBGraphIdentityMapPrivate *priv;
+  GSList *garbage = NULL;
+  guint size;
+
+  g_return_val_if_fail (GFBGRAPH_IS_IDENTITY_MAP (map), 0);
+
+  priv = map->priv;
+
+  g_mutex_lock (&priv->mutex);
+  sweep_locked (priv, &garbage);
+  size = g_hash_table_size (priv->entries);
+  g_mutex_unlock (&priv->mutex);
+
+  g_slist_free_full (garbage, g_object_unref);
+
+  return size;
+}
@@ -0,0 +1,83 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 2; tab-width: 2 -*-  */
+/*
+ * libgfbgraph - GObject library for Facebook Graph API
+ * Copyright (C) 2013 Álvaro Peña <alvaropg@gmail.com>
+ *               2020 Leesoo Ahn <yisooan@fedoraproject.org>
+ *
+ * GFBGraph is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GFBGraph is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GFBGraph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GFBGRAPH_IDENTITY_MAP_H__
+#define __GFBGRAPH_IDENTITY_MAP_H__
+
+#include <glib-object.h>
+#include <gfbgraph/gfbgraph-authorizer.h>
+#include <gfbgraph/gfbgraph-node.h>
+
+G_BEGIN_DECLS
+
+#define GFBGRAPH_TYPE_IDENTITY_MAP (gfbgraph_identity_map_get_type())
+#define GFBGRAPH_IDENTITY_MAP(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj),GFBGRAPH_TYPE_IDENTITY_MAP,GFBGraphIdentityMap))
+#define GFBGRAPH_IDENTITY_MAP_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass),GFBGRAPH_TYPE_IDENTITY_MAP,GFBGraphIdentityMapClass))
+#define GFBGRAPH_IS_IDENTITY_MAP(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj),GFBGRAPH_TYPE_IDENTITY_MAP))
+#define GFBGRAPH_IS_IDENTITY_MAP_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass),GFBGRAPH_TYPE_IDENTITY_MAP))
+#define GFBGRAPH_IDENTITY_MAP_GET_CLASS(obj) \
+  (G_TYPE_INSTANCE_GET_CLASS((obj),GFBGRAPH_TYPE_IDENTITY_MAP,GFBGraphIdentityMapClass))
+
+typedef struct _GFBGraphIdentityMap        GFBGraphIdentityMap;
+typedef struct _GFBGraphIdentityMapClass   GFBGraphIdentityMapClass;
+typedef struct _GFBGraphIdentityMapPrivate GFBGraphIdentityMapPrivate;
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (GFBGraphIdentityMap, g_object_unref)
+
+struct _GFBGraphIdentityMap {
+  GObject parent;
+
+  /*< private >*/
+  GFBGraphIdentityMapPrivate *priv;
+};
+
+struct _GFBGraphIdentityMapClass {
+  GObjectClass parent_class;
+};
+
+GType                gfbgraph_identity_map_get_type     (void) G_GNUC_CONST;
+GFBGraphIdentityMap* gfbgraph_identity_map_new          (guint                max_size,
+                                                         guint                ttl);
+
+guint                gfbgraph_identity_map_get_max_size (GFBGraphIdentityMap *map);
+void                 gfbgraph_identity_map_set_max_size (GFBGraphIdentityMap *map,
+                                                         guint                max_size);
+guint                gfbgraph_identity_map_get_ttl      (GFBGraphIdentityMap *map);
+void                 gfbgraph_identity_map_set_ttl      (GFBGraphIdentityMap *map,
+                                                         guint                ttl);
+
+GFBGraphNode*        gfbgraph_identity_map_lookup       (GFBGraphIdentityMap *map,
+                                                         GFBGraphAuthorizer  *authorizer,
+                                                         const gchar         *id);
+GFBGraphNode*        gfbgraph_identity_map_add          (GFBGraphIdentityMap *map,
+                                                         GFBGraphAuthorizer  *authorizer,
+                                                         GFBGraphNode        *node);
+void                 gfbgraph_identity_map_remove       (GFBGraphIdentityMap *map,
+                                                         const gchar         *id);
+void                 gfbgraph_identity_map_clear        (GFBGraphIdentityMap *map);
+guint                gfbgraph_identity_map_get_size     (GFBGraphIdentityMap *map);
+
+G_END_DECLS
+
+#endif /* __GFBGRAPH_IDENTITY_MAP_H__ */
@@ -0,0 +1,281 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 2; tab-width: 2 -*-  */
+/*
+ * libgfbgraph - GObject library for Facebook Graph API
+ * Copyright (C) 2013-2015 Álvaro Peña <alvaropg@gmail.com>
+ *               2020 Leesoo Ahn <yisooan@fedoraproject.org>
+ *
+ * GFBGraph is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GFBGraph is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GFBGraph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Minimal JSON scanner used to walk the responses of the Graph API without
+ * building the whole tree. It only finds the boundaries of the members and
+ * elements; every slice is parsed (and so validated) later by JsonParser. */
+
+#include <string.h>
+#include <json-glib/json-glib.h>
+
+#include "gfbgraph-private.h"
+
+#define IS_JSON_SPACE(c) ((c) == ' ' || (c) == '\t' || (c) == '\n' || (c) == '\r')
+
+static const gchar *
+skip_spaces (const gchar *p,
+             const gchar *end)
+{
+  while (p < end && IS_JSON_SPACE (*p))
+    p++;
+
+  return p;
+}
+
+/* @p points to the opening quote. Returns the position after the closing one,
+ * or %NULL if the string isn't terminated. */
+static const gchar *
+skip_string (const gchar *p,
+             const gchar *end)
+{
+  for (p++; p < end; p++) {
+    if (*p == '\\')
+      p++;
+    else if (*p == '"')
+      return p + 1;
+  }
+
+  return NULL;
+}
+
+/* Returns the position after the value starting at @p, or %NULL if it's truncated */
+static const gchar *
+skip_value (const gchar *p,
+            const gchar *end)
+{
+  gint depth = 0;
+
+  if (p >= end)
+    return NULL;
+
+  if (*p == '"')
+    return skip_string (p, end);
+
+  if (*p != '{' && *p != '[') {
+    while (p < end && *p != ',' && *p != '}' && *p != ']' && !IS_JSON_SPACE (*p))
+      p++;
+    return p;
+  }
+
+  while (p < end) {
+    switch (*p) {
+      case '"':
+        p = skip_string (p, end);
+        if (p == NULL)
+          return NULL;
+        continue;
+      case '{':
+      case '[':
+        depth++;
+        break;
+      case '}':
+      case ']':
+        if (--depth == 0)
+          return p + 1;
+        break;
+      default:
+        break;
+    }
+    p++;
+  }
+
+  return NULL;
+}
+
+static gboolean
+foreach_child (const gchar            *json,
+               gssize                  length,
+               gboolean                is_object,
+               GFBGraphJsonSliceFunc   func,
+               gpointer                user_data,
+               GError                **error)
+{
+  const gchar *p, *end;
+  gchar open_char, close_char;
+
+  if (length < 0)
+    length = strlen (json);
+
+  end = json + length;
+  open_char = is_object ? '{' : '[';
+  close_char = is_object ? '}' : ']';
+
+  p = skip_spaces (json, end);
+  if (p == end || *p != open_char)
+    goto invalid;
+
+  p = skip_spaces (p + 1, end);
+  if (p < end && *p == close_char)
+    return TRUE;
+
+  while (p < end) {
+    const gchar *name = NULL;
+    const gchar *value;
+    gsize name_length = 0;
+    GError *func_error = NULL;
+
+    if (is_object) {
+      const gchar *name_end;
+
+      if (*p != '"')
+        goto invalid;
+      name_end = skip_string (p, end);
+      if (name_end == NULL)
+        goto invalid;
+      name = p + 1;
+      name_length = name_end - name - 1;
+
+      p = skip_spaces (name_end, end);
+      if (p == end || *p != ':')
+        goto invalid;
+      p = skip_spaces (p + 1, end);
+    }
+
+    value = p;
+    p = skip_value (value, end);
+    if (p == NULL || p == value)
+      goto invalid;
+
+    if (!func (name, name_length, value, p - value, user_data, &func_error)) {
+      if (func_error != NULL) {
+        g_propagate_error (error, func_error);
+        return FALSE;
+      }
+      return TRUE;
+    }
+
+    p = skip_spaces (p, end);
+    if (p == end)
+      break;
+    if (*p == close_char)
+      return TRUE;
+    if (*p != ',')
+      break;
+    p = skip_spaces (p + 1, end);
+  }
+
+invalid:
+  g_set_error (error, JSON_PARSER_ERROR, JSON_PARSER_ERROR_INVALID_DATA,
+               "Invalid JSON data at offset %" G_GSIZE_FORMAT,
+               (gsize) (MIN (p, end) - json));
+  return FALSE;
+}
+
+/* Calls @func with the name and the raw value of every member of the JSON object
+ * in @json, until it returns %FALSE. If @func sets an error the iteration fails. */
+gboolean
+gfbgraph_json_foreach_member (const gchar            *json,
+                              gssize                  length,
+                              GFBGraphJsonSliceFunc   func,
+                              gpointer                user_data,
+                              GError                **error)
+{
+  return foreach_child (json, length, TRUE, func, user_data, error);
+}
+
+/* Like gfbgraph_json_foreach_member(), but for the elements of a JSON array.
+ * The name passed to @func is always %NULL. */
+gboolean
+gfbgraph_json_foreach_element (const gchar            *json,
+                               gssize                  length,
+                               GFBGraphJsonSliceFunc   func,
+                               gpointer                user_data,
+                               GError                **error)
+{
+  return foreach_child (json, length, FALSE, func, user_data, error);
+}
+
+typedef struct {
+  const gchar *member_name;
+  gsize        member_name_length;
+  const gchar *value;
+  gsize        value_length;
+} FindMemberData;
+
+static gboolean
+find_member (const gchar  *name,
+             gsize         name_length,
+             const gchar  *value,
+             gsize         value_length,
+             gpointer      user_data,
+             GError      **error)
+{
+  FindMemberData *data = user_data;
+
+  if (name_length != data->member_name_length
+      || memcmp (name, data->member_name, name_length) != 0)
+    return TRUE;
+
+  data->value = value;
+  data->value_length = value_length;
+
+  return FALSE;
+}
+
+/* Looks for @member_name in the JSON object in @json. Returns %TRUE and the
+ * raw value in @value and @value_length if it's found. */
+gboolean
+gfbgraph_json_get_member (const gchar  *json,
+                          gssize        length,
+                          const gchar  *member_name,
+                          const gchar **value,
+                          gsize        *value_length,
+                          GError      **error)
+{
+  FindMemberData data;
+
+  data.member_name = member_name;
+  data.member_name_length = strlen (member_name);
+  data.value = NULL;
+  data.value_length = 0;
+
+  if (!gfbgraph_json_foreach_member (json, length, find_member, &data, error))
+    return FALSE;
+
+  *value = data.value;
+  *value_length = data.value_length;
+
+  return data.value != NULL;
+}
+
+static gboolean
+count_element (const gchar  *name,
+               gsize         name_length,
+               const gchar  *value,
+               gsize         value_length,
+               gpointer      user_data,
+               GError      **error)
+{
+  (*(guint *) user_data)++;
+
+  return TRUE;
+}
+
+/* Returns the number of elements of the JSON array in @json without parsing them */
+guint
+gfbgraph_json_count_elements (const gchar *json,
+                              gssize       length)
+{
+  guint n_elements = 0;
+
+  gfbgraph_json_foreach_element (json, length, count_element, &n_elements, NULL);
+
+  return n_elements;
+}
@@ -38,7 +38,9 @@
 
 #include "gfbgraph-common.h"
 #include "gfbgraph-connectable.h"
+#include "gfbgraph-field-set.h"
 #include "gfbgraph-node.h"
+#include "gfbgraph-private.h"
 
 enum
 {
@@ -49,20 +51,68 @@ enum
   PROP_UPDATEDTIME
 };
 
+/* Most of the nodes have numeric IDs and links built from them, and the
+ * timestamps of the Graph API always have the same format, so they're stored
+ * as numbers and only formatted (once) when asked for their strings.
+ *
+ * The getters return the strings without a copy, and a node of an identity
+ * map can be merged in another thread meanwhile, so the strings replaced are
+ * kept in @retired until the node is finalized instead of being freed. */
 struct _GFBGraphNodePrivate {
   GList *connections;
-  gchar *id;
-  gchar *link;
-  gchar *created_time;
-  gchar *updated_time;
+  guint64 numeric_id;           /* 0 if the ID isn't a plain number */
+  guint64 link_id;              /* 0 if the link isn't LINK_PREFIX and a number */
+  gint64 created_time;          /* Microseconds since the epoch, 0 if unknown */
+  gint64 updated_time;
+  gchar *id;                    /* Formatted on demand for the numeric IDs */
+  gchar *link;                  /* Formatted on demand from link_id */
+  gchar *created_time_string;   /* Formatted on demand, or kept if not in the */
+  gchar *updated_time_string;   /* Graph API format */
+  GFBGraphStringArena *arena;   /* Response arena holding some of the strings */
+  GSList *retired;              /* Replaced strings, out of the arena */
 };
 
 typedef struct {
-  GList *list;
-  GType node_type;
+  const GFBGraphConnectionInfo *info;
   GFBGraphAuthorizer *authorizer;
+  gchar *fields;
+  gboolean as_list;   /* Return a GList instead of a GPtrArray */
 } GFBGraphNodeConnectionAsyncData;
 
+typedef struct {
+  GFBGraphAuthorizer *authorizer;
+  const gchar *fields;
+  GFBGraphNodeFunc func;
+  gpointer user_data;
+} GFBGraphNodeForeachData;
+
+typedef struct {
+  gchar **ids;
+  GType node_type;
+  gchar *fields;
+  GHashTable *nodes;
+  GHashTable *errors;
+  guint pending;   /* Batch requests in flight */
+  guint n_batches;
+  guint n_failed;  /* Batch requests failed as a whole */
+  GError *error;   /* Error of the first failed batch */
+} GFBGraphNodeBatchAsyncData;
+
+typedef struct {
+  GTask *task;
+  guint first;
+  guint n_ids;
+} GFBGraphNodeBatchCallData;
+
+#define LINK_PREFIX "https://www.facebook.com/"
+
+/* Format of the timestamps returned by the Graph API */
+#define GRAPH_TIME_FORMAT "%Y-%m-%dT%H:%M:%S+0000"
+#define GRAPH_TIME_LENGTH 24
+
+/* Maximum number of requests allowed by the Graph API in a single batch */
+#define GRAPH_BATCH_MAX_SIZE 50
+
 #define GFBGRAPH_NODE_GET_PRIVATE(o) \
   (G_TYPE_INSTANCE_GET_PRIVATE((o), GFBGRAPH_TYPE_NODE, GFBGraphNodePrivate))
 
@@ -70,23 +120,166 @@ static GObjectClass *parent_class = NULL;
 
 G_DEFINE_TYPE (GFBGraphNode, gfbgraph_node, G_TYPE_OBJECT);
 
+static G_DEFINE_QUARK (gfbgraph-node-merge-func, merge_func);
+
 GQuark
 gfbgraph_node_error_quark (void)
 {
   return g_quark_from_static_string ("gfbgraph-node-error-quark");
 }
 
+/* Returns the value of @str if it's a plain decimal number that fits in
+ * 64 bits and is formatted back the same way, 0 otherwise */
+static guint64
+parse_numeric_id (const gchar *str)
+{
+  guint64 value = 0;
+  const gchar *p;
+
+  if (str == NULL || *str < '1' || *str > '9')
+    return 0;
+
+  for (p = str; *p != '\0'; p++) {
+    guint digit;
+
+    if (*p < '0' || *p > '9')
+      return 0;
+
+    digit = *p - '0';
+    if (value > (G_MAXUINT64 - digit) / 10)
+      return 0;
+    value = value * 10 + digit;
+  }
+
+  return value;
+}
+
+static gchar *
+format_time (gint64 time)
+{
+  GDateTime *date_time;
+  gchar *str;
+
+  date_time = g_date_time_new_from_unix_utc (time / G_USEC_PER_SEC);
+  if (date_time == NULL)
+    return NULL;
+
+  str = g_date_time_format (date_time, GRAPH_TIME_FORMAT);
+  g_date_time_unref (date_time);
+
+  return str;
+}
+
+/* Parses an ISO 8601 encoded date, in UTC if it has no time zone, returning
+ * 0 if invalid */
+static gint64
+parse_time (const gchar *str)
+{
+  GDateTime *date_time;
+  GTimeZone *utc;
+  gint64 time;
+
+  if (str == NULL)
+    return 0;
+
+  utc = g_time_zone_new_utc ();
+  date_time = g_date_time_new_from_iso8601 (str, utc);
+  g_time_zone_unref (utc);
+  if (date_time == NULL)
+    return 0;
+
+  time = g_date_time_to_unix (date_time) * G_USEC_PER_SEC + g_date_time_get_microsecond (date_time);
+  g_date_time_unref (date_time);
+
+  return time;
+}
+
+/* Stores the formatted string in @field unless another thread did it first */
+static const gchar *
+cache_string (gchar **field,
+              gchar  *str)
+{
+  if (!g_atomic_pointer_compare_and_exchange (field, NULL, str))
+    g_free (str);
+
+  return g_atomic_pointer_get (field);
+}
+
+static void
+set_id (GFBGraphNode *node,
+        const gchar  *id)
+{
+  GFBGraphNodePrivate *priv = node->priv;
+  guint64 numeric_id;
+
+  /* The same ID keeps the string formatted for it */
+  numeric_id = parse_numeric_id (id);
+  if (numeric_id != 0 && numeric_id == priv->numeric_id)
+    return;
+
+  priv->numeric_id = numeric_id;
+  if (priv->numeric_id != 0)
+    gfbgraph_node_clear_string (node, &priv->id);
+  else
+    gfbgraph_node_set_string (node, &priv->id, id);
+}
+
+static void
+set_link (GFBGraphNode *node,
+          const gchar  *link)
+{
+  GFBGraphNodePrivate *priv = node->priv;
+  guint64 link_id = 0;
+
+  if (link != NULL && g_str_has_prefix (link, LINK_PREFIX))
+    link_id = parse_numeric_id (link + strlen (LINK_PREFIX));
+  if (link_id != 0 && link_id == priv->link_id)
+    return;
+
+  priv->link_id = link_id;
+  if (priv->link_id != 0)
+    gfbgraph_node_clear_string (node, &priv->link);
+  else
+    gfbgraph_node_set_string (node, &priv->link, link);
+}
+
+/* The string is only kept if it wouldn't be formatted back the same way */
+static void
+set_time (GFBGraphNode  *node,
+          gint64        *time,
+          gchar        **time_string,
+          const gchar   *value)
+{
+  gint64 new_time;
+
+  new_time = parse_time (value);
+  if (new_time != 0 && new_time % G_USEC_PER_SEC == 0
+      && strlen (value) == GRAPH_TIME_LENGTH && g_str_has_suffix (value, "+0000")) {
+    /* The same time keeps the string formatted for it */
+    if (new_time != *time) {
+      *time = new_time;
+      gfbgraph_node_clear_string (node, time_string);
+    }
+  } else {
+    *time = new_time;
+    gfbgraph_node_set_string (node, time_string, value);
+  }
+}
+
 static void
 gfbgraph_node_finalize (GObject *object)
 {
   GFBGraphNodePrivate *priv = GFBGRAPH_NODE_GET_PRIVATE (object);
+  GFBGraphNode *node = GFBGRAPH_NODE (object);
 
-  if (priv->id)
-    g_free (priv->id);
-  if (priv->link)
-    g_free (priv->link);
-  if (priv->created_time)
-    g_free (priv->created_time);
+  gfbgraph_node_clear_string (node, &priv->id);
+  gfbgraph_node_clear_string (node, &priv->link);
+  gfbgraph_node_clear_string (node, &priv->created_time_string);
+  gfbgraph_node_clear_string (node, &priv->updated_time_string);
+  /* The subclasses have already released their strings */
+  g_slist_free_full (priv->retired, g_free);
+  if (priv->arena != NULL)
+    gfbgraph_string_arena_unref (priv->arena);
 
   G_OBJECT_CLASS(parent_class)->finalize (object);
 }
@@ -98,27 +291,20 @@ gfbgraph_node_set_property (GObject      *object,
                             GParamSpec   *pspec)
 {
   GFBGraphNodePrivate *priv = GFBGRAPH_NODE_GET_PRIVATE (object);
+  GFBGraphNode *node = GFBGRAPH_NODE (object);
 
   switch (prop_id) {
     case PROP_ID:
-      if (priv->id)
-        g_free (priv->id);
-      priv->id = g_strdup (g_value_get_string (value));
+      set_id (node, g_value_get_string (value));
       break;
     case PROP_LINK:
-      if (priv->link)
-        g_free (priv->link);
-      priv->link = g_strdup (g_value_get_string (value));
+      set_link (node, g_value_get_string (value));
       break;
     case PROP_CREATEDTIME:
-      if (priv->created_time)
-        g_free (priv->created_time);
-      priv->created_time = g_strdup (g_value_get_string (value));
+      set_time (node, &priv->created_time, &priv->created_time_string, g_value_get_string (value));
       break;
     case PROP_UPDATEDTIME:
-      if (priv->updated_time)
-        g_free (priv->updated_time);
-      priv->updated_time = g_strdup (g_value_get_string (value));
+      set_time (node, &priv->updated_time, &priv->updated_time_string, g_value_get_string (value));
       break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
@@ -134,18 +320,31 @@ gfbgraph_node_get_property (GObject    *object,
 {
   GFBGraphNodePrivate *priv = GFBGRAPH_NODE_GET_PRIVATE (object);
 
+  /* Formatted without keeping them in the node, the getters do it */
   switch (prop_id) {
     case PROP_ID:
-      g_value_set_string (value, priv->id);
+      if (priv->id == NULL && priv->numeric_id != 0)
+        g_value_take_string (value, g_strdup_printf ("%" G_GUINT64_FORMAT, priv->numeric_id));
+      else
+        g_value_set_string (value, priv->id);
       break;
     case PROP_LINK:
-      g_value_set_string (value, priv->link);
+      if (priv->link == NULL && priv->link_id != 0)
+        g_value_take_string (value, g_strdup_printf (LINK_PREFIX "%" G_GUINT64_FORMAT, priv->link_id));
+      else
+        g_value_set_string (value, priv->link);
       break;
     case PROP_CREATEDTIME:
-      g_value_set_string (value, priv->created_time);
+      if (priv->created_time_string == NULL && priv->created_time != 0)
+        g_value_take_string (value, format_time (priv->created_time));
+      else
+        g_value_set_string (value, priv->created_time_string);
       break;
     case PROP_UPDATEDTIME:
-      g_value_set_string (value, priv->updated_time);
+      if (priv->updated_time_string == NULL && priv->updated_time != 0)
+        g_value_take_string (value, format_time (priv->updated_time));
+      else
+        g_value_set_string (value, priv->updated_time_string);
       break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
@@ -153,6 +352,38 @@ gfbgraph_node_get_property (GObject    *object,
   }
 }
 
+/* Copies the writable properties set in @source, that is, the ones which
+ * don't hold its default value. The pointer properties can't be copied, so
+ * the types having them move them in a merge function, see
+ * gfbgraph_node_type_set_merge_func(). */
+static void
+merge_properties (GFBGraphNode *node,
+                  GFBGraphNode *source)
+{
+  GParamSpec **pspecs;
+  guint i, n_pspecs;
+
+  pspecs = g_object_class_list_properties (G_OBJECT_GET_CLASS (node), &n_pspecs);
+  for (i = 0; i < n_pspecs; i++) {
+    GParamSpec *pspec = pspecs[i];
+    GValue value = G_VALUE_INIT;
+
+    if ((pspec->flags & G_PARAM_READWRITE) != G_PARAM_READWRITE
+        || (pspec->flags & G_PARAM_CONSTRUCT_ONLY)
+        || G_TYPE_FUNDAMENTAL (pspec->value_type) == G_TYPE_POINTER)
+      continue;
+
+    g_value_init (&value, pspec->value_type);
+    g_object_get_property (G_OBJECT (source), pspec->name, &value);
+    if (!g_param_value_defaults (pspec, &value)
+        && !(G_VALUE_HOLDS_STRING (&value) && g_value_get_string (&value) == NULL))
+      g_object_set_property (G_OBJECT (node), pspec->name, &value);
+    g_value_unset (&value);
+  }
+
+  g_free (pspecs);
+}
+
 static void
 gfbgraph_node_class_init (GFBGraphNodeClass *klass)
 {
@@ -226,32 +457,591 @@ gfbgraph_node_init (GFBGraphNode *obj)
 }
 
 /* --- Private Functions --- */
+/* Creates the call to retrieve the @node_type nodes connected to @node. The
+ * resolved connection, used to parse the response, is returned in @info. */
+static RestProxyCall *
+new_connection_call (GFBGraphNode                  *node,
+                     GType                          node_type,
+                     GFBGraphAuthorizer            *authorizer,
+                     GFBGraphFieldSet              *fields,
+                     const GFBGraphConnectionInfo **info,
+                     GError                       **error)
+{
+  gchar id_buffer[GFBGRAPH_NODE_ID_BUFFER_SIZE];
+  RestProxyCall *rest_call;
+  gchar *function_path;
+
+  *info = gfbgraph_connection_info_lookup (G_OBJECT_TYPE (node), node_type, error);
+  if (*info == NULL)
+    return NULL;
+
+  rest_call = gfbgraph_new_rest_call (authorizer);
+  rest_proxy_call_set_method (rest_call, "GET");
+  function_path = g_strdup_printf ("%s/%s", gfbgraph_node_peek_id (node, id_buffer), (*info)->path);
+  rest_proxy_call_set_function (rest_call, function_path);
+  g_free (function_path);
+  if (fields != NULL)
+    rest_proxy_call_add_param (rest_call, "fields", gfbgraph_field_set_to_string (fields));
+
+  return rest_call;
+}
+
+static const gchar *
+fields_to_string (GFBGraphFieldSet *fields)
+{
+  return fields != NULL ? gfbgraph_field_set_to_string (fields) : NULL;
+}
+
+/* A GFBGraphCallParseFunc, so the concurrent callers share the same node */
+static gpointer
+parse_node_payload (RestProxyCall  *call,
+                    GType           node_type,
+                    GBytes         *payload,
+                    GError        **error)
+{
+  GFBGraphNode *node = NULL;
+  GFBGraphStringArena *arena;
+  JsonParser *jparser;
+  JsonNode *jnode;
+  RestParam *fields_param;
+
+  jparser = json_parser_new ();
+  if (json_parser_load_from_data (jparser,
+                                  g_bytes_get_data (payload, NULL),
+                                  g_bytes_get_size (payload),
+                                  error)) {
+    jnode = json_parser_get_root (jparser);
+    arena = gfbgraph_string_arena_new ();
+    node = gfbgraph_node_deserialize (node_type, jnode, arena);
+    gfbgraph_string_arena_unref (arena);
+
+    fields_param = rest_proxy_call_lookup_param (call, "fields");
+    node = gfbgraph_identity_map_canonicalize (gfbgraph_call_get_authorizer (call),
+                                               node,
+                                               fields_param != NULL ?
+                                               rest_param_get_content (fields_param) : NULL);
+    if (node == NULL)
+      g_set_error (error,
+                   GFBGRAPH_NODE_ERROR,
+                   GFBGRAPH_NODE_ERROR_REQUEST_FAILED,
+                   "Unable to parse the node");
+  }
+  g_object_unref (jparser);
+
+  return node;
+}
+
 static void
 connection_async_data_free (GFBGraphNodeConnectionAsyncData *data)
 {
-  g_list_free (data->list);
   g_object_unref (data->authorizer);
-
+  g_free (data->fields);
   g_slice_free (GFBGraphNodeConnectionAsyncData, data);
 }
 
 static void
-get_connection_nodes_async_thread (GSimpleAsyncResult *simple_async,
-                                   GFBGraphNode       *node,
-                                   GCancellable        cancellable)
+free_nodes_list (GList *nodes)
+{
+  g_list_free_full (nodes, g_object_unref);
+}
+
+static void
+connection_call_cb (GObject      *source_object,
+                    GAsyncResult *result,
+                    gpointer      user_data)
 {
+  GTask *task = G_TASK (user_data);
   GFBGraphNodeConnectionAsyncData *data;
+  GPtrArray *nodes = NULL;
+  GBytes *payload;
   GError *error = NULL;
 
-  data = (GFBGraphNodeConnectionAsyncData *)g_simple_async_result_get_op_res_gpointer (simple_async);
-  data->list = gfbgraph_node_get_connection_nodes (node,
-                                                   data->node_type,
-                                                   data->authorizer,
-                                                   &error);
+  data = g_task_get_task_data (task);
+
+  payload = gfbgraph_call_finish (REST_PROXY_CALL (source_object), result, &error);
+  if (payload != NULL) {
+    nodes = gfbgraph_connection_info_parse_array (data->info,
+                                                  g_bytes_get_data (payload, NULL),
+                                                  g_bytes_get_size (payload),
+                                                  &error);
+    gfbgraph_identity_map_canonicalize_array (data->authorizer, nodes, data->fields);
+    g_bytes_unref (payload);
+  }
+
   if (error != NULL)
-    g_simple_async_result_take_error (simple_async, error);
+    g_task_return_error (task, error);
+  else if (data->as_list)
+    g_task_return_pointer (task, gfbgraph_nodes_array_to_list (nodes), (GDestroyNotify) free_nodes_list);
+  else
+    g_task_return_pointer (task, nodes, (GDestroyNotify) g_ptr_array_unref);
+
+  g_object_unref (task);
 }
 
+/* Common implementation of the asynchronous connection requests. They are sent
+ * with gfbgraph_call_async(), so no thread is blocked while waiting. */
+static void
+get_connection_nodes_async (GFBGraphNode        *node,
+                            GType                node_type,
+                            GFBGraphAuthorizer  *authorizer,
+                            GFBGraphFieldSet    *fields,
+                            gboolean             as_list,
+                            gpointer             source_tag,
+                            GCancellable        *cancellable,
+                            GAsyncReadyCallback  callback,
+                            gpointer             user_data)
+{
+  GFBGraphNodeConnectionAsyncData *data;
+  RestProxyCall *rest_call;
+  GTask *task;
+  GError *error = NULL;
+
+  task = g_task_new (node, cancellable, callback, user_data);
+  g_task_set_source_tag (task, source_tag);
+
+  data = g_slice_new (GFBGraphNodeConnectionAsyncData);
+  data->authorizer = g_object_ref (authorizer);
+  data->fields = g_strdup (fields_to_string (fields));
+  data->as_list = as_list;
+  g_task_set_task_data (task, data, (GDestroyNotify) connection_async_data_free);
+
+  rest_call = new_connection_call (node, node_type, authorizer, fields, &data->info, &error);
+  if (rest_call == NULL) {
+    g_task_return_error (task, error);
+    g_object_unref (task);
+    return;
+  }
+
+  /* The reference of the task is released in connection_call_cb() */
+  gfbgraph_call_async (rest_call, cancellable, connection_call_cb, task);
+  g_object_unref (rest_call);
+}
+
+/* Passes the canonical instance of every node to the function of the caller */
+static gboolean
+foreach_canonical_func (GFBGraphNode *node,
+                        gpointer      user_data)
+{
+  GFBGraphNodeForeachData *data = user_data;
+  GFBGraphNode *canonical;
+  gboolean result;
+
+  canonical = gfbgraph_identity_map_canonicalize (data->authorizer, g_object_ref (node), data->fields);
+  result = data->func (canonical, data->user_data);
+  g_object_unref (canonical);
+
+  return result;
+}
+
+static void
+batch_async_data_free (GFBGraphNodeBatchAsyncData *data)
+{
+  g_strfreev (data->ids);
+  g_free (data->fields);
+  if (data->nodes)
+    g_hash_table_unref (data->nodes);
+  if (data->errors)
+    g_hash_table_unref (data->errors);
+  g_clear_error (&data->error);
+
+  g_slice_free (GFBGraphNodeBatchAsyncData, data);
+}
+
+static gchar *
+build_batch_param (const gchar * const *ids,
+                   guint                n_ids,
+                   GFBGraphFieldSet    *fields)
+{
+  JsonBuilder *builder;
+  JsonGenerator *generator;
+  JsonNode *root;
+  gchar *escaped_id;
+  gchar *batch;
+  guint i;
+
+  builder = json_builder_new ();
+  json_builder_begin_array (builder);
+  for (i = 0; i < n_ids; i++) {
+    json_builder_begin_object (builder);
+    json_builder_set_member_name (builder, "method");
+    json_builder_add_string_value (builder, "GET");
+    json_builder_set_member_name (builder, "relative_url");
+    escaped_id = g_uri_escape_string (ids[i], NULL, FALSE);
+    if (fields != NULL) {
+      gchar *escaped_fields;
+      gchar *relative_url;
+
+      /* The field expansions have braces and commas */
+      escaped_fields = g_uri_escape_string (gfbgraph_field_set_to_string (fields), NULL, FALSE);
+      relative_url = g_strdup_printf ("%s?fields=%s", escaped_id, escaped_fields);
+      json_builder_add_string_value (builder, relative_url);
+      g_free (relative_url);
+      g_free (escaped_fields);
+    } else {
+      json_builder_add_string_value (builder, escaped_id);
+    }
+    g_free (escaped_id);
+    json_builder_end_object (builder);
+  }
+  json_builder_end_array (builder);
+
+  root = json_builder_get_root (builder);
+  generator = json_generator_new ();
+  json_generator_set_root (generator, root);
+  batch = json_generator_to_data (generator, NULL);
+
+  json_node_free (root);
+  g_object_unref (generator);
+  g_object_unref (builder);
+
+  return batch;
+}
+
+/* Parses one of the responses of a batch request, returning the node or
+ * setting @error with the message sent by the Graph API. */
+static GFBGraphNode *
+parse_batch_response (JsonParser           *jparser,
+                      JsonNode             *response_jnode,
+                      const gchar          *id,
+                      GType                 node_type,
+                      GFBGraphStringArena  *arena,
+                      GError              **error)
+{
+  JsonObject *response;
+  const gchar *body = NULL;
+  gint64 code = 0;
+
+  if (response_jnode == NULL || !JSON_NODE_HOLDS_OBJECT (response_jnode)) {
+    g_set_error (error, GFBGRAPH_NODE_ERROR,
+                 GFBGRAPH_NODE_ERROR_REQUEST_FAILED,
+                 "No response received for the node %s", id);
+    return NULL;
+  }
+
+  response = json_node_get_object (response_jnode);
+  if (json_object_has_member (response, "code"))
+    code = json_object_get_int_member (response, "code");
+  if (json_object_has_member (response, "body"))
+    body = json_object_get_string_member (response, "body");
+
+  if (body == NULL || !json_parser_load_from_data (jparser, body, -1, NULL)) {
+    g_set_error (error, GFBGRAPH_NODE_ERROR,
+                 GFBGRAPH_NODE_ERROR_REQUEST_FAILED,
+                 "Invalid response (HTTP %" G_GINT64_FORMAT ") for the node %s", code, id);
+    return NULL;
+  }
+
+  if (code != 200) {
+    JsonNode *body_jnode;
+    JsonObject *body_jobject = NULL;
+    const gchar *message = NULL;
+
+    body_jnode = json_parser_get_root (jparser);
+    if (JSON_NODE_HOLDS_OBJECT (body_jnode))
+      body_jobject = json_node_get_object (body_jnode);
+    if (body_jobject != NULL && json_object_has_member (body_jobject, "error")) {
+      JsonObject *error_jobject;
+
+      error_jobject = json_object_get_object_member (body_jobject, "error");
+      if (error_jobject != NULL && json_object_has_member (error_jobject, "message"))
+        message = json_object_get_string_member (error_jobject, "message");
+    }
+
+    g_set_error (error, GFBGRAPH_NODE_ERROR,
+                 GFBGRAPH_NODE_ERROR_REQUEST_FAILED,
+                 "Error retrieving the node %s (HTTP %" G_GINT64_FORMAT "): %s",
+                 id, code, message ? message : "unknown error");
+    return NULL;
+  }
+
+  return gfbgraph_node_deserialize (node_type, json_parser_get_root (jparser), arena);
+}
+
+static RestProxyCall *
+new_batch_call (GFBGraphAuthorizer   *authorizer,
+                const gchar * const  *ids,
+                guint                 n_ids,
+                GFBGraphFieldSet     *fields)
+{
+  RestProxyCall *rest_call;
+  gchar *batch;
+
+  rest_call = gfbgraph_new_rest_call (authorizer);
+  rest_proxy_call_set_method (rest_call, "POST");
+  batch = build_batch_param (ids, n_ids, fields);
+  rest_proxy_call_add_param (rest_call, "batch", batch);
+  rest_proxy_call_add_param (rest_call, "include_headers", "false");
+  g_free (batch);
+
+  return rest_call;
+}
+
+static gboolean
+parse_batch_payload (GBytes               *payload,
+                     GFBGraphAuthorizer   *authorizer,
+                     const gchar * const  *ids,
+                     guint                 n_ids,
+                     GType                 node_type,
+                     const gchar          *fields,
+                     GHashTable           *nodes,
+                     GHashTable           *errors,
+                     GError              **error)
+{
+  JsonParser *jparser;
+  gboolean success = FALSE;
+
+  jparser = json_parser_new ();
+  if (json_parser_load_from_data (jparser,
+                                  g_bytes_get_data (payload, NULL),
+                                  g_bytes_get_size (payload),
+                                  error)) {
+    JsonNode *root_jnode;
+
+    root_jnode = json_parser_get_root (jparser);
+    if (JSON_NODE_HOLDS_ARRAY (root_jnode)) {
+      GFBGraphStringArena *arena;
+      JsonArray *responses_jarray;
+      JsonParser *body_jparser;
+      guint i, n_responses;
+
+      responses_jarray = json_node_get_array (root_jnode);
+      n_responses = json_array_get_length (responses_jarray);
+      body_jparser = json_parser_new ();
+      arena = gfbgraph_string_arena_new ();
+
+      /* The responses come in the same order than the requests, a null
+       * response means the request timed out in the server. */
+      for (i = 0; i < n_ids; i++) {
+        GFBGraphNode *node;
+        GError *node_error = NULL;
+
+        node = parse_batch_response (body_jparser,
+                                     i < n_responses ? json_array_get_element (responses_jarray, i) : NULL,
+                                     ids[i],
+                                     node_type,
+                                     arena,
+                                     &node_error);
+        if (node != NULL)
+          g_hash_table_replace (nodes,
+                                g_strdup (ids[i]),
+                                gfbgraph_identity_map_canonicalize (authorizer, node, fields));
+        else if (errors != NULL)
+          g_hash_table_replace (errors, g_strdup (ids[i]), node_error);
+        else
+          g_error_free (node_error);
+      }
+
+      gfbgraph_string_arena_unref (arena);
+      g_object_unref (body_jparser);
+      success = TRUE;
+    } else {
+      g_set_error (error, GFBGRAPH_NODE_ERROR,
+                   GFBGRAPH_NODE_ERROR_REQUEST_FAILED,
+                   "The batch response from the Graph API isn't an array");
+    }
+  }
+
+  g_object_unref (jparser);
+
+  return success;
+}
+
+/* Stores a copy of @error, the failure of a whole batch request, as the error
+ * of each of its nodes */
+static void
+fail_batch_nodes (const gchar * const *ids,
+                  guint                n_ids,
+                  const GError        *error,
+                  GHashTable          *errors)
+{
+  guint i;
+
+  if (errors == NULL)
+    return;
+
+  for (i = 0; i < n_ids; i++)
+    g_hash_table_replace (errors, g_strdup (ids[i]), g_error_copy (error));
+}
+
+static gboolean
+get_nodes_batch (GFBGraphAuthorizer   *authorizer,
+                 const gchar * const  *ids,
+                 guint                 n_ids,
+                 GType                 node_type,
+                 GFBGraphFieldSet     *fields,
+                 GHashTable           *nodes,
+                 GHashTable           *errors,
+                 GError              **error)
+{
+  RestProxyCall *rest_call;
+  GBytes *payload;
+  gboolean success = FALSE;
+
+  rest_call = new_batch_call (authorizer, ids, n_ids, fields);
+  payload = gfbgraph_call_sync (rest_call, NULL, error);
+  if (payload != NULL) {
+    success = parse_batch_payload (payload,
+                                   authorizer,
+                                   ids,
+                                   n_ids,
+                                   node_type,
+                                   fields_to_string (fields),
+                                   nodes,
+                                   errors,
+                                   error);
+    g_bytes_unref (payload);
+  }
+
+  g_object_unref (rest_call);
+
+  return success;
+}
+
+static void
+batch_call_cb (GObject      *source_object,
+               GAsyncResult *result,
+               gpointer      user_data)
+{
+  GFBGraphNodeBatchCallData *call_data = user_data;
+  GTask *task = call_data->task;
+  GFBGraphNodeBatchAsyncData *data;
+  GBytes *payload;
+  GError *error = NULL;
+
+  data = g_task_get_task_data (task);
+
+  payload = gfbgraph_call_finish (REST_PROXY_CALL (source_object), result, &error);
+  if (payload != NULL) {
+    parse_batch_payload (payload,
+                         GFBGRAPH_AUTHORIZER (g_task_get_source_object (task)),
+                         (const gchar * const *) data->ids + call_data->first,
+                         call_data->n_ids,
+                         data->node_type,
+                         data->fields,
+                         data->nodes,
+                         data->errors,
+                         &error);
+    g_bytes_unref (payload);
+  }
+
+  if (error != NULL) {
+    fail_batch_nodes ((const gchar * const *) data->ids + call_data->first,
+                      call_data->n_ids,
+                      error,
+                      data->errors);
+    data->n_failed++;
+    if (data->error == NULL)
+      data->error = error;
+    else
+      g_error_free (error);
+  }
+
+  /* All the batches finish in the same main context, no locking is needed */
+  if (--data->pending == 0) {
+    if (data->n_failed == data->n_batches) {
+      g_task_return_error (task, data->error);
+      data->error = NULL;
+    } else {
+      g_task_return_boolean (task, TRUE);
+    }
+  }
+
+  g_object_unref (task);
+  g_slice_free (GFBGraphNodeBatchCallData, call_data);
+}
+
+/* --- Internal API --- */
+/* Deserializes @jnode, copying the strings of the new node into @arena */
+GFBGraphNode *
+gfbgraph_node_deserialize (GType                node_type,
+                           JsonNode            *jnode,
+                           GFBGraphStringArena *arena)
+{
+  GFBGraphStringArena *previous;
+  GFBGraphNode *node;
+
+  previous = gfbgraph_string_arena_set_current (arena);
+  node = GFBGRAPH_NODE (json_gobject_deserialize (node_type, jnode));
+  gfbgraph_string_arena_set_current (previous);
+
+  return node;
+}
+
+/* Returns the ID of @node without keeping its string in the node, the
+ * numeric IDs are formatted in @buffer */
+const gchar *
+gfbgraph_node_peek_id (GFBGraphNode *node,
+                       gchar        *buffer)
+{
+  GFBGraphNodePrivate *priv = GFBGRAPH_NODE_GET_PRIVATE (node);
+  const gchar *id;
+
+  id = g_atomic_pointer_get (&priv->id);
+  if (id == NULL && priv->numeric_id != 0) {
+    g_snprintf (buffer, GFBGRAPH_NODE_ID_BUFFER_SIZE, "%" G_GUINT64_FORMAT, priv->numeric_id);
+    id = buffer;
+  }
+
+  return id;
+}
+
+/* Replaces the string in @field, owned by @node. The strings set while
+ * deserializing a response are borrowed from its arena instead of being
+ * duplicated one by one; @node keeps it alive. A node only references one
+ * arena, the strings set out of it (like the merged ones) are duplicated. */
+void
+gfbgraph_node_set_string (GFBGraphNode *node,
+                          gchar       **field,
+                          const gchar  *value)
+{
+  GFBGraphNodePrivate *priv = GFBGRAPH_NODE_GET_PRIVATE (node);
+  GFBGraphStringArena *arena;
+
+  if (*field != NULL && g_strcmp0 (*field, value) == 0)
+    return;
+
+  gfbgraph_node_clear_string (node, field);
+  if (value == NULL)
+    return;
+
+  arena = gfbgraph_string_arena_get_current ();
+  if (arena != NULL && (priv->arena == NULL || priv->arena == arena)) {
+    if (priv->arena == NULL)
+      priv->arena = gfbgraph_string_arena_ref (arena);
+    g_atomic_pointer_set (field, (gchar *) gfbgraph_string_arena_insert (arena, value));
+  } else {
+    g_atomic_pointer_set (field, g_strdup (value));
+  }
+}
+
+/* Releases the string in @field set with gfbgraph_node_set_string(). It may
+ * have been returned by a getter, so it's only freed with @node. */
+void
+gfbgraph_node_clear_string (GFBGraphNode  *node,
+                            gchar        **field)
+{
+  GFBGraphNodePrivate *priv = GFBGRAPH_NODE_GET_PRIVATE (node);
+  gchar *str = *field;
+
+  if (str == NULL)
+    return;
+
+  g_atomic_pointer_set (field, NULL);
+  if (priv->arena == NULL || !gfbgraph_string_arena_contains (priv->arena, str))
+    priv->retired = g_slist_prepend (priv->retired, str);
+}
+
+/* Sets the function merging the data of the @node_type nodes which can't be
+ * copied through their properties. gfbgraph_node_merge() calls the ones of the
+ * type of the node and of all its parent types. */
+void
+gfbgraph_node_type_set_merge_func (GType                 node_type,
+                                   GFBGraphNodeMergeFunc merge_func)
+{
+  g_type_set_qdata (node_type, merge_func_quark (), merge_func);
+}
+
+/* --- Public API --- */
 /**
  * gfbgraph_node_new:
  *
@@ -282,35 +1072,260 @@ gfbgraph_node_new_from_id (GFBGraphAuthorizer  *authorizer,
                            GType                node_type,
                            GError             **error)
 {
-  GFBGraphNode *node = NULL;
+  return gfbgraph_node_new_from_id_with_fields (authorizer, id, node_type, NULL, error);
+}
+
+/**
+ * gfbgraph_node_new_from_id_with_fields:
+ * @authorizer: a #GFBGraphAuthorizer.
+ * @id: a const #gchar with the node ID.
+ * @node_type: a #GFBGraphNode type #GType.
+ * @fields: (allow-none): a #GFBGraphFieldSet with the fields to retrieve, or %NULL for the default ones.
+ * @error: (allow-none): a #GError or %NULL.
+ *
+ * Like gfbgraph_node_new_from_id(), but only the properties in @fields are requested
+ * to the Graph API, so the rest of the properties of the node keep their default values.
+ *
+ * Returns: (transfer full): a #GFBGraphNode or %NULL.
+ **/
+GFBGraphNode *
+gfbgraph_node_new_from_id_with_fields (GFBGraphAuthorizer  *authorizer,
+                                       const gchar         *id,
+                                       GType                node_type,
+                                       GFBGraphFieldSet    *fields,
+                                       GError             **error)
+{
+  GFBGraphNode *node;
   RestProxyCall *rest_call;
 
   g_return_val_if_fail ((strlen (id) > 0), NULL);
   g_return_val_if_fail (GFBGRAPH_IS_AUTHORIZER (authorizer), NULL);
   g_return_val_if_fail (g_type_is_a (node_type, GFBGRAPH_TYPE_NODE), NULL);
 
+  /* A node retrieved recently with the same fields is already up to date */
+  node = gfbgraph_identity_map_lookup_fetched (authorizer, id, node_type, fields_to_string (fields));
+  if (node != NULL)
+    return node;
+
   rest_call = gfbgraph_new_rest_call (authorizer);
   rest_proxy_call_set_method (rest_call, "GET");
   rest_proxy_call_set_function (rest_call, id);
+  if (fields != NULL)
+    rest_proxy_call_add_param (rest_call, "fields", gfbgraph_field_set_to_string (fields));
 
-  if (rest_proxy_call_sync (rest_call, error)) {
-    JsonParser *jparser;
-    JsonNode *jnode;
-    const gchar *payload;
+  node = gfbgraph_call_sync_parsed (rest_call, parse_node_payload, node_type, NULL, error);
+  g_object_unref (rest_call);
 
-    payload = rest_proxy_call_get_payload (rest_call);
-    jparser = json_parser_new ();
-    if (json_parser_load_from_data (jparser, payload, -1, error)) {
-      jnode = json_parser_get_root (jparser);
-      node = GFBGRAPH_NODE (json_gobject_deserialize (node_type, jnode));
+  return node;
+}
+
+/**
+ * gfbgraph_node_new_from_ids:
+ * @authorizer: a #GFBGraphAuthorizer.
+ * @ids: (array zero-terminated=1): a %NULL-terminated array with the node IDs.
+ * @node_type: a #GFBGraphNode type #GType.
+ * @fields: (allow-none): a #GFBGraphFieldSet with the fields to retrieve, or %NULL for the default ones.
+ * @batch_size: the number of nodes requested in every HTTP request, or 0 to use
+ *   the maximum allowed by the Graph API (50).
+ * @errors: (out) (optional) (element-type utf8 GLib.Error) (transfer full): return location
+ *   for a #GHashTable with the #GError of every node that couldn't be retrieved, or %NULL.
+ * @error: (allow-none): a #GError or %NULL.
+ *
+ * Retrieve several nodes of @node_type type at once, packing the requests into Graph API
+ * batch requests of @batch_size nodes, so only one round trip is done for every batch.
+ *
+ * A node that fails (for example, because the ID doesn't exist) doesn't abort the whole
+ * operation, its error is stored into @errors with the ID as key. When a whole batch
+ * request fails, its error is stored for every node of the batch, and the nodes of the
+ * other batches are still returned. @error is only set when every batch request fails.
+ *
+ * See gfbgraph_node_new_from_ids_async() for the asynchronous version of this call.
+ *
+ * Returns: (element-type utf8 GFBGraphNode) (transfer full): a #GHashTable with the
+ * retrieved nodes using the ID as key, or %NULL in case of error.
+ **/
+GHashTable *
+gfbgraph_node_new_from_ids (GFBGraphAuthorizer   *authorizer,
+                            const gchar * const  *ids,
+                            GType                 node_type,
+                            GFBGraphFieldSet     *fields,
+                            guint                 batch_size,
+                            GHashTable          **errors,
+                            GError              **error)
+{
+  GHashTable *nodes;
+  GHashTable *node_errors = NULL;
+  GError *batch_error = NULL;
+  guint n_ids, first, n_batches = 0, n_failed = 0;
+
+  g_return_val_if_fail (GFBGRAPH_IS_AUTHORIZER (authorizer), NULL);
+  g_return_val_if_fail (ids != NULL, NULL);
+  g_return_val_if_fail (g_type_is_a (node_type, GFBGRAPH_TYPE_NODE), NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  if (batch_size == 0 || batch_size > GRAPH_BATCH_MAX_SIZE)
+    batch_size = GRAPH_BATCH_MAX_SIZE;
+
+  nodes = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_object_unref);
+  if (errors != NULL)
+    node_errors = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_error_free);
+
+  n_ids = g_strv_length ((gchar **) ids);
+  for (first = 0; first < n_ids; first += batch_size) {
+    GError *local_error = NULL;
+
+    n_batches++;
+    if (!get_nodes_batch (authorizer,
+                          ids + first,
+                          MIN (batch_size, n_ids - first),
+                          node_type,
+                          fields,
+                          nodes,
+                          node_errors,
+                          &local_error)) {
+      fail_batch_nodes (ids + first, MIN (batch_size, n_ids - first), local_error, node_errors);
+      n_failed++;
+      if (batch_error == NULL)
+        batch_error = local_error;
+      else
+        g_error_free (local_error);
     }
+  }
 
-    g_object_unref (jparser);
+  if (n_batches > 0 && n_failed == n_batches) {
+    g_propagate_error (error, batch_error);
+    g_hash_table_unref (nodes);
+    if (node_errors != NULL)
+      g_hash_table_unref (node_errors);
+    return NULL;
   }
 
-  g_object_unref (rest_call);
+  g_clear_error (&batch_error);
+  if (errors != NULL)
+    *errors = node_errors;
 
-  return node;
+  return nodes;
+}
+
+/**
+ * gfbgraph_node_new_from_ids_async:
+ * @authorizer: a #GFBGraphAuthorizer.
+ * @ids: (array zero-terminated=1): a %NULL-terminated array with the node IDs.
+ * @node_type: a #GFBGraphNode type #GType.
+ * @fields: (allow-none): a #GFBGraphFieldSet with the fields to retrieve, or %NULL for the default ones.
+ * @batch_size: the number of nodes requested in every HTTP request, or 0 to use the maximum.
+ * @cancellable: (allow-none): An optional #GCancellable object, or %NULL.
+ * @callback: (scope async): A #GAsyncReadyCallback to call when the request is completed.
+ * @user_data: (closure): The data to pass to @callback.
+ *
+ * Asynchronously retrieve several nodes at once. See gfbgraph_node_new_from_ids() for the
+ * synchronous version of this call.
+ *
+ * When the operation is finished, @callback will be called. You can then call
+ * gfbgraph_node_new_from_ids_async_finish() to get the retrieved nodes.
+ **/
+void
+gfbgraph_node_new_from_ids_async (GFBGraphAuthorizer   *authorizer,
+                                  const gchar * const  *ids,
+                                  GType                 node_type,
+                                  GFBGraphFieldSet     *fields,
+                                  guint                 batch_size,
+                                  GCancellable         *cancellable,
+                                  GAsyncReadyCallback   callback,
+                                  gpointer              user_data)
+{
+  GTask *task;
+  GFBGraphNodeBatchAsyncData *data;
+  guint n_ids, first;
+
+  g_return_if_fail (GFBGRAPH_IS_AUTHORIZER (authorizer));
+  g_return_if_fail (ids != NULL);
+  g_return_if_fail (g_type_is_a (node_type, GFBGRAPH_TYPE_NODE));
+  g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+  g_return_if_fail (callback != NULL);
+
+  if (batch_size == 0 || batch_size > GRAPH_BATCH_MAX_SIZE)
+    batch_size = GRAPH_BATCH_MAX_SIZE;
+
+  data = g_slice_new0 (GFBGraphNodeBatchAsyncData);
+  data->ids = g_strdupv ((gchar **) ids);
+  data->node_type = node_type;
+  data->fields = g_strdup (fields_to_string (fields));
+  data->nodes = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_object_unref);
+  data->errors = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_error_free);
+
+  task = g_task_new (authorizer, cancellable, callback, user_data);
+  g_task_set_source_tag (task, gfbgraph_node_new_from_ids_async);
+  g_task_set_task_data (task, data, (GDestroyNotify) batch_async_data_free);
+
+  n_ids = g_strv_length (data->ids);
+  if (n_ids == 0) {
+    g_task_return_boolean (task, TRUE);
+    g_object_unref (task);
+    return;
+  }
+
+  /* All the batches are sent at once and the task returns when the last one finishes */
+  data->pending = (n_ids + batch_size - 1) / batch_size;
+  data->n_batches = data->pending;
+  for (first = 0; first < n_ids; first += batch_size) {
+    GFBGraphNodeBatchCallData *call_data;
+    RestProxyCall *rest_call;
+
+    call_data = g_slice_new (GFBGraphNodeBatchCallData);
+    call_data->task = g_object_ref (task);
+    call_data->first = first;
+    call_data->n_ids = MIN (batch_size, n_ids - first);
+
+    rest_call = new_batch_call (authorizer,
+                                (const gchar * const *) data->ids + first,
+                                call_data->n_ids,
+                                fields);
+    gfbgraph_call_async (rest_call, cancellable, batch_call_cb, call_data);
+    g_object_unref (rest_call);
+  }
+
+  g_object_unref (task);
+}
+
+/**
+ * gfbgraph_node_new_from_ids_async_finish:
+ * @authorizer: a #GFBGraphAuthorizer.
+ * @result: A #GAsyncResult.
+ * @errors: (out) (optional) (element-type utf8 GLib.Error) (transfer full): return location
+ *   for a #GHashTable with the errors of the nodes that couldn't be retrieved, or %NULL.
+ * @error: (allow-none): An optional #GError, or %NULL.
+ *
+ * Finishes an asynchronous operation started with
+ * gfbgraph_node_new_from_ids_async().
+ *
+ * Returns: (element-type utf8 GFBGraphNode) (transfer full): a #GHashTable with the
+ * retrieved nodes using the ID as key, or %NULL in case of error.
+ **/
+GHashTable *
+gfbgraph_node_new_from_ids_async_finish (GFBGraphAuthorizer  *authorizer,
+                                         GAsyncResult        *result,
+                                         GHashTable         **errors,
+                                         GError             **error)
+{
+  GFBGraphNodeBatchAsyncData *data;
+  GHashTable *nodes;
+
+  g_return_val_if_fail (g_task_is_valid (result, authorizer), NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  if (!g_task_propagate_boolean (G_TASK (result), error))
+    return NULL;
+
+  data = g_task_get_task_data (G_TASK (result));
+  nodes = data->nodes;
+  data->nodes = NULL;
+  if (errors != NULL) {
+    *errors = data->errors;
+    data->errors = NULL;
+  }
+
+  return nodes;
 }
 
 /**
@@ -324,9 +1339,17 @@ gfbgraph_node_new_from_id (GFBGraphAuthorizer  *authorizer,
 const gchar *
 gfbgraph_node_get_id (GFBGraphNode *node)
 {
+  GFBGraphNodePrivate *priv;
+  const gchar *id;
+
   g_return_val_if_fail (GFBGRAPH_IS_NODE (node), NULL);
 
-  return node->priv->id;
+  priv = node->priv;
+  id = g_atomic_pointer_get (&priv->id);
+  if (id == NULL && priv->numeric_id != 0)
+    id = cache_string (&priv->id, g_strdup_printf ("%" G_GUINT64_FORMAT, priv->numeric_id));
+
+  return id;
 }
 
 /**
@@ -340,9 +1363,17 @@ gfbgraph_node_get_id (GFBGraphNode *node)
 const gchar *
 gfbgraph_node_get_link (GFBGraphNode *node)
 {
+  GFBGraphNodePrivate *priv;
+  const gchar *link;
+
   g_return_val_if_fail (GFBGRAPH_IS_NODE (node), NULL);
 
-  return node->priv->link;
+  priv = node->priv;
+  link = g_atomic_pointer_get (&priv->link);
+  if (link == NULL && priv->link_id != 0)
+    link = cache_string (&priv->link, g_strdup_printf (LINK_PREFIX "%" G_GUINT64_FORMAT, priv->link_id));
+
+  return link;
 }
 
 /**
@@ -356,9 +1387,17 @@ gfbgraph_node_get_link (GFBGraphNode *node)
 const gchar *
 gfbgraph_node_get_created_time (GFBGraphNode *node)
 {
+  GFBGraphNodePrivate *priv;
+  const gchar *created_time;
+
   g_return_val_if_fail (GFBGRAPH_IS_NODE (node), NULL);
 
-  return node->priv->created_time;
+  priv = node->priv;
+  created_time = g_atomic_pointer_get (&priv->created_time_string);
+  if (created_time == NULL && priv->created_time != 0)
+    created_time = cache_string (&priv->created_time_string, format_time (priv->created_time));
+
+  return created_time;
 }
 
 /**
@@ -372,11 +1411,82 @@ gfbgraph_node_get_created_time (GFBGraphNode *node)
 const gchar *
 gfbgraph_node_get_updated_time (GFBGraphNode *node)
 {
+  GFBGraphNodePrivate *priv;
+  const gchar *updated_time;
+
   g_return_val_if_fail (GFBGRAPH_IS_NODE (node), NULL);
 
+  priv = node->priv;
+  updated_time = g_atomic_pointer_get (&priv->updated_time_string);
+  if (updated_time == NULL && priv->updated_time != 0)
+    updated_time = cache_string (&priv->updated_time_string, format_time (priv->updated_time));
+
+  return updated_time;
+}
+
+/**
+ * gfbgraph_node_get_created_timestamp:
+ * @node: a #GFBGraphNode.
+ *
+ * Gets the node created time already parsed, so the nodes can be sorted or
+ * filtered without parsing the ISO 8601 dates again.
+ *
+ * Returns: the time when the node was initially published in microseconds
+ * since the epoch, or 0 if unknown.
+ **/
+gint64
+gfbgraph_node_get_created_timestamp (GFBGraphNode *node)
+{
+  g_return_val_if_fail (GFBGRAPH_IS_NODE (node), 0);
+
+  return node->priv->created_time;
+}
+
+/**
+ * gfbgraph_node_get_updated_timestamp:
+ * @node: a #GFBGraphNode.
+ *
+ * Gets the node updated time already parsed, see
+ * gfbgraph_node_get_created_timestamp().
+ *
+ * Returns: the time when the node was updated in microseconds since the
+ * epoch, or 0 if unknown.
+ **/
+gint64
+gfbgraph_node_get_updated_timestamp (GFBGraphNode *node)
+{
+  g_return_val_if_fail (GFBGRAPH_IS_NODE (node), 0);
+
   return node->priv->updated_time;
 }
 
+/**
+ * gfbgraph_node_is_stale:
+ * @node: a #GFBGraphNode.
+ * @updated_time: an ISO 8601 encoded date, like the "updated_time" of a fresher copy of @node.
+ *
+ * Checks if @node was updated after it was retrieved, for example comparing a cached
+ * node with the updated time returned in a connection page. Remember to request the
+ * "updated_time" field when using a #GFBGraphFieldSet.
+ *
+ * Returns: %TRUE if @updated_time is later than the updated time of @node, or if any
+ * of them is unknown.
+ **/
+gboolean
+gfbgraph_node_is_stale (GFBGraphNode *node,
+                        const gchar  *updated_time)
+{
+  gint64 latest_time;
+
+  g_return_val_if_fail (GFBGRAPH_IS_NODE (node), TRUE);
+
+  latest_time = parse_time (updated_time);
+  if (node->priv->updated_time == 0 || latest_time == 0)
+    return TRUE;
+
+  return latest_time > node->priv->updated_time;
+}
+
 /**
  * gfbgraph_node_set_id:
  * @node: a #GFBGraphNode.
@@ -397,6 +1507,47 @@ gfbgraph_node_set_id (GFBGraphNode *node,
                 NULL);
 }
 
+/**
+ * gfbgraph_node_merge:
+ * @node: a #GFBGraphNode.
+ * @source: another #GFBGraphNode of the same type, usually a fresher copy of @node.
+ *
+ * Updates @node with the properties set in @source, keeping the ones @source
+ * doesn't have, like the fields not requested in a #GFBGraphFieldSet. The
+ * notify signals of @node are emitted once the whole @source is merged.
+ *
+ * The data owned by @source that can't be copied, like the images of a
+ * #GFBGraphPhoto, is moved into @node. The strings and images of @node
+ * returned by its getters stay valid until @node is finalized, even the ones
+ * replaced by the merge.
+ **/
+void
+gfbgraph_node_merge (GFBGraphNode *node,
+                     GFBGraphNode *source)
+{
+  GType type;
+
+  g_return_if_fail (GFBGRAPH_IS_NODE (node));
+  g_return_if_fail (GFBGRAPH_IS_NODE (source));
+  g_return_if_fail (G_OBJECT_TYPE (node) == G_OBJECT_TYPE (source));
+
+  if (node == source)
+    return;
+
+  g_object_freeze_notify (G_OBJECT (node));
+
+  merge_properties (node, source);
+  for (type = G_OBJECT_TYPE (node); type != GFBGRAPH_TYPE_NODE; type = g_type_parent (type)) {
+    GFBGraphNodeMergeFunc merge_func;
+
+    merge_func = g_type_get_qdata (type, merge_func_quark ());
+    if (merge_func != NULL)
+      merge_func (node, source);
+  }
+
+  g_object_thaw_notify (G_OBJECT (node));
+}
+
 /**
  * gfbgraph_node_get_connection_nodes:
  * @node: a #GFBGraphNode object which retrieve the connected nodes.
@@ -408,6 +1559,9 @@ gfbgraph_node_set_id (GFBGraphNode *node,
  * implement the #GFBGraphConnectionable interface and be connectable to @node type object.
  * See gfbgraph_node_get_connection_nodes_async() for the asynchronous version of this call.
  *
+ * Only the first page of connected nodes returned by the Graph API is retrieved, use a
+ * #GFBGraphConnectionIterator to go through all of them.
+ *
  * Returns: (element-type GFBGraphNode) (transfer full): a newly-allocated #GList of type @node_type objects with the found nodes.
  **/
 GList *
@@ -416,55 +1570,148 @@ gfbgraph_node_get_connection_nodes (GFBGraphNode        *node,
                                     GFBGraphAuthorizer  *authorizer,
                                     GError             **error)
 {
-  GFBGraphNodePrivate *priv;
-  GList *nodes_list = NULL;
-  GFBGraphNode *connected_node;
+  return gfbgraph_node_get_connection_nodes_with_fields (node, node_type, authorizer, NULL, error);
+}
+
+/**
+ * gfbgraph_node_get_connection_nodes_with_fields:
+ * @node: a #GFBGraphNode object which retrieve the connected nodes.
+ * @node_type: a #GFBGraphNode type #GType that determines the kind of nodes to retrieve.
+ * @authorizer: a #GFBGraphAuthorizer.
+ * @fields: (allow-none): a #GFBGraphFieldSet with the fields to retrieve of every connected node,
+ *   or %NULL for the default ones.
+ * @error: (allow-none): a #GError or %NULL.
+ *
+ * Like gfbgraph_node_get_connection_nodes(), but only the properties in @fields are requested
+ * for the connected nodes.
+ *
+ * Returns: (element-type GFBGraphNode) (transfer full): a newly-allocated #GList of type @node_type objects with the found nodes.
+ **/
+GList *
+gfbgraph_node_get_connection_nodes_with_fields (GFBGraphNode        *node,
+                                                GType                node_type,
+                                                GFBGraphAuthorizer  *authorizer,
+                                                GFBGraphFieldSet    *fields,
+                                                GError             **error)
+{
+  return gfbgraph_nodes_array_to_list (gfbgraph_node_get_connection_nodes_array (node,
+                                                                                 node_type,
+                                                                                 authorizer,
+                                                                                 fields,
+                                                                                 error));
+}
+
+/**
+ * gfbgraph_node_get_connection_nodes_array:
+ * @node: a #GFBGraphNode object which retrieve the connected nodes.
+ * @node_type: a #GFBGraphNode type #GType that determines the kind of nodes to retrieve.
+ * @authorizer: a #GFBGraphAuthorizer.
+ * @fields: (allow-none): a #GFBGraphFieldSet with the fields to retrieve of every connected node,
+ *   or %NULL for the default ones.
+ * @error: (allow-none): a #GError or %NULL.
+ *
+ * Like gfbgraph_node_get_connection_nodes_with_fields(), but the nodes are returned in a
+ * #GPtrArray, which is cheaper to build and to walk than a #GList for big pages.
+ *
+ * Returns: (element-type GFBGraphNode) (transfer full): a newly-allocated #GPtrArray of type
+ * @node_type objects with the found nodes, or %NULL in case of error.
+ **/
+GPtrArray *
+gfbgraph_node_get_connection_nodes_array (GFBGraphNode        *node,
+                                          GType                node_type,
+                                          GFBGraphAuthorizer  *authorizer,
+                                          GFBGraphFieldSet    *fields,
+                                          GError             **error)
+{
+  GPtrArray *nodes = NULL;
+  const GFBGraphConnectionInfo *info;
   RestProxyCall *rest_call;
-  gchar *function_path;
+  GBytes *payload;
 
   g_return_val_if_fail (GFBGRAPH_IS_NODE (node), NULL);
   g_return_val_if_fail (g_type_is_a (node_type, GFBGRAPH_TYPE_NODE), NULL);
   g_return_val_if_fail (GFBGRAPH_IS_AUTHORIZER (authorizer), NULL);
 
-  priv = GFBGRAPH_NODE_GET_PRIVATE (node);
-
-  /* Dummy node just for test */
-  connected_node = g_object_new (node_type, NULL);
-  if (GFBGRAPH_IS_CONNECTABLE (connected_node) == FALSE) {
-    g_set_error (error, GFBGRAPH_NODE_ERROR,
-                 GFBGRAPH_NODE_ERROR_NO_CONNECTABLE,
-                 "The given node type (%s) doesn't implement connectable interface",
-                 g_type_name (node_type));
+  rest_call = new_connection_call (node, node_type, authorizer, fields, &info, error);
+  if (rest_call == NULL)
     return NULL;
-  }
 
-  if (gfbgraph_connectable_is_connectable_to (GFBGRAPH_CONNECTABLE (connected_node), G_OBJECT_TYPE (node)) == FALSE) {
-    g_set_error (error, GFBGRAPH_NODE_ERROR,
-                 GFBGRAPH_NODE_ERROR_NO_CONNECTABLE,
-                 "The given node type (%s) can't connect with the node",
-                 g_type_name (node_type));
-    return NULL;
+  payload = gfbgraph_call_sync (rest_call, NULL, error);
+  if (payload != NULL) {
+    nodes = gfbgraph_connection_info_parse_array (info,
+                                                  g_bytes_get_data (payload, NULL),
+                                                  g_bytes_get_size (payload),
+                                                  error);
+    gfbgraph_identity_map_canonicalize_array (authorizer, nodes, fields_to_string (fields));
+    g_bytes_unref (payload);
   }
 
-  rest_call = gfbgraph_new_rest_call (authorizer);
-  rest_proxy_call_set_method (rest_call, "GET");
-  function_path = g_strdup_printf ("%s/%s",
-                                   priv->id,
-                                   gfbgraph_connectable_get_connection_path (GFBGRAPH_CONNECTABLE (connected_node),
-                                                                             G_OBJECT_TYPE (node)));
-  rest_proxy_call_set_function (rest_call, function_path);
-  g_free (function_path);
+  g_object_unref (rest_call);
+
+  return nodes;
+}
+
+/**
+ * gfbgraph_node_foreach_connection_node:
+ * @node: a #GFBGraphNode object which retrieve the connected nodes.
+ * @node_type: a #GFBGraphNode type #GType that determines the kind of nodes to retrieve.
+ * @authorizer: a #GFBGraphAuthorizer.
+ * @fields: (allow-none): a #GFBGraphFieldSet with the fields to retrieve of every connected node,
+ *   or %NULL for the default ones.
+ * @func: (scope call): a #GFBGraphNodeFunc called for every connected node.
+ * @user_data: (closure): the data to pass to @func.
+ * @error: (allow-none): a #GError or %NULL.
+ *
+ * Retrieves the nodes of type @node_type connected to @node, like
+ * gfbgraph_node_get_connection_nodes_with_fields(), but every node is passed to @func
+ * as soon as it's parsed from the response and released after it, unless @func keeps
+ * a reference. The memory used is then bounded by a single node instead of the whole page.
+ *
+ * Returns: %TRUE on success, %FALSE in case of error.
+ **/
+gboolean
+gfbgraph_node_foreach_connection_node (GFBGraphNode        *node,
+                                       GType                node_type,
+                                       GFBGraphAuthorizer  *authorizer,
+                                       GFBGraphFieldSet    *fields,
+                                       GFBGraphNodeFunc     func,
+                                       gpointer             user_data,
+                                       GError             **error)
+{
+  const GFBGraphConnectionInfo *info;
+  GFBGraphNodeForeachData data;
+  RestProxyCall *rest_call;
+  GBytes *payload;
+  gboolean success = FALSE;
 
-  if (rest_proxy_call_sync (rest_call, error)) {
-    const gchar *payload = rest_proxy_call_get_payload (rest_call);
-    nodes_list = gfbgraph_connectable_parse_connected_data (GFBGRAPH_CONNECTABLE (connected_node), payload, error);
+  g_return_val_if_fail (GFBGRAPH_IS_NODE (node), FALSE);
+  g_return_val_if_fail (g_type_is_a (node_type, GFBGRAPH_TYPE_NODE), FALSE);
+  g_return_val_if_fail (GFBGRAPH_IS_AUTHORIZER (authorizer), FALSE);
+  g_return_val_if_fail (func != NULL, FALSE);
+
+  rest_call = new_connection_call (node, node_type, authorizer, fields, &info, error);
+  if (rest_call == NULL)
+    return FALSE;
+
+  data.authorizer = authorizer;
+  data.fields = fields_to_string (fields);
+  data.func = func;
+  data.user_data = user_data;
+
+  payload = gfbgraph_call_sync (rest_call, NULL, error);
+  if (payload != NULL) {
+    success = gfbgraph_connection_info_parse_foreach (info,
+                                                      g_bytes_get_data (payload, NULL),
+                                                      g_bytes_get_size (payload),
+                                                      foreach_canonical_func,
+                                                      &data,
+                                                      error);
+    g_bytes_unref (payload);
   }
 
-  /* We don't need this node again */
-  g_object_unref (connected_node);
   g_object_unref (rest_call);
 
-  return nodes_list;
+  return success;
 }
 
 /**
@@ -490,34 +1737,15 @@ gfbgraph_node_get_connection_nodes_async (GFBGraphNode        *node,
                                           GAsyncReadyCallback  callback,
                                           gpointer             user_data)
 {
-  GSimpleAsyncResult *result;
-  GFBGraphNodeConnectionAsyncData *data;
-
   g_return_if_fail (GFBGRAPH_IS_NODE (node));
+  g_return_if_fail (g_type_is_a (node_type, GFBGRAPH_TYPE_NODE));
+  g_return_if_fail (GFBGRAPH_IS_AUTHORIZER (authorizer));
   g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
   g_return_if_fail (callback != NULL);
 
-  result = g_simple_async_result_new (G_OBJECT (node),
-                                      callback,
-                                      user_data,
-                                      gfbgraph_node_get_connection_nodes_async);
-  g_simple_async_result_set_check_cancellable (result, cancellable);
-
-  data = g_slice_new (GFBGraphNodeConnectionAsyncData);
-  data->list = NULL;
-  data->node_type = node_type;
-  data->authorizer = authorizer;
-  g_object_ref (data->authorizer);
-
-  g_simple_async_result_set_op_res_gpointer (result,
-                                             data,
-                                             (GDestroyNotify)connection_async_data_free);
-  g_simple_async_result_run_in_thread (result,
-                                       (GSimpleAsyncThreadFunc)get_connection_nodes_async_thread,
-                                       G_PRIORITY_DEFAULT,
-                                       cancellable);
-
-  g_object_unref (result);
+  get_connection_nodes_async (node, node_type, authorizer, NULL, TRUE,
+                              gfbgraph_node_get_connection_nodes_async,
+                              cancellable, callback, user_data);
 }
 
 /**
@@ -536,19 +1764,70 @@ gfbgraph_node_get_connection_nodes_async_finish (GFBGraphNode  *node,
                                                  GAsyncResult  *result,
                                                  GError       **error)
 {
-  GSimpleAsyncResult *simple_async;
-  GFBGraphNodeConnectionAsyncData *data;
-
-  g_return_val_if_fail (g_simple_async_result_is_valid (result, G_OBJECT (node), gfbgraph_node_get_connection_nodes_async), NULL);
+  g_return_val_if_fail (g_task_is_valid (result, node), NULL);
   g_return_val_if_fail (error == NULL || *error == NULL, NULL);
 
-  simple_async = G_SIMPLE_ASYNC_RESULT (result);
+  return g_task_propagate_pointer (G_TASK (result), error);
+}
 
-  if (g_simple_async_result_propagate_error (simple_async, error))
-    return NULL;
+/**
+ * gfbgraph_node_get_connection_nodes_array_async:
+ * @node: A #GFBGraphNode object which retrieve the connected nodes.
+ * @node_type: a #GFBGraphNode type #GType that must implement the #GFBGraphConnectionable interface.
+ * @authorizer: a #GFBGraphAuthorizer.
+ * @fields: (allow-none): a #GFBGraphFieldSet with the fields to retrieve of every connected node,
+ *   or %NULL for the default ones.
+ * @cancellable: (allow-none): An optional #GCancellable object, or %NULL.
+ * @callback: (scope async): A #GAsyncReadyCallback to call when the request is completed.
+ * @user_data: (closure): The data to pass to @callback.
+ *
+ * Asynchronously retrieve the array of nodes of type @node_type connected to the @node object. See
+ * gfbgraph_node_get_connection_nodes_array() for the synchronous version of this call.
+ *
+ * When the operation is finished, @callback will be called. You can then call
+ * gfbgraph_node_get_connection_nodes_array_async_finish() to get the array of connected nodes.
+ **/
+void
+gfbgraph_node_get_connection_nodes_array_async (GFBGraphNode        *node,
+                                                GType                node_type,
+                                                GFBGraphAuthorizer  *authorizer,
+                                                GFBGraphFieldSet    *fields,
+                                                GCancellable        *cancellable,
+                                                GAsyncReadyCallback  callback,
+                                                gpointer             user_data)
+{
+  g_return_if_fail (GFBGRAPH_IS_NODE (node));
+  g_return_if_fail (g_type_is_a (node_type, GFBGRAPH_TYPE_NODE));
+  g_return_if_fail (GFBGRAPH_IS_AUTHORIZER (authorizer));
+  g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+  g_return_if_fail (callback != NULL);
 
-  data = (GFBGraphNodeConnectionAsyncData *) g_simple_async_result_get_op_res_gpointer (simple_async);
-  return data->list;
+  get_connection_nodes_async (node, node_type, authorizer, fields, FALSE,
+                              gfbgraph_node_get_connection_nodes_array_async,
+                              cancellable, callback, user_data);
+}
+
+/**
+ * gfbgraph_node_get_connection_nodes_array_async_finish:
+ * @node: A #GFBGraphNode.
+ * @result: A #GAsyncResult.
+ * @error: (allow-none): An optional #GError, or %NULL.
+ *
+ * Finishes an asynchronous operation started with
+ * gfbgraph_node_get_connection_nodes_array_async().
+ *
+ * Returns: (element-type GFBGraphNode) (transfer full): a newly-allocated #GPtrArray of type
+ * #node_type objects with the found nodes, or %NULL in case of error.
+ **/
+GPtrArray *
+gfbgraph_node_get_connection_nodes_array_async_finish (GFBGraphNode  *node,
+                                                       GAsyncResult  *result,
+                                                       GError       **error)
+{
+  g_return_val_if_fail (g_task_is_valid (result, node), NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  return g_task_propagate_pointer (G_TASK (result), error);
 }
 
 /**
@@ -569,9 +1848,11 @@ gfbgraph_node_append_connection (GFBGraphNode        *node,
                                  GFBGraphAuthorizer  *authorizer,
                                  GError             **error)
 {
-  GFBGraphNodePrivate *priv;
+  gchar id_buffer[GFBGRAPH_NODE_ID_BUFFER_SIZE];
+  const GFBGraphConnectionInfo *info;
   RestProxyCall *rest_call;
   GHashTable *params;
+  GBytes *payload;
   gchar *function_path;
   gboolean success = FALSE;
 
@@ -579,36 +1860,19 @@ gfbgraph_node_append_connection (GFBGraphNode        *node,
   g_return_val_if_fail (GFBGRAPH_IS_NODE (connect_node), FALSE);
   g_return_val_if_fail (GFBGRAPH_IS_AUTHORIZER (authorizer), FALSE);
 
-  if (GFBGRAPH_IS_CONNECTABLE (connect_node) == FALSE) {
-    g_set_error (error, GFBGRAPH_NODE_ERROR,
-                 GFBGRAPH_NODE_ERROR_NO_CONNECTABLE,
-                 "The given node type (%s) doesn't implement connectable interface",
-                 G_OBJECT_TYPE_NAME (connect_node));
+  info = gfbgraph_connection_info_lookup (G_OBJECT_TYPE (node), G_OBJECT_TYPE (connect_node), error);
+  if (info == NULL)
     return FALSE;
-  }
-
-  if (gfbgraph_connectable_is_connectable_to (GFBGRAPH_CONNECTABLE (connect_node), G_OBJECT_TYPE (node)) == FALSE) {
-    g_set_error (error, GFBGRAPH_NODE_ERROR,
-                 GFBGRAPH_NODE_ERROR_NO_CONNECTABLE,
-                 "The given node type (%s) can't append a %s connection",
-                 G_OBJECT_TYPE_NAME (node),
-                 G_OBJECT_TYPE_NAME (connect_node));
-    return FALSE;
-  }
-
-  priv = GFBGRAPH_NODE_GET_PRIVATE (node);
 
   rest_call = gfbgraph_new_rest_call (authorizer);
   rest_proxy_call_set_method (rest_call, "POST");
-  function_path = g_strdup_printf ("%s/%s",
-                                   priv->id,
-                                   gfbgraph_connectable_get_connection_path (GFBGRAPH_CONNECTABLE (connect_node),
-                                                                             G_OBJECT_TYPE (node)));
+  function_path = g_strdup_printf ("%s/%s", gfbgraph_node_peek_id (node, id_buffer), info->path);
   rest_proxy_call_set_function (rest_call, function_path);
   g_free (function_path);
 
-  params = gfbgraph_connectable_get_connection_post_params (GFBGRAPH_CONNECTABLE (connect_node),
-                                                            G_OBJECT_TYPE (node));
+  g_assert (info->iface->get_connection_post_params != NULL);
+  params = info->iface->get_connection_post_params (GFBGRAPH_CONNECTABLE (connect_node),
+                                                    G_OBJECT_TYPE (node));
   if (g_hash_table_size (params) > 0) {
     GHashTableIter iter;
     const gchar *key;
@@ -619,17 +1883,20 @@ gfbgraph_node_append_connection (GFBGraphNode        *node,
       rest_proxy_call_add_param (rest_call, key, value);
     }
   }
+  g_hash_table_unref (params);
 
-  if (rest_proxy_call_sync (rest_call, error)) {
-    const gchar *payload;
+  payload = gfbgraph_call_sync (rest_call, NULL, error);
+  if (payload != NULL) {
     JsonParser *jparser;
     JsonNode *jnode;
     JsonReader *jreader;
 
-    payload = rest_proxy_call_get_payload (rest_call);
     /* Parssing the new ID */
     jparser = json_parser_new ();
-    json_parser_load_from_data (jparser, payload, -1, error);
+    json_parser_load_from_data (jparser,
+                                g_bytes_get_data (payload, NULL),
+                                g_bytes_get_size (payload),
+                                error);
     jnode = json_parser_get_root (jparser);
     jreader = json_reader_new (jnode);
 
@@ -640,6 +1907,7 @@ gfbgraph_node_append_connection (GFBGraphNode        *node,
 
     g_object_unref (jreader);
     g_object_unref (jparser);
+    g_bytes_unref (payload);
     success = TRUE;
   }
   g_object_unref (rest_call);
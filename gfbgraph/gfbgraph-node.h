@@ -23,6 +23,7 @@
 
 #include <glib-object.h>
 #include <gfbgraph/gfbgraph-authorizer.h>
+#include <gfbgraph/gfbgraph-field-set.h>
 
 G_BEGIN_DECLS
 
@@ -59,9 +60,22 @@ struct _GFBGraphNodeClass {
 
 typedef enum {
   GFBGRAPH_NODE_ERROR_NO_CONNECTIONABLE = 1,
-  GFBGRAPH_NODE_ERROR_NO_CONNECTABLE
+  GFBGRAPH_NODE_ERROR_NO_CONNECTABLE,
+  GFBGRAPH_NODE_ERROR_REQUEST_FAILED
 } GFBGraphNodeError;
 
+/**
+ * GFBGraphNodeFunc:
+ * @node: (transfer none): a #GFBGraphNode just parsed, take a reference to keep it.
+ * @user_data: (closure): the user data passed to the function which calls it.
+ *
+ * Callback used to deliver, one at a time, the nodes parsed from a response.
+ *
+ * Returns: %TRUE to continue with the next node, %FALSE to stop.
+ **/
+typedef gboolean (*GFBGraphNodeFunc) (GFBGraphNode *node,
+                                      gpointer      user_data);
+
 GType          gfbgraph_node_get_type    (void) G_GNUC_CONST;
 GQuark         gfbgraph_node_error_quark (void) G_GNUC_CONST;
 GFBGraphNode*  gfbgraph_node_new         (void);
@@ -70,19 +84,76 @@ GFBGraphNode*  gfbgraph_node_new_from_id (GFBGraphAuthorizer  *authorizer,
                                           const gchar         *id,
                                           GType                node_type,
                                           GError             **error);
+GFBGraphNode*  gfbgraph_node_new_from_id_with_fields (GFBGraphAuthorizer  *authorizer,
+                                                      const gchar         *id,
+                                                      GType                node_type,
+                                                      GFBGraphFieldSet    *fields,
+                                                      GError             **error);
+GHashTable*    gfbgraph_node_new_from_ids (GFBGraphAuthorizer   *authorizer,
+                                           const gchar * const  *ids,
+                                           GType                 node_type,
+                                           GFBGraphFieldSet     *fields,
+                                           guint                 batch_size,
+                                           GHashTable          **errors,
+                                           GError              **error);
+void           gfbgraph_node_new_from_ids_async (GFBGraphAuthorizer   *authorizer,
+                                                 const gchar * const  *ids,
+                                                 GType                 node_type,
+                                                 GFBGraphFieldSet     *fields,
+                                                 guint                 batch_size,
+                                                 GCancellable         *cancellable,
+                                                 GAsyncReadyCallback   callback,
+                                                 gpointer              user_data);
+GHashTable*    gfbgraph_node_new_from_ids_async_finish (GFBGraphAuthorizer  *authorizer,
+                                                        GAsyncResult        *result,
+                                                        GHashTable         **errors,
+                                                        GError             **error);
 
 const gchar*   gfbgraph_node_get_id           (GFBGraphNode *node);
 const gchar*   gfbgraph_node_get_link         (GFBGraphNode *node);
 const gchar*   gfbgraph_node_get_created_time (GFBGraphNode *node);
 const gchar*   gfbgraph_node_get_updated_time (GFBGraphNode *node);
+gint64         gfbgraph_node_get_created_timestamp (GFBGraphNode *node);
+gint64         gfbgraph_node_get_updated_timestamp (GFBGraphNode *node);
+gboolean       gfbgraph_node_is_stale         (GFBGraphNode *node,
+                                               const gchar  *updated_time);
 
 void           gfbgraph_node_set_id           (GFBGraphNode *node,
                                                const gchar  *id);
+void           gfbgraph_node_merge            (GFBGraphNode *node,
+                                               GFBGraphNode *source);
 
 GList*         gfbgraph_node_get_connection_nodes (GFBGraphNode        *node,
                                                    GType                node_type,
                                                    GFBGraphAuthorizer  *authorizer,
                                                    GError             **error);
+GList*         gfbgraph_node_get_connection_nodes_with_fields (GFBGraphNode        *node,
+                                                               GType                node_type,
+                                                               GFBGraphAuthorizer  *authorizer,
+                                                               GFBGraphFieldSet    *fields,
+                                                               GError             **error);
+GPtrArray*     gfbgraph_node_get_connection_nodes_array (GFBGraphNode        *node,
+                                                         GType                node_type,
+                                                         GFBGraphAuthorizer  *authorizer,
+                                                         GFBGraphFieldSet    *fields,
+                                                         GError             **error);
+void           gfbgraph_node_get_connection_nodes_array_async (GFBGraphNode        *node,
+                                                               GType                node_type,
+                                                               GFBGraphAuthorizer  *authorizer,
+                                                               GFBGraphFieldSet    *fields,
+                                                               GCancellable        *cancellable,
+                                                               GAsyncReadyCallback  callback,
+                                                               gpointer             user_data);
+GPtrArray*     gfbgraph_node_get_connection_nodes_array_async_finish (GFBGraphNode  *node,
+                                                                      GAsyncResult  *result,
+                                                                      GError       **error);
+gboolean       gfbgraph_node_foreach_connection_node (GFBGraphNode        *node,
+                                                      GType                node_type,
+                                                      GFBGraphAuthorizer  *authorizer,
+                                                      GFBGraphFieldSet    *fields,
+                                                      GFBGraphNodeFunc     func,
+                                                      gpointer             user_data,
+                                                      GError             **error);
 void           gfbgraph_node_get_connection_nodes_async (GFBGraphNode        *node,
                                                          GType                node_type,
                                                          GFBGraphAuthorizer  *authorizer,
@@ -30,12 +30,12 @@
 #include "gfbgraph-photo.h"
 #include "gfbgraph-connectable.h"
 #include "gfbgraph-album.h"
+#include "gfbgraph-context.h"
+#include "gfbgraph-private.h"
 
+#include <string.h>
 #include <json-glib/json-glib.h>
 #include <libsoup/soup.h>
-#include <libsoup/soup-request.h>
-#include <libsoup/soup-request-http.h>
-#include <libsoup/soup-requester.h>
 
 enum {
   PROP_0,
@@ -46,15 +46,32 @@ enum {
   PROP_IMAGES
 };
 
+/* The image variants are stored in a single block, sorted by width and
+ * followed by the indexes of the images sorted by height and by area, so the
+ * nearest size lookups are binary searches. Their sources are stored in a
+ * single string arena. A table is never modified once built: a merge
+ * replaces it, and the replaced ones are kept until the photo is finalized,
+ * as their images may have been returned to other threads. */
+typedef struct {
+  GFBGraphPhotoImage *images;
+  guint              *by_height;
+  guint              *by_area;
+  guint               n_images;
+  gchar              *sources;
+  GList              *list;           /* Built on demand by gfbgraph_photo_get_images(), atomic */
+} ImageTable;
+
 struct _GFBGraphPhotoPrivate {
   gchar              *name;
   gchar              *source;
   guint               width;
   guint               height;
-  GList              *images;
-  GFBGraphPhotoImage *hires_image;
+  ImageTable         *images;         /* Atomic, NULL without images */
+  GSList             *retired_images; /* ImageTable replaced by a merge */
 };
 
+typedef guint64 (*ImageKeyFunc) (const GFBGraphPhotoImage *image);
+
 #define GFBGRAPH_PHOTO_GET_PRIVATE(o) \
   (G_TYPE_INSTANCE_GET_PRIVATE((o), GFBGRAPH_TYPE_PHOTO, GFBGraphPhotoPrivate))
 
@@ -68,29 +85,251 @@ G_DEFINE_TYPE_WITH_CODE (GFBGraphPhoto, gfbgraph_photo, GFBGRAPH_TYPE_NODE,
   G_IMPLEMENT_INTERFACE (JSON_TYPE_SERIALIZABLE, serializable_iface_init););
 
 static void
-gfbgraph_photo_finalize (GObject *obj)
+image_table_free (ImageTable *table)
 {
-  GList *images;
-  GFBGraphPhotoImage *photo_image;
-  GFBGraphPhotoPrivate *priv = GFBGRAPH_PHOTO_GET_PRIVATE (obj);
+  g_free (table->images);
+  g_free (table->sources);
+  g_list_free (table->list);
+  g_slice_free (ImageTable, table);
+}
+
+static ImageTable *
+peek_images (GFBGraphPhotoPrivate *priv)
+{
+  return g_atomic_pointer_get (&priv->images);
+}
+
+/* Publishes @table, retiring the current one */
+static void
+replace_images (GFBGraphPhotoPrivate *priv,
+                ImageTable           *table)
+{
+  ImageTable *old = priv->images;
+
+  g_atomic_pointer_set (&priv->images, table);
+  if (old != NULL)
+    priv->retired_images = g_slist_prepend (priv->retired_images, old);
+}
+
+static guint64
+image_width (const GFBGraphPhotoImage *image)
+{
+  return image->width;
+}
+
+static guint64
+image_height (const GFBGraphPhotoImage *image)
+{
+  return image->height;
+}
+
+static guint64
+image_area (const GFBGraphPhotoImage *image)
+{
+  return (guint64) image->width * image->height;
+}
+
+static gint
+compare_images_by_width (gconstpointer a,
+                         gconstpointer b)
+{
+  const GFBGraphPhotoImage *image_a = a;
+  const GFBGraphPhotoImage *image_b = b;
+
+  if (image_a->width != image_b->width)
+    return image_a->width < image_b->width ? -1 : 1;
+  if (image_a->height != image_b->height)
+    return image_a->height < image_b->height ? -1 : 1;
+  return 0;
+}
+
+typedef struct {
+  const GFBGraphPhotoImage *images;
+  ImageKeyFunc              key_func;
+} ImageIndexData;
+
+static gint
+compare_indexes (gconstpointer a,
+                 gconstpointer b,
+                 gpointer      user_data)
+{
+  ImageIndexData *data = user_data;
+  guint64 key_a, key_b;
+
+  key_a = data->key_func (&data->images[*(const guint *) a]);
+  key_b = data->key_func (&data->images[*(const guint *) b]);
+  if (key_a != key_b)
+    return key_a < key_b ? -1 : 1;
+
+  /* The ties keep the width order */
+  return (gint) *(const guint *) a - (gint) *(const guint *) b;
+}
+
+/* Fills @index with the positions of the @n_images of @images, sorted by the
+ * key of @key_func, and returns it */
+static guint *
+build_index (const GFBGraphPhotoImage *images,
+             guint                     n_images,
+             guint                    *index,
+             ImageKeyFunc              key_func)
+{
+  ImageIndexData data = { images, key_func };
+  guint i;
+
+  for (i = 0; i < n_images; i++)
+    index[i] = i;
+  g_qsort_with_data (index, n_images, sizeof (guint), compare_indexes, &data);
+
+  return index;
+}
+
+/* Returns a new table with a copy of @images, or %NULL if there're none */
+static ImageTable *
+image_table_new (const GFBGraphPhotoImage *images,
+                 guint                     n_images)
+{
+  ImageTable *table;
+  gsize sources_size = 0;
+  gchar *arena;
+  guint i;
+
+  if (n_images == 0)
+    return NULL;
+
+  table = g_slice_new0 (ImageTable);
+  table->n_images = n_images;
+  table->images = g_malloc (n_images * (sizeof (GFBGraphPhotoImage) + 2 * sizeof (guint)));
+  memcpy (table->images, images, n_images * sizeof (GFBGraphPhotoImage));
+  qsort (table->images, n_images, sizeof (GFBGraphPhotoImage), compare_images_by_width);
+
+  /* The sources are copied after sorting, so the arena follows the same order */
+  for (i = 0; i < n_images; i++) {
+    if (table->images[i].source != NULL)
+      sources_size += strlen (table->images[i].source) + 1;
+  }
+  arena = table->sources = g_malloc (MAX (sources_size, 1));
+  for (i = 0; i < n_images; i++) {
+    const gchar *source = table->images[i].source;
+
+    if (source != NULL) {
+      gsize length = strlen (source) + 1;
+
+      memcpy (arena, source, length);
+      table->images[i].source = arena;
+      arena += length;
+    }
+  }
+
+  table->by_height = build_index (table->images, n_images,
+                                  (guint *) (table->images + n_images),
+                                  image_height);
+  table->by_area = build_index (table->images, n_images,
+                                table->by_height + n_images,
+                                image_area);
+
+  return table;
+}
+
+/* Returns the image whose key is the nearest to @key, looking for it with a
+ * binary search over the images in the order of @index (or by width if %NULL),
+ * which must be sorted by @key_func. The ties are resolved with the bigger one. */
+static const GFBGraphPhotoImage *
+find_nearest_image (const ImageTable *table,
+                    const guint      *index,
+                    ImageKeyFunc      key_func,
+                    guint64           key)
+{
+  const GFBGraphPhotoImage *lower, *upper;
+  guint low, high;
+
+  if (table == NULL)
+    return NULL;
+
+  low = 0;
+  high = table->n_images;
+
+#define IMAGE_AT(i) (&table->images[index != NULL ? index[i] : (i)])
+
+  /* First image whose key isn't lower than @key */
+  while (low < high) {
+    guint middle = low + (high - low) / 2;
+
+    if (key_func (IMAGE_AT (middle)) < key)
+      low = middle + 1;
+    else
+      high = middle;
+  }
+
+  if (low == table->n_images)
+    return IMAGE_AT (table->n_images - 1);
+  if (low == 0)
+    return IMAGE_AT (0);
+
+  lower = IMAGE_AT (low - 1);
+  upper = IMAGE_AT (low);
+
+#undef IMAGE_AT
+
+  return key - key_func (lower) < key_func (upper) - key ? lower : upper;
+}
 
-  images = priv->images;
-  while (images) {
-    photo_image = (GFBGraphPhotoImage *) images->data;
+/* Takes the #GList of #GFBGraphPhotoImage set in the "images" property */
+static void
+set_images_from_list (GFBGraphPhotoPrivate *priv,
+                      GList                *images_list)
+{
+  GFBGraphPhotoImage *images;
+  guint i, n_images;
+  GList *l;
+
+  n_images = g_list_length (images_list);
+  images = g_new (GFBGraphPhotoImage, MAX (n_images, 1));
+  for (l = images_list, i = 0; l != NULL; l = l->next, i++)
+    images[i] = *(GFBGraphPhotoImage *) l->data;
+
+  replace_images (priv, image_table_new (images, n_images));
+
+  for (l = images_list; l != NULL; l = l->next) {
+    GFBGraphPhotoImage *photo_image = l->data;
 
     g_free (photo_image->source);
     g_free (photo_image);
-
-    images = g_list_next (images);
   }
+  g_list_free (images_list);
+  g_free (images);
+}
 
-  g_free (priv->name);
-  g_free (priv->source);
-  g_list_free (priv->images);
+static void
+gfbgraph_photo_finalize (GObject *obj)
+{
+  GFBGraphPhotoPrivate *priv = GFBGRAPH_PHOTO_GET_PRIVATE (obj);
+
+  gfbgraph_node_clear_string (GFBGRAPH_NODE (obj), &priv->name);
+  gfbgraph_node_clear_string (GFBGRAPH_NODE (obj), &priv->source);
+  g_clear_pointer (&priv->images, image_table_free);
+  g_slist_free_full (priv->retired_images, (GDestroyNotify) image_table_free);
 
   G_OBJECT_CLASS(parent_class)->finalize (obj);
 }
 
+/* The images are owned by the photo, so they are moved from @source */
+static void
+gfbgraph_photo_merge (GFBGraphNode *node,
+                      GFBGraphNode *source)
+{
+  GFBGraphPhotoPrivate *priv = GFBGRAPH_PHOTO_GET_PRIVATE (node);
+  GFBGraphPhotoPrivate *source_priv = GFBGRAPH_PHOTO_GET_PRIVATE (source);
+  ImageTable *table;
+
+  table = g_atomic_pointer_get (&source_priv->images);
+  if (table != NULL) {
+    g_atomic_pointer_set (&source_priv->images, NULL);
+    replace_images (priv, table);
+
+    g_object_notify (G_OBJECT (node), "images");
+  }
+}
+
 static void
 gfbgraph_photo_set_property (GObject      *object,
                              guint         prop_id,
@@ -101,14 +340,10 @@ gfbgraph_photo_set_property (GObject      *object,
 
   switch (prop_id) {
     case PROP_NAME:
-      if (priv->name)
-        g_free (priv->name);
-      priv->name = g_strdup (g_value_get_string (value));
+      gfbgraph_node_set_string (GFBGRAPH_NODE (object), &priv->name, g_value_get_string (value));
       break;
     case PROP_SOURCE:
-      if (priv->source)
-        g_free (priv->source);
-      priv->source = g_strdup (g_value_get_string (value));
+      gfbgraph_node_set_string (GFBGRAPH_NODE (object), &priv->source, g_value_get_string (value));
       break;
     case PROP_WIDTH:
       priv->width = g_value_get_uint (value);
@@ -117,8 +352,7 @@ gfbgraph_photo_set_property (GObject      *object,
       priv->height = g_value_get_uint (value);
       break;
     case PROP_IMAGES:
-      /* TODO: Free GList memory with g_list_free_full */
-      priv->images = g_value_get_pointer (value);
+      set_images_from_list (priv, g_value_get_pointer (value));
       break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
@@ -148,7 +382,8 @@ gfbgraph_photo_get_property (GObject    *object,
       g_value_set_uint (value, priv->height);
       break;
     case PROP_IMAGES:
-      g_value_set_pointer (value, priv->images);
+      g_value_set_pointer (value, gfbgraph_photo_get_images (GFBGRAPH_PHOTO (object)));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -159,7 +394,6 @@ static void
 gfbgraph_photo_init (GFBGraphPhoto *obj)
 {
   obj->priv = GFBGRAPH_PHOTO_GET_PRIVATE(obj);
-  obj->priv->images = NULL;
 }
 
 static void
@@ -173,6 +407,7 @@ gfbgraph_photo_class_init (GFBGraphPhotoClass *klass)
   gobject_class->get_property = gfbgraph_photo_get_property;
 
   g_type_class_add_private (gobject_class, sizeof(GFBGraphPhotoPrivate));
+  gfbgraph_node_type_set_merge_func (GFBGRAPH_TYPE_PHOTO, gfbgraph_photo_merge);
 
   /**
    * GFBGraphPhoto:name:
@@ -266,6 +501,8 @@ connectable_iface_init (GFBGraphConnectableInterface *iface)
   iface->connections = connections;
   iface->get_connection_post_params = get_connection_post_params;
   iface->parse_connected_data = gfbgraph_connectable_default_parse_connected_data;
+  iface->parse_connected_data_array = gfbgraph_connectable_default_parse_connected_data_array;
+  iface->parse_connected_data_foreach = gfbgraph_connectable_default_parse_connected_data_foreach;
 }
 
 /* --- Serializable Interface --- */
@@ -299,30 +536,29 @@ serializable_deserialize_property (JsonSerializable *serializable,
 
   if (g_strcmp0 ("images", property_name) == 0) {
     if (JSON_NODE_HOLDS_ARRAY (property_node)) {
+      GFBGraphPhotoImage *images;
       guint i, num_images;
       JsonArray *jarray;
-      GList *images = NULL;
 
       jarray = json_node_get_array (property_node);
       num_images = json_array_get_length (jarray);
+      images = g_new0 (GFBGraphPhotoImage, MAX (num_images, 1));
       for (i = 0; i < num_images; i++) {
         JsonObject *image_object;
-        GFBGraphPhotoImage *photo_image;
 
         image_object = json_array_get_object_element (jarray, i);
-        photo_image = g_new0 (GFBGraphPhotoImage, 1);
-        photo_image->width = json_object_get_int_member (image_object,
-                                                         "width");
-        photo_image->height = json_object_get_int_member (image_object,
-                                                          "height");
-        photo_image->source = g_strdup (json_object_get_string_member (image_object,
-                                                                       "source"));
-
-        images = g_list_append (images, photo_image);
+        images[i].width = json_object_get_int_member (image_object, "width");
+        images[i].height = json_object_get_int_member (image_object, "height");
+        /* Borrowed from the parser, image_table_new() copies it into the arena */
+        images[i].source = (gchar *) json_object_get_string_member (image_object, "source");
       }
 
-      g_value_set_pointer (value, (gpointer *) images);
-      res = TRUE;
+      /* The table is built in place instead of going through the "images"
+       * property, so there's no value to set */
+      replace_images (GFBGRAPH_PHOTO_GET_PRIVATE (serializable),
+                      image_table_new (images, num_images));
+      g_free (images);
+      res = FALSE;
     } else {
       g_warning ("The 'images' node retrieved from the Facebook Graph API isn't an array,"
                  "it's holding a %s\n",
@@ -387,6 +623,89 @@ serializable_iface_init (JsonSerializableIface *iface)
   iface->get_property         = serializable_get_property;
 }
 
+/* --- Private Functions --- */
+static GInputStream *
+check_image_response (SoupMessage   *msg,
+                      GInputStream  *stream,
+                      GError       **error)
+{
+  if (!SOUP_STATUS_IS_SUCCESSFUL (msg->status_code)) {
+    g_set_error (error, GFBGRAPH_NODE_ERROR,
+                 GFBGRAPH_NODE_ERROR_REQUEST_FAILED,
+                 "Error downloading the image (HTTP %u): %s",
+                 msg->status_code, msg->reason_phrase);
+    g_object_unref (stream);
+    return NULL;
+  }
+
+  return stream;
+}
+
+/* Keep the session alive while the stream is, even if the context goes away */
+static void
+keep_session_alive (GInputStream *stream,
+                    SoupSession  *session)
+{
+  g_object_weak_ref (G_OBJECT (stream),
+                     (GWeakNotify) g_object_unref,
+                     g_object_ref (session));
+}
+
+static GInputStream *
+download_uri (GFBGraphAuthorizer  *authorizer,
+              const gchar         *uri,
+              GCancellable        *cancellable,
+              GError             **error)
+{
+  GInputStream *stream;
+  SoupSession *session;
+  SoupMessage *msg;
+
+  msg = soup_message_new (SOUP_METHOD_GET, uri);
+  if (msg == NULL) {
+    g_set_error (error, GFBGRAPH_NODE_ERROR,
+                 GFBGRAPH_NODE_ERROR_REQUEST_FAILED,
+                 "Invalid image URI: %s", uri);
+    return NULL;
+  }
+
+  /* Shared and pooled session, so downloading a whole album reuses the connections */
+  session = gfbgraph_context_get_session (gfbgraph_context_get_for_authorizer (authorizer));
+
+  stream = soup_session_send (session, msg, cancellable, error);
+  if (stream != NULL)
+    stream = check_image_response (msg, stream, error);
+  if (stream != NULL)
+    keep_session_alive (stream, session);
+
+  g_object_unref (msg);
+
+  return stream;
+}
+
+static void
+image_sent_cb (GObject      *source_object,
+               GAsyncResult *result,
+               gpointer      user_data)
+{
+  GTask *task = G_TASK (user_data);
+  GInputStream *stream;
+  GError *error = NULL;
+
+  stream = soup_session_send_finish (SOUP_SESSION (source_object), result, &error);
+  if (stream != NULL)
+    stream = check_image_response (g_task_get_task_data (task), stream, &error);
+
+  if (stream != NULL) {
+    keep_session_alive (stream, SOUP_SESSION (source_object));
+    g_task_return_pointer (task, stream, g_object_unref);
+  } else {
+    g_task_return_error (task, error);
+  }
+
+  g_object_unref (task);
+}
+
 /**
  * gfbgraph_photo_new:
  *
@@ -438,41 +757,112 @@ gfbgraph_photo_download_default_size (GFBGraphPhoto       *photo,
                                       GFBGraphAuthorizer  *authorizer,
                                       GError             **error)
 {
-  GInputStream *stream = NULL;
-  SoupSession *session;
-  SoupRequester *requester;
-  SoupRequest *request;
-  SoupMessage *message;
-  GFBGraphPhotoPrivate *priv;
-
   g_return_val_if_fail (GFBGRAPH_IS_PHOTO (photo), NULL);
   g_return_val_if_fail (GFBGRAPH_IS_AUTHORIZER (authorizer), NULL);
 
-  priv = GFBGRAPH_PHOTO_GET_PRIVATE (photo);
-
-  session = soup_session_sync_new ();
-  requester = soup_requester_new ();
-  g_object_set (G_OBJECT (session), "ssl-use-system-ca-file", TRUE, NULL);
-  soup_session_add_feature (session, SOUP_SESSION_FEATURE (requester));
+  return download_uri (authorizer, photo->priv->source, NULL, error);
+}
 
-  request = soup_requester_request (requester, priv->source, error);
-  if (request != NULL) {
-    message = soup_request_http_get_message (SOUP_REQUEST_HTTP (request));
+/**
+ * gfbgraph_photo_download_image:
+ * @photo: a #GFBGraphPhoto.
+ * @image: one of the #GFBGraphPhotoImage of @photo.
+ * @authorizer: a #GFBGraphAuthorizer.
+ * @cancellable: (allow-none): An optional #GCancellable object, or %NULL.
+ * @error: (allow-none): a #GError or %NULL.
+ *
+ * Downloads the @image variant of @photo, like the one returned by
+ * gfbgraph_photo_get_image_for_size(), so a thumbnail can be retrieved without
+ * downloading the default size. See gfbgraph_photo_download_image_async() for
+ * the asynchronous version of this call.
+ *
+ * Returns: (transfer full): a #GInputStream with the image content or %NULL in case of error.
+ **/
+GInputStream *
+gfbgraph_photo_download_image (GFBGraphPhoto             *photo,
+                               const GFBGraphPhotoImage  *image,
+                               GFBGraphAuthorizer        *authorizer,
+                               GCancellable              *cancellable,
+                               GError                   **error)
+{
+  g_return_val_if_fail (GFBGRAPH_IS_PHOTO (photo), NULL);
+  g_return_val_if_fail (image != NULL && image->source != NULL, NULL);
+  g_return_val_if_fail (GFBGRAPH_IS_AUTHORIZER (authorizer), NULL);
+  g_return_val_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable), NULL);
 
-    stream = soup_request_send (request, NULL, error);
-    if (stream != NULL) {
-      g_object_weak_ref (G_OBJECT (stream),
-                         (GWeakNotify)g_object_unref,
-                         session);
-    }
+  return download_uri (authorizer, image->source, cancellable, error);
+}
 
-    g_clear_object (&message);
-    g_clear_object (&request);
+/**
+ * gfbgraph_photo_download_image_async:
+ * @photo: a #GFBGraphPhoto.
+ * @image: one of the #GFBGraphPhotoImage of @photo.
+ * @authorizer: a #GFBGraphAuthorizer.
+ * @cancellable: (allow-none): An optional #GCancellable object, or %NULL.
+ * @callback: (scope async): A #GAsyncReadyCallback to call when the request is completed.
+ * @user_data: (closure): The data to pass to @callback.
+ *
+ * Asynchronously downloads the @image variant of @photo. See
+ * gfbgraph_photo_download_image() for the synchronous version of this call.
+ *
+ * When the response is received, @callback will be called. You can then call
+ * gfbgraph_photo_download_image_async_finish() to get the stream with the content.
+ **/
+void
+gfbgraph_photo_download_image_async (GFBGraphPhoto             *photo,
+                                     const GFBGraphPhotoImage  *image,
+                                     GFBGraphAuthorizer        *authorizer,
+                                     GCancellable              *cancellable,
+                                     GAsyncReadyCallback        callback,
+                                     gpointer                   user_data)
+{
+  SoupSession *session;
+  SoupMessage *msg;
+  GTask *task;
+
+  g_return_if_fail (GFBGRAPH_IS_PHOTO (photo));
+  g_return_if_fail (image != NULL && image->source != NULL);
+  g_return_if_fail (GFBGRAPH_IS_AUTHORIZER (authorizer));
+  g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+  g_return_if_fail (callback != NULL);
+
+  task = g_task_new (photo, cancellable, callback, user_data);
+  g_task_set_source_tag (task, gfbgraph_photo_download_image_async);
+
+  msg = soup_message_new (SOUP_METHOD_GET, image->source);
+  if (msg == NULL) {
+    g_task_return_new_error (task, GFBGRAPH_NODE_ERROR,
+                             GFBGRAPH_NODE_ERROR_REQUEST_FAILED,
+                             "Invalid image URI: %s", image->source);
+    g_object_unref (task);
+    return;
   }
+  g_task_set_task_data (task, msg, g_object_unref);
 
-  g_clear_object (&requester);
+  session = gfbgraph_context_get_session (gfbgraph_context_get_for_authorizer (authorizer));
+  soup_session_send_async (session, msg, cancellable, image_sent_cb, task);
+}
 
-  return stream;
+/**
+ * gfbgraph_photo_download_image_async_finish:
+ * @photo: a #GFBGraphPhoto.
+ * @result: A #GAsyncResult.
+ * @error: (allow-none): An optional #GError, or %NULL.
+ *
+ * Finishes an asynchronous operation started with
+ * gfbgraph_photo_download_image_async().
+ *
+ * Returns: (transfer full): a #GInputStream with the image content or %NULL in case of error.
+ **/
+GInputStream *
+gfbgraph_photo_download_image_async_finish (GFBGraphPhoto  *photo,
+                                            GAsyncResult   *result,
+                                            GError        **error)
+{
+  g_return_val_if_fail (g_task_is_valid (result, photo), NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  return g_task_propagate_pointer (G_TASK (result), error);
 }
 
 /**
@@ -535,14 +925,75 @@ gfbgraph_photo_get_default_height (GFBGraphPhoto *photo)
  * gfbgraph_photo_get_images:
  * @photo: a #GFBGraphPhoto.
  *
- * Returns: (element-type GFBGraphPhotoImage) (transfer none): a #GList of #GFBGraphPhotoImage with the available photo sizes
+ * Returns: (element-type GFBGraphPhotoImage) (transfer none): a #GList of #GFBGraphPhotoImage with the available photo sizes,
+ * sorted by width.
  **/
 GList *
 gfbgraph_photo_get_images (GFBGraphPhoto *photo)
 {
+  ImageTable *table;
+
   g_return_val_if_fail (GFBGRAPH_IS_PHOTO (photo), NULL);
 
-  return photo->priv->images;
+  table = peek_images (photo->priv);
+  if (table == NULL)
+    return NULL;
+
+  if (g_atomic_pointer_get (&table->list) == NULL) {
+    GList *images_list = NULL;
+    guint i;
+
+    for (i = table->n_images; i > 0; i--)
+      images_list = g_list_prepend (images_list, &table->images[i - 1]);
+
+    /* The photo can be shared by other threads, so keep the first list built */
+    if (!g_atomic_pointer_compare_and_exchange (&table->list, NULL, images_list))
+      g_list_free (images_list);
+  }
+
+  return g_atomic_pointer_get (&table->list);
+}
+
+/**
+ * gfbgraph_photo_get_n_images:
+ * @photo: a #GFBGraphPhoto.
+ *
+ * Returns: the number of image variants of @photo.
+ **/
+guint
+gfbgraph_photo_get_n_images (GFBGraphPhoto *photo)
+{
+  ImageTable *table;
+
+  g_return_val_if_fail (GFBGRAPH_IS_PHOTO (photo), 0);
+
+  table = peek_images (photo->priv);
+
+  return table != NULL ? table->n_images : 0;
+}
+
+/**
+ * gfbgraph_photo_get_image:
+ * @photo: a #GFBGraphPhoto.
+ * @index: the position of the image, lower than gfbgraph_photo_get_n_images().
+ *
+ * Gets an image variant of @photo. The images are sorted by width, so the
+ * first one is the smallest and the last one the biggest.
+ *
+ * Returns: (transfer none): a #GFBGraphPhotoImage.
+ **/
+const GFBGraphPhotoImage *
+gfbgraph_photo_get_image (GFBGraphPhoto *photo,
+                          guint          index)
+{
+  ImageTable *table;
+
+  g_return_val_if_fail (GFBGRAPH_IS_PHOTO (photo), NULL);
+
+  table = peek_images (photo->priv);
+  g_return_val_if_fail (table != NULL && index < table->n_images, NULL);
+
+  return &table->images[index];
 }
 
 /**
@@ -554,80 +1005,160 @@ gfbgraph_photo_get_images (GFBGraphPhoto *photo)
 const GFBGraphPhotoImage *
 gfbgraph_photo_get_image_hires (GFBGraphPhoto *photo)
 {
-  g_return_val_if_fail (GFBGRAPH_IS_PHOTO (photo), NULL);
+  ImageTable *table;
 
-  if (photo->priv->hires_image == NULL) {
-    GList *images_list;
-    guint bigger_width;
-    GFBGraphPhotoImage *photo_image;
-
-    bigger_width = 0;
-    images_list = photo->priv->images;
-    while (images_list) {
-      photo_image = (GFBGraphPhotoImage *) images_list->data;
-      if (photo_image->width > bigger_width) {
-        photo->priv->hires_image = photo_image;
-        bigger_width = photo_image->width;
-      }
+  g_return_val_if_fail (GFBGRAPH_IS_PHOTO (photo), NULL);
 
-      images_list = g_list_next (images_list);
-    }
-  }
+  table = peek_images (photo->priv);
+  if (table == NULL)
+    return NULL;
 
-  return photo->priv->hires_image;
+  return &table->images[table->n_images - 1];
 }
 
+/**
+ * gfbgraph_photo_get_image_near_width:
+ * @photo: a #GFBGraphPhoto.
+ * @width: the desired width.
+ *
+ * Returns: (transfer none): the #GFBGraphPhotoImage with the width nearest to @width,
+ * or %NULL if @photo has no images.
+ **/
 const GFBGraphPhotoImage *
 gfbgraph_photo_get_image_near_width (GFBGraphPhoto *photo,
                                      guint          width)
 {
-  GList *images_list;
-  GFBGraphPhotoImage *tmp_photo_image;
-  GFBGraphPhotoImage *photo_image = NULL;
-  gint tmp_w_dif, w_dif;
+  g_return_val_if_fail (GFBGRAPH_IS_PHOTO (photo), NULL);
+
+  return find_nearest_image (peek_images (photo->priv), NULL, image_width, width);
+}
+
+/**
+ * gfbgraph_photo_get_image_near_height:
+ * @photo: a #GFBGraphPhoto.
+ * @height: the desired height.
+ *
+ * Returns: (transfer none): the #GFBGraphPhotoImage with the height nearest to @height,
+ * or %NULL if @photo has no images.
+ **/
+const GFBGraphPhotoImage *
+gfbgraph_photo_get_image_near_height (GFBGraphPhoto *photo,
+                                      guint          height)
+{
+  ImageTable *table;
+
+  g_return_val_if_fail (GFBGRAPH_IS_PHOTO (photo), NULL);
+
+  table = peek_images (photo->priv);
+
+  return find_nearest_image (table, table != NULL ? table->by_height : NULL, image_height, height);
+}
+
+/**
+ * gfbgraph_photo_get_image_near_area:
+ * @photo: a #GFBGraphPhoto.
+ * @width: the desired width.
+ * @height: the desired height.
+ *
+ * Looks for the image whose number of pixels is the nearest to @width x @height,
+ * regardless of its shape.
+ *
+ * Returns: (transfer none): a #GFBGraphPhotoImage, or %NULL if @photo has no images.
+ **/
+const GFBGraphPhotoImage *
+gfbgraph_photo_get_image_near_area (GFBGraphPhoto *photo,
+                                    guint          width,
+                                    guint          height)
+{
+  ImageTable *table;
 
   g_return_val_if_fail (GFBGRAPH_IS_PHOTO (photo), NULL);
 
-  images_list = photo->priv->images;
-  while (images_list) {
-    tmp_photo_image = (GFBGraphPhotoImage *) images_list->data;
-    tmp_w_dif = tmp_photo_image->width - width;
-    tmp_w_dif = (tmp_w_dif > 0) ? tmp_w_dif : (tmp_w_dif * -1);
+  table = peek_images (photo->priv);
+
+  return find_nearest_image (table, table != NULL ? table->by_area : NULL, image_area,
+                             (guint64) width * height);
+}
+
+/**
+ * gfbgraph_photo_get_image_near_aspect_ratio:
+ * @photo: a #GFBGraphPhoto.
+ * @aspect_ratio: the desired width / height ratio.
+ *
+ * Looks for the image whose aspect ratio is the nearest to @aspect_ratio, like
+ * the square variants used as thumbnails. Among the images with the same ratio,
+ * the biggest one is returned.
+ *
+ * Returns: (transfer none): a #GFBGraphPhotoImage, or %NULL if @photo has no images.
+ **/
+const GFBGraphPhotoImage *
+gfbgraph_photo_get_image_near_aspect_ratio (GFBGraphPhoto *photo,
+                                            gdouble        aspect_ratio)
+{
+  ImageTable *table;
+  const GFBGraphPhotoImage *photo_image = NULL;
+  gdouble best_diff = G_MAXDOUBLE;
+  guint i;
+
+  g_return_val_if_fail (GFBGRAPH_IS_PHOTO (photo), NULL);
+  g_return_val_if_fail (aspect_ratio > 0, NULL);
 
-    if (photo_image == NULL || tmp_w_dif < w_dif) {
-      w_dif = tmp_w_dif;
+  table = peek_images (photo->priv);
+  if (table == NULL)
+    return NULL;
+
+  /* The ratio isn't monotonic in any of the orders, but there're just a few
+   * variants. Walking from the biggest keeps it on ties. */
+  for (i = table->n_images; i > 0; i--) {
+    const GFBGraphPhotoImage *tmp_photo_image = &table->images[i - 1];
+    gdouble diff;
+
+    if (tmp_photo_image->height == 0)
+      continue;
+
+    diff = ABS ((gdouble) tmp_photo_image->width / tmp_photo_image->height - aspect_ratio);
+    if (diff < best_diff) {
+      best_diff = diff;
       photo_image = tmp_photo_image;
     }
-
-    images_list = g_list_next (images_list);
   }
 
   return photo_image;
 }
 
+/**
+ * gfbgraph_photo_get_image_for_size:
+ * @photo: a #GFBGraphPhoto.
+ * @width: the minimum width.
+ * @height: the minimum height.
+ *
+ * Looks for the smallest image of @photo that is at least @width x @height
+ * pixels, so it can be scaled down without losing quality. If all the images
+ * are smaller, the bigger one is returned.
+ *
+ * Returns: (transfer none): a #GFBGraphPhotoImage, or %NULL if @photo has no images.
+ **/
 const GFBGraphPhotoImage *
-gfbgraph_photo_get_image_near_height (GFBGraphPhoto *photo,
-                                      guint          height)
+gfbgraph_photo_get_image_for_size (GFBGraphPhoto *photo,
+                                   guint          width,
+                                   guint          height)
 {
-  GList *images_list;
-  GFBGraphPhotoImage *tmp_photo_image;
-  GFBGraphPhotoImage *photo_image = NULL;
-  gint tmp_h_dif, h_dif;
+  ImageTable *table;
+  guint i;
 
   g_return_val_if_fail (GFBGRAPH_IS_PHOTO (photo), NULL);
 
-  images_list = photo->priv->images;
-  while (images_list) {
-    tmp_photo_image = (GFBGraphPhotoImage *) images_list->data;
-    tmp_h_dif = ABS(tmp_photo_image->height - height);
+  table = peek_images (photo->priv);
+  if (table == NULL)
+    return NULL;
 
-    if (photo_image == NULL || tmp_h_dif < h_dif) {
-      h_dif = tmp_h_dif;
-      photo_image = tmp_photo_image;
-    }
+  /* The first one big enough in the area order is the smallest */
+  for (i = 0; i < table->n_images; i++) {
+    const GFBGraphPhotoImage *photo_image = &table->images[table->by_area[i]];
 
-    images_list = g_list_next (images_list);
+    if (photo_image->width >= width && photo_image->height >= height)
+      return photo_image;
   }
 
-  return photo_image;
+  return &table->images[table->n_images - 1];
 }
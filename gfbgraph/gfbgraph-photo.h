@@ -76,17 +76,42 @@ GFBGraphPhoto* gfbgraph_photo_new_from_id (GFBGraphAuthorizer  *authorizer,
 GInputStream*  gfbgraph_photo_download_default_size (GFBGraphPhoto       *photo,
                                                      GFBGraphAuthorizer  *authorizer,
                                                      GError             **error);
+GInputStream*  gfbgraph_photo_download_image        (GFBGraphPhoto             *photo,
+                                                     const GFBGraphPhotoImage  *image,
+                                                     GFBGraphAuthorizer        *authorizer,
+                                                     GCancellable              *cancellable,
+                                                     GError                   **error);
+void           gfbgraph_photo_download_image_async  (GFBGraphPhoto             *photo,
+                                                     const GFBGraphPhotoImage  *image,
+                                                     GFBGraphAuthorizer        *authorizer,
+                                                     GCancellable              *cancellable,
+                                                     GAsyncReadyCallback        callback,
+                                                     gpointer                   user_data);
+GInputStream*  gfbgraph_photo_download_image_async_finish (GFBGraphPhoto  *photo,
+                                                           GAsyncResult   *result,
+                                                           GError        **error);
 
 const gchar*        gfbgraph_photo_get_name               (GFBGraphPhoto *photo);
 const gchar*        gfbgraph_photo_get_default_source_uri (GFBGraphPhoto *photo);
 guint               gfbgraph_photo_get_default_width      (GFBGraphPhoto *photo);
 guint               gfbgraph_photo_get_default_height     (GFBGraphPhoto *photo);
 GList*              gfbgraph_photo_get_images             (GFBGraphPhoto *photo);
+guint               gfbgraph_photo_get_n_images           (GFBGraphPhoto *photo);
+const GFBGraphPhotoImage* gfbgraph_photo_get_image              (GFBGraphPhoto *photo,
+                                                                 guint          index);
 const GFBGraphPhotoImage* gfbgraph_photo_get_image_hires        (GFBGraphPhoto *photo);
 const GFBGraphPhotoImage* gfbgraph_photo_get_image_near_width   (GFBGraphPhoto *photo,
                                                                  guint          width);
 const GFBGraphPhotoImage* gfbgraph_photo_get_image_near_height  (GFBGraphPhoto *photo,
                                                                  guint          height);
+const GFBGraphPhotoImage* gfbgraph_photo_get_image_near_area    (GFBGraphPhoto *photo,
+                                                                 guint          width,
+                                                                 guint          height);
+const GFBGraphPhotoImage* gfbgraph_photo_get_image_near_aspect_ratio (GFBGraphPhoto *photo,
+                                                                      gdouble        aspect_ratio);
+const GFBGraphPhotoImage* gfbgraph_photo_get_image_for_size     (GFBGraphPhoto *photo,
+                                                                 guint          width,
+                                                                 guint          height);
 
 G_END_DECLS
 
@@ -0,0 +1,306 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 2; tab-width: 2 -*-  */
+/*
+ * libgfbgraph - GObject library for Facebook Graph API
+ * Copyright (C) 2013 Álvaro Peña <alvaropg@gmail.com>
+ *               2020 Leesoo Ahn <yisooan@fedoraproject.org>
+ *
+ * GFBGraph is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GFBGraph is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GFBGraph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GFBGRAPH_PRIVATE_H__
+#define __GFBGRAPH_PRIVATE_H__
+
+/* Internal helpers shared between the library sources, not installed */
+
+#include <glib.h>
+
+#include <gio/gio.h>
+#include <json-glib/json-glib.h>
+#include <rest/rest-proxy-call.h>
+
+#include "gfbgraph-authorizer.h"
+#include "gfbgraph-cache.h"
+#include "gfbgraph-connectable.h"
+#include "gfbgraph-context.h"
+#include "gfbgraph-identity-map.h"
+#include "gfbgraph-retry-policy.h"
+#include "gfbgraph-scheduler.h"
+
+G_BEGIN_DECLS
+
+typedef struct _GFBGraphStringArena GFBGraphStringArena;
+
+/* An access token readable without locks, see gfbgraph-token-cell.c */
+typedef struct {
+  gchar  *token;
+  gint    readers[2];   /* Active readers in each epoch */
+  gint    epoch;
+  GMutex  write_mutex;
+} GFBGraphTokenCell;
+
+/* The retries of a request, see gfbgraph_retry_policy_next_delay() */
+typedef struct {
+  guint   n_retries;
+  gint64  last_delay;   /* Microseconds */
+} GFBGraphRetryState;
+
+/* Enough for any 64 bits ID formatted by gfbgraph_node_peek_id() */
+#define GFBGRAPH_NODE_ID_BUFFER_SIZE 21
+
+/* Moves into @node the data of @source that isn't in a copyable property */
+typedef void (*GFBGraphNodeMergeFunc) (GFBGraphNode *node,
+                                       GFBGraphNode *source);
+
+typedef gboolean (*GFBGraphJsonSliceFunc) (const gchar  *name,
+                                           gsize         name_length,
+                                           const gchar  *value,
+                                           gsize         value_length,
+                                           gpointer      user_data,
+                                           GError      **error);
+
+/* Resolved connection between a source node type and the connectable
+ * type of the nodes connected to it */
+typedef struct {
+  GType                         source_type;
+  GType                         target_type;
+  const gchar                  *path;
+  GFBGraphConnectableInterface *iface;
+  GFBGraphConnectable          *parser; /* Only for implementers with their own parse functions */
+} GFBGraphConnectionInfo;
+
+G_GNUC_INTERNAL
+GBytes*    gfbgraph_call_sync   (RestProxyCall        *call,
+                                 GCancellable         *cancellable,
+                                 GError              **error);
+G_GNUC_INTERNAL
+void       gfbgraph_call_async  (RestProxyCall        *call,
+                                 GCancellable         *cancellable,
+                                 GAsyncReadyCallback   callback,
+                                 gpointer              user_data);
+G_GNUC_INTERNAL
+GBytes*    gfbgraph_call_finish (RestProxyCall        *call,
+                                 GAsyncResult         *result,
+                                 GError              **error);
+
+/* Builds the result of a call from its payload: a #GObject shared by the
+ * identical calls in progress, or %NULL with @error set */
+typedef gpointer (*GFBGraphCallParseFunc) (RestProxyCall  *call,
+                                           GType           node_type,
+                                           GBytes         *payload,
+                                           GError        **error);
+
+G_GNUC_INTERNAL
+gpointer   gfbgraph_call_sync_parsed   (RestProxyCall          *call,
+                                        GFBGraphCallParseFunc   parse_func,
+                                        GType                   node_type,
+                                        GCancellable           *cancellable,
+                                        GError                **error);
+G_GNUC_INTERNAL
+void       gfbgraph_call_async_parsed  (RestProxyCall          *call,
+                                        GFBGraphCallParseFunc   parse_func,
+                                        GType                   node_type,
+                                        GCancellable           *cancellable,
+                                        GAsyncReadyCallback     callback,
+                                        gpointer                user_data);
+G_GNUC_INTERNAL
+gpointer   gfbgraph_call_finish_parsed (RestProxyCall          *call,
+                                        GAsyncResult           *result,
+                                        GError                **error);
+
+/* A response stored in a #GFBGraphCache */
+typedef struct {
+  GBytes *payload;
+  gchar  *etag;
+  gint64  stored_time; /* Seconds since the epoch of the last validation */
+} GFBGraphCacheEntry;
+
+G_GNUC_INTERNAL
+gint       gfbgraph_call_get_graph_error_code       (RestProxyCall *call);
+G_GNUC_INTERNAL
+gchar*     gfbgraph_call_lookup_response_header     (RestProxyCall *call,
+                                                     const gchar   *header_name);
+
+G_GNUC_INTERNAL
+gchar*              gfbgraph_cache_get_key        (RestProxyCall      *call);
+G_GNUC_INTERNAL
+GFBGraphCacheEntry* gfbgraph_cache_lookup         (GFBGraphCache      *cache,
+                                                   const gchar        *key);
+G_GNUC_INTERNAL
+gboolean            gfbgraph_cache_entry_is_fresh (GFBGraphCache      *cache,
+                                                   GFBGraphCacheEntry *entry);
+G_GNUC_INTERNAL
+void                gfbgraph_cache_entry_free     (GFBGraphCacheEntry *entry);
+G_GNUC_INTERNAL
+void                gfbgraph_cache_store          (GFBGraphCache      *cache,
+                                                   const gchar        *key,
+                                                   const gchar        *etag,
+                                                   GBytes             *payload);
+G_GNUC_INTERNAL
+void                gfbgraph_cache_touch          (GFBGraphCache      *cache,
+                                                   const gchar        *key);
+
+G_GNUC_INTERNAL
+GFBGraphContext*    gfbgraph_call_get_context    (RestProxyCall *call);
+G_GNUC_INTERNAL
+GFBGraphAuthorizer* gfbgraph_call_get_authorizer (RestProxyCall *call);
+G_GNUC_INTERNAL
+GFBGraphCache*      gfbgraph_context_dup_cache   (GFBGraphContext *context);
+G_GNUC_INTERNAL
+GFBGraphIdentityMap* gfbgraph_context_dup_identity_map (GFBGraphContext *context);
+G_GNUC_INTERNAL
+GFBGraphRetryPolicy* gfbgraph_context_dup_retry_policy (GFBGraphContext *context);
+
+G_GNUC_INTERNAL
+GFBGraphNode* gfbgraph_identity_map_canonicalize       (GFBGraphAuthorizer *authorizer,
+                                                        GFBGraphNode       *node,
+                                                        const gchar        *fields);
+G_GNUC_INTERNAL
+void          gfbgraph_identity_map_canonicalize_array (GFBGraphAuthorizer *authorizer,
+                                                        GPtrArray          *nodes,
+                                                        const gchar        *fields);
+G_GNUC_INTERNAL
+GFBGraphNode* gfbgraph_identity_map_lookup_fetched     (GFBGraphAuthorizer *authorizer,
+                                                        const gchar        *id,
+                                                        GType               node_type,
+                                                        const gchar        *fields);
+
+G_GNUC_INTERNAL
+gboolean   gfbgraph_scheduler_acquire        (GFBGraphScheduler    *scheduler,
+                                              GFBGraphAuthorizer   *authorizer,
+                                              GCancellable         *cancellable,
+                                              GError              **error);
+G_GNUC_INTERNAL
+void       gfbgraph_scheduler_acquire_async  (GFBGraphScheduler    *scheduler,
+                                              GFBGraphAuthorizer   *authorizer,
+                                              GCancellable         *cancellable,
+                                              GAsyncReadyCallback   callback,
+                                              gpointer              user_data);
+G_GNUC_INTERNAL
+gboolean   gfbgraph_scheduler_acquire_finish (GFBGraphScheduler    *scheduler,
+                                              GAsyncResult         *result,
+                                              GError              **error);
+G_GNUC_INTERNAL
+void       gfbgraph_scheduler_release        (GFBGraphScheduler    *scheduler,
+                                              GFBGraphAuthorizer   *authorizer,
+                                              RestProxyCall        *call,
+                                              GMainContext         *context);
+
+G_GNUC_INTERNAL
+void       gfbgraph_retry_policy_deposit     (GFBGraphRetryPolicy  *policy);
+G_GNUC_INTERNAL
+gboolean   gfbgraph_retry_policy_next_delay  (GFBGraphRetryPolicy  *policy,
+                                              RestProxyCall        *call,
+                                              const GError         *error,
+                                              GFBGraphRetryState   *state,
+                                              gint64               *delay);
+
+G_GNUC_INTERNAL
+GFBGraphStringArena* gfbgraph_string_arena_new         (void);
+G_GNUC_INTERNAL
+GFBGraphStringArena* gfbgraph_string_arena_ref         (GFBGraphStringArena *arena);
+G_GNUC_INTERNAL
+void                 gfbgraph_string_arena_unref       (GFBGraphStringArena *arena);
+G_GNUC_INTERNAL
+const gchar*         gfbgraph_string_arena_insert      (GFBGraphStringArena *arena,
+                                                        const gchar         *str);
+G_GNUC_INTERNAL
+gboolean             gfbgraph_string_arena_contains    (GFBGraphStringArena *arena,
+                                                        const gchar         *str);
+G_GNUC_INTERNAL
+GFBGraphStringArena* gfbgraph_string_arena_get_current (void);
+G_GNUC_INTERNAL
+GFBGraphStringArena* gfbgraph_string_arena_set_current (GFBGraphStringArena *arena);
+
+G_GNUC_INTERNAL
+void         gfbgraph_token_cell_init       (GFBGraphTokenCell *cell);
+G_GNUC_INTERNAL
+void         gfbgraph_token_cell_clear      (GFBGraphTokenCell *cell);
+G_GNUC_INTERNAL
+const gchar* gfbgraph_token_cell_read_begin (GFBGraphTokenCell *cell,
+                                             guint             *slot);
+G_GNUC_INTERNAL
+void         gfbgraph_token_cell_read_end   (GFBGraphTokenCell *cell,
+                                             guint              slot);
+G_GNUC_INTERNAL
+gchar*       gfbgraph_token_cell_dup        (GFBGraphTokenCell *cell);
+G_GNUC_INTERNAL
+void         gfbgraph_token_cell_set        (GFBGraphTokenCell *cell,
+                                             const gchar       *token);
+
+G_GNUC_INTERNAL
+GFBGraphNode* gfbgraph_node_deserialize   (GType                node_type,
+                                           JsonNode            *jnode,
+                                           GFBGraphStringArena *arena);
+G_GNUC_INTERNAL
+const gchar*  gfbgraph_node_peek_id       (GFBGraphNode        *node,
+                                           gchar               *buffer);
+G_GNUC_INTERNAL
+void          gfbgraph_node_set_string    (GFBGraphNode        *node,
+                                           gchar              **field,
+                                           const gchar         *value);
+G_GNUC_INTERNAL
+void          gfbgraph_node_clear_string  (GFBGraphNode        *node,
+                                           gchar              **field);
+G_GNUC_INTERNAL
+void          gfbgraph_node_type_set_merge_func (GType                 node_type,
+                                                 GFBGraphNodeMergeFunc merge_func);
+
+G_GNUC_INTERNAL
+GList*     gfbgraph_nodes_array_to_list (GPtrArray *nodes);
+G_GNUC_INTERNAL
+GPtrArray* gfbgraph_nodes_list_to_array (GList     *nodes);
+
+G_GNUC_INTERNAL
+gboolean   gfbgraph_json_foreach_member  (const gchar            *json,
+                                          gssize                  length,
+                                          GFBGraphJsonSliceFunc   func,
+                                          gpointer                user_data,
+                                          GError                **error);
+G_GNUC_INTERNAL
+gboolean   gfbgraph_json_foreach_element (const gchar            *json,
+                                          gssize                  length,
+                                          GFBGraphJsonSliceFunc   func,
+                                          gpointer                user_data,
+                                          GError                **error);
+G_GNUC_INTERNAL
+gboolean   gfbgraph_json_get_member      (const gchar            *json,
+                                          gssize                  length,
+                                          const gchar            *member_name,
+                                          const gchar           **value,
+                                          gsize                  *value_length,
+                                          GError                **error);
+G_GNUC_INTERNAL
+guint      gfbgraph_json_count_elements  (const gchar            *json,
+                                          gssize                  length);
+
+G_GNUC_INTERNAL
+const GFBGraphConnectionInfo* gfbgraph_connection_info_lookup        (GType                          source_type,
+                                                                      GType                          target_type,
+                                                                      GError                       **error);
+G_GNUC_INTERNAL
+GPtrArray*                    gfbgraph_connection_info_parse_array   (const GFBGraphConnectionInfo  *info,
+                                                                      const gchar                   *payload,
+                                                                      gssize                         length,
+                                                                      GError                       **error);
+G_GNUC_INTERNAL
+gboolean                      gfbgraph_connection_info_parse_foreach (const GFBGraphConnectionInfo  *info,
+                                                                      const gchar                   *payload,
+                                                                      gssize                         length,
+                                                                      GFBGraphNodeFunc               func,
+                                                                      gpointer                       user_data,
+                                                                      GError                       **error);
+
+G_END_DECLS
+
+#endif /* __GFBGRAPH_PRIVATE_H__ */
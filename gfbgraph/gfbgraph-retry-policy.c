@@ -0,0 +1,569 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 2; tab-width: 2 -*-  */
+/*
+ * libgfbgraph - GObject library for Facebook Graph API
+ * Copyright (C) 2013 Álvaro Peña <alvaropg@gmail.com>
+ *               2020 Leesoo Ahn <yisooan@fedoraproject.org>
+ *
+ * GFBGraph is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GFBGraph is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GFBGraph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * SECTION:gfbgraph-retry-policy
+ * @title: GFBGraphRetryPolicy
+ * @short_description: Retries of the failed Graph API requests
+ * @stability: Unstable
+ * @include: gfbgraph/gfbgraph.h
+ *
+ * A #GFBGraphRetryPolicy set in a #GFBGraphContext (see
+ * gfbgraph_context_set_retry_policy()) sends again the requests of the context
+ * failing for a transient reason, instead of failing the whole operation.
+ *
+ * Every #GFBGraphRetryClass of failures has its own rule: the maximum number
+ * of retries of a request, and the base and maximum delays before a retry.
+ * The delays follow a decorrelated jitter backoff, a random value between the
+ * base delay and three times the previous delay, so the requests failed at the
+ * same time don't come back at the same time. A Retry-After header in the
+ * response sets the minimum delay, and the request isn't retried if it asks
+ * for more than the maximum delay of the rule.
+ *
+ * The retries of all the requests sharing the policy are limited by a budget:
+ * every request adds #GFBGraphRetryPolicy:budget-ratio retries to it, and it
+ * gets #GFBGraphRetryPolicy:min-retry-rate retries per second, so a long
+ * outage ends up with a few retries instead of multiplying the load of the
+ * Graph API.
+ *
+ * Only the GET requests are retried after network and server errors, as the
+ * other ones could have been done. All of them are retried when throttled.
+ **/
+
+#include <libsoup/soup.h>
+#include <rest/rest-proxy.h>
+#include <string.h>
+
+#include "gfbgraph-retry-policy.h"
+#include "gfbgraph-private.h"
+
+#define N_RETRY_CLASSES (GFBGRAPH_RETRY_CLASS_GRAPH_THROTTLED + 1)
+
+#define DEFAULT_BUDGET_RATIO   0.1
+#define DEFAULT_MIN_RETRY_RATE 1.0
+/* Retries the budget can save for a burst of failures */
+#define BUDGET_CAPACITY        10.0
+
+/* Graph API error codes */
+#define GRAPH_ERROR_UNKNOWN         1
+#define GRAPH_ERROR_SERVICE         2
+#define GRAPH_ERROR_APP_LIMIT       4
+#define GRAPH_ERROR_USER_LIMIT      17
+#define GRAPH_ERROR_PAGE_LIMIT      32
+#define GRAPH_ERROR_CALL_LIMIT      341
+#define GRAPH_ERROR_BUC_LIMIT_FIRST 80000
+#define GRAPH_ERROR_BUC_LIMIT_LAST  80014
+
+enum {
+  PROP_0,
+  PROP_BUDGET_RATIO,
+  PROP_MIN_RETRY_RATE
+};
+
+typedef struct {
+  guint max_retries;
+  guint base_delay;      /* Milliseconds */
+  guint max_delay;
+} RetryRule;
+
+struct _GFBGraphRetryPolicyPrivate {
+  GMutex    mutex;
+  RetryRule rules[N_RETRY_CLASSES];
+  gdouble   budget_ratio;
+  gdouble   min_retry_rate;
+  gdouble   budget;
+  gint64    last_refill; /* Monotonic time, in microseconds */
+};
+
+static const RetryRule default_rules[N_RETRY_CLASSES] = {
+  [GFBGRAPH_RETRY_CLASS_NETWORK]         = { 3,  200, 10000 },
+  [GFBGRAPH_RETRY_CLASS_SERVER_ERROR]    = { 3,  500, 30000 },
+  [GFBGRAPH_RETRY_CLASS_GRAPH_TRANSIENT] = { 3, 1000, 30000 },
+  [GFBGRAPH_RETRY_CLASS_GRAPH_THROTTLED] = { 2, 2000, 60000 }
+};
+
+#define GFBGRAPH_RETRY_POLICY_GET_PRIVATE(o) \
+  (G_TYPE_INSTANCE_GET_PRIVATE((o), GFBGRAPH_TYPE_RETRY_POLICY, GFBGraphRetryPolicyPrivate))
+
+static GObjectClass *parent_class = NULL;
+
+G_DEFINE_TYPE (GFBGraphRetryPolicy, gfbgraph_retry_policy, G_TYPE_OBJECT);
+
+static void
+gfbgraph_retry_policy_finalize (GObject *object)
+{
+  GFBGraphRetryPolicyPrivate *priv = GFBGRAPH_RETRY_POLICY_GET_PRIVATE (object);
+
+  g_mutex_clear (&priv->mutex);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static void
+gfbgraph_retry_policy_set_property (GObject      *object,
+                                    guint         prop_id,
+                                    const GValue *value,
+                                    GParamSpec   *pspec)
+{
+  GFBGraphRetryPolicyPrivate *priv = GFBGRAPH_RETRY_POLICY_GET_PRIVATE (object);
+
+  g_mutex_lock (&priv->mutex);
+
+  switch (prop_id) {
+    case PROP_BUDGET_RATIO:
+      priv->budget_ratio = g_value_get_double (value);
+      break;
+    case PROP_MIN_RETRY_RATE:
+      priv->min_retry_rate = g_value_get_double (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+
+  g_mutex_unlock (&priv->mutex);
+}
+
+static void
+gfbgraph_retry_policy_get_property (GObject    *object,
+                                    guint       prop_id,
+                                    GValue     *value,
+                                    GParamSpec *pspec)
+{
+  GFBGraphRetryPolicyPrivate *priv = GFBGRAPH_RETRY_POLICY_GET_PRIVATE (object);
+
+  g_mutex_lock (&priv->mutex);
+
+  switch (prop_id) {
+    case PROP_BUDGET_RATIO:
+      g_value_set_double (value, priv->budget_ratio);
+      break;
+    case PROP_MIN_RETRY_RATE:
+      g_value_set_double (value, priv->min_retry_rate);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+
+  g_mutex_unlock (&priv->mutex);
+}
+
+static void
+gfbgraph_retry_policy_class_init (GFBGraphRetryPolicyClass *klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+
+  parent_class                 = g_type_class_peek_parent (klass);
+  gobject_class->finalize      = gfbgraph_retry_policy_finalize;
+  gobject_class->set_property  = gfbgraph_retry_policy_set_property;
+  gobject_class->get_property  = gfbgraph_retry_policy_get_property;
+
+  g_type_class_add_private (gobject_class, sizeof(GFBGraphRetryPolicyPrivate));
+
+  /**
+   * GFBGraphRetryPolicy:budget-ratio:
+   *
+   * The retries added to the budget by every request. With the default, 0.1,
+   * the retries are at most a tenth of the requests, besides the ones allowed
+   * by #GFBGraphRetryPolicy:min-retry-rate.
+   **/
+  g_object_class_install_property (gobject_class,
+                                   PROP_BUDGET_RATIO,
+                                   g_param_spec_double ("budget-ratio",
+                                                        "Budget ratio",
+                                                        "The retries added to the budget by every request",
+                                                        0.0, G_MAXDOUBLE, DEFAULT_BUDGET_RATIO,
+                                                        G_PARAM_CONSTRUCT | G_PARAM_READWRITE));
+
+  /**
+   * GFBGraphRetryPolicy:min-retry-rate:
+   *
+   * The retries per second added to the budget, so the requests done rarely
+   * can be retried too.
+   **/
+  g_object_class_install_property (gobject_class,
+                                   PROP_MIN_RETRY_RATE,
+                                   g_param_spec_double ("min-retry-rate",
+                                                        "Minimum retry rate",
+                                                        "The retries per second added to the budget",
+                                                        0.0, G_MAXDOUBLE, DEFAULT_MIN_RETRY_RATE,
+                                                        G_PARAM_CONSTRUCT | G_PARAM_READWRITE));
+}
+
+static void
+gfbgraph_retry_policy_init (GFBGraphRetryPolicy *obj)
+{
+  GFBGraphRetryPolicyPrivate *priv;
+
+  obj->priv = priv = GFBGRAPH_RETRY_POLICY_GET_PRIVATE (obj);
+
+  g_mutex_init (&priv->mutex);
+  memcpy (priv->rules, default_rules, sizeof (default_rules));
+  priv->budget = BUDGET_CAPACITY;
+  priv->last_refill = g_get_monotonic_time ();
+}
+
+/* --- Private Functions --- */
+
+/* Sets @retry_class to the kind of the failure of @call with @error.
+ * Returns %FALSE if it isn't worth retrying. */
+static gboolean
+classify_failure (RestProxyCall      *call,
+                  const GError       *error,
+                  GFBGraphRetryClass *retry_class)
+{
+  guint status;
+  gint error_code;
+
+  if (error->domain != REST_PROXY_ERROR)
+    return FALSE;
+
+  switch (error->code) {
+    case REST_PROXY_ERROR_RESOLUTION:
+    case REST_PROXY_ERROR_CONNECTION:
+    case REST_PROXY_ERROR_IO:
+      *retry_class = GFBGRAPH_RETRY_CLASS_NETWORK;
+      return TRUE;
+    default:
+      break;
+  }
+
+  error_code = gfbgraph_call_get_graph_error_code (call);
+  switch (error_code) {
+    case GRAPH_ERROR_UNKNOWN:
+    case GRAPH_ERROR_SERVICE:
+      *retry_class = GFBGRAPH_RETRY_CLASS_GRAPH_TRANSIENT;
+      return TRUE;
+    case GRAPH_ERROR_APP_LIMIT:
+    case GRAPH_ERROR_USER_LIMIT:
+    case GRAPH_ERROR_PAGE_LIMIT:
+    case GRAPH_ERROR_CALL_LIMIT:
+      *retry_class = GFBGRAPH_RETRY_CLASS_GRAPH_THROTTLED;
+      return TRUE;
+    default:
+      if (error_code >= GRAPH_ERROR_BUC_LIMIT_FIRST && error_code <= GRAPH_ERROR_BUC_LIMIT_LAST) {
+        *retry_class = GFBGRAPH_RETRY_CLASS_GRAPH_THROTTLED;
+        return TRUE;
+      }
+      break;
+  }
+
+  /* Other Graph API errors won't go away by retrying */
+  if (error_code != 0)
+    return FALSE;
+
+  status = rest_proxy_call_get_status_code (call);
+  if (status == 429) {
+    *retry_class = GFBGRAPH_RETRY_CLASS_GRAPH_THROTTLED;
+    return TRUE;
+  } else if (status >= 500 && status < 600) {
+    *retry_class = GFBGRAPH_RETRY_CLASS_SERVER_ERROR;
+    return TRUE;
+  }
+
+  return FALSE;
+}
+
+/* Returns the delay in microseconds asked by the Retry-After header of the
+ * response of @call, in seconds or as a date, or 0 */
+static gint64
+get_retry_after (RestProxyCall *call)
+{
+  gchar *value;
+  gchar *end;
+  gint64 delay = 0;
+
+  value = gfbgraph_call_lookup_response_header (call, "Retry-After");
+  if (value == NULL)
+    return 0;
+
+  g_strstrip (value);
+  delay = g_ascii_strtoll (value, &end, 10);
+  if (end != value && *end == '\0') {
+    delay = MAX (delay, 0) * G_USEC_PER_SEC;
+  } else {
+    SoupDate *date;
+
+    delay = 0;
+    date = soup_date_new_from_string (value);
+    if (date != NULL) {
+      delay = MAX ((gint64) soup_date_to_time_t (date) - g_get_real_time () / G_USEC_PER_SEC, 0) * G_USEC_PER_SEC;
+      soup_date_free (date);
+    }
+  }
+
+  g_free (value);
+
+  return delay;
+}
+
+/* Takes a retry from the budget, refilled by the time passed since the last
+ * time. Must be called with the mutex locked. */
+static gboolean
+budget_withdraw_locked (GFBGraphRetryPolicyPrivate *priv)
+{
+  gint64 now;
+
+  now = g_get_monotonic_time ();
+  priv->budget = MIN (priv->budget + priv->min_retry_rate * (now - priv->last_refill) / G_USEC_PER_SEC,
+                      BUDGET_CAPACITY);
+  priv->last_refill = now;
+
+  if (priv->budget < 1.0)
+    return FALSE;
+
+  priv->budget -= 1.0;
+
+  return TRUE;
+}
+
+/* --- Internal API --- */
+
+/* Adds the share of @policy budget of a request about to be sent */
+void
+gfbgraph_retry_policy_deposit (GFBGraphRetryPolicy *policy)
+{
+  GFBGraphRetryPolicyPrivate *priv = policy->priv;
+
+  g_mutex_lock (&priv->mutex);
+  priv->budget = MIN (priv->budget + priv->budget_ratio, BUDGET_CAPACITY);
+  g_mutex_unlock (&priv->mutex);
+}
+
+/* Whether @call, failed with @error, has to be sent again. If so, @delay is
+ * set to the microseconds to wait before and @state is updated. */
+gboolean
+gfbgraph_retry_policy_next_delay (GFBGraphRetryPolicy *policy,
+                                  RestProxyCall       *call,
+                                  const GError        *error,
+                                  GFBGraphRetryState  *state,
+                                  gint64              *delay)
+{
+  GFBGraphRetryPolicyPrivate *priv = policy->priv;
+  GFBGraphRetryClass retry_class;
+  RetryRule rule;
+  gint64 retry_after, base_delay, max_delay, upper;
+
+  if (!classify_failure (call, error, &retry_class))
+    return FALSE;
+
+  if (retry_class != GFBGRAPH_RETRY_CLASS_GRAPH_THROTTLED
+      && g_strcmp0 (rest_proxy_call_get_method (call), "GET") != 0)
+    return FALSE;
+
+  g_mutex_lock (&priv->mutex);
+  rule = priv->rules[retry_class];
+  g_mutex_unlock (&priv->mutex);
+
+  if (state->n_retries >= rule.max_retries)
+    return FALSE;
+
+  base_delay = (gint64) rule.base_delay * 1000;
+  max_delay = MAX ((gint64) rule.max_delay * 1000, base_delay);
+
+  retry_after = get_retry_after (call);
+  if (retry_after > max_delay)
+    return FALSE;
+
+  g_mutex_lock (&priv->mutex);
+  if (!budget_withdraw_locked (priv)) {
+    g_mutex_unlock (&priv->mutex);
+    return FALSE;
+  }
+  g_mutex_unlock (&priv->mutex);
+
+  /* Decorrelated jitter */
+  upper = MIN (MAX (state->last_delay, base_delay) * 3, max_delay);
+  if (upper > base_delay)
+    *delay = base_delay + (gint64) g_random_double_range (0, upper - base_delay);
+  else
+    *delay = base_delay;
+  *delay = MAX (*delay, retry_after);
+
+  state->n_retries++;
+  state->last_delay = *delay;
+
+  return TRUE;
+}
+
+/* --- Public API --- */
+
+/**
+ * gfbgraph_retry_policy_new:
+ *
+ * Creates a new #GFBGraphRetryPolicy with the default rules. Use it in the
+ * #GFBGraphContext:retry-policy property of several contexts to share its
+ * retry budget between them.
+ *
+ * Returns: (transfer full): a new #GFBGraphRetryPolicy; unref with g_object_unref()
+ **/
+GFBGraphRetryPolicy *
+gfbgraph_retry_policy_new (void)
+{
+  return GFBGRAPH_RETRY_POLICY (g_object_new (GFBGRAPH_TYPE_RETRY_POLICY, NULL));
+}
+
+/**
+ * gfbgraph_retry_policy_get_rule:
+ * @policy: a #GFBGraphRetryPolicy.
+ * @retry_class: a #GFBGraphRetryClass.
+ * @max_retries: (out) (allow-none): return location for the maximum number of
+ *   retries of a request, or %NULL.
+ * @base_delay: (out) (allow-none): return location for the minimum delay before
+ *   a retry in milliseconds, or %NULL.
+ * @max_delay: (out) (allow-none): return location for the maximum delay before
+ *   a retry in milliseconds, or %NULL.
+ *
+ * Gets the rule of the failures of @retry_class.
+ **/
+void
+gfbgraph_retry_policy_get_rule (GFBGraphRetryPolicy *policy,
+                                GFBGraphRetryClass   retry_class,
+                                guint               *max_retries,
+                                guint               *base_delay,
+                                guint               *max_delay)
+{
+  RetryRule rule;
+
+  g_return_if_fail (GFBGRAPH_IS_RETRY_POLICY (policy));
+  g_return_if_fail (retry_class < N_RETRY_CLASSES);
+
+  g_mutex_lock (&policy->priv->mutex);
+  rule = policy->priv->rules[retry_class];
+  g_mutex_unlock (&policy->priv->mutex);
+
+  if (max_retries != NULL)
+    *max_retries = rule.max_retries;
+  if (base_delay != NULL)
+    *base_delay = rule.base_delay;
+  if (max_delay != NULL)
+    *max_delay = rule.max_delay;
+}
+
+/**
+ * gfbgraph_retry_policy_set_rule:
+ * @policy: a #GFBGraphRetryPolicy.
+ * @retry_class: a #GFBGraphRetryClass.
+ * @max_retries: the maximum number of retries of a request, 0 to not retry them.
+ * @base_delay: the minimum delay before a retry, in milliseconds.
+ * @max_delay: the maximum delay before a retry, in milliseconds.
+ *
+ * Sets how the requests failed with @retry_class are retried. This function is
+ * thread safe.
+ **/
+void
+gfbgraph_retry_policy_set_rule (GFBGraphRetryPolicy *policy,
+                                GFBGraphRetryClass   retry_class,
+                                guint                max_retries,
+                                guint                base_delay,
+                                guint                max_delay)
+{
+  RetryRule *rule;
+
+  g_return_if_fail (GFBGRAPH_IS_RETRY_POLICY (policy));
+  g_return_if_fail (retry_class < N_RETRY_CLASSES);
+  g_return_if_fail (base_delay <= max_delay);
+
+  g_mutex_lock (&policy->priv->mutex);
+  rule = &policy->priv->rules[retry_class];
+  rule->max_retries = max_retries;
+  rule->base_delay = base_delay;
+  rule->max_delay = max_delay;
+  g_mutex_unlock (&policy->priv->mutex);
+}
+
+/**
+ * gfbgraph_retry_policy_get_budget_ratio:
+ * @policy: a #GFBGraphRetryPolicy.
+ *
+ * Returns: the retries added to the budget by every request.
+ **/
+gdouble
+gfbgraph_retry_policy_get_budget_ratio (GFBGraphRetryPolicy *policy)
+{
+  gdouble ratio;
+
+  g_return_val_if_fail (GFBGRAPH_IS_RETRY_POLICY (policy), 0);
+
+  g_object_get (G_OBJECT (policy),
+                "budget-ratio", &ratio,
+                NULL);
+
+  return ratio;
+}
+
+/**
+ * gfbgraph_retry_policy_set_budget_ratio:
+ * @policy: a #GFBGraphRetryPolicy.
+ * @ratio: the retries added to the budget by every request.
+ *
+ * Sets the retries added to the budget by every request, see
+ * #GFBGraphRetryPolicy:budget-ratio.
+ **/
+void
+gfbgraph_retry_policy_set_budget_ratio (GFBGraphRetryPolicy *policy,
+                                        gdouble              ratio)
+{
+  g_return_if_fail (GFBGRAPH_IS_RETRY_POLICY (policy));
+
+  g_object_set (G_OBJECT (policy),
+                "budget-ratio", ratio,
+                NULL);
+}
+
+/**
+ * gfbgraph_retry_policy_get_min_retry_rate:
+ * @policy: a #GFBGraphRetryPolicy.
+ *
+ * Returns: the retries per second added to the budget.
+ **/
+gdouble
+gfbgraph_retry_policy_get_min_retry_rate (GFBGraphRetryPolicy *policy)
+{
+  gdouble rate;
+
+  g_return_val_if_fail (GFBGRAPH_IS_RETRY_POLICY (policy), 0);
+
+  g_object_get (G_OBJECT (policy),
+                "min-retry-rate", &rate,
+                NULL);
+
+  return rate;
+}
+
+/**
+ * gfbgraph_retry_policy_set_min_retry_rate:
+ * @policy: a #GFBGraphRetryPolicy.
+ * @rate: the retries per second added to the budget.
+ *
+ * Sets the retries per second added to the budget, see
+ * #GFBGraphRetryPolicy:min-retry-rate.
+ **/
+void
+gfbgraph_retry_policy_set_min_retry_rate (GFBGraphRetryPolicy *policy,
+                                          gdouble              rate)
+{
+  g_return_if_fail (GFBGRAPH_IS_RETRY_POLICY (policy));
+
+  g_object_set (G_OBJECT (policy),
+                "min-retry-rate", rate,
+                NULL);
+}
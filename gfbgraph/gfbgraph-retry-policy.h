@@ -0,0 +1,100 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 2; tab-width: 2 -*-  */
+/*
+ * libgfbgraph - GObject library for Facebook Graph API
+ * Copyright (C) 2013 Álvaro Peña <alvaropg@gmail.com>
+ *               2020 Leesoo Ahn <yisooan@fedoraproject.org>
+ *
+ * GFBGraph is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GFBGraph is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GFBGraph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GFBGRAPH_RETRY_POLICY_H__
+#define __GFBGRAPH_RETRY_POLICY_H__
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define GFBGRAPH_TYPE_RETRY_POLICY (gfbgraph_retry_policy_get_type())
+#define GFBGRAPH_RETRY_POLICY(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj),GFBGRAPH_TYPE_RETRY_POLICY,GFBGraphRetryPolicy))
+#define GFBGRAPH_RETRY_POLICY_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass),GFBGRAPH_TYPE_RETRY_POLICY,GFBGraphRetryPolicyClass))
+#define GFBGRAPH_IS_RETRY_POLICY(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj),GFBGRAPH_TYPE_RETRY_POLICY))
+#define GFBGRAPH_IS_RETRY_POLICY_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass),GFBGRAPH_TYPE_RETRY_POLICY))
+#define GFBGRAPH_RETRY_POLICY_GET_CLASS(obj) \
+  (G_TYPE_INSTANCE_GET_CLASS((obj),GFBGRAPH_TYPE_RETRY_POLICY,GFBGraphRetryPolicyClass))
+
+typedef struct _GFBGraphRetryPolicy        GFBGraphRetryPolicy;
+typedef struct _GFBGraphRetryPolicyClass   GFBGraphRetryPolicyClass;
+typedef struct _GFBGraphRetryPolicyPrivate GFBGraphRetryPolicyPrivate;
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (GFBGraphRetryPolicy, g_object_unref)
+
+struct _GFBGraphRetryPolicy {
+  GObject parent;
+
+  /*< private >*/
+  GFBGraphRetryPolicyPrivate *priv;
+};
+
+struct _GFBGraphRetryPolicyClass {
+  GObjectClass parent_class;
+};
+
+/**
+ * GFBGraphRetryClass:
+ * @GFBGRAPH_RETRY_CLASS_NETWORK: the Graph API couldn't be reached, or the
+ *   connection was lost.
+ * @GFBGRAPH_RETRY_CLASS_SERVER_ERROR: an HTTP 5xx error without a Graph API
+ *   error code.
+ * @GFBGRAPH_RETRY_CLASS_GRAPH_TRANSIENT: the Graph API errors 1 (unknown
+ *   error) and 2 (service temporarily unavailable).
+ * @GFBGRAPH_RETRY_CLASS_GRAPH_THROTTLED: the Graph API rate limit errors 4,
+ *   17, 32, 341 and the business use case ones, and HTTP 429.
+ *
+ * The kinds of failed requests a #GFBGraphRetryPolicy can retry, each one with
+ * its own rule.
+ **/
+typedef enum {
+  GFBGRAPH_RETRY_CLASS_NETWORK,
+  GFBGRAPH_RETRY_CLASS_SERVER_ERROR,
+  GFBGRAPH_RETRY_CLASS_GRAPH_TRANSIENT,
+  GFBGRAPH_RETRY_CLASS_GRAPH_THROTTLED
+} GFBGraphRetryClass;
+
+GType                gfbgraph_retry_policy_get_type           (void) G_GNUC_CONST;
+GFBGraphRetryPolicy* gfbgraph_retry_policy_new                (void);
+
+void                 gfbgraph_retry_policy_get_rule           (GFBGraphRetryPolicy *policy,
+                                                               GFBGraphRetryClass   retry_class,
+                                                               guint               *max_retries,
+                                                               guint               *base_delay,
+                                                               guint               *max_delay);
+void                 gfbgraph_retry_policy_set_rule           (GFBGraphRetryPolicy *policy,
+                                                               GFBGraphRetryClass   retry_class,
+                                                               guint                max_retries,
+                                                               guint                base_delay,
+                                                               guint                max_delay);
+gdouble              gfbgraph_retry_policy_get_budget_ratio   (GFBGraphRetryPolicy *policy);
+void                 gfbgraph_retry_policy_set_budget_ratio   (GFBGraphRetryPolicy *policy,
+                                                               gdouble              ratio);
+gdouble              gfbgraph_retry_policy_get_min_retry_rate (GFBGraphRetryPolicy *policy);
+void                 gfbgraph_retry_policy_set_min_retry_rate (GFBGraphRetryPolicy *policy,
+                                                               gdouble              rate);
+
+G_END_DECLS
+
+#endif /* __GFBGRAPH_RETRY_POLICY_H__ */
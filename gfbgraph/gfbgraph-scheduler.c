@@ -0,0 +1,1112 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 2; tab-width: 2 -*-  */
+/*
+ * libgfbgraph - GObject library for Facebook Graph API
+ * Copyright (C) 2013 Álvaro Peña <alvaropg@gmail.com>
+ *               2020 Leesoo Ahn <yisooan@fedoraproject.org>
+ *
+ * GFBGraph is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GFBGraph is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GFBGraph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * SECTION:gfbgraph-scheduler
+ * @title: GFBGraphScheduler
+ * @short_description: Concurrency and rate limits for the Graph API requests
+ * @stability: Unstable
+ * @include: gfbgraph/gfbgraph.h
+ *
+ * Every request done by the library waits in the #GFBGraphScheduler of its
+ * #GFBGraphContext (see gfbgraph_context_get_scheduler()) until it can be sent.
+ *
+ * The scheduler limits the number of requests in flight, both in total and for
+ * every #GFBGraphAuthorizer, and paces them with two token buckets: one for the
+ * whole application and one for every authorizer. The refill rate of the buckets
+ * follows the quota usage reported by the Graph API in the X-App-Usage and
+ * X-Business-Use-Case-Usage headers, slowing down smoothly as the usage gets
+ * close to the limit, so the throughput stays near the quota instead of
+ * alternating between full speed and throttled. When the Graph API still
+ * answers with a rate limit error (codes 4, 17, 32 or a business use case
+ * limit) the affected bucket is paused with an exponential backoff.
+ *
+ * The limits are shared by all the contexts using the same scheduler.
+ *
+ * A synchronous request made from the thread running the main context of some
+ * asynchronous requests in flight isn't held by the limits on the requests in
+ * flight: those requests can only finish once that main context runs again, so
+ * waiting for them would never end. The rate limits still apply.
+ **/
+
+#include <json-glib/json-glib.h>
+
+#include "gfbgraph-scheduler.h"
+#include "gfbgraph-private.h"
+
+#define DEFAULT_MAX_IN_FLIGHT                16
+#define DEFAULT_MAX_IN_FLIGHT_PER_AUTHORIZER 4
+#define DEFAULT_MAX_RATE                     50.0
+#define DEFAULT_MAX_RATE_PER_AUTHORIZER      10.0
+
+/* Quota usage (in percent) from which the buckets start slowing down */
+#define USAGE_TARGET      75.0
+/* Lowest fraction of the maximum rate a bucket goes down to */
+#define MIN_RATE_FACTOR   0.02
+/* Rate recovered after every successful request without usage headers */
+#define RATE_FACTOR_STEP  0.05
+
+#define INITIAL_BACKOFF   (1 * G_USEC_PER_SEC)
+#define MAX_BACKOFF       (300 * G_USEC_PER_SEC)
+
+/* Graph API error codes */
+#define GRAPH_ERROR_APP_LIMIT       4
+#define GRAPH_ERROR_USER_LIMIT      17
+#define GRAPH_ERROR_PAGE_LIMIT      32
+#define GRAPH_ERROR_BUC_LIMIT_FIRST 80000
+#define GRAPH_ERROR_BUC_LIMIT_LAST  80014
+
+enum {
+  PROP_0,
+  PROP_MAX_IN_FLIGHT,
+  PROP_MAX_IN_FLIGHT_PER_AUTHORIZER,
+  PROP_MAX_RATE,
+  PROP_MAX_RATE_PER_AUTHORIZER
+};
+
+typedef struct {
+  gdouble factor;        /* Fraction of the maximum rate currently allowed */
+  gdouble tokens;
+  gint64  last_refill;   /* Monotonic time, in microseconds */
+  gint64  blocked_until;
+  gint64  backoff;
+} TokenBucket;
+
+typedef struct {
+  GFBGraphAuthorizer *authorizer; /* Weak */
+  guint               in_flight;
+  TokenBucket         bucket;
+} AuthorizerState;
+
+typedef struct {
+  GFBGraphScheduler  *scheduler;
+  GFBGraphAuthorizer *authorizer;
+  AuthorizerState    *state;
+  GTask              *task;       /* NULL for the synchronous waiters */
+  gboolean            unlimited;  /* Not held by the limits on the requests in flight */
+  gulong              cancelled_id;
+  GSource            *cancel_source;
+  gint64              retry_at;   /* When the buckets allow the request */
+  GSource            *timeout;
+  gboolean            granted;
+  gboolean            cancelled;
+} Waiter;
+
+struct _GFBGraphSchedulerPrivate {
+  GMutex       mutex;
+  GCond        cond;
+  guint        max_in_flight;
+  guint        max_in_flight_per_authorizer;
+  gdouble      max_rate;
+  gdouble      max_rate_per_authorizer;
+
+  guint        in_flight;
+  TokenBucket  app_bucket;
+  GHashTable  *authorizers; /* GFBGraphAuthorizer -> AuthorizerState */
+  GHashTable  *contexts;    /* GMainContext -> number of asynchronous requests in flight */
+  GQueue       waiters;
+};
+
+#define GFBGRAPH_SCHEDULER_GET_PRIVATE(o) \
+  (G_TYPE_INSTANCE_GET_PRIVATE((o), GFBGRAPH_TYPE_SCHEDULER, GFBGraphSchedulerPrivate))
+
+static GObjectClass *parent_class = NULL;
+
+G_DEFINE_TYPE (GFBGraphScheduler, gfbgraph_scheduler, G_TYPE_OBJECT);
+
+static void dispatch_locked (GFBGraphScheduler  *scheduler,
+                             GList             **granted);
+static void complete_granted (GList *granted);
+
+static void
+authorizer_finalized_cb (gpointer  data,
+                         GObject  *where_the_object_was)
+{
+  GFBGraphSchedulerPrivate *priv = GFBGRAPH_SCHEDULER (data)->priv;
+
+  g_mutex_lock (&priv->mutex);
+  g_hash_table_remove (priv->authorizers, where_the_object_was);
+  g_mutex_unlock (&priv->mutex);
+}
+
+static void
+gfbgraph_scheduler_finalize (GObject *object)
+{
+  GFBGraphSchedulerPrivate *priv = GFBGRAPH_SCHEDULER_GET_PRIVATE (object);
+  GHashTableIter iter;
+  gpointer authorizer;
+
+  /* Every waiter keeps a reference to the scheduler */
+  g_warn_if_fail (g_queue_is_empty (&priv->waiters));
+
+  g_hash_table_iter_init (&iter, priv->authorizers);
+  while (g_hash_table_iter_next (&iter, &authorizer, NULL))
+    g_object_weak_unref (G_OBJECT (authorizer), authorizer_finalized_cb, object);
+  g_hash_table_unref (priv->authorizers);
+  g_hash_table_unref (priv->contexts);
+
+  g_mutex_clear (&priv->mutex);
+  g_cond_clear (&priv->cond);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static void
+gfbgraph_scheduler_set_property (GObject      *object,
+                                 guint         prop_id,
+                                 const GValue *value,
+                                 GParamSpec   *pspec)
+{
+  GFBGraphScheduler *scheduler = GFBGRAPH_SCHEDULER (object);
+  GFBGraphSchedulerPrivate *priv = scheduler->priv;
+  GList *granted = NULL;
+
+  g_mutex_lock (&priv->mutex);
+
+  switch (prop_id) {
+    case PROP_MAX_IN_FLIGHT:
+      priv->max_in_flight = g_value_get_uint (value);
+      break;
+    case PROP_MAX_IN_FLIGHT_PER_AUTHORIZER:
+      priv->max_in_flight_per_authorizer = g_value_get_uint (value);
+      break;
+    case PROP_MAX_RATE:
+      priv->max_rate = g_value_get_double (value);
+      break;
+    case PROP_MAX_RATE_PER_AUTHORIZER:
+      priv->max_rate_per_authorizer = g_value_get_double (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+
+  /* Higher limits can let some waiters go */
+  dispatch_locked (scheduler, &granted);
+
+  g_mutex_unlock (&priv->mutex);
+
+  complete_granted (granted);
+}
+
+static void
+gfbgraph_scheduler_get_property (GObject    *object,
+                                 guint       prop_id,
+                                 GValue     *value,
+                                 GParamSpec *pspec)
+{
+  GFBGraphSchedulerPrivate *priv = GFBGRAPH_SCHEDULER_GET_PRIVATE (object);
+
+  g_mutex_lock (&priv->mutex);
+
+  switch (prop_id) {
+    case PROP_MAX_IN_FLIGHT:
+      g_value_set_uint (value, priv->max_in_flight);
+      break;
+    case PROP_MAX_IN_FLIGHT_PER_AUTHORIZER:
+      g_value_set_uint (value, priv->max_in_flight_per_authorizer);
+      break;
+    case PROP_MAX_RATE:
+      g_value_set_double (value, priv->max_rate);
+      break;
+    case PROP_MAX_RATE_PER_AUTHORIZER:
+      g_value_set_double (value, priv->max_rate_per_authorizer);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+
+  g_mutex_unlock (&priv->mutex);
+}
+
+static void
+gfbgraph_scheduler_class_init (GFBGraphSchedulerClass *klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+
+  parent_class                 = g_type_class_peek_parent (klass);
+  gobject_class->finalize      = gfbgraph_scheduler_finalize;
+  gobject_class->set_property  = gfbgraph_scheduler_set_property;
+  gobject_class->get_property  = gfbgraph_scheduler_get_property;
+
+  g_type_class_add_private (gobject_class, sizeof(GFBGraphSchedulerPrivate));
+
+  /**
+   * GFBGraphScheduler:max-in-flight:
+   *
+   * The maximum number of requests in progress at the same time.
+   **/
+  g_object_class_install_property (gobject_class,
+                                   PROP_MAX_IN_FLIGHT,
+                                   g_param_spec_uint ("max-in-flight",
+                                                      "Maximum requests in flight",
+                                                      "The maximum number of requests in progress",
+                                                      1, G_MAXUINT, DEFAULT_MAX_IN_FLIGHT,
+                                                      G_PARAM_CONSTRUCT | G_PARAM_READWRITE));
+
+  /**
+   * GFBGraphScheduler:max-in-flight-per-authorizer:
+   *
+   * The maximum number of requests of the same #GFBGraphAuthorizer in progress at the same time.
+   **/
+  g_object_class_install_property (gobject_class,
+                                   PROP_MAX_IN_FLIGHT_PER_AUTHORIZER,
+                                   g_param_spec_uint ("max-in-flight-per-authorizer",
+                                                      "Maximum requests in flight per authorizer",
+                                                      "The maximum number of requests in progress for a single authorizer",
+                                                      1, G_MAXUINT, DEFAULT_MAX_IN_FLIGHT_PER_AUTHORIZER,
+                                                      G_PARAM_CONSTRUCT | G_PARAM_READWRITE));
+
+  /**
+   * GFBGraphScheduler:max-rate:
+   *
+   * The maximum number of requests per second, reached while the application
+   * quota usage reported by the Graph API is low.
+   **/
+  g_object_class_install_property (gobject_class,
+                                   PROP_MAX_RATE,
+                                   g_param_spec_double ("max-rate",
+                                                        "Maximum rate",
+                                                        "The maximum number of requests per second",
+                                                        0.1, G_MAXDOUBLE, DEFAULT_MAX_RATE,
+                                                        G_PARAM_CONSTRUCT | G_PARAM_READWRITE));
+
+  /**
+   * GFBGraphScheduler:max-rate-per-authorizer:
+   *
+   * The maximum number of requests per second of the same #GFBGraphAuthorizer,
+   * reached while its quota usage reported by the Graph API is low.
+   **/
+  g_object_class_install_property (gobject_class,
+                                   PROP_MAX_RATE_PER_AUTHORIZER,
+                                   g_param_spec_double ("max-rate-per-authorizer",
+                                                        "Maximum rate per authorizer",
+                                                        "The maximum number of requests per second for a single authorizer",
+                                                        0.1, G_MAXDOUBLE, DEFAULT_MAX_RATE_PER_AUTHORIZER,
+                                                        G_PARAM_CONSTRUCT | G_PARAM_READWRITE));
+}
+
+static void
+token_bucket_init (TokenBucket *bucket,
+                   gdouble      max_rate)
+{
+  bucket->factor = 1.0;
+  bucket->tokens = MAX (1.0, max_rate);
+  bucket->last_refill = g_get_monotonic_time ();
+  bucket->blocked_until = 0;
+  bucket->backoff = 0;
+}
+
+static void
+gfbgraph_scheduler_init (GFBGraphScheduler *obj)
+{
+  GFBGraphSchedulerPrivate *priv;
+
+  obj->priv = priv = GFBGRAPH_SCHEDULER_GET_PRIVATE (obj);
+
+  g_mutex_init (&priv->mutex);
+  g_cond_init (&priv->cond);
+  priv->authorizers = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_free);
+  priv->contexts = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                          (GDestroyNotify) g_main_context_unref, NULL);
+  g_queue_init (&priv->waiters);
+  token_bucket_init (&priv->app_bucket, DEFAULT_MAX_RATE);
+}
+
+/* --- Private Functions --- */
+
+/* The bucket holds one second of requests, so short bursts don't wait */
+static void
+token_bucket_refill (TokenBucket *bucket,
+                     gdouble      max_rate,
+                     gint64       now)
+{
+  gdouble rate;
+
+  rate = max_rate * bucket->factor;
+  bucket->tokens = MIN (MAX (1.0, max_rate),
+                        bucket->tokens + rate * (now - bucket->last_refill) / G_USEC_PER_SEC);
+  bucket->last_refill = now;
+}
+
+/* Returns when the bucket will have a token for a new request */
+static gint64
+token_bucket_ready_time (TokenBucket *bucket,
+                         gdouble      max_rate,
+                         gint64       now)
+{
+  if (bucket->blocked_until > now)
+    return bucket->blocked_until;
+
+  token_bucket_refill (bucket, max_rate, now);
+  if (bucket->tokens >= 1.0)
+    return now;
+
+  return now + (gint64) ((1.0 - bucket->tokens) / (max_rate * bucket->factor) * G_USEC_PER_SEC) + 1;
+}
+
+/* Proportional slow down once the usage goes over USAGE_TARGET */
+static void
+token_bucket_set_usage (TokenBucket *bucket,
+                        gdouble      usage)
+{
+  bucket->factor = CLAMP ((100.0 - usage) / (100.0 - USAGE_TARGET), MIN_RATE_FACTOR, 1.0);
+}
+
+static void
+token_bucket_throttled (TokenBucket *bucket,
+                        gint64       now,
+                        gint64       regain_time)
+{
+  bucket->backoff = bucket->backoff ? MIN (bucket->backoff * 2, MAX_BACKOFF) : INITIAL_BACKOFF;
+  bucket->blocked_until = now + MAX (bucket->backoff, regain_time);
+  bucket->factor = MAX (bucket->factor / 2, MIN_RATE_FACTOR);
+  bucket->tokens = 0;
+}
+
+static void
+token_bucket_succeeded (TokenBucket *bucket,
+                        gboolean     usage_reported)
+{
+  bucket->backoff /= 2;
+  if (bucket->backoff < INITIAL_BACKOFF)
+    bucket->backoff = 0;
+
+  if (!usage_reported)
+    bucket->factor = MIN (bucket->factor + RATE_FACTOR_STEP, 1.0);
+}
+
+static AuthorizerState *
+get_authorizer_state_locked (GFBGraphScheduler  *scheduler,
+                             GFBGraphAuthorizer *authorizer)
+{
+  GFBGraphSchedulerPrivate *priv = scheduler->priv;
+  AuthorizerState *state;
+
+  state = g_hash_table_lookup (priv->authorizers, authorizer);
+  if (state == NULL) {
+    state = g_new0 (AuthorizerState, 1);
+    state->authorizer = authorizer;
+    token_bucket_init (&state->bucket, priv->max_rate_per_authorizer);
+    g_hash_table_insert (priv->authorizers, authorizer, state);
+    g_object_weak_ref (G_OBJECT (authorizer), authorizer_finalized_cb, scheduler);
+  }
+
+  return state;
+}
+
+/* Counts the asynchronous requests in flight driven by @context */
+static void
+context_add_in_flight_locked (GFBGraphScheduler *scheduler,
+                              GMainContext      *context,
+                              gint               delta)
+{
+  GFBGraphSchedulerPrivate *priv = scheduler->priv;
+  guint n_in_flight;
+
+  if (context == NULL)
+    context = g_main_context_default ();
+
+  n_in_flight = GPOINTER_TO_UINT (g_hash_table_lookup (priv->contexts, context));
+  g_return_if_fail (delta > 0 || n_in_flight > 0);
+
+  n_in_flight += delta;
+  if (n_in_flight > 0)
+    g_hash_table_insert (priv->contexts, g_main_context_ref (context), GUINT_TO_POINTER (n_in_flight));
+  else
+    g_hash_table_remove (priv->contexts, context);
+}
+
+/* Whether blocking the calling thread stops @context, because the thread runs
+ * it or nobody else can */
+static gboolean
+context_stopped_by_caller (GMainContext *context)
+{
+  if (!g_main_context_acquire (context))
+    return FALSE;
+
+  g_main_context_release (context);
+
+  return TRUE;
+}
+
+static void
+retry_timeout_destroy (gpointer data)
+{
+  g_object_unref (data);
+}
+
+static gboolean
+retry_timeout_cb (gpointer data)
+{
+  GFBGraphScheduler *scheduler = GFBGRAPH_SCHEDULER (data);
+  GList *granted = NULL;
+
+  g_mutex_lock (&scheduler->priv->mutex);
+  dispatch_locked (scheduler, &granted);
+  g_mutex_unlock (&scheduler->priv->mutex);
+
+  complete_granted (granted);
+
+  return G_SOURCE_REMOVE;
+}
+
+/* Asynchronous waiters blocked by the buckets need a timer in their main
+ * context, synchronous ones wait on the condition until retry_at */
+static void
+waiter_retry_at_locked (Waiter *waiter,
+                        gint64  retry_at)
+{
+  if (waiter->task != NULL
+      && (waiter->timeout == NULL
+          || g_source_is_destroyed (waiter->timeout)
+          || waiter->retry_at > retry_at)) {
+    if (waiter->timeout != NULL) {
+      g_source_destroy (waiter->timeout);
+      g_source_unref (waiter->timeout);
+    }
+
+    waiter->timeout = g_timeout_source_new (MAX (1, (retry_at - g_get_monotonic_time ()) / 1000));
+    g_source_set_callback (waiter->timeout,
+                           retry_timeout_cb,
+                           g_object_ref (waiter->scheduler),
+                           retry_timeout_destroy);
+    g_source_attach (waiter->timeout, g_task_get_context (waiter->task));
+  }
+
+  waiter->retry_at = retry_at;
+}
+
+/* Grants every waiter allowed by the limits, in arrival order. The asynchronous
+ * ones are returned in @granted to be completed without the lock. */
+static void
+dispatch_locked (GFBGraphScheduler  *scheduler,
+                 GList             **granted)
+{
+  GFBGraphSchedulerPrivate *priv = scheduler->priv;
+  GList *l;
+  GList *next;
+  gint64 now;
+
+  now = g_get_monotonic_time ();
+
+  for (l = priv->waiters.head; l != NULL; l = next) {
+    Waiter *waiter = l->data;
+    gint64 app_ready;
+    gint64 authorizer_ready;
+
+    next = l->next;
+
+    if (!waiter->unlimited
+        && (priv->in_flight >= priv->max_in_flight
+            || waiter->state->in_flight >= priv->max_in_flight_per_authorizer))
+      continue;
+
+    app_ready = token_bucket_ready_time (&priv->app_bucket, priv->max_rate, now);
+    authorizer_ready = token_bucket_ready_time (&waiter->state->bucket,
+                                                priv->max_rate_per_authorizer,
+                                                now);
+    if (app_ready > now || authorizer_ready > now) {
+      waiter_retry_at_locked (waiter, MAX (app_ready, authorizer_ready));
+      continue;
+    }
+
+    priv->app_bucket.tokens -= 1.0;
+    waiter->state->bucket.tokens -= 1.0;
+    priv->in_flight++;
+    waiter->state->in_flight++;
+
+    g_queue_delete_link (&priv->waiters, l);
+    waiter->granted = TRUE;
+    if (waiter->task != NULL) {
+      context_add_in_flight_locked (scheduler, g_task_get_context (waiter->task), 1);
+      *granted = g_list_prepend (*granted, waiter);
+    }
+  }
+
+  *granted = g_list_reverse (*granted);
+  g_cond_broadcast (&priv->cond);
+}
+
+static void
+waiter_free (gpointer data)
+{
+  Waiter *waiter = data;
+
+  if (waiter->timeout != NULL) {
+    g_source_destroy (waiter->timeout);
+    g_source_unref (waiter->timeout);
+  }
+  if (waiter->cancel_source != NULL)
+    g_source_unref (waiter->cancel_source);
+  g_object_unref (waiter->authorizer);
+  g_object_unref (waiter->scheduler);
+  g_slice_free (Waiter, waiter);
+}
+
+static void
+complete_granted (GList *granted)
+{
+  GList *l;
+
+  for (l = granted; l != NULL; l = l->next) {
+    Waiter *waiter = l->data;
+    GTask *task = waiter->task;
+
+    /* Releases the reference of the source to the task */
+    if (waiter->cancel_source != NULL)
+      g_source_destroy (waiter->cancel_source);
+
+    g_task_return_boolean (task, TRUE);
+    g_object_unref (task);
+  }
+
+  g_list_free (granted);
+}
+
+static void
+waiter_cancelled_cb (GCancellable *cancellable,
+                     gpointer      data)
+{
+  Waiter *waiter = data;
+  GFBGraphSchedulerPrivate *priv = waiter->scheduler->priv;
+
+  g_mutex_lock (&priv->mutex);
+  if (g_queue_remove (&priv->waiters, waiter))
+    waiter->cancelled = TRUE;
+  g_cond_broadcast (&priv->cond);
+  g_mutex_unlock (&priv->mutex);
+}
+
+/* Runs in the main context of the task, so it never races with waiter_free() */
+static gboolean
+task_cancelled_cb (GCancellable *cancellable,
+                   gpointer      data)
+{
+  GTask *task = G_TASK (data);
+  Waiter *waiter = g_task_get_task_data (task);
+  GFBGraphSchedulerPrivate *priv = waiter->scheduler->priv;
+  gboolean removed;
+
+  g_mutex_lock (&priv->mutex);
+  removed = g_queue_remove (&priv->waiters, waiter);
+  g_mutex_unlock (&priv->mutex);
+
+  if (removed) {
+    g_task_return_error_if_cancelled (task);
+    g_object_unref (task);
+  }
+
+  return G_SOURCE_REMOVE;
+}
+
+/* Returns the highest usage percentage in a X-App-Usage object, like
+ * {"call_count":28,"total_time":25,"total_cputime":25} */
+static gdouble
+get_usage_from_object (JsonObject *jobject,
+                       gint64     *regain_time)
+{
+  static const gchar *counters[] = { "call_count", "total_time", "total_cputime" };
+  gdouble usage = 0;
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (counters); i++) {
+    if (json_object_has_member (jobject, counters[i]))
+      usage = MAX (usage, json_object_get_double_member (jobject, counters[i]));
+  }
+
+  /* In minutes, only in the business use case usage */
+  if (regain_time != NULL && json_object_has_member (jobject, "estimated_time_to_regain_access"))
+    *regain_time = MAX (*regain_time,
+                        json_object_get_int_member (jobject, "estimated_time_to_regain_access") * 60 * G_USEC_PER_SEC);
+
+  return usage;
+}
+
+/* Returns the highest usage of a X-Business-Use-Case-Usage object, like
+ * {"<business id>":[{"type":"pages","call_count":100,...}]} */
+static gdouble
+get_business_usage (JsonObject *jobject,
+                    gint64     *regain_time)
+{
+  GList *members;
+  GList *l;
+  gdouble usage = 0;
+
+  members = json_object_get_values (jobject);
+  for (l = members; l != NULL; l = l->next) {
+    JsonNode *jnode = l->data;
+    JsonArray *jarray;
+    guint i;
+
+    if (!JSON_NODE_HOLDS_ARRAY (jnode))
+      continue;
+
+    jarray = json_node_get_array (jnode);
+    for (i = 0; i < json_array_get_length (jarray); i++) {
+      JsonNode *element = json_array_get_element (jarray, i);
+
+      if (JSON_NODE_HOLDS_OBJECT (element))
+        usage = MAX (usage, get_usage_from_object (json_node_get_object (element), regain_time));
+    }
+  }
+  g_list_free (members);
+
+  return usage;
+}
+
+/* Returns the usage percentage in the @header_name response header of
+ * @call, or a negative value if not present */
+static gdouble
+get_header_usage (RestProxyCall *call,
+                  const gchar   *header_name,
+                  gint64        *regain_time)
+{
+  JsonParser *parser;
+  gchar *value;
+  gdouble usage = -1;
+
+  value = gfbgraph_call_lookup_response_header (call, header_name);
+  if (value == NULL)
+    return -1;
+
+  parser = json_parser_new ();
+  if (json_parser_load_from_data (parser, value, -1, NULL)
+      && JSON_NODE_HOLDS_OBJECT (json_parser_get_root (parser))) {
+    JsonObject *jobject = json_node_get_object (json_parser_get_root (parser));
+
+    if (regain_time != NULL)
+      usage = get_business_usage (jobject, regain_time);
+    else
+      usage = get_usage_from_object (jobject, NULL);
+  }
+  g_object_unref (parser);
+  g_free (value);
+
+  return usage;
+}
+
+/* --- Internal API --- */
+
+/* Blocks until the limits allow a new request of @authorizer. On success
+ * gfbgraph_scheduler_release() must be called when the request is done.
+ *
+ * The asynchronous requests in flight of the thread-default main context
+ * don't hold the caller if the caller stops that context, see the section
+ * documentation. */
+gboolean
+gfbgraph_scheduler_acquire (GFBGraphScheduler   *scheduler,
+                            GFBGraphAuthorizer  *authorizer,
+                            GCancellable        *cancellable,
+                            GError             **error)
+{
+  GFBGraphSchedulerPrivate *priv;
+  Waiter waiter = { 0, };
+  GMainContext *context;
+  gboolean stops_context;
+
+  g_return_val_if_fail (GFBGRAPH_IS_SCHEDULER (scheduler), FALSE);
+  g_return_val_if_fail (GFBGRAPH_IS_AUTHORIZER (authorizer), FALSE);
+
+  priv = scheduler->priv;
+
+  if (g_cancellable_set_error_if_cancelled (cancellable, error))
+    return FALSE;
+
+  context = g_main_context_ref_thread_default ();
+  stops_context = context_stopped_by_caller (context);
+
+  waiter.scheduler = scheduler;
+  waiter.authorizer = authorizer;
+
+  g_mutex_lock (&priv->mutex);
+  waiter.state = get_authorizer_state_locked (scheduler, authorizer);
+  g_queue_push_tail (&priv->waiters, &waiter);
+  g_mutex_unlock (&priv->mutex);
+
+  if (cancellable != NULL)
+    waiter.cancelled_id = g_cancellable_connect (cancellable,
+                                                 G_CALLBACK (waiter_cancelled_cb),
+                                                 &waiter,
+                                                 NULL);
+
+  g_mutex_lock (&priv->mutex);
+  while (!waiter.granted && !waiter.cancelled) {
+    GList *granted = NULL;
+
+    /* Rechecked every time, other threads can grant more asynchronous
+     * requests of the context while this one waits */
+    waiter.unlimited = stops_context && g_hash_table_contains (priv->contexts, context);
+    waiter.retry_at = 0;
+    dispatch_locked (scheduler, &granted);
+    if (granted != NULL) {
+      g_mutex_unlock (&priv->mutex);
+      complete_granted (granted);
+      g_mutex_lock (&priv->mutex);
+      continue;
+    }
+
+    if (waiter.granted || waiter.cancelled)
+      break;
+
+    if (waiter.retry_at > 0)
+      g_cond_wait_until (&priv->cond, &priv->mutex, waiter.retry_at);
+    else
+      g_cond_wait (&priv->cond, &priv->mutex);
+  }
+  g_mutex_unlock (&priv->mutex);
+
+  if (waiter.cancelled_id != 0)
+    g_cancellable_disconnect (cancellable, waiter.cancelled_id);
+
+  g_main_context_unref (context);
+
+  if (!waiter.granted) {
+    g_cancellable_set_error_if_cancelled (cancellable, error);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+/* Asynchronous version of gfbgraph_scheduler_acquire(), @callback is called
+ * in the thread-default main context when the request can be sent. */
+void
+gfbgraph_scheduler_acquire_async (GFBGraphScheduler   *scheduler,
+                                  GFBGraphAuthorizer  *authorizer,
+                                  GCancellable        *cancellable,
+                                  GAsyncReadyCallback  callback,
+                                  gpointer             user_data)
+{
+  GFBGraphSchedulerPrivate *priv;
+  GTask *task;
+  Waiter *waiter;
+  GList *granted = NULL;
+
+  g_return_if_fail (GFBGRAPH_IS_SCHEDULER (scheduler));
+  g_return_if_fail (GFBGRAPH_IS_AUTHORIZER (authorizer));
+
+  priv = scheduler->priv;
+
+  task = g_task_new (scheduler, cancellable, callback, user_data);
+  g_task_set_source_tag (task, gfbgraph_scheduler_acquire_async);
+  /* A granted slot must always reach the caller to be released */
+  g_task_set_check_cancellable (task, FALSE);
+
+  if (g_task_return_error_if_cancelled (task)) {
+    g_object_unref (task);
+    return;
+  }
+
+  waiter = g_slice_new0 (Waiter);
+  waiter->scheduler = g_object_ref (scheduler);
+  waiter->authorizer = g_object_ref (authorizer);
+  waiter->task = task; /* The queue owns the reference */
+  g_task_set_task_data (task, waiter, waiter_free);
+
+  if (cancellable != NULL) {
+    waiter->cancel_source = g_cancellable_source_new (cancellable);
+    g_source_set_callback (waiter->cancel_source,
+                           (GSourceFunc) task_cancelled_cb,
+                           g_object_ref (task),
+                           g_object_unref);
+    g_source_attach (waiter->cancel_source, g_task_get_context (task));
+  }
+
+  g_mutex_lock (&priv->mutex);
+  waiter->state = get_authorizer_state_locked (scheduler, authorizer);
+  g_queue_push_tail (&priv->waiters, waiter);
+  dispatch_locked (scheduler, &granted);
+  g_mutex_unlock (&priv->mutex);
+
+  complete_granted (granted);
+}
+
+gboolean
+gfbgraph_scheduler_acquire_finish (GFBGraphScheduler  *scheduler,
+                                   GAsyncResult       *result,
+                                   GError            **error)
+{
+  g_return_val_if_fail (g_task_is_valid (result, scheduler), FALSE);
+
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
+
+/* Releases the slot taken by a request of @authorizer, @context being the
+ * main context of an asynchronous request or %NULL for a synchronous one. The
+ * response of @call, if any, updates the buckets with the usage reported by the
+ * Graph API and its rate limit errors. */
+void
+gfbgraph_scheduler_release (GFBGraphScheduler  *scheduler,
+                            GFBGraphAuthorizer *authorizer,
+                            RestProxyCall      *call,
+                            GMainContext       *context)
+{
+  GFBGraphSchedulerPrivate *priv;
+  AuthorizerState *state;
+  GList *granted = NULL;
+  gdouble app_usage = -1;
+  gdouble business_usage = -1;
+  gint64 regain_time = 0;
+  gint error_code = 0;
+  guint status = 0;
+  gint64 now;
+
+  g_return_if_fail (GFBGRAPH_IS_SCHEDULER (scheduler));
+  g_return_if_fail (GFBGRAPH_IS_AUTHORIZER (authorizer));
+
+  priv = scheduler->priv;
+
+  if (call != NULL)
+    status = rest_proxy_call_get_status_code (call);
+
+  if (status != 0) {
+    app_usage = get_header_usage (call, "X-App-Usage", NULL);
+    business_usage = get_header_usage (call, "X-Business-Use-Case-Usage", &regain_time);
+  }
+  /* Only the errors carry a Graph API error code, no need to parse the rest */
+  if (status >= 400)
+    error_code = gfbgraph_call_get_graph_error_code (call);
+
+  now = g_get_monotonic_time ();
+
+  g_mutex_lock (&priv->mutex);
+
+  state = get_authorizer_state_locked (scheduler, authorizer);
+  g_warn_if_fail (priv->in_flight > 0 && state->in_flight > 0);
+  priv->in_flight--;
+  state->in_flight--;
+  if (context != NULL)
+    context_add_in_flight_locked (scheduler, context, -1);
+
+  if (app_usage >= 0)
+    token_bucket_set_usage (&priv->app_bucket, app_usage);
+  if (business_usage >= 0)
+    token_bucket_set_usage (&state->bucket, business_usage);
+
+  if (error_code == GRAPH_ERROR_APP_LIMIT) {
+    token_bucket_throttled (&priv->app_bucket, now, 0);
+  } else if (error_code == GRAPH_ERROR_USER_LIMIT
+             || error_code == GRAPH_ERROR_PAGE_LIMIT
+             || (error_code >= GRAPH_ERROR_BUC_LIMIT_FIRST && error_code <= GRAPH_ERROR_BUC_LIMIT_LAST)) {
+    token_bucket_throttled (&state->bucket, now, regain_time);
+  } else if (status != 0) {
+    token_bucket_succeeded (&priv->app_bucket, app_usage >= 0);
+    token_bucket_succeeded (&state->bucket, business_usage >= 0);
+  }
+
+  dispatch_locked (scheduler, &granted);
+
+  g_mutex_unlock (&priv->mutex);
+
+  complete_granted (granted);
+}
+
+/* --- Public API --- */
+
+/**
+ * gfbgraph_scheduler_new:
+ *
+ * Creates a new #GFBGraphScheduler with the default limits. Use it in the
+ * #GFBGraphContext:scheduler property of several contexts to share the limits
+ * between them.
+ *
+ * Returns: (transfer full): a new #GFBGraphScheduler; unref with g_object_unref()
+ **/
+GFBGraphScheduler *
+gfbgraph_scheduler_new (void)
+{
+  return GFBGRAPH_SCHEDULER (g_object_new (GFBGRAPH_TYPE_SCHEDULER, NULL));
+}
+
+/**
+ * gfbgraph_scheduler_get_max_in_flight:
+ * @scheduler: a #GFBGraphScheduler.
+ *
+ * Returns: the maximum number of requests in progress at the same time.
+ **/
+guint
+gfbgraph_scheduler_get_max_in_flight (GFBGraphScheduler *scheduler)
+{
+  guint max_in_flight;
+
+  g_return_val_if_fail (GFBGRAPH_IS_SCHEDULER (scheduler), 0);
+
+  g_object_get (G_OBJECT (scheduler),
+                "max-in-flight", &max_in_flight,
+                NULL);
+
+  return max_in_flight;
+}
+
+/**
+ * gfbgraph_scheduler_set_max_in_flight:
+ * @scheduler: a #GFBGraphScheduler.
+ * @max_in_flight: the maximum number of requests in progress.
+ *
+ * Sets the maximum number of requests in progress at the same time.
+ **/
+void
+gfbgraph_scheduler_set_max_in_flight (GFBGraphScheduler *scheduler,
+                                      guint              max_in_flight)
+{
+  g_return_if_fail (GFBGRAPH_IS_SCHEDULER (scheduler));
+
+  g_object_set (G_OBJECT (scheduler),
+                "max-in-flight", max_in_flight,
+                NULL);
+}
+
+/**
+ * gfbgraph_scheduler_get_max_in_flight_per_authorizer:
+ * @scheduler: a #GFBGraphScheduler.
+ *
+ * Returns: the maximum number of requests of a single #GFBGraphAuthorizer in progress
+ * at the same time.
+ **/
+guint
+gfbgraph_scheduler_get_max_in_flight_per_authorizer (GFBGraphScheduler *scheduler)
+{
+  guint max_in_flight;
+
+  g_return_val_if_fail (GFBGRAPH_IS_SCHEDULER (scheduler), 0);
+
+  g_object_get (G_OBJECT (scheduler),
+                "max-in-flight-per-authorizer", &max_in_flight,
+                NULL);
+
+  return max_in_flight;
+}
+
+/**
+ * gfbgraph_scheduler_set_max_in_flight_per_authorizer:
+ * @scheduler: a #GFBGraphScheduler.
+ * @max_in_flight: the maximum number of requests in progress for a single authorizer.
+ *
+ * Sets the maximum number of requests of a single #GFBGraphAuthorizer in progress
+ * at the same time.
+ **/
+void
+gfbgraph_scheduler_set_max_in_flight_per_authorizer (GFBGraphScheduler *scheduler,
+                                                     guint              max_in_flight)
+{
+  g_return_if_fail (GFBGRAPH_IS_SCHEDULER (scheduler));
+
+  g_object_set (G_OBJECT (scheduler),
+                "max-in-flight-per-authorizer", max_in_flight,
+                NULL);
+}
+
+/**
+ * gfbgraph_scheduler_get_max_rate:
+ * @scheduler: a #GFBGraphScheduler.
+ *
+ * Returns: the maximum number of requests per second.
+ **/
+gdouble
+gfbgraph_scheduler_get_max_rate (GFBGraphScheduler *scheduler)
+{
+  gdouble max_rate;
+
+  g_return_val_if_fail (GFBGRAPH_IS_SCHEDULER (scheduler), 0);
+
+  g_object_get (G_OBJECT (scheduler),
+                "max-rate", &max_rate,
+                NULL);
+
+  return max_rate;
+}
+
+/**
+ * gfbgraph_scheduler_set_max_rate:
+ * @scheduler: a #GFBGraphScheduler.
+ * @max_rate: the maximum number of requests per second.
+ *
+ * Sets the maximum number of requests per second of the whole application.
+ **/
+void
+gfbgraph_scheduler_set_max_rate (GFBGraphScheduler *scheduler,
+                                 gdouble            max_rate)
+{
+  g_return_if_fail (GFBGRAPH_IS_SCHEDULER (scheduler));
+
+  g_object_set (G_OBJECT (scheduler),
+                "max-rate", max_rate,
+                NULL);
+}
+
+/**
+ * gfbgraph_scheduler_get_max_rate_per_authorizer:
+ * @scheduler: a #GFBGraphScheduler.
+ *
+ * Returns: the maximum number of requests per second of a single #GFBGraphAuthorizer.
+ **/
+gdouble
+gfbgraph_scheduler_get_max_rate_per_authorizer (GFBGraphScheduler *scheduler)
+{
+  gdouble max_rate;
+
+  g_return_val_if_fail (GFBGRAPH_IS_SCHEDULER (scheduler), 0);
+
+  g_object_get (G_OBJECT (scheduler),
+                "max-rate-per-authorizer", &max_rate,
+                NULL);
+
+  return max_rate;
+}
+
+/**
+ * gfbgraph_scheduler_set_max_rate_per_authorizer:
+ * @scheduler: a #GFBGraphScheduler.
+ * @max_rate: the maximum number of requests per second for a single authorizer.
+ *
+ * Sets the maximum number of requests per second of a single #GFBGraphAuthorizer.
+ **/
+void
+gfbgraph_scheduler_set_max_rate_per_authorizer (GFBGraphScheduler *scheduler,
+                                                gdouble            max_rate)
+{
+  g_return_if_fail (GFBGRAPH_IS_SCHEDULER (scheduler));
+
+  g_object_set (G_OBJECT (scheduler),
+                "max-rate-per-authorizer", max_rate,
+                NULL);
+}
+
+/**
+ * gfbgraph_scheduler_get_in_flight:
+ * @scheduler: a #GFBGraphScheduler.
+ *
+ * Returns: the number of requests currently in progress.
+ **/
+guint
+gfbgraph_scheduler_get_in_flight (GFBGraphScheduler *scheduler)
+{
+  guint in_flight;
+
+  g_return_val_if_fail (GFBGRAPH_IS_SCHEDULER (scheduler), 0);
+
+  g_mutex_lock (&scheduler->priv->mutex);
+  in_flight = scheduler->priv->in_flight;
+  g_mutex_unlock (&scheduler->priv->mutex);
+
+  return in_flight;
+}
@@ -0,0 +1,76 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 2; tab-width: 2 -*-  */
+/*
+ * libgfbgraph - GObject library for Facebook Graph API
+ * Copyright (C) 2013 Álvaro Peña <alvaropg@gmail.com>
+ *               2020 Leesoo Ahn <yisooan@fedoraproject.org>
+ *
+ * GFBGraph is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GFBGraph is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GFBGraph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GFBGRAPH_SCHEDULER_H__
+#define __GFBGRAPH_SCHEDULER_H__
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define GFBGRAPH_TYPE_SCHEDULER (gfbgraph_scheduler_get_type())
+#define GFBGRAPH_SCHEDULER(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj),GFBGRAPH_TYPE_SCHEDULER,GFBGraphScheduler))
+#define GFBGRAPH_SCHEDULER_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass),GFBGRAPH_TYPE_SCHEDULER,GFBGraphSchedulerClass))
+#define GFBGRAPH_IS_SCHEDULER(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj),GFBGRAPH_TYPE_SCHEDULER))
+#define GFBGRAPH_IS_SCHEDULER_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass),GFBGRAPH_TYPE_SCHEDULER))
+#define GFBGRAPH_SCHEDULER_GET_CLASS(obj) \
+  (G_TYPE_INSTANCE_GET_CLASS((obj),GFBGRAPH_TYPE_SCHEDULER,GFBGraphSchedulerClass))
+
+typedef struct _GFBGraphScheduler        GFBGraphScheduler;
+typedef struct _GFBGraphSchedulerClass   GFBGraphSchedulerClass;
+typedef struct _GFBGraphSchedulerPrivate GFBGraphSchedulerPrivate;
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (GFBGraphScheduler, g_object_unref)
+
+struct _GFBGraphScheduler {
+  GObject parent;
+
+  /*< private >*/
+  GFBGraphSchedulerPrivate *priv;
+};
+
+struct _GFBGraphSchedulerClass {
+  GObjectClass parent_class;
+};
+
+GType              gfbgraph_scheduler_get_type                        (void) G_GNUC_CONST;
+GFBGraphScheduler* gfbgraph_scheduler_new                             (void);
+
+guint              gfbgraph_scheduler_get_max_in_flight               (GFBGraphScheduler *scheduler);
+void               gfbgraph_scheduler_set_max_in_flight               (GFBGraphScheduler *scheduler,
+                                                                       guint              max_in_flight);
+guint              gfbgraph_scheduler_get_max_in_flight_per_authorizer (GFBGraphScheduler *scheduler);
+void               gfbgraph_scheduler_set_max_in_flight_per_authorizer (GFBGraphScheduler *scheduler,
+                                                                        guint              max_in_flight);
+gdouble            gfbgraph_scheduler_get_max_rate                    (GFBGraphScheduler *scheduler);
+void               gfbgraph_scheduler_set_max_rate                    (GFBGraphScheduler *scheduler,
+                                                                       gdouble            max_rate);
+gdouble            gfbgraph_scheduler_get_max_rate_per_authorizer     (GFBGraphScheduler *scheduler);
+void               gfbgraph_scheduler_set_max_rate_per_authorizer     (GFBGraphScheduler *scheduler,
+                                                                       gdouble            max_rate);
+guint              gfbgraph_scheduler_get_in_flight                   (GFBGraphScheduler *scheduler);
+
+G_END_DECLS
+
+#endif /* __GFBGRAPH_SCHEDULER_H__ */
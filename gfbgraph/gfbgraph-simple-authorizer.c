@@ -31,6 +31,7 @@
 
 #include "gfbgraph-authorizer.h"
 #include "gfbgraph-simple-authorizer.h"
+#include "gfbgraph-private.h"
 
 enum
 {
@@ -39,8 +40,7 @@ enum
 };
 
 struct _GFBGraphSimpleAuthorizerPrivate {
-  GMutex mutex;
-  gchar *access_token;
+  GFBGraphTokenCell access_token;
 };
 
 #define GFBGRAPH_SIMPLE_AUTHORIZER_GET_PRIVATE(o) \
@@ -58,8 +58,7 @@ gfbgraph_simple_authorizer_finalize (GObject *obj)
 {
   GFBGraphSimpleAuthorizerPrivate *priv = GFBGRAPH_SIMPLE_AUTHORIZER_GET_PRIVATE (obj);
 
-  g_free (priv->access_token);
-  g_mutex_clear (&priv->mutex);
+  gfbgraph_token_cell_clear (&priv->access_token);
 
   G_OBJECT_CLASS(parent_class)->finalize (obj);
 }
@@ -74,9 +73,7 @@ gfbgraph_simple_authorizer_set_property (GObject      *object,
 
   switch (prop_id) {
     case PROP_ACCESS_TOKEN:
-      if (priv->access_token)
-        g_free (priv->access_token);
-      priv->access_token = g_strdup (g_value_get_string (value));
+      gfbgraph_token_cell_set (&priv->access_token, g_value_get_string (value));
       break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
@@ -94,7 +91,7 @@ gfbgraph_simple_authorizer_get_property (GObject    *object,
 
   switch (prop_id) {
     case PROP_ACCESS_TOKEN:
-      g_value_set_string (value, priv->access_token);
+      g_value_take_string (value, gfbgraph_token_cell_dup (&priv->access_token));
       break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
@@ -106,7 +103,7 @@ static void
 gfbgraph_simple_authorizer_init (GFBGraphSimpleAuthorizer *obj)
 {
   obj->priv = GFBGRAPH_SIMPLE_AUTHORIZER_GET_PRIVATE(obj);
-  g_mutex_init (&obj->priv->mutex);
+  gfbgraph_token_cell_init (&obj->priv->access_token);
 }
 
 static void
@@ -142,11 +139,13 @@ process_call (GFBGraphAuthorizer *iface,
               RestProxyCall      *call)
 {
   GFBGraphSimpleAuthorizerPrivate *priv;
+  const gchar *access_token;
+  guint slot;
   priv = GFBGRAPH_SIMPLE_AUTHORIZER_GET_PRIVATE (GFBGRAPH_SIMPLE_AUTHORIZER (iface));
 
-  g_mutex_lock (&priv->mutex);
-  rest_proxy_call_add_param (call, "access_token", priv->access_token);
-  g_mutex_unlock (&priv->mutex);
+  access_token = gfbgraph_token_cell_read_begin (&priv->access_token, &slot);
+  rest_proxy_call_add_param (call, "access_token", access_token);
+  gfbgraph_token_cell_read_end (&priv->access_token, slot);
 }
 
 static void
@@ -155,18 +154,19 @@ process_message (GFBGraphAuthorizer *iface,
 {
   gchar *auth_value;
   SoupURI *uri;
+  const gchar *access_token;
+  guint slot;
   GFBGraphSimpleAuthorizerPrivate *priv;
   priv = GFBGRAPH_SIMPLE_AUTHORIZER_GET_PRIVATE (GFBGRAPH_SIMPLE_AUTHORIZER (iface));
 
-  g_mutex_lock (&priv->mutex);
+  access_token = gfbgraph_token_cell_read_begin (&priv->access_token, &slot);
+  auth_value = g_strconcat ("access_token=", access_token, NULL);
+  gfbgraph_token_cell_read_end (&priv->access_token, slot);
 
   uri = soup_message_get_uri (message);
-  auth_value = g_strconcat ("access_token=", priv->access_token, NULL);
   soup_uri_set_query (uri, auth_value);
 
   g_free (auth_value);
-
-  g_mutex_unlock (&priv->mutex);
 }
 
 static gboolean
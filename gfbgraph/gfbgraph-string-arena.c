@@ -0,0 +1,176 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 2; tab-width: 2 -*-  */
+/*
+ * libgfbgraph - GObject library for Facebook Graph API
+ * Copyright (C) 2013-2015 Álvaro Peña <alvaropg@gmail.com>
+ *               2020 Leesoo Ahn <yisooan@fedoraproject.org>
+ *
+ * GFBGraph is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GFBGraph is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GFBGraph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Per response string arena. The strings of the nodes deserialized from a
+ * response are copied one after the other in big blocks instead of being
+ * allocated one by one, and the nodes keep a reference on the arena while they
+ * point to them. The arena is only written by the thread deserializing the
+ * response, so only the reference count is atomic. */
+
+#include <string.h>
+
+#include "gfbgraph-private.h"
+
+#define ARENA_BLOCK_SIZE 4096
+
+typedef struct _ArenaBlock ArenaBlock;
+
+struct _ArenaBlock {
+  ArenaBlock *next;
+  gsize       size;
+  gsize       used;
+  gchar       data[1];
+};
+
+struct _GFBGraphStringArena {
+  gint        ref_count;
+  ArenaBlock *blocks;   /* The block being filled goes first */
+};
+
+static GPrivate current_arena;
+
+static ArenaBlock *
+arena_block_new (gsize size)
+{
+  ArenaBlock *block;
+
+  block = g_malloc (G_STRUCT_OFFSET (ArenaBlock, data) + size);
+  block->next = NULL;
+  block->size = size;
+  block->used = 0;
+
+  return block;
+}
+
+/* --- Internal API --- */
+GFBGraphStringArena *
+gfbgraph_string_arena_new (void)
+{
+  GFBGraphStringArena *arena;
+
+  arena = g_new0 (GFBGraphStringArena, 1);
+  arena->ref_count = 1;
+
+  return arena;
+}
+
+GFBGraphStringArena *
+gfbgraph_string_arena_ref (GFBGraphStringArena *arena)
+{
+  g_return_val_if_fail (arena != NULL, NULL);
+
+  g_atomic_int_inc (&arena->ref_count);
+
+  return arena;
+}
+
+void
+gfbgraph_string_arena_unref (GFBGraphStringArena *arena)
+{
+  ArenaBlock *block;
+
+  g_return_if_fail (arena != NULL);
+
+  if (!g_atomic_int_dec_and_test (&arena->ref_count))
+    return;
+
+  while (arena->blocks != NULL) {
+    block = arena->blocks;
+    arena->blocks = block->next;
+    g_free (block);
+  }
+
+  g_free (arena);
+}
+
+/* Copies @str into @arena, the copy lives as long as the arena */
+const gchar *
+gfbgraph_string_arena_insert (GFBGraphStringArena *arena,
+                              const gchar         *str)
+{
+  ArenaBlock *block;
+  gsize length;
+  gchar *copy;
+
+  g_return_val_if_fail (arena != NULL, NULL);
+
+  if (str == NULL)
+    return NULL;
+
+  length = strlen (str) + 1;
+  block = arena->blocks;
+  if (block == NULL || block->size - block->used < length) {
+    if (length > ARENA_BLOCK_SIZE / 4 && block != NULL) {
+      /* Big strings get their own block behind the current one,
+       * so its free space isn't wasted */
+      ArenaBlock *big_block = arena_block_new (length);
+
+      big_block->next = block->next;
+      block->next = big_block;
+      block = big_block;
+    } else {
+      block = arena_block_new (MAX (length, ARENA_BLOCK_SIZE));
+      block->next = arena->blocks;
+      arena->blocks = block;
+    }
+  }
+
+  copy = block->data + block->used;
+  memcpy (copy, str, length);
+  block->used += length;
+
+  return copy;
+}
+
+/* Whether @str points into the memory of @arena */
+gboolean
+gfbgraph_string_arena_contains (GFBGraphStringArena *arena,
+                                const gchar         *str)
+{
+  ArenaBlock *block;
+
+  g_return_val_if_fail (arena != NULL, FALSE);
+
+  for (block = arena->blocks; block != NULL; block = block->next) {
+    if (str >= block->data && str < block->data + block->used)
+      return TRUE;
+  }
+
+  return FALSE;
+}
+
+GFBGraphStringArena *
+gfbgraph_string_arena_get_current (void)
+{
+  return g_private_get (&current_arena);
+}
+
+/* Makes @arena the one used by the nodes deserialized in this thread,
+ * returns the previous one to restore it later */
+GFBGraphStringArena *
+gfbgraph_string_arena_set_current (GFBGraphStringArena *arena)
+{
+  GFBGraphStringArena *previous;
+
+  previous = g_private_get (&current_arena);
+  g_private_set (&current_arena, arena);
+
+  return previous;
+}
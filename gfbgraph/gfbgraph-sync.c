@@ -0,0 +1,1386 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 2; tab-width: 2 -*-  */
+/*
+ * libgfbgraph - GObject library for Facebook Graph API
+ * Copyright (C) 2013 Álvaro Peña <alvaropg@gmail.com>
+ *               2020 Leesoo Ahn <yisooan@fedoraproject.org>
+ *
+ * GFBGraph is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GFBGraph is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GFBGraph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * SECTION:gfbgraph-sync
+ * @title: GFBGraphSync
+ * @short_description: Incremental synchronization of the albums of a user
+ * @stability: Unstable
+ * @include: gfbgraph/gfbgraph.h
+ *
+ * #GFBGraphSync mirrors the albums of a #GFBGraphUser and their photos. It keeps
+ * a snapshot with the ID, updated time and count of every album and the ID and
+ * updated time of every photo, and every gfbgraph_sync_run() reports the
+ * differences with the previous one as a stream of #GFBGraphSyncChange.
+ *
+ * The list of albums is always retrieved, but only the albums whose updated
+ * time or count changed have their photos listed, and only with their IDs and
+ * updated times. The photos added or updated are then retrieved in batches, so
+ * the traffic of a sync depends on the amount of changes, not on the size of
+ * the albums.
+ *
+ * gfbgraph_sync_run() updates the snapshot of an album once all its changes
+ * have been reported, while gfbgraph_sync_run_async(), which returns the
+ * changes at the end, only updates the snapshot if the whole sync succeeds. If
+ * a sync fails, the next one reports again the changes not reported, so every
+ * change is reported at least once. The snapshot can be kept between sessions
+ * with gfbgraph_sync_save_state() and gfbgraph_sync_load_state().
+ **/
+
+#include <json-glib/json-glib.h>
+
+#include "gfbgraph-album.h"
+#include "gfbgraph-connection-iterator.h"
+#include "gfbgraph-field-set.h"
+#include "gfbgraph-photo.h"
+#include "gfbgraph-sync.h"
+#include "gfbgraph-private.h"
+
+#define ALBUM_FIELDS       "id,name,description,cover_photo,count,link,created_time,updated_time"
+#define PHOTO_LIST_FIELDS  "id,updated_time"
+#define PHOTO_FIELDS       "id,name,source,width,height,images,link,created_time,updated_time"
+
+#define STATE_VERSION 1
+
+enum {
+  PROP_0,
+  PROP_USER,
+  PROP_AUTHORIZER
+};
+
+struct _GFBGraphSyncPrivate {
+  GFBGraphUser       *user;
+  GFBGraphAuthorizer *authorizer;
+  GMutex              mutex;
+  GHashTable         *albums;    /* Album ID -> AlbumState */
+  gboolean            running;
+};
+
+typedef struct {
+  gint64      updated_time;
+  guint       count;
+  GHashTable *photos;            /* Photo ID -> gint64 updated time */
+} AlbumState;
+
+#define GFBGRAPH_SYNC_GET_PRIVATE(o) \
+  (G_TYPE_INSTANCE_GET_PRIVATE((o), GFBGRAPH_TYPE_SYNC, GFBGraphSyncPrivate))
+
+static GObjectClass *parent_class = NULL;
+
+G_DEFINE_TYPE (GFBGraphSync, gfbgraph_sync, G_TYPE_OBJECT);
+
+G_DEFINE_BOXED_TYPE (GFBGraphSyncChange, gfbgraph_sync_change, gfbgraph_sync_change_copy, gfbgraph_sync_change_free);
+
+static void
+album_state_free (AlbumState *state)
+{
+  g_hash_table_unref (state->photos);
+  g_slice_free (AlbumState, state);
+}
+
+static GHashTable *
+new_photos_table (void)
+{
+  return g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+}
+
+static GHashTable *
+new_albums_table (void)
+{
+  return g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) album_state_free);
+}
+
+static void
+gfbgraph_sync_dispose (GObject *object)
+{
+  GFBGraphSyncPrivate *priv = GFBGRAPH_SYNC_GET_PRIVATE (object);
+
+  g_clear_object (&priv->user);
+  g_clear_object (&priv->authorizer);
+
+  G_OBJECT_CLASS (parent_class)->dispose (object);
+}
+
+static void
+gfbgraph_sync_finalize (GObject *object)
+{
+  GFBGraphSyncPrivate *priv = GFBGRAPH_SYNC_GET_PRIVATE (object);
+
+  g_hash_table_unref (priv->albums);
+  g_mutex_clear (&priv->mutex);
+
+  G_OBJECT_CLASS (parent_class)->finalize (object);
+}
+
+static void
+gfbgraph_sync_set_property (GObject      *object,
+                            guint         prop_id,
+                            const GValue *value,
+                            GParamSpec   *pspec)
+{
+  GFBGraphSyncPrivate *priv = GFBGRAPH_SYNC_GET_PRIVATE (object);
+
+  switch (prop_id) {
+    case PROP_USER:
+      priv->user = g_value_dup_object (value);
+      break;
+    case PROP_AUTHORIZER:
+      priv->authorizer = g_value_dup_object (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gfbgraph_sync_get_property (GObject    *object,
+                            guint       prop_id,
+                            GValue     *value,
+                            GParamSpec *pspec)
+{
+  GFBGraphSyncPrivate *priv = GFBGRAPH_SYNC_GET_PRIVATE (object);
+
+  switch (prop_id) {
+    case PROP_USER:
+      g_value_set_object (value, priv->user);
+      break;
+    case PROP_AUTHORIZER:
+      g_value_set_object (value, priv->authorizer);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+gfbgraph_sync_class_init (GFBGraphSyncClass *klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+
+  parent_class                = g_type_class_peek_parent (klass);
+  gobject_class->dispose      = gfbgraph_sync_dispose;
+  gobject_class->finalize     = gfbgraph_sync_finalize;
+  gobject_class->set_property = gfbgraph_sync_set_property;
+  gobject_class->get_property = gfbgraph_sync_get_property;
+
+  g_type_class_add_private (gobject_class, sizeof(GFBGraphSyncPrivate));
+
+  /**
+   * GFBGraphSync:user:
+   *
+   * The #GFBGraphUser whose albums are synchronized.
+   **/
+  g_object_class_install_property (gobject_class,
+                                   PROP_USER,
+                                   g_param_spec_object ("user",
+                                                        "User",
+                                                        "The user whose albums are synchronized",
+                                                        GFBGRAPH_TYPE_USER,
+                                                        G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE));
+
+  /**
+   * GFBGraphSync:authorizer:
+   *
+   * The #GFBGraphAuthorizer used to request the albums and photos.
+   **/
+  g_object_class_install_property (gobject_class,
+                                   PROP_AUTHORIZER,
+                                   g_param_spec_object ("authorizer",
+                                                        "Authorizer",
+                                                        "The authorizer used to request the albums and photos",
+                                                        GFBGRAPH_TYPE_AUTHORIZER,
+                                                        G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE));
+}
+
+static void
+gfbgraph_sync_init (GFBGraphSync *obj)
+{
+  obj->priv = GFBGRAPH_SYNC_GET_PRIVATE (obj);
+
+  g_mutex_init (&obj->priv->mutex);
+  obj->priv->albums = new_albums_table ();
+}
+
+/* --- Private Functions --- */
+static void
+emit_change (GFBGraphSyncChangeFunc  func,
+             gpointer                user_data,
+             GFBGraphSyncChangeType  type,
+             const gchar            *album_id,
+             const gchar            *id,
+             GFBGraphNode           *node)
+{
+  GFBGraphSyncChange change;
+
+  change.type = type;
+  change.album_id = (gchar *) album_id;
+  change.id = (gchar *) id;
+  change.node = node;
+
+  func (&change, user_data);
+}
+
+/* The photos table of the album in the snapshot, the running sync only reads
+ * it and it's only replaced by the running sync itself */
+static GHashTable *
+lookup_album_locked (GFBGraphSyncPrivate  *priv,
+                     const gchar          *album_id,
+                     gint64               *updated_time,
+                     guint                *count)
+{
+  AlbumState *state;
+
+  state = g_hash_table_lookup (priv->albums, album_id);
+  if (state == NULL)
+    return NULL;
+
+  *updated_time = state->updated_time;
+  *count = state->count;
+
+  return state->photos;
+}
+
+/* Stores the new state of an album in the snapshot, or in @staged if not %NULL */
+static void
+commit_album (GFBGraphSync *sync,
+              GHashTable   *staged,
+              const gchar  *album_id,
+              gint64        updated_time,
+              guint         count,
+              GHashTable   *photos)
+{
+  AlbumState *state;
+
+  state = g_slice_new (AlbumState);
+  state->updated_time = updated_time;
+  state->count = count;
+  state->photos = photos;
+
+  if (staged != NULL) {
+    g_hash_table_replace (staged, g_strdup (album_id), state);
+    return;
+  }
+
+  g_mutex_lock (&sync->priv->mutex);
+  g_hash_table_replace (sync->priv->albums, g_strdup (album_id), state);
+  g_mutex_unlock (&sync->priv->mutex);
+}
+
+static void
+set_photo_time (GHashTable  *photos,
+                const gchar *photo_id,
+                gint64       updated_time)
+{
+  gint64 *value;
+
+  value = g_new (gint64, 1);
+  *value = updated_time;
+  g_hash_table_replace (photos, g_strdup (photo_id), value);
+}
+
+/* Adds the photos of a @page of the album listing to @photos, and the ones
+ * added or updated since @old_photos to @changed_ids */
+static void
+add_listed_photos (GPtrArray  *page,
+                   GHashTable *old_photos,
+                   GHashTable *photos,
+                   GPtrArray  *changed_ids)
+{
+  guint i;
+
+  for (i = 0; i < page->len; i++) {
+    GFBGraphNode *photo = g_ptr_array_index (page, i);
+    const gchar *photo_id = gfbgraph_node_get_id (photo);
+    gint64 updated_time = gfbgraph_node_get_updated_timestamp (photo);
+    gint64 *old_time = NULL;
+
+    if (photo_id == NULL)
+      continue;
+
+    if (old_photos != NULL)
+      old_time = g_hash_table_lookup (old_photos, photo_id);
+    set_photo_time (photos, photo_id, updated_time);
+    if (old_time == NULL || *old_time != updated_time)
+      g_ptr_array_add (changed_ids, g_strdup (photo_id));
+  }
+}
+
+/* Reports the photos of @changed_ids retrieved in @nodes as added or updated.
+ * The ones not retrieved keep their old time in @photos, so they're reported
+ * again in the next sync. */
+static void
+report_retrieved_photos (GHashTable             *nodes,
+                         GPtrArray              *changed_ids,
+                         GHashTable             *old_photos,
+                         GHashTable             *photos,
+                         const gchar            *album_id,
+                         GFBGraphSyncChangeFunc  func,
+                         gpointer                user_data)
+{
+  guint i;
+
+  for (i = 0; i < changed_ids->len; i++) {
+    const gchar *photo_id = g_ptr_array_index (changed_ids, i);
+    GFBGraphNode *photo;
+    gint64 *old_time;
+
+    if (photo_id == NULL)
+      continue;
+
+    photo = g_hash_table_lookup (nodes, photo_id);
+    old_time = old_photos != NULL ? g_hash_table_lookup (old_photos, photo_id) : NULL;
+    if (photo != NULL) {
+      emit_change (func, user_data,
+                   old_time == NULL ? GFBGRAPH_SYNC_CHANGE_ADDED : GFBGRAPH_SYNC_CHANGE_UPDATED,
+                   album_id, photo_id, photo);
+    } else if (old_time != NULL) {
+      set_photo_time (photos, photo_id, *old_time);
+    } else {
+      g_hash_table_remove (photos, photo_id);
+    }
+  }
+}
+
+static void
+report_removed_photos (GHashTable             *old_photos,
+                       GHashTable             *photos,
+                       const gchar            *album_id,
+                       GFBGraphSyncChangeFunc  func,
+                       gpointer                user_data)
+{
+  GHashTableIter iter;
+  gpointer key;
+
+  if (old_photos == NULL)
+    return;
+
+  g_hash_table_iter_init (&iter, old_photos);
+  while (g_hash_table_iter_next (&iter, &key, NULL)) {
+    if (!g_hash_table_contains (photos, key))
+      emit_change (func, user_data, GFBGRAPH_SYNC_CHANGE_REMOVED, album_id, key, NULL);
+  }
+}
+
+static GFBGraphConnectionIterator *
+new_album_photos_iterator (GFBGraphSync   *sync,
+                           GFBGraphAlbum  *album,
+                           GError        **error)
+{
+  GFBGraphConnectionIterator *iterator;
+  GFBGraphFieldSet *fields;
+
+  iterator = gfbgraph_connection_iterator_new (GFBGRAPH_NODE (album), GFBGRAPH_TYPE_PHOTO,
+                                               sync->priv->authorizer, error);
+  if (iterator == NULL)
+    return NULL;
+
+  fields = gfbgraph_field_set_new_from_string (PHOTO_LIST_FIELDS);
+  gfbgraph_connection_iterator_set_fields (iterator, fields);
+  gfbgraph_field_set_unref (fields);
+
+  return iterator;
+}
+
+static GFBGraphConnectionIterator *
+new_albums_iterator (GFBGraphSync  *sync,
+                     GError       **error)
+{
+  GFBGraphConnectionIterator *iterator;
+  GFBGraphFieldSet *fields;
+
+  iterator = gfbgraph_connection_iterator_new (GFBGRAPH_NODE (sync->priv->user), GFBGRAPH_TYPE_ALBUM,
+                                               sync->priv->authorizer, error);
+  if (iterator == NULL)
+    return NULL;
+
+  fields = gfbgraph_field_set_new_from_string (ALBUM_FIELDS);
+  gfbgraph_connection_iterator_set_fields (iterator, fields);
+  gfbgraph_field_set_unref (fields);
+
+  return iterator;
+}
+
+/* Whether @album changed since the snapshot, returning its old photos table
+ * in @old_photos, %NULL if it's new */
+static gboolean
+album_changed (GFBGraphSync   *sync,
+               GFBGraphAlbum  *album,
+               GHashTable    **old_photos)
+{
+  const gchar *album_id = gfbgraph_node_get_id (GFBGRAPH_NODE (album));
+  gint64 old_updated_time = 0;
+  guint old_count = 0;
+
+  g_mutex_lock (&sync->priv->mutex);
+  *old_photos = lookup_album_locked (sync->priv, album_id, &old_updated_time, &old_count);
+  g_mutex_unlock (&sync->priv->mutex);
+
+  return *old_photos == NULL
+         || old_updated_time != gfbgraph_node_get_updated_timestamp (GFBGRAPH_NODE (album))
+         || old_count != gfbgraph_album_get_count (album);
+}
+
+/* Lists the photos of @album with just their updated time, retrieves the
+ * added and updated ones and reports the changes against @old_photos. Returns
+ * the new photos table of the album, or %NULL in case of error. */
+static GHashTable *
+sync_album_photos (GFBGraphSync            *sync,
+                   GFBGraphAlbum           *album,
+                   const gchar             *album_id,
+                   GHashTable              *old_photos,
+                   GFBGraphSyncChangeFunc   func,
+                   gpointer                 user_data,
+                   GCancellable            *cancellable,
+                   GError                 **error)
+{
+  GFBGraphSyncPrivate *priv = sync->priv;
+  GFBGraphConnectionIterator *iterator;
+  GFBGraphFieldSet *fields;
+  GHashTable *photos, *nodes, *node_errors = NULL;
+  GPtrArray *changed_ids, *page;
+  GError *page_error = NULL;
+
+  iterator = new_album_photos_iterator (sync, album, error);
+  if (iterator == NULL)
+    return NULL;
+
+  photos = new_photos_table ();
+  changed_ids = g_ptr_array_new_with_free_func (g_free);
+
+  while ((page = gfbgraph_connection_iterator_next_page_array (iterator, cancellable, &page_error)) != NULL) {
+    add_listed_photos (page, old_photos, photos, changed_ids);
+    g_ptr_array_unref (page);
+  }
+  g_object_unref (iterator);
+
+  if (page_error != NULL) {
+    g_propagate_error (error, page_error);
+    g_ptr_array_unref (changed_ids);
+    g_hash_table_unref (photos);
+    return NULL;
+  }
+
+  if (changed_ids->len > 0) {
+    /* The photos of a failed batch come in node_errors like the photos that
+     * failed alone, and are retried in the next sync. The album only fails if
+     * no batch could be retrieved. */
+    g_ptr_array_add (changed_ids, NULL);
+    fields = gfbgraph_field_set_new_from_string (PHOTO_FIELDS);
+    nodes = gfbgraph_node_new_from_ids (priv->authorizer,
+                                        (const gchar * const *) changed_ids->pdata,
+                                        GFBGRAPH_TYPE_PHOTO,
+                                        fields,
+                                        0,
+                                        &node_errors,
+                                        error);
+    gfbgraph_field_set_unref (fields);
+    if (nodes == NULL) {
+      g_ptr_array_unref (changed_ids);
+      g_hash_table_unref (photos);
+      return NULL;
+    }
+
+    report_retrieved_photos (nodes, changed_ids, old_photos, photos, album_id, func, user_data);
+
+    g_hash_table_unref (nodes);
+    if (node_errors != NULL)
+      g_hash_table_unref (node_errors);
+  }
+  g_ptr_array_unref (changed_ids);
+
+  report_removed_photos (old_photos, photos, album_id, func, user_data);
+
+  return photos;
+}
+
+/* Reports the albums of the snapshot not in @seen, and their photos, as removed */
+static void
+remove_missing_albums (GFBGraphSync           *sync,
+                       GHashTable             *seen,
+                       GFBGraphSyncChangeFunc  func,
+                       gpointer                user_data)
+{
+  GFBGraphSyncPrivate *priv = sync->priv;
+  GHashTable *removed;
+  GHashTableIter iter;
+  gpointer key, value;
+
+  removed = new_albums_table ();
+
+  g_mutex_lock (&priv->mutex);
+  g_hash_table_iter_init (&iter, priv->albums);
+  while (g_hash_table_iter_next (&iter, &key, &value)) {
+    if (!g_hash_table_contains (seen, key)) {
+      g_hash_table_insert (removed, key, value);
+      g_hash_table_iter_steal (&iter);
+    }
+  }
+  g_mutex_unlock (&priv->mutex);
+
+  g_hash_table_iter_init (&iter, removed);
+  while (g_hash_table_iter_next (&iter, &key, &value)) {
+    AlbumState *state = value;
+    GHashTableIter photos_iter;
+    gpointer photo_id;
+
+    g_hash_table_iter_init (&photos_iter, state->photos);
+    while (g_hash_table_iter_next (&photos_iter, &photo_id, NULL))
+      emit_change (func, user_data, GFBGRAPH_SYNC_CHANGE_REMOVED, key, photo_id, NULL);
+    emit_change (func, user_data, GFBGRAPH_SYNC_CHANGE_REMOVED, key, key, NULL);
+  }
+
+  g_hash_table_unref (removed);
+}
+
+/* Moves the album states staged by sync_albums() to the snapshot */
+static void
+apply_staged_albums (GFBGraphSync *sync,
+                     GHashTable   *staged)
+{
+  GHashTableIter iter;
+  gpointer key, value;
+
+  g_mutex_lock (&sync->priv->mutex);
+  g_hash_table_iter_init (&iter, staged);
+  while (g_hash_table_iter_next (&iter, &key, &value)) {
+    g_hash_table_replace (sync->priv->albums, key, value);
+    g_hash_table_iter_steal (&iter);
+  }
+  g_mutex_unlock (&sync->priv->mutex);
+}
+
+/* Reports the changes to @func. The completed albums are committed to the
+ * snapshot right away, or to @staged if not %NULL. */
+static gboolean
+sync_albums (GFBGraphSync            *sync,
+             GHashTable              *staged,
+             GFBGraphSyncChangeFunc   func,
+             gpointer                 user_data,
+             GCancellable            *cancellable,
+             GError                 **error)
+{
+  GFBGraphConnectionIterator *iterator;
+  GHashTable *seen;
+  GPtrArray *page;
+  GError *sync_error = NULL;
+  guint i;
+
+  iterator = new_albums_iterator (sync, error);
+  if (iterator == NULL)
+    return FALSE;
+
+  seen = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+  while (sync_error == NULL
+         && (page = gfbgraph_connection_iterator_next_page_array (iterator, cancellable, &sync_error)) != NULL) {
+    for (i = 0; i < page->len && sync_error == NULL; i++) {
+      GFBGraphAlbum *album = g_ptr_array_index (page, i);
+      const gchar *album_id = gfbgraph_node_get_id (GFBGRAPH_NODE (album));
+      GHashTable *old_photos, *photos;
+
+      if (album_id == NULL)
+        continue;
+      g_hash_table_add (seen, g_strdup (album_id));
+
+      if (!album_changed (sync, album, &old_photos))
+        continue;
+
+      emit_change (func, user_data,
+                   old_photos == NULL ? GFBGRAPH_SYNC_CHANGE_ADDED : GFBGRAPH_SYNC_CHANGE_UPDATED,
+                   album_id, album_id, GFBGRAPH_NODE (album));
+
+      photos = sync_album_photos (sync, album, album_id, old_photos,
+                                  func, user_data, cancellable, &sync_error);
+      if (photos != NULL)
+        commit_album (sync, staged, album_id,
+                      gfbgraph_node_get_updated_timestamp (GFBGRAPH_NODE (album)),
+                      gfbgraph_album_get_count (album),
+                      photos);
+    }
+    g_ptr_array_unref (page);
+  }
+  g_object_unref (iterator);
+
+  /* Only a complete list of albums tells which ones were removed */
+  if (sync_error == NULL)
+    remove_missing_albums (sync, seen, func, user_data);
+  g_hash_table_unref (seen);
+
+  if (sync_error != NULL) {
+    g_propagate_error (error, sync_error);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static gboolean
+start_run (GFBGraphSync  *sync,
+           GError       **error)
+{
+  gboolean started = FALSE;
+
+  g_mutex_lock (&sync->priv->mutex);
+  if (!sync->priv->running) {
+    sync->priv->running = TRUE;
+    started = TRUE;
+  }
+  g_mutex_unlock (&sync->priv->mutex);
+
+  if (!started)
+    g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_PENDING,
+                         "A synchronization is already in progress");
+
+  return started;
+}
+
+static void
+finish_run (GFBGraphSync *sync)
+{
+  g_mutex_lock (&sync->priv->mutex);
+  sync->priv->running = FALSE;
+  g_mutex_unlock (&sync->priv->mutex);
+}
+
+static void
+collect_change (const GFBGraphSyncChange *change,
+                gpointer                  user_data)
+{
+  g_ptr_array_add ((GPtrArray *) user_data, gfbgraph_sync_change_copy (change));
+}
+
+/* The state of gfbgraph_sync_run_async(), which walks the albums like
+ * sync_albums() with the asynchronous calls */
+typedef struct {
+  GHashTable                 *staged;
+  GPtrArray                  *changes;
+  GHashTable                 *seen;
+  GFBGraphConnectionIterator *albums_iterator;
+  GPtrArray                  *albums_page;
+  guint                       album_index;
+
+  /* Of the album whose photos are being listed */
+  GFBGraphConnectionIterator *photos_iterator;
+  GHashTable                 *old_photos;
+  GHashTable                 *photos;
+  GPtrArray                  *changed_ids;
+} RunData;
+
+static void
+run_data_clear_album (RunData *data)
+{
+  g_clear_object (&data->photos_iterator);
+  g_clear_pointer (&data->photos, g_hash_table_unref);
+  g_clear_pointer (&data->changed_ids, g_ptr_array_unref);
+  data->old_photos = NULL;
+}
+
+static void
+run_data_free (RunData *data)
+{
+  run_data_clear_album (data);
+  g_clear_object (&data->albums_iterator);
+  g_clear_pointer (&data->albums_page, g_ptr_array_unref);
+  g_hash_table_unref (data->seen);
+  g_hash_table_unref (data->staged);
+  g_ptr_array_unref (data->changes);
+  g_slice_free (RunData, data);
+}
+
+static void run_next_album (GTask *task);
+
+static void
+run_return_error (GTask  *task,
+                  GError *error)
+{
+  finish_run (GFBGRAPH_SYNC (g_task_get_source_object (task)));
+  g_task_return_error (task, error);
+  g_object_unref (task);
+}
+
+static GFBGraphAlbum *
+run_current_album (RunData *data)
+{
+  return g_ptr_array_index (data->albums_page, data->album_index);
+}
+
+static void
+run_album_done (GTask *task)
+{
+  GFBGraphSync *sync = g_task_get_source_object (task);
+  RunData *data = g_task_get_task_data (task);
+  GFBGraphAlbum *album = run_current_album (data);
+  const gchar *album_id = gfbgraph_node_get_id (GFBGRAPH_NODE (album));
+
+  report_removed_photos (data->old_photos, data->photos, album_id, collect_change, data->changes);
+  commit_album (sync, data->staged, album_id,
+                gfbgraph_node_get_updated_timestamp (GFBGRAPH_NODE (album)),
+                gfbgraph_album_get_count (album),
+                data->photos);
+  data->photos = NULL;
+  run_data_clear_album (data);
+
+  data->album_index++;
+  run_next_album (task);
+}
+
+static void
+run_photos_retrieved_cb (GObject      *source_object,
+                         GAsyncResult *result,
+                         gpointer      user_data)
+{
+  GTask *task = G_TASK (user_data);
+  RunData *data = g_task_get_task_data (task);
+  GHashTable *nodes, *node_errors = NULL;
+  GError *error = NULL;
+
+  nodes = gfbgraph_node_new_from_ids_async_finish (GFBGRAPH_AUTHORIZER (source_object), result,
+                                                   &node_errors, &error);
+  if (nodes == NULL) {
+    run_return_error (task, error);
+    return;
+  }
+
+  report_retrieved_photos (nodes, data->changed_ids, data->old_photos, data->photos,
+                           gfbgraph_node_get_id (GFBGRAPH_NODE (run_current_album (data))),
+                           collect_change, data->changes);
+  g_hash_table_unref (nodes);
+  if (node_errors != NULL)
+    g_hash_table_unref (node_errors);
+
+  run_album_done (task);
+}
+
+static void
+run_photos_page_cb (GObject      *source_object,
+                    GAsyncResult *result,
+                    gpointer      user_data)
+{
+  GTask *task = G_TASK (user_data);
+  GFBGraphSync *sync = g_task_get_source_object (task);
+  RunData *data = g_task_get_task_data (task);
+  GFBGraphFieldSet *fields;
+  GPtrArray *page;
+  GError *error = NULL;
+
+  page = gfbgraph_connection_iterator_next_page_array_finish (data->photos_iterator, result, &error);
+  if (page != NULL) {
+    add_listed_photos (page, data->old_photos, data->photos, data->changed_ids);
+    g_ptr_array_unref (page);
+    gfbgraph_connection_iterator_next_page_async (data->photos_iterator, g_task_get_cancellable (task),
+                                                  run_photos_page_cb, task);
+    return;
+  }
+
+  if (error != NULL) {
+    run_return_error (task, error);
+    return;
+  }
+
+  if (data->changed_ids->len == 0) {
+    run_album_done (task);
+    return;
+  }
+
+  /* Like in sync_album_photos(), the photos of a failed batch are retried in
+   * the next sync */
+  g_ptr_array_add (data->changed_ids, NULL);
+  fields = gfbgraph_field_set_new_from_string (PHOTO_FIELDS);
+  gfbgraph_node_new_from_ids_async (sync->priv->authorizer,
+                                    (const gchar * const *) data->changed_ids->pdata,
+                                    GFBGRAPH_TYPE_PHOTO,
+                                    fields,
+                                    0,
+                                    g_task_get_cancellable (task),
+                                    run_photos_retrieved_cb,
+                                    task);
+  gfbgraph_field_set_unref (fields);
+}
+
+static void
+run_albums_page_cb (GObject      *source_object,
+                    GAsyncResult *result,
+                    gpointer      user_data)
+{
+  GTask *task = G_TASK (user_data);
+  GFBGraphSync *sync = g_task_get_source_object (task);
+  RunData *data = g_task_get_task_data (task);
+  GError *error = NULL;
+
+  data->albums_page = gfbgraph_connection_iterator_next_page_array_finish (data->albums_iterator, result, &error);
+  if (error != NULL) {
+    run_return_error (task, error);
+    return;
+  }
+
+  if (data->albums_page != NULL) {
+    data->album_index = 0;
+    run_next_album (task);
+    return;
+  }
+
+  /* The changes are only returned if the whole sync succeeds, so the albums
+   * completed before are only committed now */
+  remove_missing_albums (sync, data->seen, collect_change, data->changes);
+  apply_staged_albums (sync, data->staged);
+  finish_run (sync);
+  g_task_return_pointer (task, g_ptr_array_ref (data->changes), (GDestroyNotify) g_ptr_array_unref);
+  g_object_unref (task);
+}
+
+/* Goes on with the album at album_index in the current page, or with the
+ * next page */
+static void
+run_next_album (GTask *task)
+{
+  GFBGraphSync *sync = g_task_get_source_object (task);
+  RunData *data = g_task_get_task_data (task);
+  GError *error = NULL;
+
+  for (; data->album_index < data->albums_page->len; data->album_index++) {
+    GFBGraphAlbum *album = run_current_album (data);
+    const gchar *album_id = gfbgraph_node_get_id (GFBGRAPH_NODE (album));
+
+    if (album_id == NULL)
+      continue;
+    g_hash_table_add (data->seen, g_strdup (album_id));
+
+    if (!album_changed (sync, album, &data->old_photos))
+      continue;
+
+    emit_change (collect_change, data->changes,
+                 data->old_photos == NULL ? GFBGRAPH_SYNC_CHANGE_ADDED : GFBGRAPH_SYNC_CHANGE_UPDATED,
+                 album_id, album_id, GFBGRAPH_NODE (album));
+
+    data->photos_iterator = new_album_photos_iterator (sync, album, &error);
+    if (data->photos_iterator == NULL) {
+      run_return_error (task, error);
+      return;
+    }
+
+    data->photos = new_photos_table ();
+    data->changed_ids = g_ptr_array_new_with_free_func (g_free);
+    gfbgraph_connection_iterator_next_page_async (data->photos_iterator, g_task_get_cancellable (task),
+                                                  run_photos_page_cb, task);
+    return;
+  }
+
+  g_clear_pointer (&data->albums_page, g_ptr_array_unref);
+  gfbgraph_connection_iterator_next_page_async (data->albums_iterator, g_task_get_cancellable (task),
+                                                run_albums_page_cb, task);
+}
+
+static void
+add_state_member (JsonBuilder *builder,
+                  const gchar *id,
+                  gint64       updated_time)
+{
+  json_builder_set_member_name (builder, "id");
+  json_builder_add_string_value (builder, id);
+  json_builder_set_member_name (builder, "updated_time");
+  json_builder_add_int_value (builder, updated_time);
+}
+
+/* The int @member of @object, %FALSE if missing or of another type */
+static gboolean
+get_int_member (JsonObject  *object,
+                const gchar *member,
+                gint64      *value)
+{
+  JsonNode *node;
+
+  node = json_object_get_member (object, member);
+  if (node == NULL || !JSON_NODE_HOLDS_VALUE (node) || json_node_get_value_type (node) != G_TYPE_INT64)
+    return FALSE;
+
+  *value = json_node_get_int (node);
+  return TRUE;
+}
+
+/* The string @member of @object, %NULL if missing or of another type */
+static const gchar *
+get_string_member (JsonObject  *object,
+                   const gchar *member)
+{
+  JsonNode *node;
+
+  node = json_object_get_member (object, member);
+  if (node == NULL || !JSON_NODE_HOLDS_VALUE (node) || json_node_get_value_type (node) != G_TYPE_STRING)
+    return NULL;
+
+  return json_node_get_string (node);
+}
+
+/* The array @member of @object, %NULL if missing or of another type */
+static JsonArray *
+get_array_member (JsonObject  *object,
+                  const gchar *member)
+{
+  JsonNode *node;
+
+  node = json_object_get_member (object, member);
+  if (node == NULL || !JSON_NODE_HOLDS_ARRAY (node))
+    return NULL;
+
+  return json_node_get_array (node);
+}
+
+static gboolean
+parse_state (JsonNode    *root,
+             GHashTable  *albums,
+             GError     **error)
+{
+  JsonObject *root_object;
+  JsonArray *albums_array;
+  gint64 version;
+  guint i, j;
+
+  if (root == NULL || !JSON_NODE_HOLDS_OBJECT (root)) {
+    g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                         "Invalid synchronization state: not an object");
+    return FALSE;
+  }
+
+  root_object = json_node_get_object (root);
+  if (!get_int_member (root_object, "version", &version) || version != STATE_VERSION) {
+    g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                         "Invalid synchronization state: unsupported version");
+    return FALSE;
+  }
+
+  albums_array = get_array_member (root_object, "albums");
+  if (albums_array == NULL) {
+    g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                         "Invalid synchronization state: no albums");
+    return FALSE;
+  }
+
+  for (i = 0; i < json_array_get_length (albums_array); i++) {
+    JsonObject *album_object;
+    JsonArray *photos_array;
+    AlbumState *state;
+    const gchar *album_id;
+    gint64 updated_time, count;
+
+    if (!JSON_NODE_HOLDS_OBJECT (json_array_get_element (albums_array, i))) {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                   "Invalid synchronization state: album %u isn't an object", i);
+      return FALSE;
+    }
+
+    album_object = json_array_get_object_element (albums_array, i);
+    album_id = get_string_member (album_object, "id");
+    photos_array = get_array_member (album_object, "photos");
+    if (album_id == NULL || photos_array == NULL
+        || !get_int_member (album_object, "updated_time", &updated_time)
+        || !get_int_member (album_object, "count", &count)
+        || count < 0 || count > G_MAXUINT) {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                   "Invalid synchronization state: album %u is incomplete", i);
+      return FALSE;
+    }
+
+    state = g_slice_new (AlbumState);
+    state->updated_time = updated_time;
+    state->count = count;
+    state->photos = new_photos_table ();
+    g_hash_table_replace (albums, g_strdup (album_id), state);
+
+    for (j = 0; j < json_array_get_length (photos_array); j++) {
+      JsonObject *photo_object;
+      const gchar *photo_id;
+
+      if (!JSON_NODE_HOLDS_OBJECT (json_array_get_element (photos_array, j))) {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                     "Invalid synchronization state: photo %u of album %s isn't an object",
+                     j, album_id);
+        return FALSE;
+      }
+
+      photo_object = json_array_get_object_element (photos_array, j);
+      photo_id = get_string_member (photo_object, "id");
+      if (photo_id == NULL || !get_int_member (photo_object, "updated_time", &updated_time)) {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                     "Invalid synchronization state: photo %u of album %s is incomplete",
+                     j, album_id);
+        return FALSE;
+      }
+
+      set_photo_time (state->photos, photo_id, updated_time);
+    }
+  }
+
+  return TRUE;
+}
+
+/* --- Public API --- */
+
+/**
+ * gfbgraph_sync_change_copy:
+ * @change: a #GFBGraphSyncChange.
+ *
+ * Returns: (transfer full): a copy of @change, free it with gfbgraph_sync_change_free().
+ **/
+GFBGraphSyncChange *
+gfbgraph_sync_change_copy (const GFBGraphSyncChange *change)
+{
+  GFBGraphSyncChange *copy;
+
+  g_return_val_if_fail (change != NULL, NULL);
+
+  copy = g_slice_new (GFBGraphSyncChange);
+  copy->type = change->type;
+  copy->album_id = g_strdup (change->album_id);
+  copy->id = g_strdup (change->id);
+  copy->node = change->node != NULL ? g_object_ref (change->node) : NULL;
+
+  return copy;
+}
+
+/**
+ * gfbgraph_sync_change_free:
+ * @change: a #GFBGraphSyncChange.
+ *
+ * Frees a #GFBGraphSyncChange returned by gfbgraph_sync_change_copy().
+ **/
+void
+gfbgraph_sync_change_free (GFBGraphSyncChange *change)
+{
+  if (change == NULL)
+    return;
+
+  g_free (change->album_id);
+  g_free (change->id);
+  g_clear_object (&change->node);
+  g_slice_free (GFBGraphSyncChange, change);
+}
+
+/**
+ * gfbgraph_sync_new:
+ * @user: a #GFBGraphUser, like the one returned by gfbgraph_user_get_me().
+ * @authorizer: a #GFBGraphAuthorizer.
+ *
+ * Creates a new #GFBGraphSync for the albums of @user, with an empty snapshot,
+ * so the first sync reports all the albums and photos as added.
+ *
+ * Returns: (transfer full): a new #GFBGraphSync; unref with g_object_unref()
+ **/
+GFBGraphSync *
+gfbgraph_sync_new (GFBGraphUser       *user,
+                   GFBGraphAuthorizer *authorizer)
+{
+  g_return_val_if_fail (GFBGRAPH_IS_USER (user), NULL);
+  g_return_val_if_fail (GFBGRAPH_IS_AUTHORIZER (authorizer), NULL);
+
+  return GFBGRAPH_SYNC (g_object_new (GFBGRAPH_TYPE_SYNC,
+                                      "user", user,
+                                      "authorizer", authorizer,
+                                      NULL));
+}
+
+/**
+ * gfbgraph_sync_get_user:
+ * @sync: a #GFBGraphSync.
+ *
+ * Returns: (transfer none): the #GFBGraphUser whose albums are synchronized.
+ **/
+GFBGraphUser *
+gfbgraph_sync_get_user (GFBGraphSync *sync)
+{
+  g_return_val_if_fail (GFBGRAPH_IS_SYNC (sync), NULL);
+
+  return sync->priv->user;
+}
+
+/**
+ * gfbgraph_sync_get_authorizer:
+ * @sync: a #GFBGraphSync.
+ *
+ * Returns: (transfer none): the #GFBGraphAuthorizer used by @sync.
+ **/
+GFBGraphAuthorizer *
+gfbgraph_sync_get_authorizer (GFBGraphSync *sync)
+{
+  g_return_val_if_fail (GFBGRAPH_IS_SYNC (sync), NULL);
+
+  return sync->priv->authorizer;
+}
+
+/**
+ * gfbgraph_sync_save_state:
+ * @sync: a #GFBGraphSync.
+ *
+ * Serializes the snapshot of @sync, so it can be restored with
+ * gfbgraph_sync_load_state() in a later session. It can be called while a
+ * sync is in progress, the albums being synchronized keep their previous state.
+ *
+ * Returns: (transfer full): a newly-allocated string with the snapshot.
+ **/
+gchar *
+gfbgraph_sync_save_state (GFBGraphSync *sync)
+{
+  GFBGraphSyncPrivate *priv;
+  JsonBuilder *builder;
+  JsonGenerator *generator;
+  JsonNode *root;
+  GHashTableIter iter, photos_iter;
+  gpointer key, value;
+  gchar *state;
+
+  g_return_val_if_fail (GFBGRAPH_IS_SYNC (sync), NULL);
+
+  priv = sync->priv;
+  builder = json_builder_new ();
+  json_builder_begin_object (builder);
+  json_builder_set_member_name (builder, "version");
+  json_builder_add_int_value (builder, STATE_VERSION);
+  json_builder_set_member_name (builder, "albums");
+  json_builder_begin_array (builder);
+
+  g_mutex_lock (&priv->mutex);
+  g_hash_table_iter_init (&iter, priv->albums);
+  while (g_hash_table_iter_next (&iter, &key, &value)) {
+    AlbumState *album_state = value;
+
+    json_builder_begin_object (builder);
+    add_state_member (builder, key, album_state->updated_time);
+    json_builder_set_member_name (builder, "count");
+    json_builder_add_int_value (builder, album_state->count);
+    json_builder_set_member_name (builder, "photos");
+    json_builder_begin_array (builder);
+    g_hash_table_iter_init (&photos_iter, album_state->photos);
+    while (g_hash_table_iter_next (&photos_iter, &key, &value)) {
+      json_builder_begin_object (builder);
+      add_state_member (builder, key, *(gint64 *) value);
+      json_builder_end_object (builder);
+    }
+    json_builder_end_array (builder);
+    json_builder_end_object (builder);
+  }
+  g_mutex_unlock (&priv->mutex);
+
+  json_builder_end_array (builder);
+  json_builder_end_object (builder);
+
+  root = json_builder_get_root (builder);
+  generator = json_generator_new ();
+  json_generator_set_root (generator, root);
+  state = json_generator_to_data (generator, NULL);
+
+  json_node_free (root);
+  g_object_unref (generator);
+  g_object_unref (builder);
+
+  return state;
+}
+
+/**
+ * gfbgraph_sync_load_state:
+ * @sync: a #GFBGraphSync.
+ * @state: a snapshot returned by gfbgraph_sync_save_state().
+ * @error: (allow-none): a #GError or %NULL.
+ *
+ * Replaces the snapshot of @sync with @state, so the next sync only reports
+ * the changes made since @state was saved. It fails if a sync is in progress.
+ *
+ * Returns: %TRUE on success, %FALSE in case of error.
+ **/
+gboolean
+gfbgraph_sync_load_state (GFBGraphSync  *sync,
+                          const gchar   *state,
+                          GError       **error)
+{
+  GFBGraphSyncPrivate *priv;
+  JsonParser *parser;
+  GHashTable *albums;
+  gboolean success = FALSE;
+
+  g_return_val_if_fail (GFBGRAPH_IS_SYNC (sync), FALSE);
+  g_return_val_if_fail (state != NULL, FALSE);
+
+  priv = sync->priv;
+  albums = new_albums_table ();
+
+  parser = json_parser_new ();
+  if (json_parser_load_from_data (parser, state, -1, error))
+    success = parse_state (json_parser_get_root (parser), albums, error);
+  g_object_unref (parser);
+
+  if (success) {
+    g_mutex_lock (&priv->mutex);
+    if (priv->running) {
+      g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_BUSY,
+                           "A synchronization is in progress");
+      success = FALSE;
+    } else {
+      GHashTable *old_albums = priv->albums;
+
+      priv->albums = albums;
+      albums = old_albums;
+    }
+    g_mutex_unlock (&priv->mutex);
+  }
+
+  g_hash_table_unref (albums);
+
+  return success;
+}
+
+/**
+ * gfbgraph_sync_reset:
+ * @sync: a #GFBGraphSync.
+ *
+ * Empties the snapshot of @sync, so the next sync reports all the albums and
+ * photos as added. It must not be called while a sync is in progress.
+ **/
+void
+gfbgraph_sync_reset (GFBGraphSync *sync)
+{
+  GFBGraphSyncPrivate *priv;
+
+  g_return_if_fail (GFBGRAPH_IS_SYNC (sync));
+
+  priv = sync->priv;
+  g_mutex_lock (&priv->mutex);
+  if (!priv->running)
+    g_hash_table_remove_all (priv->albums);
+  else
+    g_warning ("Can't reset a synchronization in progress");
+  g_mutex_unlock (&priv->mutex);
+}
+
+/**
+ * gfbgraph_sync_run:
+ * @sync: a #GFBGraphSync.
+ * @func: (scope call): a #GFBGraphSyncChangeFunc called for every change.
+ * @user_data: (closure): the data to pass to @func.
+ * @cancellable: (allow-none): An optional #GCancellable object, or %NULL.
+ * @error: (allow-none): a #GError or %NULL.
+ *
+ * Compares the albums of the user, and the photos of the albums changed, with
+ * the snapshot of @sync, calling @func for every change found, and updates the
+ * snapshot. An album change is reported before the changes of its photos, and
+ * the photos of a removed album are reported as removed before the album.
+ *
+ * Only one sync can be in progress at the same time, otherwise this fails with
+ * %G_IO_ERROR_PENDING. See gfbgraph_sync_run_async() for the asynchronous
+ * version of this call.
+ *
+ * Returns: %TRUE on success, %FALSE in case of error.
+ **/
+gboolean
+gfbgraph_sync_run (GFBGraphSync            *sync,
+                   GFBGraphSyncChangeFunc   func,
+                   gpointer                 user_data,
+                   GCancellable            *cancellable,
+                   GError                 **error)
+{
+  gboolean success;
+
+  g_return_val_if_fail (GFBGRAPH_IS_SYNC (sync), FALSE);
+  g_return_val_if_fail (func != NULL, FALSE);
+
+  if (!start_run (sync, error))
+    return FALSE;
+
+  success = sync_albums (sync, NULL, func, user_data, cancellable, error);
+  finish_run (sync);
+
+  return success;
+}
+
+/**
+ * gfbgraph_sync_run_async:
+ * @sync: a #GFBGraphSync.
+ * @cancellable: (allow-none): An optional #GCancellable object, or %NULL.
+ * @callback: (scope async): A #GAsyncReadyCallback to call when the request is completed.
+ * @user_data: (closure): The data to pass to @callback.
+ *
+ * Asynchronously runs a sync. See gfbgraph_sync_run() for the synchronous
+ * version of this call. The pages and the photos are requested with the
+ * asynchronous calls in the thread-default main context of the caller, without
+ * blocking any thread.
+ *
+ * When the operation is finished, @callback will be called. You can then call
+ * gfbgraph_sync_run_async_finish() to get the changes found.
+ **/
+void
+gfbgraph_sync_run_async (GFBGraphSync        *sync,
+                         GCancellable        *cancellable,
+                         GAsyncReadyCallback  callback,
+                         gpointer             user_data)
+{
+  GTask *task;
+  RunData *data;
+  GError *error = NULL;
+
+  g_return_if_fail (GFBGRAPH_IS_SYNC (sync));
+  g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+
+  task = g_task_new (sync, cancellable, callback, user_data);
+  g_task_set_source_tag (task, gfbgraph_sync_run_async);
+
+  if (!start_run (sync, &error)) {
+    g_task_return_error (task, error);
+    g_object_unref (task);
+    return;
+  }
+
+  data = g_slice_new0 (RunData);
+  data->staged = new_albums_table ();
+  data->changes = g_ptr_array_new_with_free_func ((GDestroyNotify) gfbgraph_sync_change_free);
+  data->seen = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  g_task_set_task_data (task, data, (GDestroyNotify) run_data_free);
+
+  data->albums_iterator = new_albums_iterator (sync, &error);
+  if (data->albums_iterator == NULL) {
+    run_return_error (task, error);
+    return;
+  }
+
+  gfbgraph_connection_iterator_next_page_async (data->albums_iterator, cancellable,
+                                                run_albums_page_cb, task);
+}
+
+/**
+ * gfbgraph_sync_run_async_finish:
+ * @sync: a #GFBGraphSync.
+ * @result: A #GAsyncResult.
+ * @error: (allow-none): An optional #GError, or %NULL.
+ *
+ * Finishes an asynchronous operation started with gfbgraph_sync_run_async().
+ * If the sync failed, the snapshot isn't updated, so the next sync reports all
+ * its changes again.
+ *
+ * Returns: (element-type GFBGraphSyncChange) (transfer full): a #GPtrArray with
+ * the changes found, in order, or %NULL in case of error.
+ **/
+GPtrArray *
+gfbgraph_sync_run_async_finish (GFBGraphSync  *sync,
+                                GAsyncResult  *result,
+                                GError       **error)
+{
+  g_return_val_if_fail (GFBGRAPH_IS_SYNC (sync), NULL);
+  g_return_val_if_fail (g_task_is_valid (result, sync), NULL);
+
+  return g_task_propagate_pointer (G_TASK (result), error);
+}
@@ -0,0 +1,139 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 2; tab-width: 2 -*-  */
+/*
+ * libgfbgraph - GObject library for Facebook Graph API
+ * Copyright (C) 2013 Álvaro Peña <alvaropg@gmail.com>
+ *               2020 Leesoo Ahn <yisooan@fedoraproject.org>
+ *
+ * GFBGraph is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GFBGraph is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GFBGraph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GFBGRAPH_SYNC_H__
+#define __GFBGRAPH_SYNC_H__
+
+#include <gio/gio.h>
+#include <glib-object.h>
+
+#include <gfbgraph/gfbgraph-authorizer.h>
+#include <gfbgraph/gfbgraph-node.h>
+#include <gfbgraph/gfbgraph-user.h>
+
+G_BEGIN_DECLS
+
+#define GFBGRAPH_TYPE_SYNC (gfbgraph_sync_get_type())
+#define GFBGRAPH_SYNC(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj),GFBGRAPH_TYPE_SYNC,GFBGraphSync))
+#define GFBGRAPH_SYNC_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass),GFBGRAPH_TYPE_SYNC,GFBGraphSyncClass))
+#define GFBGRAPH_IS_SYNC(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj),GFBGRAPH_TYPE_SYNC))
+#define GFBGRAPH_IS_SYNC_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass),GFBGRAPH_TYPE_SYNC))
+#define GFBGRAPH_SYNC_GET_CLASS(obj) \
+  (G_TYPE_INSTANCE_GET_CLASS((obj),GFBGRAPH_TYPE_SYNC,GFBGraphSyncClass))
+
+#define GFBGRAPH_TYPE_SYNC_CHANGE (gfbgraph_sync_change_get_type())
+
+typedef struct _GFBGraphSync        GFBGraphSync;
+typedef struct _GFBGraphSyncClass   GFBGraphSyncClass;
+typedef struct _GFBGraphSyncPrivate GFBGraphSyncPrivate;
+
+/**
+ * GFBGraphSyncChangeType:
+ * @GFBGRAPH_SYNC_CHANGE_ADDED: the node is new since the previous sync.
+ * @GFBGRAPH_SYNC_CHANGE_UPDATED: the node was modified since the previous sync.
+ * @GFBGRAPH_SYNC_CHANGE_REMOVED: the node doesn't exist anymore.
+ *
+ * The kind of change of a #GFBGraphSyncChange.
+ **/
+typedef enum {
+  GFBGRAPH_SYNC_CHANGE_ADDED,
+  GFBGRAPH_SYNC_CHANGE_UPDATED,
+  GFBGRAPH_SYNC_CHANGE_REMOVED
+} GFBGraphSyncChangeType;
+
+/**
+ * GFBGraphSyncChange:
+ * @type: the #GFBGraphSyncChangeType of the change.
+ * @album_id: the ID of the album changed, or of the album of the photo changed.
+ * @id: the ID of the changed node, the same as @album_id for the albums.
+ * @node: (allow-none): the #GFBGraphAlbum or #GFBGraphPhoto added or updated,
+ *   or %NULL if it was removed.
+ *
+ * A change found by gfbgraph_sync_run().
+ **/
+typedef struct {
+  GFBGraphSyncChangeType  type;
+  gchar                  *album_id;
+  gchar                  *id;
+  GFBGraphNode           *node;
+} GFBGraphSyncChange;
+
+/**
+ * GFBGraphSyncChangeFunc:
+ * @change: a #GFBGraphSyncChange.
+ * @user_data: the data passed to gfbgraph_sync_run().
+ *
+ * Called by gfbgraph_sync_run() for every change found, in order.
+ **/
+typedef void (*GFBGraphSyncChangeFunc) (const GFBGraphSyncChange *change,
+                                        gpointer                  user_data);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (GFBGraphSync, g_object_unref)
+
+struct _GFBGraphSync {
+  GObject parent;
+
+  /*< private >*/
+  GFBGraphSyncPrivate *priv;
+};
+
+struct _GFBGraphSyncClass {
+  GObjectClass parent_class;
+};
+
+GType               gfbgraph_sync_change_get_type (void) G_GNUC_CONST;
+GFBGraphSyncChange* gfbgraph_sync_change_copy     (const GFBGraphSyncChange *change);
+void                gfbgraph_sync_change_free     (GFBGraphSyncChange       *change);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (GFBGraphSyncChange, gfbgraph_sync_change_free)
+
+GType               gfbgraph_sync_get_type        (void) G_GNUC_CONST;
+GFBGraphSync*       gfbgraph_sync_new             (GFBGraphUser        *user,
+                                                   GFBGraphAuthorizer  *authorizer);
+
+GFBGraphUser*       gfbgraph_sync_get_user        (GFBGraphSync        *sync);
+GFBGraphAuthorizer* gfbgraph_sync_get_authorizer  (GFBGraphSync        *sync);
+
+gchar*              gfbgraph_sync_save_state      (GFBGraphSync        *sync);
+gboolean            gfbgraph_sync_load_state      (GFBGraphSync        *sync,
+                                                   const gchar         *state,
+                                                   GError             **error);
+void                gfbgraph_sync_reset           (GFBGraphSync        *sync);
+
+gboolean            gfbgraph_sync_run             (GFBGraphSync            *sync,
+                                                   GFBGraphSyncChangeFunc   func,
+                                                   gpointer                 user_data,
+                                                   GCancellable            *cancellable,
+                                                   GError                 **error);
+void                gfbgraph_sync_run_async       (GFBGraphSync            *sync,
+                                                   GCancellable            *cancellable,
+                                                   GAsyncReadyCallback      callback,
+                                                   gpointer                 user_data);
+GPtrArray*          gfbgraph_sync_run_async_finish (GFBGraphSync           *sync,
+                                                    GAsyncResult           *result,
+                                                    GError                **error);
+
+G_END_DECLS
+
+#endif /* __GFBGRAPH_SYNC_H__ */
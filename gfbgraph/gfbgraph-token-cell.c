@@ -0,0 +1,117 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 2; tab-width: 2 -*-  */
+/*
+ * libgfbgraph - GObject library for Facebook Graph API
+ * Copyright (C) 2013-2015 Álvaro Peña <alvaropg@gmail.com>
+ *               2020 Leesoo Ahn <yisooan@fedoraproject.org>
+ *
+ * GFBGraph is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GFBGraph is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GFBGraph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Access token cell of the authorizers, read on every request without any
+ * lock, RCU style. The token is an immutable string swapped atomically by the
+ * writers, and the replaced one is freed once the readers that could still be
+ * using it are gone.
+ *
+ * The readers register in the counter of the current epoch, and every writer
+ * swaps the token, moves to the next epoch and waits until the counter of the
+ * previous epoch drops to zero. A reader seeing the epoch change between its
+ * registration and the check retries, so it's always counted in the epoch its
+ * writer waits for. Writers are rare (token refreshes), so they're serialized
+ * with a mutex and wait yielding the CPU. */
+
+#include "gfbgraph-private.h"
+
+void
+gfbgraph_token_cell_init (GFBGraphTokenCell *cell)
+{
+  cell->token = NULL;
+  cell->readers[0] = 0;
+  cell->readers[1] = 0;
+  cell->epoch = 0;
+  g_mutex_init (&cell->write_mutex);
+}
+
+/* No reader can be active anymore */
+void
+gfbgraph_token_cell_clear (GFBGraphTokenCell *cell)
+{
+  g_free (cell->token);
+  cell->token = NULL;
+  g_mutex_clear (&cell->write_mutex);
+}
+
+/* Returns the current token, or %NULL, valid until
+ * gfbgraph_token_cell_read_end() is called with the same @slot. */
+const gchar *
+gfbgraph_token_cell_read_begin (GFBGraphTokenCell *cell,
+                                guint             *slot)
+{
+  guint epoch;
+
+  for (;;) {
+    epoch = (guint) g_atomic_int_get (&cell->epoch);
+    g_atomic_int_inc (&cell->readers[epoch & 1]);
+    if ((guint) g_atomic_int_get (&cell->epoch) == epoch)
+      break;
+    g_atomic_int_dec_and_test (&cell->readers[epoch & 1]);
+  }
+
+  *slot = epoch & 1;
+
+  return g_atomic_pointer_get (&cell->token);
+}
+
+void
+gfbgraph_token_cell_read_end (GFBGraphTokenCell *cell,
+                              guint              slot)
+{
+  g_atomic_int_dec_and_test (&cell->readers[slot]);
+}
+
+/* Returns a copy of the current token */
+gchar *
+gfbgraph_token_cell_dup (GFBGraphTokenCell *cell)
+{
+  gchar *token;
+  guint slot;
+
+  token = g_strdup (gfbgraph_token_cell_read_begin (cell, &slot));
+  gfbgraph_token_cell_read_end (cell, slot);
+
+  return token;
+}
+
+/* Replaces the token with a copy of @token, blocking until the old one can be
+ * freed. Must not be called between read_begin() and read_end(). */
+void
+gfbgraph_token_cell_set (GFBGraphTokenCell *cell,
+                         const gchar       *token)
+{
+  gchar *old_token;
+  guint slot;
+
+  g_mutex_lock (&cell->write_mutex);
+
+  old_token = g_atomic_pointer_get (&cell->token);
+  g_atomic_pointer_set (&cell->token, g_strdup (token));
+
+  slot = (guint) g_atomic_int_get (&cell->epoch) & 1;
+  g_atomic_int_inc (&cell->epoch);
+  while (g_atomic_int_get (&cell->readers[slot]) > 0)
+    g_thread_yield ();
+
+  g_mutex_unlock (&cell->write_mutex);
+
+  g_free (old_token);
+}
@@ -34,8 +34,10 @@
 #include "gfbgraph-user.h"
 #include "gfbgraph-album.h"
 #include "gfbgraph-common.h"
+#include "gfbgraph-private.h"
 
 #define ME_FUNCTION "me"
+#define ME_FIELDS   "name,email"
 
 enum {
   PROP_0,
@@ -48,12 +50,6 @@ struct _GFBGraphUserPrivate {
   gchar *email;
 };
 
-typedef struct {
-  GFBGraphUser *user;
-  GFBGraphAuthorizer *authorizer;
-  GList *nodes;
-} UserAsyncData;
-
 #define GFBGRAPH_USER_GET_PRIVATE(o) \
   (G_TYPE_INSTANCE_GET_PRIVATE((o), GFBGRAPH_TYPE_USER, GFBGraphUserPrivate))
 
@@ -66,8 +62,8 @@ gfbgraph_user_finalize (GObject *object)
 {
   GFBGraphUserPrivate *priv = GFBGRAPH_USER_GET_PRIVATE (object);
 
-  g_free (priv->name);
-  g_free (priv->email);
+  gfbgraph_node_clear_string (GFBGRAPH_NODE (object), &priv->name);
+  gfbgraph_node_clear_string (GFBGRAPH_NODE (object), &priv->email);
 
   G_OBJECT_CLASS(parent_class)->finalize (object);
 }
@@ -82,14 +78,10 @@ gfbgraph_user_set_property (GObject      *object,
 
   switch (prop_id) {
     case PROP_NAME:
-      if (priv->name)
-        g_free (priv->name);
-      priv->name = g_strdup (g_value_get_string (value));
+      gfbgraph_node_set_string (GFBGRAPH_NODE (object), &priv->name, g_value_get_string (value));
       break;
     case PROP_EMAIL:
-      if (priv->email)
-        g_free (priv->email);
-      priv->email = g_strdup (g_value_get_string (value));
+      gfbgraph_node_set_string (GFBGRAPH_NODE (object), &priv->email, g_value_get_string (value));
       break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
@@ -164,81 +156,96 @@ gfbgraph_user_class_init (GFBGraphUserClass *klass)
 }
 
 /* --- Private Functions --- */
-static void
-get_me_async_io_thread (GTask        *task,
-                        gpointer      source_object,
-                        gpointer      task_data,
-                        GCancellable *cancellable)
+static RestProxyCall *
+new_me_call (GFBGraphAuthorizer *authorizer)
 {
-  GFBGraphAuthorizer *authorizer = GFBGRAPH_AUTHORIZER (source_object);
-  GFBGraphUser *user = NULL;
-  GError *error = NULL;
+  RestProxyCall *rest_call;
 
-  user = gfbgraph_user_get_me (authorizer, &error);
-  if (user && !error)
-    g_task_return_pointer (task, user, g_object_unref);
-  else
-    {
-      /* FIXME: better way to handle error */
-      if (error)
-        g_task_return_error (task, error);
-    }
+  rest_call = gfbgraph_new_rest_call (authorizer);
+  rest_proxy_call_set_function (rest_call, ME_FUNCTION);
+  rest_proxy_call_set_method (rest_call, "GET");
+  rest_proxy_call_add_param (rest_call, "fields", ME_FIELDS);
+
+  return rest_call;
 }
 
-static UserAsyncData *
-user_async_data_new (GFBGraphUser       *user,
-                     GFBGraphAuthorizer *authorizer)
+/* A GFBGraphCallParseFunc, so the concurrent callers share the same user */
+static gpointer
+parse_me_payload (RestProxyCall  *call,
+                  GType           node_type,
+                  GBytes         *payload,
+                  GError        **error)
 {
-  UserAsyncData *new_data = NULL;
+  GFBGraphUser *me = NULL;
+  JsonParser *parser;
+
+  parser = json_parser_new ();
+  if (json_parser_load_from_data (parser,
+                                  g_bytes_get_data (payload, NULL),
+                                  g_bytes_get_size (payload),
+                                  error)) {
+    GFBGraphStringArena *arena;
+    JsonNode *node;
 
-  new_data = g_slice_new0 (UserAsyncData);
-  if (GFBGRAPH_IS_USER (user))
-    new_data->user = g_object_ref (user);
-  if (GFBGRAPH_IS_AUTHORIZER (authorizer))
-    new_data->authorizer = g_object_ref (authorizer);
+    node = json_parser_get_root (parser);
+    arena = gfbgraph_string_arena_new ();
+    me = GFBGRAPH_USER (gfbgraph_node_deserialize (node_type, node, arena));
+    gfbgraph_string_arena_unref (arena);
+    me = GFBGRAPH_USER (gfbgraph_identity_map_canonicalize (gfbgraph_call_get_authorizer (call),
+                                                            GFBGRAPH_NODE (me), ME_FIELDS));
+    if (me == NULL)
+      g_set_error (error,
+                   GFBGRAPH_NODE_ERROR,
+                   GFBGRAPH_NODE_ERROR_REQUEST_FAILED,
+                   "Unable to parse the current user");
+  }
+  g_object_unref (parser);
 
-  return new_data;
+  return me;
 }
 
 static void
-user_async_data_free (gpointer data)
+get_me_call_cb (GObject      *source_object,
+                GAsyncResult *result,
+                gpointer      user_data)
 {
-  UserAsyncData *real_data = (UserAsyncData *)data;
+  GTask *task = G_TASK (user_data);
+  GFBGraphUser *me;
+  GError *error = NULL;
 
-  g_return_if_fail (data != NULL);
+  me = gfbgraph_call_finish_parsed (REST_PROXY_CALL (source_object), result, &error);
+  if (me != NULL)
+    g_task_return_pointer (task, me, g_object_unref);
+  else
+    g_task_return_error (task, error);
 
-  if (GFBGRAPH_IS_USER (real_data->user))
-    g_object_unref (real_data->user);
-  if (GFBGRAPH_IS_AUTHORIZER (real_data->authorizer))
-    g_object_unref (real_data->authorizer);
-  if (real_data->nodes)
-    g_list_free_full (real_data->nodes, g_object_unref/* XXX */);
+  g_object_unref (task);
+}
 
-  g_slice_free (UserAsyncData, real_data);
+static void
+free_albums_list (GList *albums)
+{
+  g_list_free_full (albums, g_object_unref);
 }
 
 static void
-get_albums_async_io_thread (GTask        *task,
-                            gpointer      source_object,
-                            gpointer      task_data,
-                            GCancellable *cancellable)
+get_albums_cb (GObject      *source_object,
+               GAsyncResult *result,
+               gpointer      user_data)
 {
-  UserAsyncData *data = NULL;
+  GTask *task = G_TASK (user_data);
+  GList *albums;
   GError *error = NULL;
 
-  data = (UserAsyncData *)task_data;
-  if (data && data->user && data->authorizer)
-    {
-      data->nodes = gfbgraph_user_get_albums (data->user, data->authorizer, &error);
-      if (data->nodes && !error)
-        g_task_return_pointer (task, data, user_async_data_free);
-    }
+  albums = gfbgraph_node_get_connection_nodes_async_finish (GFBGRAPH_NODE (source_object),
+                                                            result,
+                                                            &error);
+  if (error != NULL)
+    g_task_return_error (task, error);
   else
-    {
-      if (error)
-        g_task_return_error (task, error);
-      user_async_data_free (data);
-    }
+    g_task_return_pointer (task, albums, (GDestroyNotify) free_albums_list);
+
+  g_object_unref (task);
 }
 
 /**
@@ -289,32 +296,13 @@ GFBGraphUser *
 gfbgraph_user_get_me (GFBGraphAuthorizer  *authorizer,
                       GError             **error)
 {
-  GFBGraphUser *me = NULL;
+  GFBGraphUser *me;
   RestProxyCall *rest_call;
-  const gchar *payload;
-  gboolean result;
 
   g_return_val_if_fail (GFBGRAPH_IS_AUTHORIZER (authorizer), NULL);
 
-  rest_call = gfbgraph_new_rest_call (authorizer);
-  rest_proxy_call_set_function (rest_call, ME_FUNCTION);
-  rest_proxy_call_set_method (rest_call, "GET");
-  rest_proxy_call_add_param (rest_call, "fields", "name,email");
-
-  result = rest_proxy_call_sync (rest_call, error);
-  if (result) {
-    JsonParser *parser;
-    JsonNode *node;
-
-    payload = rest_proxy_call_get_payload (rest_call);
-    parser = json_parser_new ();
-    if (json_parser_load_from_data (parser, payload, -1, error)) {
-      node = json_parser_get_root (parser);
-      me = GFBGRAPH_USER (json_gobject_deserialize (GFBGRAPH_TYPE_USER, node));
-    }
-
-    g_object_unref (parser);
-  }
+  rest_call = new_me_call (authorizer);
+  me = gfbgraph_call_sync_parsed (rest_call, parse_me_payload, GFBGRAPH_TYPE_USER, NULL, error);
   g_object_unref (rest_call);
 
   return me;
@@ -340,6 +328,7 @@ gfbgraph_user_get_me_async (GFBGraphAuthorizer  *authorizer,
                             gpointer             user_data)
 {
   GTask *task;
+  RestProxyCall *rest_call;
 
   g_return_if_fail (GFBGRAPH_IS_AUTHORIZER (authorizer));
   g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
@@ -349,9 +338,12 @@ gfbgraph_user_get_me_async (GFBGraphAuthorizer  *authorizer,
                      cancellable,
                      callback,
                      user_data);
-  g_task_run_in_thread (task, get_me_async_io_thread);
+  g_task_set_source_tag (task, gfbgraph_user_get_me_async);
 
-  g_object_unref (task);
+  rest_call = new_me_call (authorizer);
+  gfbgraph_call_async_parsed (rest_call, parse_me_payload, GFBGRAPH_TYPE_USER,
+                              cancellable, get_me_call_cb, task);
+  g_object_unref (rest_call);
 }
 
 /**
@@ -422,7 +414,6 @@ gfbgraph_user_get_albums_async (GFBGraphUser        *user,
                                 gpointer             user_data)
 {
   GTask *task;
-  UserAsyncData *data;
 
   g_return_if_fail (GFBGRAPH_IS_USER (user));
   g_return_if_fail (GFBGRAPH_IS_AUTHORIZER (authorizer));
@@ -433,13 +424,14 @@ gfbgraph_user_get_albums_async (GFBGraphUser        *user,
                      cancellable,
                      callback,
                      user_data);
-
-  data = user_async_data_new (user, authorizer);
-  g_task_set_task_data (task, data, NULL);
-
-  g_task_run_in_thread (task, get_albums_async_io_thread);
-
-  g_object_unref (task);
+  g_task_set_source_tag (task, gfbgraph_user_get_albums_async);
+
+  gfbgraph_node_get_connection_nodes_async (GFBGRAPH_NODE (user),
+                                            GFBGRAPH_TYPE_ALBUM,
+                                            authorizer,
+                                            cancellable,
+                                            get_albums_cb,
+                                            task);
 }
 
 /**
@@ -458,28 +450,11 @@ gfbgraph_user_get_albums_async_finish (GFBGraphUser  *user,
                                        GAsyncResult  *result,
                                        GError       **error)
 {
-  UserAsyncData *data;
-  GList *nodes = NULL;
-
   g_return_val_if_fail (GFBGRAPH_IS_USER (user), NULL);
-  g_return_val_if_fail (g_task_is_valid (result, NULL), NULL);
+  g_return_val_if_fail (g_task_is_valid (result, user), NULL);
   g_return_val_if_fail (error == NULL || *error == NULL, NULL);
 
-  data = g_task_propagate_pointer (G_TASK (result), error);
-  if (!data || g_task_had_error (G_TASK (result))) /* error */
-    /* Don't need to free or unref objects about UserAsyncData,
-     * GTask takes the responsibility inside its thread. */
-    return NULL;
-
-  if (data->nodes)
-    {
-      nodes = data->nodes;
-      data->nodes = NULL; /* For freeing UserAsyncData */
-    }
-
-  user_async_data_free (data);
-
-  return nodes;
+  return g_task_propagate_pointer (G_TASK (result), error);
 }
 
 /**
@@ -22,9 +22,18 @@
 #define __GFBGRAPH_H__
 
 #include <gfbgraph/gfbgraph-album.h>
+#include <gfbgraph/gfbgraph-cache.h>
 #include <gfbgraph/gfbgraph-connectable.h>
+#include <gfbgraph/gfbgraph-connection-iterator.h>
+#include <gfbgraph/gfbgraph-context.h>
+#include <gfbgraph/gfbgraph-downloader.h>
+#include <gfbgraph/gfbgraph-field-set.h>
+#include <gfbgraph/gfbgraph-identity-map.h>
 #include <gfbgraph/gfbgraph-node.h>
 #include <gfbgraph/gfbgraph-photo.h>
+#include <gfbgraph/gfbgraph-retry-policy.h>
+#include <gfbgraph/gfbgraph-scheduler.h>
+#include <gfbgraph/gfbgraph-sync.h>
 #include <gfbgraph/gfbgraph-user.h>
 
 #endif /* __GFBGRAPH_H__ */
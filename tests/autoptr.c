@@ -22,43 +22,46 @@
  */
 
 #include <glib.h>
+#include <glib/gstdio.h>
 
 #include <gfbgraph/gfbgraph.h>
+#include <gfbgraph/gfbgraph-simple-authorizer.h>
 
-static void
-test_gfbgraph_album (void)
-{
-  g_autoptr (GFBGraphAlbum) val = NULL;
-
-  val = gfbgraph_album_new ();
-  g_assert_nonnull (val);
-}
-
-static void
-test_gfbgraph_node (void)
-{
-  g_autoptr (GFBGraphNode) val = NULL;
-
-  val = gfbgraph_node_new ();
-  g_assert_nonnull (val);
-}
+/* Every type is freed by its g_autoptr() cleanup. The behavior of the types
+ * is tested in unit.c and mock.c. */
+#define CHECK_AUTOPTR(Type, new_expr)   \
+  G_STMT_START {                        \
+    g_autoptr (Type) val = (new_expr);  \
+    g_assert_nonnull (val);             \
+  } G_STMT_END
 
 static void
-test_gfbgraph_photo (void)
+test_gfbgraph_types (void)
 {
-  g_autoptr (GFBGraphPhoto) val = NULL;
+  g_autoptr (GFBGraphUser) user = NULL;
+  g_autofree gchar *directory = NULL;
+  GFBGraphSimpleAuthorizer *authorizer;
 
-  val = gfbgraph_photo_new ();
-  g_assert_nonnull (val);
-}
+  directory = g_dir_make_tmp ("gfbgraph-cache-XXXXXX", NULL);
+  g_assert_nonnull (directory);
+  user = gfbgraph_user_new ();
+  authorizer = gfbgraph_simple_authorizer_new ("token");
 
-static void
-test_gfbgraph_user (void)
-{
-  g_autoptr (GFBGraphUser) val = NULL;
+  CHECK_AUTOPTR (GFBGraphAlbum, gfbgraph_album_new ());
+  CHECK_AUTOPTR (GFBGraphCache, gfbgraph_cache_new (directory, NULL));
+  CHECK_AUTOPTR (GFBGraphContext, gfbgraph_context_new (NULL));
+  CHECK_AUTOPTR (GFBGraphDownloader, gfbgraph_downloader_new (NULL, 4));
+  CHECK_AUTOPTR (GFBGraphFieldSet, gfbgraph_field_set_new ("id", "name", NULL));
+  CHECK_AUTOPTR (GFBGraphIdentityMap, gfbgraph_identity_map_new (10, 60));
+  CHECK_AUTOPTR (GFBGraphNode, gfbgraph_node_new ());
+  CHECK_AUTOPTR (GFBGraphPhoto, gfbgraph_photo_new ());
+  CHECK_AUTOPTR (GFBGraphRetryPolicy, gfbgraph_retry_policy_new ());
+  CHECK_AUTOPTR (GFBGraphScheduler, gfbgraph_scheduler_new ());
+  CHECK_AUTOPTR (GFBGraphSync, gfbgraph_sync_new (user, GFBGRAPH_AUTHORIZER (authorizer)));
+  CHECK_AUTOPTR (GFBGraphUser, gfbgraph_user_new ());
 
-  val = gfbgraph_user_new ();
-  g_assert_nonnull (val);
+  g_object_unref (authorizer);
+  g_rmdir (directory);
 }
 
 int
@@ -67,10 +70,7 @@ main (int   argc,
 {
   g_test_init (&argc, &argv, NULL);
 
-  g_test_add_func ("/GFBGraph/autoptr/Album", test_gfbgraph_album);
-  g_test_add_func ("/GFBGraph/autoptr/Node", test_gfbgraph_node);
-  g_test_add_func ("/GFBGraph/autoptr/Photo", test_gfbgraph_photo);
-  g_test_add_func ("/GFBGraph/autoptr/User", test_gfbgraph_user);
+  g_test_add_func ("/GFBGraph/autoptr/Types", test_gfbgraph_types);
 
   return g_test_run ();
 }
@@ -47,6 +47,15 @@ struct _GFBGraphTestApp
 
 #define FACEBOOK_ENDPOINT "https://graph.facebook.com/v2.10"
 
+/* Same variable used by the library for its default context */
+static const gchar *
+test_endpoint (void)
+{
+  const gchar *endpoint = g_getenv ("GFBGRAPH_ENDPOINT");
+
+  return endpoint != NULL && *endpoint != '\0' ? endpoint : FACEBOOK_ENDPOINT;
+}
+
 #define FACEBOOK_TEST_USER_PERMISSIONS "email,user_about_me,user_photos,publish_actions"
 
 GFBGraphTestApp*
@@ -87,7 +96,7 @@ gfbgraph_test_app_setup (void)
       &error);
   g_assert_no_error(error);
 
-  proxy = rest_proxy_new (FACEBOOK_ENDPOINT, FALSE);
+  proxy = rest_proxy_new (test_endpoint (), FALSE);
   rest_call = rest_proxy_new_call (proxy);
 
   rest_proxy_call_add_param (rest_call, "client_id", app->client_id);
@@ -133,7 +142,7 @@ gfbgraph_test_fixture_setup (GFBGraphTestFixture *fixture, gconstpointer user_da
 
   /* Create a new user */
 
-  proxy = rest_proxy_new (FACEBOOK_ENDPOINT, FALSE);
+  proxy = rest_proxy_new (test_endpoint (), FALSE);
   rest_call = rest_proxy_new_call (proxy);
 
   /* Params as documented here: https://developers.facebook.com/docs/graph-api/reference/app/accounts/test-users#publish */
@@ -184,7 +193,7 @@ gfbgraph_test_fixture_teardown (GFBGraphTestFixture *fixture, G_GNUC_UNUSED gcon
 
   ssession = soup_session_new ();
 
-  function_path = g_strdup_printf ("%s/%s", FACEBOOK_ENDPOINT, fixture->user_id);
+  function_path = g_strdup_printf ("%s/%s", test_endpoint (), fixture->user_id);
   smessage = soup_message_new ("DELETE", function_path);
   gfbgraph_authorizer_process_message (GFBGRAPH_AUTHORIZER (fixture->authorizer), smessage);
 
@@ -0,0 +1,1515 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 2; tab-width: 2 -*-  */
+/*
+ * libgfbgraph - GObject library for Facebook Graph API
+ * Copyright (C) 2013 Álvaro Peña <alvaropg@gmail.com>
+ *               2020 Leesoo Ahn <yisooan@fedoraproject.org>
+ *
+ * GFBGraph is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GFBGraph is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GFBGraph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <json-glib/json-glib.h>
+#include <libsoup/soup.h>
+#include <string.h>
+
+#include "mock-server.h"
+
+#define DEFAULT_LIMIT 25
+#define MAX_LIMIT     100
+
+#define IMAGES_PATH   "/images/"
+#define IMAGE_SIZE    GFBGRAPH_MOCK_SERVER_IMAGE_SIZE
+#define IMAGE_BYTE    0xAB
+
+/* 2020-01-01T00:00:00+0000, the clock of the server starts here and advances
+ * one second on every change, so the updated times are always different */
+#define CLOCK_START   G_GINT64_CONSTANT (1577836800)
+
+#define TIME_FORMAT   "%Y-%m-%dT%H:%M:%S+0000"
+
+struct _GFBGraphMockServer {
+  GThread      *thread;
+  GMainContext *context;
+  GMainLoop    *loop;
+  SoupServer   *soup_server;
+  gchar        *endpoint;
+
+  GMutex        mutex;        /* Guards everything below */
+  GCond         ready_cond;
+  gboolean      ready;
+  GHashTable   *nodes;        /* ID -> JsonObject */
+  GHashTable   *connections;  /* "ID/connection" -> GPtrArray of IDs */
+  GHashTable   *parents;      /* ID -> "ID/connection" of its parent */
+  gchar        *me_id;
+  gchar        *access_token;
+  guint64       next_id;
+  gint64        clock;
+  GRand        *rand;
+  guint         min_latency;
+  guint         max_latency;
+  gdouble       error_rate;
+  guint         error_status;
+  gint          error_code;
+  guint         fail_skip;
+  guint         fail_next;
+  guint         fail_status;
+  gint          fail_code;
+  gint          app_usage;
+  guint         image_version;
+  gssize        image_cut;    /* Bytes sent of the next image before closing, -1 for all */
+  guint         n_requests;
+  guint         n_not_modified;
+  guint         n_in_progress;
+  guint         max_in_progress;
+};
+
+typedef struct {
+  GFBGraphMockServer *server;
+  SoupServer         *soup_server;
+  SoupMessage        *msg;
+} PausedMessage;
+
+/* --- Helpers --- */
+
+static gchar *
+format_time (gint64 seconds)
+{
+  GDateTime *date_time;
+  gchar *formatted;
+
+  date_time = g_date_time_new_from_unix_utc (seconds);
+  formatted = g_date_time_format (date_time, TIME_FORMAT);
+  g_date_time_unref (date_time);
+
+  return formatted;
+}
+
+static gint64
+get_time_member (JsonObject  *object,
+                 const gchar *member)
+{
+  const gchar *time_str;
+  GDateTime *date_time;
+  gint64 seconds;
+
+  if (!json_object_has_member (object, member))
+    return 0;
+
+  time_str = json_object_get_string_member (object, member);
+  date_time = time_str != NULL ? g_date_time_new_from_iso8601 (time_str, NULL) : NULL;
+  if (date_time == NULL)
+    return 0;
+
+  seconds = g_date_time_to_unix (date_time);
+  g_date_time_unref (date_time);
+
+  return seconds;
+}
+
+static void
+set_time_member (JsonObject  *object,
+                 const gchar *member,
+                 gint64       seconds)
+{
+  gchar *time_str;
+
+  time_str = format_time (seconds);
+  json_object_set_string_member (object, member, time_str);
+  g_free (time_str);
+}
+
+static gchar *
+object_to_data (JsonObject *object)
+{
+  JsonGenerator *generator;
+  JsonNode *root;
+  gchar *data;
+
+  root = json_node_alloc ();
+  json_node_init_object (root, object);
+  generator = json_generator_new ();
+  json_generator_set_root (generator, root);
+  data = json_generator_to_data (generator, NULL);
+
+  g_object_unref (generator);
+  json_node_free (root);
+
+  return data;
+}
+
+static gchar *
+builder_to_data (JsonBuilder *builder)
+{
+  JsonGenerator *generator;
+  JsonNode *root;
+  gchar *data;
+
+  root = json_builder_get_root (builder);
+  generator = json_generator_new ();
+  json_generator_set_root (generator, root);
+  data = json_generator_to_data (generator, NULL);
+
+  g_object_unref (generator);
+  json_node_free (root);
+
+  return data;
+}
+
+static JsonObject *
+parse_object (const gchar  *data,
+              GError      **error)
+{
+  JsonParser *parser;
+  JsonObject *object = NULL;
+
+  parser = json_parser_new ();
+  if (json_parser_load_from_data (parser, data, -1, error)) {
+    JsonNode *root = json_parser_get_root (parser);
+
+    if (JSON_NODE_HOLDS_OBJECT (root))
+      object = json_object_ref (json_node_get_object (root));
+    else
+      g_set_error_literal (error, JSON_PARSER_ERROR, JSON_PARSER_ERROR_INVALID_DATA,
+                           "Expected a JSON object");
+  }
+  g_object_unref (parser);
+
+  return object;
+}
+
+static gchar *
+error_body (gint         code,
+            const gchar *message)
+{
+  return g_strdup_printf ("{\"error\":{\"message\":\"%s\",\"type\":\"OAuthException\",\"code\":%d}}",
+                          message, code);
+}
+
+/* The top level names of a "fields" param, like "id,images{source},photos.limit(5)" */
+static GPtrArray *
+parse_fields (const gchar *fields)
+{
+  GPtrArray *names;
+  GString *name;
+  const gchar *p;
+  gboolean name_done = FALSE;
+  gint depth = 0;
+
+  names = g_ptr_array_new_with_free_func (g_free);
+  name = g_string_new (NULL);
+
+  for (p = fields; ; p++) {
+    if (*p == '\0' || (*p == ',' && depth == 0)) {
+      if (name->len > 0)
+        g_ptr_array_add (names, g_strdup (name->str));
+      g_string_truncate (name, 0);
+      name_done = FALSE;
+      if (*p == '\0')
+        break;
+      continue;
+    }
+
+    if (*p == '{' || *p == '(')
+      depth++;
+    else if (*p == '}' || *p == ')')
+      depth--;
+
+    if (depth > 0 || *p == '.' || *p == '}' || *p == ')')
+      name_done = TRUE;
+    else if (!name_done && !g_ascii_isspace (*p))
+      g_string_append_c (name, *p);
+  }
+
+  g_string_free (name, TRUE);
+
+  return names;
+}
+
+/* Returns a new reference to the members of @object requested in @fields, the
+ * Graph API always includes the ID */
+static JsonObject *
+project_object (JsonObject  *object,
+                const gchar *fields)
+{
+  JsonObject *projected;
+  GPtrArray *names;
+  guint i;
+
+  if (fields == NULL)
+    return json_object_ref (object);
+
+  projected = json_object_new ();
+  json_object_set_member (projected, "id", json_node_copy (json_object_get_member (object, "id")));
+
+  names = parse_fields (fields);
+  for (i = 0; i < names->len; i++) {
+    const gchar *name = g_ptr_array_index (names, i);
+
+    if (json_object_has_member (object, name) && !json_object_has_member (projected, name))
+      json_object_set_member (projected, name, json_node_copy (json_object_get_member (object, name)));
+  }
+  g_ptr_array_unref (names);
+
+  return projected;
+}
+
+/* --- Data, with the mutex locked --- */
+
+static JsonObject *
+lookup_node_locked (GFBGraphMockServer  *server,
+                    const gchar        **id)
+{
+  if (g_strcmp0 (*id, "me") == 0 && server->me_id != NULL)
+    *id = server->me_id;
+
+  return g_hash_table_lookup (server->nodes, *id);
+}
+
+static void
+link_node_locked (GFBGraphMockServer *server,
+                  const gchar        *key,
+                  const gchar        *id)
+{
+  GPtrArray *ids;
+
+  ids = g_hash_table_lookup (server->connections, key);
+  if (ids == NULL) {
+    ids = g_ptr_array_new_with_free_func (g_free);
+    g_hash_table_insert (server->connections, g_strdup (key), ids);
+  }
+
+  g_ptr_array_add (ids, g_strdup (id));
+  g_hash_table_replace (server->parents, g_strdup (id), g_strdup (key));
+}
+
+/* Like the albums in the Graph API, the nodes with a count update it and
+ * their updated time when their connections change */
+static void
+touch_parent_locked (GFBGraphMockServer *server,
+                     const gchar        *key)
+{
+  JsonObject *parent;
+  GPtrArray *ids;
+  gchar *parent_id;
+
+  ids = g_hash_table_lookup (server->connections, key);
+  parent_id = g_strndup (key, strchr (key, '/') - key);
+  parent = g_hash_table_lookup (server->nodes, parent_id);
+  g_free (parent_id);
+
+  if (ids == NULL || parent == NULL || !json_object_has_member (parent, "count"))
+    return;
+
+  json_object_set_int_member (parent, "count", ids->len);
+  set_time_member (parent, "updated_time", server->clock++);
+}
+
+/* Takes a reference on @object, returns the ID of the new node */
+static gchar *
+add_node_locked (GFBGraphMockServer *server,
+                 const gchar        *parent_id,
+                 const gchar        *connection,
+                 JsonObject         *object)
+{
+  gchar *id;
+
+  if (json_object_has_member (object, "id"))
+    id = g_strdup (json_object_get_string_member (object, "id"));
+  else
+    id = g_strdup_printf ("%" G_GUINT64_FORMAT, server->next_id++);
+
+  json_object_set_string_member (object, "id", id);
+  if (!json_object_has_member (object, "created_time"))
+    set_time_member (object, "created_time", server->clock);
+  if (!json_object_has_member (object, "updated_time"))
+    set_time_member (object, "updated_time", server->clock);
+  server->clock++;
+
+  g_hash_table_replace (server->nodes, g_strdup (id), json_object_ref (object));
+
+  if (parent_id != NULL) {
+    gchar *key;
+
+    key = g_strdup_printf ("%s/%s", parent_id, connection);
+    link_node_locked (server, key, id);
+    touch_parent_locked (server, key);
+    g_free (key);
+  }
+
+  return id;
+}
+
+static gboolean
+remove_node_locked (GFBGraphMockServer *server,
+                    const gchar        *id)
+{
+  GHashTableIter iter;
+  GPtrArray *children_keys;
+  gpointer key, value;
+  gchar *prefix;
+  const gchar *parent_key;
+  guint i, j;
+
+  if (!g_hash_table_contains (server->nodes, id))
+    return FALSE;
+
+  /* The connections of the node go with it */
+  prefix = g_strconcat (id, "/", NULL);
+  children_keys = g_ptr_array_new_with_free_func (g_free);
+  g_hash_table_iter_init (&iter, server->connections);
+  while (g_hash_table_iter_next (&iter, &key, NULL)) {
+    if (g_str_has_prefix (key, prefix))
+      g_ptr_array_add (children_keys, g_strdup (key));
+  }
+  g_free (prefix);
+
+  for (i = 0; i < children_keys->len; i++) {
+    GPtrArray *ids;
+
+    ids = g_hash_table_lookup (server->connections, g_ptr_array_index (children_keys, i));
+    g_ptr_array_ref (ids);
+    g_hash_table_remove (server->connections, g_ptr_array_index (children_keys, i));
+    for (j = 0; j < ids->len; j++)
+      remove_node_locked (server, g_ptr_array_index (ids, j));
+    g_ptr_array_unref (ids);
+  }
+  g_ptr_array_unref (children_keys);
+
+  parent_key = g_hash_table_lookup (server->parents, id);
+  if (parent_key != NULL) {
+    GPtrArray *ids = g_hash_table_lookup (server->connections, parent_key);
+
+    for (i = 0; ids != NULL && i < ids->len; i++) {
+      if (g_strcmp0 (g_ptr_array_index (ids, i), id) == 0) {
+        g_ptr_array_remove_index (ids, i);
+        touch_parent_locked (server, parent_key);
+        break;
+      }
+    }
+  }
+
+  g_hash_table_remove (server->parents, id);
+  g_hash_table_remove (server->nodes, id);
+
+  return TRUE;
+}
+
+static JsonObject *
+new_photo_object (GFBGraphMockServer *server,
+                  const gchar        *id,
+                  guint               index)
+{
+  static const guint sizes[][2] = { { 960, 720 }, { 480, 360 }, { 130, 98 } };
+  JsonObject *object, *image;
+  JsonArray *images;
+  gchar *source, *value;
+  guint i;
+
+  object = json_object_new ();
+  json_object_set_string_member (object, "id", id);
+  value = g_strdup_printf ("Photo %u", index);
+  json_object_set_string_member (object, "name", value);
+  g_free (value);
+  value = g_strconcat ("https://www.facebook.com/photo.php?fbid=", id, NULL);
+  json_object_set_string_member (object, "link", value);
+  g_free (value);
+
+  images = json_array_new ();
+  for (i = 0; i < G_N_ELEMENTS (sizes); i++) {
+    source = g_strdup_printf ("%s" IMAGES_PATH "%s_%u.jpg", server->endpoint, id, sizes[i][0]);
+    if (i == 0) {
+      json_object_set_string_member (object, "source", source);
+      json_object_set_int_member (object, "width", sizes[i][0]);
+      json_object_set_int_member (object, "height", sizes[i][1]);
+    }
+
+    image = json_object_new ();
+    json_object_set_int_member (image, "width", sizes[i][0]);
+    json_object_set_int_member (image, "height", sizes[i][1]);
+    json_object_set_string_member (image, "source", source);
+    json_array_add_object_element (images, image);
+    g_free (source);
+  }
+  json_object_set_array_member (object, "images", images);
+
+  return object;
+}
+
+/* --- Requests --- */
+
+static gchar *
+get_node (GFBGraphMockServer *server,
+          const gchar        *id,
+          GHashTable         *params,
+          guint              *status)
+{
+  JsonObject *object, *projected;
+  gchar *body;
+
+  object = lookup_node_locked (server, &id);
+  if (object == NULL) {
+    *status = SOUP_STATUS_BAD_REQUEST;
+    return error_body (100, "Unsupported get request");
+  }
+
+  projected = project_object (object, g_hash_table_lookup (params, "fields"));
+  body = object_to_data (projected);
+  json_object_unref (projected);
+
+  *status = SOUP_STATUS_OK;
+  return body;
+}
+
+static gboolean
+in_time_range (JsonObject *object,
+               gint64      since,
+               gint64      until)
+{
+  gint64 created_time = get_time_member (object, "created_time");
+
+  return (since == 0 || created_time >= since) && (until == 0 || created_time <= until);
+}
+
+static gchar *
+get_connection (GFBGraphMockServer *server,
+                const gchar        *id,
+                const gchar        *connection,
+                GHashTable         *params,
+                guint              *status)
+{
+  JsonBuilder *builder;
+  GPtrArray *ids, *page_ids;
+  const gchar *value;
+  gchar *key, *body;
+  gint64 since = 0, until = 0;
+  guint limit = DEFAULT_LIMIT;
+  guint offset = 0, end, i;
+
+  if (lookup_node_locked (server, &id) == NULL) {
+    *status = SOUP_STATUS_BAD_REQUEST;
+    return error_body (100, "Unsupported get request");
+  }
+
+  if ((value = g_hash_table_lookup (params, "limit")) != NULL)
+    limit = CLAMP (g_ascii_strtoull (value, NULL, 10), 1, MAX_LIMIT);
+  if ((value = g_hash_table_lookup (params, "after")) != NULL)
+    offset = g_ascii_strtoull (value, NULL, 10);
+  if ((value = g_hash_table_lookup (params, "since")) != NULL)
+    since = g_ascii_strtoll (value, NULL, 10);
+  if ((value = g_hash_table_lookup (params, "until")) != NULL)
+    until = g_ascii_strtoll (value, NULL, 10);
+
+  key = g_strdup_printf ("%s/%s", id, connection);
+  ids = g_hash_table_lookup (server->connections, key);
+  g_free (key);
+
+  page_ids = g_ptr_array_new ();
+  for (i = 0; ids != NULL && i < ids->len; i++) {
+    JsonObject *object = g_hash_table_lookup (server->nodes, g_ptr_array_index (ids, i));
+
+    if (object != NULL && in_time_range (object, since, until))
+      g_ptr_array_add (page_ids, object);
+  }
+
+  offset = MIN (offset, page_ids->len);
+  end = MIN (offset + limit, page_ids->len);
+
+  builder = json_builder_new ();
+  json_builder_begin_object (builder);
+  json_builder_set_member_name (builder, "data");
+  json_builder_begin_array (builder);
+  for (i = offset; i < end; i++) {
+    JsonObject *projected;
+    JsonNode *node;
+
+    projected = project_object (g_ptr_array_index (page_ids, i), g_hash_table_lookup (params, "fields"));
+    node = json_node_alloc ();
+    json_node_init_object (node, projected);
+    json_builder_add_value (builder, node);
+    json_object_unref (projected);
+  }
+  json_builder_end_array (builder);
+
+  json_builder_set_member_name (builder, "paging");
+  json_builder_begin_object (builder);
+  json_builder_set_member_name (builder, "cursors");
+  json_builder_begin_object (builder);
+  json_builder_set_member_name (builder, "before");
+  body = g_strdup_printf ("%u", offset);
+  json_builder_add_string_value (builder, body);
+  g_free (body);
+  json_builder_set_member_name (builder, "after");
+  body = g_strdup_printf ("%u", end);
+  json_builder_add_string_value (builder, body);
+  g_free (body);
+  json_builder_end_object (builder);
+  if (end < page_ids->len) {
+    json_builder_set_member_name (builder, "next");
+    body = g_strdup_printf ("%s/%s/%s?limit=%u&after=%u", server->endpoint, id, connection, limit, end);
+    json_builder_add_string_value (builder, body);
+    g_free (body);
+  }
+  json_builder_end_object (builder);
+  json_builder_end_object (builder);
+
+  body = builder_to_data (builder);
+  g_object_unref (builder);
+  g_ptr_array_unref (page_ids);
+
+  *status = SOUP_STATUS_OK;
+  return body;
+}
+
+static gchar *
+post_connection (GFBGraphMockServer *server,
+                 const gchar        *id,
+                 const gchar        *connection,
+                 GHashTable         *params,
+                 guint              *status)
+{
+  JsonObject *object;
+  GHashTableIter iter;
+  gpointer name, value;
+  gchar *new_id, *body;
+
+  if (lookup_node_locked (server, &id) == NULL) {
+    *status = SOUP_STATUS_BAD_REQUEST;
+    return error_body (100, "Unsupported post request");
+  }
+
+  object = json_object_new ();
+  g_hash_table_iter_init (&iter, params);
+  while (g_hash_table_iter_next (&iter, &name, &value)) {
+    if (g_strcmp0 (name, "access_token") != 0)
+      json_object_set_string_member (object, name, value);
+  }
+
+  new_id = add_node_locked (server, id, connection, object);
+  json_object_unref (object);
+
+  body = g_strdup_printf ("{\"id\":\"%s\"}", new_id);
+  g_free (new_id);
+
+  *status = SOUP_STATUS_OK;
+  return body;
+}
+
+static gchar *handle_graph_request (GFBGraphMockServer *server,
+                                    const gchar        *method,
+                                    const gchar        *path,
+                                    GHashTable         *params,
+                                    guint              *status);
+
+static GHashTable *
+decode_params (const gchar *query)
+{
+  GHashTable *params;
+  GHashTable *decoded;
+  GHashTableIter iter;
+  gpointer name, value;
+
+  params = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+  if (query == NULL || *query == '\0')
+    return params;
+
+  decoded = soup_form_decode (query);
+  g_hash_table_iter_init (&iter, decoded);
+  while (g_hash_table_iter_next (&iter, &name, &value))
+    g_hash_table_replace (params, g_strdup (name), g_strdup (value));
+  g_hash_table_unref (decoded);
+
+  return params;
+}
+
+/* Every request of the batch is answered, in order, with its code and body */
+static gchar *
+handle_batch (GFBGraphMockServer *server,
+              const gchar        *batch,
+              guint              *status)
+{
+  JsonParser *parser;
+  JsonBuilder *builder;
+  JsonArray *requests;
+  gchar *body;
+  guint i;
+
+  parser = json_parser_new ();
+  if (!json_parser_load_from_data (parser, batch, -1, NULL)
+      || !JSON_NODE_HOLDS_ARRAY (json_parser_get_root (parser))) {
+    g_object_unref (parser);
+    *status = SOUP_STATUS_BAD_REQUEST;
+    return error_body (100, "The batch parameter must be a JSON array");
+  }
+
+  requests = json_node_get_array (json_parser_get_root (parser));
+  builder = json_builder_new ();
+  json_builder_begin_array (builder);
+  for (i = 0; i < json_array_get_length (requests); i++) {
+    JsonObject *request = json_array_get_object_element (requests, i);
+    const gchar *method = "GET";
+    gchar **url_parts;
+    gchar *path;
+    GHashTable *params;
+    guint request_status;
+
+    if (request == NULL || !json_object_has_member (request, "relative_url")) {
+      json_builder_add_null_value (builder);
+      continue;
+    }
+    if (json_object_has_member (request, "method"))
+      method = json_object_get_string_member (request, "method");
+
+    url_parts = g_strsplit (json_object_get_string_member (request, "relative_url"), "?", 2);
+    path = g_uri_unescape_string (url_parts[0], NULL);
+    params = decode_params (url_parts[1]);
+    body = handle_graph_request (server, method, path != NULL ? path : "", params, &request_status);
+    g_hash_table_unref (params);
+    g_free (path);
+    g_strfreev (url_parts);
+
+    json_builder_begin_object (builder);
+    json_builder_set_member_name (builder, "code");
+    json_builder_add_int_value (builder, request_status);
+    json_builder_set_member_name (builder, "body");
+    json_builder_add_string_value (builder, body);
+    json_builder_end_object (builder);
+    g_free (body);
+  }
+  json_builder_end_array (builder);
+
+  body = builder_to_data (builder);
+  g_object_unref (builder);
+  g_object_unref (parser);
+
+  *status = SOUP_STATUS_OK;
+  return body;
+}
+
+/* @path is relative to the endpoint, without the leading slash */
+static gchar *
+handle_graph_request (GFBGraphMockServer *server,
+                      const gchar        *method,
+                      const gchar        *path,
+                      GHashTable         *params,
+                      guint              *status)
+{
+  gchar **components;
+  gchar *body = NULL;
+
+  while (*path == '/')
+    path++;
+
+  if (*path == '\0') {
+    if (g_strcmp0 (method, "POST") == 0 && g_hash_table_contains (params, "batch"))
+      return handle_batch (server, g_hash_table_lookup (params, "batch"), status);
+
+    *status = SOUP_STATUS_BAD_REQUEST;
+    return error_body (100, "Unsupported request");
+  }
+
+  components = g_strsplit (path, "/", 3);
+  if (g_strv_length (components) == 1) {
+    if (g_strcmp0 (method, "GET") == 0) {
+      body = get_node (server, components[0], params, status);
+    } else if (g_strcmp0 (method, "DELETE") == 0) {
+      const gchar *id = components[0];
+
+      lookup_node_locked (server, &id);
+      if (remove_node_locked (server, id)) {
+        *status = SOUP_STATUS_OK;
+        body = g_strdup ("{\"success\":true}");
+      }
+    }
+  } else if (g_strv_length (components) == 2 && *components[1] != '\0') {
+    if (g_strcmp0 (method, "GET") == 0)
+      body = get_connection (server, components[0], components[1], params, status);
+    else if (g_strcmp0 (method, "POST") == 0)
+      body = post_connection (server, components[0], components[1], params, status);
+  }
+  g_strfreev (components);
+
+  if (body == NULL) {
+    *status = SOUP_STATUS_BAD_REQUEST;
+    body = error_body (100, "Unsupported request");
+  }
+
+  return body;
+}
+
+static gboolean
+check_access_token_locked (GFBGraphMockServer *server,
+                           SoupMessage        *msg,
+                           GHashTable         *params)
+{
+  const gchar *token;
+  const gchar *authorization;
+
+  if (server->access_token == NULL)
+    return TRUE;
+
+  token = g_hash_table_lookup (params, "access_token");
+  if (token == NULL) {
+    authorization = soup_message_headers_get_one (msg->request_headers, "Authorization");
+    if (authorization != NULL && strchr (authorization, ' ') != NULL)
+      token = strchr (authorization, ' ') + 1;
+  }
+
+  return g_strcmp0 (token, server->access_token) == 0;
+}
+
+static gboolean
+inject_error_locked (GFBGraphMockServer  *server,
+                     guint               *status,
+                     gchar              **body)
+{
+  if (server->fail_next > 0 && server->fail_skip > 0) {
+    server->fail_skip--;
+  } else if (server->fail_next > 0) {
+    server->fail_next--;
+    *status = server->fail_status;
+    *body = error_body (server->fail_code, "Injected error");
+    return TRUE;
+  }
+
+  if (server->error_rate > 0 && g_rand_double (server->rand) < server->error_rate) {
+    *status = server->error_status;
+    *body = error_body (server->error_code, "Injected error");
+    return TRUE;
+  }
+
+  return FALSE;
+}
+
+/* Every image is IMAGE_SIZE bytes of IMAGE_BYTE plus the image version, which
+ * changes its ETag too. A "Range: bytes=N-" request gets the rest of the image,
+ * unless its If-Range doesn't match the current ETag. */
+static gchar *
+handle_image_request_locked (GFBGraphMockServer  *server,
+                             SoupMessage         *msg,
+                             guint               *status,
+                             gsize               *length,
+                             gchar              **etag)
+{
+  const gchar *range, *if_range;
+  gint64 start = 0;
+  gchar *end, *body;
+
+  *etag = g_strdup_printf ("\"image-%u\"", server->image_version);
+  *status = SOUP_STATUS_OK;
+
+  range = soup_message_headers_get_one (msg->request_headers, "Range");
+  if_range = soup_message_headers_get_one (msg->request_headers, "If-Range");
+  if (range != NULL && g_str_has_prefix (range, "bytes=")
+      && (if_range == NULL || g_strcmp0 (if_range, *etag) == 0)) {
+    start = g_ascii_strtoll (range + strlen ("bytes="), &end, 10);
+    if (end[0] != '-' || end[1] != '\0' || start < 0) {
+      start = 0;
+    } else if (start >= IMAGE_SIZE) {
+      *status = SOUP_STATUS_REQUESTED_RANGE_NOT_SATISFIABLE;
+      *length = 0;
+      soup_message_headers_replace (msg->response_headers, "Content-Range",
+                                    "bytes */" G_STRINGIFY (GFBGRAPH_MOCK_SERVER_IMAGE_SIZE));
+      return g_strdup ("");
+    } else if (start > 0) {
+      *status = SOUP_STATUS_PARTIAL_CONTENT;
+      soup_message_headers_set_content_range (msg->response_headers, start, IMAGE_SIZE - 1, IMAGE_SIZE);
+    }
+  }
+
+  /* Otherwise SoupServer applies the range to the whole image itself */
+  soup_message_headers_remove (msg->request_headers, "Range");
+
+  *length = IMAGE_SIZE - start;
+  body = g_malloc (*length);
+  memset (body, IMAGE_BYTE + server->image_version, *length);
+
+  return body;
+}
+
+static void
+close_connection_cb (SoupMessage *msg,
+                     gpointer     user_data)
+{
+  g_socket_shutdown (G_SOCKET (user_data), TRUE, TRUE, NULL);
+}
+
+static void
+request_done (GFBGraphMockServer *server)
+{
+  g_mutex_lock (&server->mutex);
+  server->n_in_progress--;
+  g_mutex_unlock (&server->mutex);
+}
+
+static gboolean
+unpause_message_cb (gpointer user_data)
+{
+  PausedMessage *paused = user_data;
+
+  request_done (paused->server);
+  soup_server_unpause_message (paused->soup_server, paused->msg);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+paused_message_free (gpointer user_data)
+{
+  PausedMessage *paused = user_data;
+
+  g_object_unref (paused->soup_server);
+  g_object_unref (paused->msg);
+  g_slice_free (PausedMessage, paused);
+}
+
+static GHashTable *
+get_message_params (SoupMessage *msg,
+                    GHashTable  *query)
+{
+  GHashTable *params;
+  SoupBuffer *buffer;
+
+  params = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+  if (query != NULL) {
+    GHashTableIter iter;
+    gpointer name, value;
+
+    g_hash_table_iter_init (&iter, query);
+    while (g_hash_table_iter_next (&iter, &name, &value))
+      g_hash_table_replace (params, g_strdup (name), g_strdup (value));
+  }
+
+  buffer = soup_message_body_flatten (msg->request_body);
+  if (buffer->length > 0) {
+    GHashTable *form_params;
+    GHashTableIter iter;
+    gpointer name, value;
+    gchar *form;
+
+    form = g_strndup (buffer->data, buffer->length);
+    form_params = decode_params (form);
+    g_hash_table_iter_init (&iter, form_params);
+    while (g_hash_table_iter_next (&iter, &name, &value))
+      g_hash_table_replace (params, g_strdup (name), g_strdup (value));
+    g_hash_table_unref (form_params);
+    g_free (form);
+  }
+  soup_buffer_free (buffer);
+
+  return params;
+}
+
+static void
+server_callback (SoupServer        *soup_server,
+                 SoupMessage       *msg,
+                 const char        *path,
+                 GHashTable        *query,
+                 SoupClientContext *client,
+                 gpointer           user_data)
+{
+  GFBGraphMockServer *server = user_data;
+  GHashTable *params;
+  const gchar *content_type = "application/json";
+  gchar *body;
+  gchar *usage = NULL;
+  gchar *etag = NULL;
+  gssize cut = -1;
+  gsize length;
+  guint status, latency;
+
+  params = get_message_params (msg, query);
+
+  g_mutex_lock (&server->mutex);
+  server->n_requests++;
+  server->n_in_progress++;
+  server->max_in_progress = MAX (server->max_in_progress, server->n_in_progress);
+  if (inject_error_locked (server, &status, &body)) {
+    length = strlen (body);
+  } else if (g_str_has_prefix (path, IMAGES_PATH)) {
+    /* The images don't need the access token */
+    content_type = "image/jpeg";
+    body = handle_image_request_locked (server, msg, &status, &length, &etag);
+    if (server->image_cut >= 0 && (gsize) server->image_cut < length) {
+      cut = server->image_cut;
+      server->image_cut = -1;
+    }
+  } else if (!check_access_token_locked (server, msg, params)) {
+    status = SOUP_STATUS_BAD_REQUEST;
+    body = error_body (190, "Invalid OAuth access token");
+    length = strlen (body);
+  } else {
+    body = handle_graph_request (server, msg->method, path, params, &status);
+    length = strlen (body);
+
+    /* Like the Graph API, the GET responses have an ETag and are answered
+     * with 304 Not Modified when the client already has them */
+    if (msg->method == SOUP_METHOD_GET && status == SOUP_STATUS_OK) {
+      gchar *checksum;
+
+      checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA1, body, length);
+      etag = g_strdup_printf ("\"%s\"", checksum);
+      g_free (checksum);
+
+      if (g_strcmp0 (soup_message_headers_get_one (msg->request_headers, "If-None-Match"), etag) == 0) {
+        server->n_not_modified++;
+        status = SOUP_STATUS_NOT_MODIFIED;
+        g_free (body);
+        body = g_strdup ("");
+        length = 0;
+      }
+    }
+  }
+
+  if (server->app_usage >= 0 && !g_str_has_prefix (path, IMAGES_PATH))
+    usage = g_strdup_printf ("{\"call_count\":%d,\"total_time\":%d,\"total_cputime\":%d}",
+                             server->app_usage, server->app_usage / 2, server->app_usage / 2);
+
+  latency = server->min_latency;
+  if (server->max_latency > server->min_latency)
+    latency = g_rand_int_range (server->rand, server->min_latency, server->max_latency + 1);
+  g_mutex_unlock (&server->mutex);
+
+  soup_message_set_status (msg, status);
+  if (cut >= 0) {
+    /* The promised length is never completed: the connection is closed once
+     * the first @cut bytes are written, like a network error would do */
+    soup_message_headers_set_content_type (msg->response_headers, content_type, NULL);
+    soup_message_headers_set_content_length (msg->response_headers, length);
+    soup_message_body_append (msg->response_body, SOUP_MEMORY_TAKE, body, cut);
+    g_signal_connect_data (msg, "wrote-chunk", G_CALLBACK (close_connection_cb),
+                           g_object_ref (soup_client_context_get_gsocket (client)),
+                           (GClosureNotify) g_object_unref, 0);
+    latency = 0;
+  } else {
+    soup_message_set_response (msg, content_type, SOUP_MEMORY_TAKE, body, length);
+  }
+  if (usage != NULL)
+    soup_message_headers_replace (msg->response_headers, "X-App-Usage", usage);
+  if (etag != NULL)
+    soup_message_headers_replace (msg->response_headers, "ETag", etag);
+  g_free (usage);
+  g_free (etag);
+
+  if (latency > 0) {
+    PausedMessage *paused;
+    GSource *source;
+
+    paused = g_slice_new (PausedMessage);
+    paused->server = server;
+    paused->soup_server = g_object_ref (soup_server);
+    paused->msg = g_object_ref (msg);
+    soup_server_pause_message (soup_server, msg);
+
+    source = g_timeout_source_new (latency);
+    g_source_set_callback (source, unpause_message_cb, paused, paused_message_free);
+    g_source_attach (source, server->context);
+    g_source_unref (source);
+  } else {
+    request_done (server);
+  }
+
+  g_hash_table_unref (params);
+}
+
+static gpointer
+server_thread_func (gpointer user_data)
+{
+  GFBGraphMockServer *server = user_data;
+  GError *error = NULL;
+  GSList *uris;
+
+  g_main_context_push_thread_default (server->context);
+
+  server->soup_server = soup_server_new (SOUP_SERVER_SERVER_HEADER, "gfbgraph-mock-server ", NULL);
+  soup_server_add_handler (server->soup_server, NULL, server_callback, server, NULL);
+  if (!soup_server_listen_local (server->soup_server, 0, SOUP_SERVER_LISTEN_IPV4_ONLY, &error))
+    g_error ("Can't start the mock Graph API server: %s", error->message);
+
+  uris = soup_server_get_uris (server->soup_server);
+
+  g_mutex_lock (&server->mutex);
+  server->endpoint = g_strdup_printf ("http://127.0.0.1:%u", soup_uri_get_port (uris->data));
+  server->ready = TRUE;
+  g_cond_signal (&server->ready_cond);
+  g_mutex_unlock (&server->mutex);
+
+  g_slist_free_full (uris, (GDestroyNotify) soup_uri_free);
+
+  g_main_loop_run (server->loop);
+
+  soup_server_disconnect (server->soup_server);
+  g_clear_object (&server->soup_server);
+
+  g_main_context_pop_thread_default (server->context);
+
+  return NULL;
+}
+
+static gboolean
+quit_loop_cb (gpointer user_data)
+{
+  GFBGraphMockServer *server = user_data;
+
+  g_main_loop_quit (server->loop);
+
+  return G_SOURCE_REMOVE;
+}
+
+/* --- Public API --- */
+
+/*
+ * Starts a new server, without any node, listening in a random port of the
+ * loopback interface.
+ */
+GFBGraphMockServer *
+gfbgraph_mock_server_new (void)
+{
+  GFBGraphMockServer *server;
+
+  server = g_slice_new0 (GFBGraphMockServer);
+  server->context = g_main_context_new ();
+  server->loop = g_main_loop_new (server->context, FALSE);
+  server->nodes = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) json_object_unref);
+  server->connections = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_ptr_array_unref);
+  server->parents = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+  server->next_id = 1000;
+  server->clock = CLOCK_START;
+  server->app_usage = -1;
+  server->image_cut = -1;
+  /* Fixed seed, so the injected latency and errors are reproducible */
+  server->rand = g_rand_new_with_seed (0x6fb6);
+  g_mutex_init (&server->mutex);
+  g_cond_init (&server->ready_cond);
+
+  server->thread = g_thread_new ("gfbgraph-mock-server", server_thread_func, server);
+
+  g_mutex_lock (&server->mutex);
+  while (!server->ready)
+    g_cond_wait (&server->ready_cond, &server->mutex);
+  g_mutex_unlock (&server->mutex);
+
+  return server;
+}
+
+void
+gfbgraph_mock_server_free (GFBGraphMockServer *server)
+{
+  if (server == NULL)
+    return;
+
+  g_main_context_invoke (server->context, quit_loop_cb, server);
+  g_thread_join (server->thread);
+
+  g_main_loop_unref (server->loop);
+  g_main_context_unref (server->context);
+  g_hash_table_unref (server->nodes);
+  g_hash_table_unref (server->connections);
+  g_hash_table_unref (server->parents);
+  g_rand_free (server->rand);
+  g_mutex_clear (&server->mutex);
+  g_cond_clear (&server->ready_cond);
+  g_free (server->endpoint);
+  g_free (server->me_id);
+  g_free (server->access_token);
+  g_slice_free (GFBGraphMockServer, server);
+}
+
+/* The URL to use as #GFBGraphContext:endpoint */
+const gchar *
+gfbgraph_mock_server_get_endpoint (GFBGraphMockServer *server)
+{
+  return server->endpoint;
+}
+
+/* Requests with another token fail with the OAuthException 190, like the
+ * Graph API does with expired tokens. %NULL accepts any token. */
+void
+gfbgraph_mock_server_set_access_token (GFBGraphMockServer *server,
+                                       const gchar        *access_token)
+{
+  g_mutex_lock (&server->mutex);
+  g_free (server->access_token);
+  server->access_token = g_strdup (access_token);
+  g_mutex_unlock (&server->mutex);
+}
+
+/*
+ * Adds the nodes of a recorded session, a JSON object like:
+ *
+ *   { "me": "100",
+ *     "nodes": { "100": { "name": "..." }, "200": { "name": "...", "count": 1 }, ... },
+ *     "connections": { "100/albums": [ "200" ], "200/photos": [ "300" ], ... } }
+ */
+gboolean
+gfbgraph_mock_server_load (GFBGraphMockServer  *server,
+                           const gchar         *data,
+                           GError             **error)
+{
+  JsonObject *root, *nodes, *connections;
+  GList *members, *l;
+
+  root = parse_object (data, error);
+  if (root == NULL)
+    return FALSE;
+
+  g_mutex_lock (&server->mutex);
+
+  if (json_object_has_member (root, "me")) {
+    g_free (server->me_id);
+    server->me_id = g_strdup (json_object_get_string_member (root, "me"));
+  }
+
+  nodes = json_object_has_member (root, "nodes") ? json_object_get_object_member (root, "nodes") : NULL;
+  members = nodes != NULL ? json_object_get_members (nodes) : NULL;
+  for (l = members; l != NULL; l = l->next) {
+    JsonObject *object = json_object_get_object_member (nodes, l->data);
+
+    if (object != NULL) {
+      json_object_set_string_member (object, "id", l->data);
+      g_hash_table_replace (server->nodes, g_strdup (l->data), json_object_ref (object));
+    }
+  }
+  g_list_free (members);
+
+  connections = json_object_has_member (root, "connections") ? json_object_get_object_member (root, "connections") : NULL;
+  members = connections != NULL ? json_object_get_members (connections) : NULL;
+  for (l = members; l != NULL; l = l->next) {
+    JsonArray *ids = json_object_get_array_member (connections, l->data);
+    guint i;
+
+    if (ids == NULL || strchr (l->data, '/') == NULL)
+      continue;
+    for (i = 0; i < json_array_get_length (ids); i++)
+      link_node_locked (server, l->data, json_array_get_string_element (ids, i));
+  }
+  g_list_free (members);
+
+  g_mutex_unlock (&server->mutex);
+
+  json_object_unref (root);
+
+  return TRUE;
+}
+
+/*
+ * Generates a user, the "me" node if there wasn't any, with @n_albums albums
+ * of @n_photos photos each. Returns the ID of the user.
+ */
+const gchar *
+gfbgraph_mock_server_populate (GFBGraphMockServer *server,
+                               guint               n_albums,
+                               guint               n_photos)
+{
+  JsonObject *object;
+  gchar *user_id, *value;
+  guint i, j;
+
+  g_mutex_lock (&server->mutex);
+
+  object = json_object_new ();
+  json_object_set_string_member (object, "name", "Mock User");
+  json_object_set_string_member (object, "email", "mock.user@example.com");
+  user_id = add_node_locked (server, NULL, NULL, object);
+  json_object_unref (object);
+
+  if (server->me_id == NULL)
+    server->me_id = g_strdup (user_id);
+
+  for (i = 0; i < n_albums; i++) {
+    gchar *album_id;
+
+    object = json_object_new ();
+    value = g_strdup_printf ("Album %u", i);
+    json_object_set_string_member (object, "name", value);
+    g_free (value);
+    json_object_set_string_member (object, "description", "Generated by the mock server");
+    json_object_set_int_member (object, "count", 0);
+    album_id = add_node_locked (server, user_id, "albums", object);
+    value = g_strconcat ("https://www.facebook.com/album.php?fbid=", album_id, NULL);
+    json_object_set_string_member (object, "link", value);
+    g_free (value);
+    json_object_unref (object);
+
+    for (j = 0; j < n_photos; j++) {
+      gchar *photo_id;
+
+      photo_id = g_strdup_printf ("%" G_GUINT64_FORMAT, server->next_id++);
+      object = new_photo_object (server, photo_id, j);
+      g_free (add_node_locked (server, album_id, "photos", object));
+      json_object_unref (object);
+      g_free (photo_id);
+    }
+    g_free (album_id);
+  }
+
+  g_mutex_unlock (&server->mutex);
+
+  g_free (user_id);
+
+  return server->me_id;
+}
+
+/*
+ * Adds a node with the members in the JSON object @members to the
+ * @connection of @parent_id, or unconnected if @parent_id is %NULL. The
+ * photos get generated images. Returns the ID of the node.
+ */
+gchar *
+gfbgraph_mock_server_add_node (GFBGraphMockServer *server,
+                               const gchar        *parent_id,
+                               const gchar        *connection,
+                               const gchar        *members)
+{
+  JsonObject *object, *extra;
+  GList *names, *l;
+  gchar *id;
+
+  extra = parse_object (members != NULL ? members : "{}", NULL);
+  g_return_val_if_fail (extra != NULL, NULL);
+
+  g_mutex_lock (&server->mutex);
+
+  if (g_strcmp0 (connection, "photos") == 0) {
+    gchar *photo_id;
+
+    photo_id = g_strdup_printf ("%" G_GUINT64_FORMAT, server->next_id++);
+    object = new_photo_object (server, photo_id, 0);
+    g_free (photo_id);
+  } else {
+    object = json_object_new ();
+  }
+
+  names = json_object_get_members (extra);
+  for (l = names; l != NULL; l = l->next)
+    json_object_set_member (object, l->data, json_node_copy (json_object_get_member (extra, l->data)));
+  g_list_free (names);
+
+  if (parent_id != NULL)
+    lookup_node_locked (server, &parent_id);
+  id = add_node_locked (server, parent_id, connection, object);
+
+  g_mutex_unlock (&server->mutex);
+
+  json_object_unref (object);
+  json_object_unref (extra);
+
+  return id;
+}
+
+/*
+ * Replaces the members of the node @id present in the JSON object @members.
+ * The updated time is advanced unless it's in @members.
+ */
+gboolean
+gfbgraph_mock_server_update_node (GFBGraphMockServer *server,
+                                  const gchar        *id,
+                                  const gchar        *members)
+{
+  JsonObject *object, *extra;
+  GList *names, *l;
+  const gchar *parent_key;
+
+  extra = parse_object (members != NULL ? members : "{}", NULL);
+  g_return_val_if_fail (extra != NULL, FALSE);
+
+  g_mutex_lock (&server->mutex);
+
+  object = lookup_node_locked (server, &id);
+  if (object != NULL) {
+    names = json_object_get_members (extra);
+    for (l = names; l != NULL; l = l->next) {
+      if (g_strcmp0 (l->data, "id") != 0)
+        json_object_set_member (object, l->data, json_node_copy (json_object_get_member (extra, l->data)));
+    }
+    g_list_free (names);
+
+    if (!json_object_has_member (extra, "updated_time"))
+      set_time_member (object, "updated_time", server->clock++);
+
+    parent_key = g_hash_table_lookup (server->parents, id);
+    if (parent_key != NULL)
+      touch_parent_locked (server, parent_key);
+  }
+
+  g_mutex_unlock (&server->mutex);
+
+  json_object_unref (extra);
+
+  return object != NULL;
+}
+
+/* Removes the node @id with all its connections */
+gboolean
+gfbgraph_mock_server_remove_node (GFBGraphMockServer *server,
+                                  const gchar        *id)
+{
+  gboolean removed;
+
+  g_mutex_lock (&server->mutex);
+  lookup_node_locked (server, &id);
+  removed = remove_node_locked (server, id);
+  g_mutex_unlock (&server->mutex);
+
+  return removed;
+}
+
+/* Returns the IDs in the @connection of the node @id, free with g_strfreev() */
+gchar **
+gfbgraph_mock_server_get_connection (GFBGraphMockServer *server,
+                                     const gchar        *id,
+                                     const gchar        *connection)
+{
+  GPtrArray *ids, *copy;
+  gchar *key;
+  guint i;
+
+  copy = g_ptr_array_new ();
+
+  g_mutex_lock (&server->mutex);
+  lookup_node_locked (server, &id);
+  key = g_strdup_printf ("%s/%s", id, connection);
+  ids = g_hash_table_lookup (server->connections, key);
+  for (i = 0; ids != NULL && i < ids->len; i++)
+    g_ptr_array_add (copy, g_strdup (g_ptr_array_index (ids, i)));
+  g_mutex_unlock (&server->mutex);
+
+  g_free (key);
+  g_ptr_array_add (copy, NULL);
+
+  return (gchar **) g_ptr_array_free (copy, FALSE);
+}
+
+/* Every response is delayed a random time between @min_ms and @max_ms */
+void
+gfbgraph_mock_server_set_latency (GFBGraphMockServer *server,
+                                  guint               min_ms,
+                                  guint               max_ms)
+{
+  g_mutex_lock (&server->mutex);
+  server->min_latency = min_ms;
+  server->max_latency = MAX (min_ms, max_ms);
+  g_mutex_unlock (&server->mutex);
+}
+
+/* A @rate fraction of the requests fail with the HTTP @status and the Graph
+ * API error @code, like 1 (unknown), 2 (service), 4 or 17 (rate limits) */
+void
+gfbgraph_mock_server_set_error_rate (GFBGraphMockServer *server,
+                                     gdouble             rate,
+                                     guint               status,
+                                     gint                code)
+{
+  g_mutex_lock (&server->mutex);
+  server->error_rate = CLAMP (rate, 0.0, 1.0);
+  server->error_status = status;
+  server->error_code = code;
+  g_mutex_unlock (&server->mutex);
+}
+
+/* The next @n_requests requests fail with the HTTP @status and the Graph API error @code */
+void
+gfbgraph_mock_server_fail_next (GFBGraphMockServer *server,
+                                guint               n_requests,
+                                guint               status,
+                                gint                code)
+{
+  gfbgraph_mock_server_fail_after (server, 0, n_requests, status, code);
+}
+
+/* Like gfbgraph_mock_server_fail_next(), but after @n_skipped requests succeed */
+void
+gfbgraph_mock_server_fail_after (GFBGraphMockServer *server,
+                                 guint               n_skipped,
+                                 guint               n_requests,
+                                 guint               status,
+                                 gint                code)
+{
+  g_mutex_lock (&server->mutex);
+  server->fail_skip = n_skipped;
+  server->fail_next = n_requests;
+  server->fail_status = status;
+  server->fail_code = code;
+  g_mutex_unlock (&server->mutex);
+}
+
+/* The responses report an application quota usage of @usage percent in the
+ * X-App-Usage header, or no usage if negative */
+void
+gfbgraph_mock_server_set_app_usage (GFBGraphMockServer *server,
+                                    gint                usage)
+{
+  g_mutex_lock (&server->mutex);
+  server->app_usage = usage;
+  g_mutex_unlock (&server->mutex);
+}
+
+/* Changes the content and the ETag of every image: its bytes become 0xAB plus @version */
+void
+gfbgraph_mock_server_set_image_version (GFBGraphMockServer *server,
+                                        guint               version)
+{
+  g_mutex_lock (&server->mutex);
+  server->image_version = version;
+  g_mutex_unlock (&server->mutex);
+}
+
+/* The connection of the next image response is closed after sending @n_bytes
+ * of its body, so the client gets a truncated download */
+void
+gfbgraph_mock_server_interrupt_next_image (GFBGraphMockServer *server,
+                                           gsize               n_bytes)
+{
+  g_mutex_lock (&server->mutex);
+  server->image_cut = n_bytes;
+  g_mutex_unlock (&server->mutex);
+}
+
+/* The number of HTTP requests received, a batch counts as one */
+guint
+gfbgraph_mock_server_get_n_requests (GFBGraphMockServer *server)
+{
+  guint n_requests;
+
+  g_mutex_lock (&server->mutex);
+  n_requests = server->n_requests;
+  g_mutex_unlock (&server->mutex);
+
+  return n_requests;
+}
+
+/* The number of GET requests answered with 304 Not Modified */
+guint
+gfbgraph_mock_server_get_n_not_modified (GFBGraphMockServer *server)
+{
+  guint n_not_modified;
+
+  g_mutex_lock (&server->mutex);
+  n_not_modified = server->n_not_modified;
+  g_mutex_unlock (&server->mutex);
+
+  return n_not_modified;
+}
+
+/* The highest number of requests in progress at the same time, the delay of
+ * gfbgraph_mock_server_set_latency() included */
+guint
+gfbgraph_mock_server_get_max_in_progress (GFBGraphMockServer *server)
+{
+  guint max_in_progress;
+
+  g_mutex_lock (&server->mutex);
+  max_in_progress = server->max_in_progress;
+  g_mutex_unlock (&server->mutex);
+
+  return max_in_progress;
+}
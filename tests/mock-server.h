@@ -0,0 +1,97 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 2; tab-width: 2 -*-  */
+/*
+ * libgfbgraph - GObject library for Facebook Graph API
+ * Copyright (C) 2013 Álvaro Peña <alvaropg@gmail.com>
+ *               2020 Leesoo Ahn <yisooan@fedoraproject.org>
+ *
+ * GFBGraph is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GFBGraph is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GFBGraph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GFBGRAPH_MOCK_SERVER_H__
+#define __GFBGRAPH_MOCK_SERVER_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * A local Graph API server for the tests and benchmarks, so they don't need
+ * network access nor a Facebook application. It runs in its own thread and
+ * serves the nodes loaded or generated on it, with cursor based paging of the
+ * connections, batch requests, field projection, and injected latency and
+ * errors. Point a #GFBGraphContext to gfbgraph_mock_server_get_endpoint() to
+ * use it.
+ */
+typedef struct _GFBGraphMockServer GFBGraphMockServer;
+
+/* Size of the images served for the generated photos */
+#define GFBGRAPH_MOCK_SERVER_IMAGE_SIZE 4096
+
+GFBGraphMockServer* gfbgraph_mock_server_new              (void);
+void                gfbgraph_mock_server_free             (GFBGraphMockServer  *server);
+
+const gchar*        gfbgraph_mock_server_get_endpoint     (GFBGraphMockServer  *server);
+void                gfbgraph_mock_server_set_access_token (GFBGraphMockServer  *server,
+                                                           const gchar         *access_token);
+
+gboolean            gfbgraph_mock_server_load             (GFBGraphMockServer  *server,
+                                                           const gchar         *data,
+                                                           GError             **error);
+const gchar*        gfbgraph_mock_server_populate         (GFBGraphMockServer  *server,
+                                                           guint                n_albums,
+                                                           guint                n_photos);
+gchar*              gfbgraph_mock_server_add_node         (GFBGraphMockServer  *server,
+                                                           const gchar         *parent_id,
+                                                           const gchar         *connection,
+                                                           const gchar         *members);
+gboolean            gfbgraph_mock_server_update_node      (GFBGraphMockServer  *server,
+                                                           const gchar         *id,
+                                                           const gchar         *members);
+gboolean            gfbgraph_mock_server_remove_node      (GFBGraphMockServer  *server,
+                                                           const gchar         *id);
+gchar**             gfbgraph_mock_server_get_connection   (GFBGraphMockServer  *server,
+                                                           const gchar         *id,
+                                                           const gchar         *connection);
+
+void                gfbgraph_mock_server_set_latency      (GFBGraphMockServer  *server,
+                                                           guint                min_ms,
+                                                           guint                max_ms);
+void                gfbgraph_mock_server_set_error_rate   (GFBGraphMockServer  *server,
+                                                           gdouble              rate,
+                                                           guint                status,
+                                                           gint                 code);
+void                gfbgraph_mock_server_fail_next        (GFBGraphMockServer  *server,
+                                                           guint                n_requests,
+                                                           guint                status,
+                                                           gint                 code);
+void                gfbgraph_mock_server_fail_after       (GFBGraphMockServer  *server,
+                                                           guint                n_skipped,
+                                                           guint                n_requests,
+                                                           guint                status,
+                                                           gint                 code);
+void                gfbgraph_mock_server_set_app_usage    (GFBGraphMockServer  *server,
+                                                           gint                 usage);
+void                gfbgraph_mock_server_set_image_version (GFBGraphMockServer *server,
+                                                            guint               version);
+void                gfbgraph_mock_server_interrupt_next_image (GFBGraphMockServer *server,
+                                                               gsize               n_bytes);
+guint               gfbgraph_mock_server_get_n_requests   (GFBGraphMockServer  *server);
+guint               gfbgraph_mock_server_get_n_not_modified (GFBGraphMockServer *server);
+guint               gfbgraph_mock_server_get_max_in_progress (GFBGraphMockServer *server);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (GFBGraphMockServer, gfbgraph_mock_server_free)
+
+G_END_DECLS
+
+#endif /* __GFBGRAPH_MOCK_SERVER_H__ */
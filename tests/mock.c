@@ -0,0 +1,1750 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 2; tab-width: 2 -*-  */
+/*
+ * libgfbgraph - GObject library for Facebook Graph API
+ * Copyright (C) 2013 Álvaro Peña <alvaropg@gmail.com>
+ *               2020 Leesoo Ahn <yisooan@fedoraproject.org>
+ *
+ * GFBGraph is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GFBGraph is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GFBGraph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Functional tests against the local Graph API server of mock-server.c, so
+ * they run without network access.
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <rest/rest-proxy.h>
+#include <string.h>
+#include <utime.h>
+
+#include <gfbgraph/gfbgraph.h>
+#include <gfbgraph/gfbgraph-simple-authorizer.h>
+#include <gfbgraph/gfbgraph-goa-authorizer.h>
+
+#include "mock-server.h"
+
+#define N_ALBUMS 5
+#define N_PHOTOS 12
+
+/* A simple authorizer whose refresh switches to the next token, keeping its account */
+typedef struct {
+  GFBGraphSimpleAuthorizer parent;
+  gchar *next_token;
+  gint   n_refreshes;
+} RotatingAuthorizer;
+
+typedef GFBGraphSimpleAuthorizerClass RotatingAuthorizerClass;
+
+static GType rotating_authorizer_get_type (void);
+static void rotating_authorizer_iface_init (GFBGraphAuthorizerInterface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (RotatingAuthorizer, rotating_authorizer, GFBGRAPH_TYPE_SIMPLE_AUTHORIZER,
+  G_IMPLEMENT_INTERFACE (GFBGRAPH_TYPE_AUTHORIZER, rotating_authorizer_iface_init));
+
+static void
+rotating_authorizer_finalize (GObject *object)
+{
+  g_free (((RotatingAuthorizer *) object)->next_token);
+
+  G_OBJECT_CLASS (rotating_authorizer_parent_class)->finalize (object);
+}
+
+static void
+rotating_authorizer_class_init (RotatingAuthorizerClass *klass)
+{
+  G_OBJECT_CLASS (klass)->finalize = rotating_authorizer_finalize;
+}
+
+static void
+rotating_authorizer_init (RotatingAuthorizer *self)
+{
+}
+
+static gboolean
+rotating_authorizer_refresh_authorization (GFBGraphAuthorizer  *iface,
+                                           GCancellable        *cancellable,
+                                           GError             **error)
+{
+  RotatingAuthorizer *self = (RotatingAuthorizer *) iface;
+
+  g_atomic_int_inc (&self->n_refreshes);
+  g_object_set (self, "access-token", self->next_token, NULL);
+
+  return TRUE;
+}
+
+static gchar *
+rotating_authorizer_get_account_id (GFBGraphAuthorizer *iface)
+{
+  return g_strdup ("mock-account");
+}
+
+static void
+rotating_authorizer_iface_init (GFBGraphAuthorizerInterface *iface)
+{
+  iface->refresh_authorization = rotating_authorizer_refresh_authorization;
+  iface->get_account_id = rotating_authorizer_get_account_id;
+}
+
+static RotatingAuthorizer *
+rotating_authorizer_new (const gchar *access_token,
+                         const gchar *next_token)
+{
+  RotatingAuthorizer *self;
+
+  self = g_object_new (rotating_authorizer_get_type (), "access-token", access_token, NULL);
+  self->next_token = g_strdup (next_token);
+
+  return self;
+}
+
+typedef struct {
+  GFBGraphMockServer *server;
+  GFBGraphContext    *context;
+  GFBGraphAuthorizer *authorizer;
+  const gchar        *me_id;
+} MockFixture;
+
+static void
+mock_fixture_setup (MockFixture   *fixture,
+                    gconstpointer  user_data)
+{
+  fixture->server = gfbgraph_mock_server_new ();
+  fixture->me_id = gfbgraph_mock_server_populate (fixture->server, N_ALBUMS, N_PHOTOS);
+  gfbgraph_mock_server_set_access_token (fixture->server, "mock-token");
+
+  fixture->context = gfbgraph_context_new (gfbgraph_mock_server_get_endpoint (fixture->server));
+  fixture->authorizer = GFBGRAPH_AUTHORIZER (gfbgraph_simple_authorizer_new ("mock-token"));
+  gfbgraph_context_set_for_authorizer (fixture->context, fixture->authorizer);
+}
+
+static void
+mock_fixture_teardown (MockFixture   *fixture,
+                       gconstpointer  user_data)
+{
+  g_object_unref (fixture->authorizer);
+  g_object_unref (fixture->context);
+  gfbgraph_mock_server_free (fixture->server);
+}
+
+static void
+test_mock_me (MockFixture   *fixture,
+              gconstpointer  user_data)
+{
+  g_autoptr (GFBGraphUser) me = NULL;
+  g_autoptr (GError) error = NULL;
+
+  me = gfbgraph_user_get_me (fixture->authorizer, &error);
+  g_assert_no_error (error);
+  g_assert_true (GFBGRAPH_IS_USER (me));
+
+  g_assert_cmpstr (gfbgraph_node_get_id (GFBGRAPH_NODE (me)), ==, fixture->me_id);
+  g_assert_cmpstr (gfbgraph_user_get_email (me), ==, "mock.user@example.com");
+}
+
+static void
+test_mock_paging (MockFixture   *fixture,
+                  gconstpointer  user_data)
+{
+  g_autoptr (GFBGraphUser) me = NULL;
+  g_autoptr (GFBGraphConnectionIterator) iterator = NULL;
+  g_autoptr (GError) error = NULL;
+  g_auto (GStrv) album_ids = NULL;
+  GPtrArray *page;
+  guint n_pages = 0, n_albums = 0, i;
+
+  me = gfbgraph_user_get_me (fixture->authorizer, &error);
+  g_assert_no_error (error);
+
+  iterator = gfbgraph_connection_iterator_new (GFBGRAPH_NODE (me), GFBGRAPH_TYPE_ALBUM,
+                                               fixture->authorizer, &error);
+  g_assert_no_error (error);
+  gfbgraph_connection_iterator_set_limit (iterator, 2);
+
+  album_ids = gfbgraph_mock_server_get_connection (fixture->server, fixture->me_id, "albums");
+  g_assert_cmpuint (g_strv_length (album_ids), ==, N_ALBUMS);
+
+  while ((page = gfbgraph_connection_iterator_next_page_array (iterator, NULL, &error)) != NULL) {
+    g_assert_cmpuint (page->len, <=, 2);
+    for (i = 0; i < page->len; i++) {
+      GFBGraphAlbum *album = g_ptr_array_index (page, i);
+
+      g_assert_cmpstr (gfbgraph_node_get_id (GFBGRAPH_NODE (album)), ==, album_ids[n_albums]);
+      g_assert_cmpuint (gfbgraph_album_get_count (album), ==, N_PHOTOS);
+      n_albums++;
+    }
+    n_pages++;
+    g_ptr_array_unref (page);
+  }
+
+  g_assert_no_error (error);
+  g_assert_true (gfbgraph_connection_iterator_is_finished (iterator));
+  g_assert_cmpuint (n_albums, ==, N_ALBUMS);
+  g_assert_cmpuint (n_pages, ==, (N_ALBUMS + 1) / 2);
+}
+
+/* Iterates over the photos of @album with @since and @until, checking that
+ * they are the ones of @timestamps in the range, in the same order */
+static void
+assert_photos_in_range (MockFixture  *fixture,
+                        GFBGraphNode *album,
+                        const gint64 *timestamps,
+                        guint         n_timestamps,
+                        gint64        since,
+                        gint64        until)
+{
+  g_autoptr (GFBGraphConnectionIterator) iterator = NULL;
+  g_autoptr (GError) error = NULL;
+  GPtrArray *page;
+  guint i, j = 0;
+
+  iterator = gfbgraph_connection_iterator_new (album, GFBGRAPH_TYPE_PHOTO, fixture->authorizer, &error);
+  g_assert_no_error (error);
+  gfbgraph_connection_iterator_set_limit (iterator, 2);
+  gfbgraph_connection_iterator_set_since (iterator, since);
+  gfbgraph_connection_iterator_set_until (iterator, until);
+
+  while ((page = gfbgraph_connection_iterator_next_page_array (iterator, NULL, &error)) != NULL) {
+    for (i = 0; i < page->len; i++) {
+      gint64 timestamp = gfbgraph_node_get_created_timestamp (g_ptr_array_index (page, i));
+
+      /* The next timestamp of @timestamps in the range */
+      while (j < n_timestamps
+             && ((since > 0 && timestamps[j] < since) || (until > 0 && timestamps[j] > until)))
+        j++;
+      g_assert_cmpuint (j, <, n_timestamps);
+      g_assert_cmpint (timestamp, ==, timestamps[j++]);
+    }
+    g_ptr_array_unref (page);
+  }
+  g_assert_no_error (error);
+
+  for (; j < n_timestamps; j++)
+    g_assert_false ((since == 0 || timestamps[j] >= since) && (until == 0 || timestamps[j] <= until));
+}
+
+static void
+test_mock_time_range (MockFixture   *fixture,
+                      gconstpointer  user_data)
+{
+  g_autoptr (GFBGraphUser) me = NULL;
+  g_autoptr (GFBGraphNode) album = NULL;
+  g_autoptr (GError) error = NULL;
+  g_auto (GStrv) album_ids = NULL;
+  GList *photos, *l;
+  gint64 timestamps[N_PHOTOS];
+  guint n_photos = 0;
+
+  me = gfbgraph_user_get_me (fixture->authorizer, &error);
+  g_assert_no_error (error);
+  album_ids = gfbgraph_mock_server_get_connection (fixture->server, fixture->me_id, "albums");
+  album = gfbgraph_node_new_from_id (fixture->authorizer, album_ids[1], GFBGRAPH_TYPE_ALBUM, &error);
+  g_assert_no_error (error);
+
+  /* The photos were created in order, at whole seconds like in the Graph API */
+  photos = gfbgraph_node_get_connection_nodes (album, GFBGRAPH_TYPE_PHOTO, fixture->authorizer, &error);
+  g_assert_no_error (error);
+  for (l = photos; l != NULL; l = l->next) {
+    g_assert_cmpuint (n_photos, <, N_PHOTOS);
+    timestamps[n_photos] = gfbgraph_node_get_created_timestamp (l->data);
+    g_assert_cmpint (timestamps[n_photos] % G_USEC_PER_SEC, ==, 0);
+    if (n_photos > 0)
+      g_assert_cmpint (timestamps[n_photos], >, timestamps[n_photos - 1]);
+    n_photos++;
+  }
+  g_list_free_full (photos, g_object_unref);
+  g_assert_cmpuint (n_photos, ==, N_PHOTOS);
+
+  /* Both bounds are inclusive, and kept in all the pages */
+  assert_photos_in_range (fixture, album, timestamps, N_PHOTOS, timestamps[3], timestamps[8]);
+  assert_photos_in_range (fixture, album, timestamps, N_PHOTOS, timestamps[N_PHOTOS - 1], 0);
+  assert_photos_in_range (fixture, album, timestamps, N_PHOTOS, 0, timestamps[0]);
+  assert_photos_in_range (fixture, album, timestamps, N_PHOTOS, timestamps[N_PHOTOS - 1] + G_USEC_PER_SEC, 0);
+}
+
+static gboolean
+cancel_cb (gpointer user_data)
+{
+  g_cancellable_cancel (G_CANCELLABLE (user_data));
+
+  return G_SOURCE_REMOVE;
+}
+
+static void
+next_page_cb (GObject      *source_object,
+              GAsyncResult *result,
+              gpointer      user_data)
+{
+  GError **error = user_data;
+  GPtrArray *page;
+
+  page = gfbgraph_connection_iterator_next_page_array_finish (GFBGRAPH_CONNECTION_ITERATOR (source_object),
+                                                              result, error);
+  g_assert_null (page);
+  g_assert_nonnull (*error);
+}
+
+static void
+test_mock_paging_cancel (MockFixture   *fixture,
+                         gconstpointer  user_data)
+{
+  g_autoptr (GFBGraphUser) me = NULL;
+  g_autoptr (GFBGraphConnectionIterator) iterator = NULL;
+  g_autoptr (GCancellable) cancellable = NULL;
+  g_autoptr (GError) error = NULL;
+  g_auto (GStrv) album_ids = NULL;
+  GPtrArray *page;
+  gint64 start;
+
+  me = gfbgraph_user_get_me (fixture->authorizer, &error);
+  g_assert_no_error (error);
+
+  iterator = gfbgraph_connection_iterator_new (GFBGRAPH_NODE (me), GFBGRAPH_TYPE_ALBUM,
+                                               fixture->authorizer, &error);
+  g_assert_no_error (error);
+  gfbgraph_connection_iterator_set_limit (iterator, 2);
+
+  /* The page request in progress is cancelled, not only the next one */
+  gfbgraph_mock_server_set_latency (fixture->server, 2000, 2000);
+  cancellable = g_cancellable_new ();
+  g_timeout_add (50, cancel_cb, cancellable);
+  start = g_get_monotonic_time ();
+  gfbgraph_connection_iterator_next_page_async (iterator, cancellable, next_page_cb, &error);
+  while (error == NULL)
+    g_main_context_iteration (NULL, TRUE);
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+  g_assert_cmpint (g_get_monotonic_time () - start, <, 1000 * G_TIME_SPAN_MILLISECOND);
+  g_clear_error (&error);
+
+  /* And the cancelled page is requested again by the next call */
+  gfbgraph_mock_server_set_latency (fixture->server, 0, 0);
+  album_ids = gfbgraph_mock_server_get_connection (fixture->server, fixture->me_id, "albums");
+  page = gfbgraph_connection_iterator_next_page_array (iterator, NULL, &error);
+  g_assert_no_error (error);
+  g_assert_nonnull (page);
+  g_assert_cmpstr (gfbgraph_node_get_id (g_ptr_array_index (page, 0)), ==, album_ids[0]);
+  g_ptr_array_unref (page);
+}
+
+static void
+test_mock_batch (MockFixture   *fixture,
+                 gconstpointer  user_data)
+{
+  g_autoptr (GHashTable) photos = NULL;
+  g_autoptr (GHashTable) errors = NULL;
+  g_autoptr (GFBGraphFieldSet) fields = NULL;
+  g_autoptr (GError) error = NULL;
+  g_auto (GStrv) album_ids = NULL;
+  g_auto (GStrv) photo_ids = NULL;
+  const gchar *odd_ids[3] = { "odd?id&x", NULL, NULL };
+  guint n_requests, i;
+
+  album_ids = gfbgraph_mock_server_get_connection (fixture->server, fixture->me_id, "albums");
+  photo_ids = gfbgraph_mock_server_get_connection (fixture->server, album_ids[0], "photos");
+  fields = gfbgraph_field_set_new ("id", "width", "height", NULL);
+  odd_ids[1] = photo_ids[0];
+
+  n_requests = gfbgraph_mock_server_get_n_requests (fixture->server);
+  photos = gfbgraph_node_new_from_ids (fixture->authorizer,
+                                       (const gchar * const *) photo_ids,
+                                       GFBGRAPH_TYPE_PHOTO,
+                                       fields,
+                                       5,
+                                       NULL,
+                                       &error);
+  g_assert_no_error (error);
+
+  /* 12 nodes in batches of 5 */
+  g_assert_cmpuint (gfbgraph_mock_server_get_n_requests (fixture->server) - n_requests, ==, 3);
+  g_assert_cmpuint (g_hash_table_size (photos), ==, N_PHOTOS);
+  for (i = 0; photo_ids[i] != NULL; i++) {
+    GFBGraphPhoto *photo = g_hash_table_lookup (photos, photo_ids[i]);
+
+    g_assert_true (GFBGRAPH_IS_PHOTO (photo));
+    g_assert_cmpuint (gfbgraph_photo_get_default_width (photo), ==, 960);
+  }
+  g_clear_pointer (&photos, g_hash_table_unref);
+
+  /* A failed batch fails only its nodes */
+  gfbgraph_mock_server_fail_next (fixture->server, 1, 500, 1);
+  photos = gfbgraph_node_new_from_ids (fixture->authorizer,
+                                       (const gchar * const *) photo_ids,
+                                       GFBGRAPH_TYPE_PHOTO,
+                                       fields,
+                                       5,
+                                       &errors,
+                                       &error);
+  g_assert_no_error (error);
+  g_assert_cmpuint (g_hash_table_size (photos), ==, N_PHOTOS - 5);
+  g_assert_cmpuint (g_hash_table_size (errors), ==, 5);
+  for (i = 0; i < 5; i++)
+    g_assert_true (g_hash_table_contains (errors, photo_ids[i]));
+  g_clear_pointer (&photos, g_hash_table_unref);
+  g_clear_pointer (&errors, g_hash_table_unref);
+
+  /* And only when all of them fail the whole call does */
+  gfbgraph_mock_server_fail_next (fixture->server, 3, 500, 1);
+  photos = gfbgraph_node_new_from_ids (fixture->authorizer,
+                                       (const gchar * const *) photo_ids,
+                                       GFBGRAPH_TYPE_PHOTO,
+                                       fields,
+                                       5,
+                                       NULL,
+                                       &error);
+  g_assert_error (error, REST_PROXY_ERROR, REST_PROXY_ERROR_HTTP_INTERNAL_SERVER_ERROR);
+  g_assert_null (photos);
+  g_clear_error (&error);
+
+  /* The IDs and fields are escaped in the relative URLs */
+  g_assert_true (gfbgraph_mock_server_load (fixture->server,
+                                            "{\"nodes\": {\"odd?id&x\": {\"name\": \"Odd\"}}}",
+                                            &error));
+  g_clear_pointer (&fields, gfbgraph_field_set_unref);
+  fields = gfbgraph_field_set_new ("id", "name", "images{source,width}", NULL);
+  photos = gfbgraph_node_new_from_ids (fixture->authorizer,
+                                       odd_ids,
+                                       GFBGRAPH_TYPE_PHOTO,
+                                       fields,
+                                       0,
+                                       &errors,
+                                       &error);
+  g_assert_no_error (error);
+  g_assert_cmpuint (g_hash_table_size (errors), ==, 0);
+  g_assert_cmpstr (gfbgraph_photo_get_name (g_hash_table_lookup (photos, odd_ids[0])), ==, "Odd");
+  g_assert_cmpuint (g_list_length (gfbgraph_photo_get_images (g_hash_table_lookup (photos, odd_ids[1]))), ==, 3);
+}
+
+static void
+test_mock_errors (MockFixture   *fixture,
+                  gconstpointer  user_data)
+{
+  g_autoptr (GFBGraphUser) me = NULL;
+  GError *error = NULL;
+
+  gfbgraph_mock_server_fail_next (fixture->server, 1, 500, 2);
+  me = gfbgraph_user_get_me (fixture->authorizer, &error);
+  g_assert_nonnull (error);
+  g_assert_null (me);
+  g_clear_error (&error);
+
+  me = gfbgraph_user_get_me (fixture->authorizer, &error);
+  g_assert_no_error (error);
+  g_assert_nonnull (me);
+  g_clear_object (&me);
+
+  gfbgraph_mock_server_set_access_token (fixture->server, "another-token");
+  me = gfbgraph_user_get_me (fixture->authorizer, &error);
+  g_assert_nonnull (error);
+  g_assert_null (me);
+  g_clear_error (&error);
+}
+
+static void
+test_mock_latency (MockFixture   *fixture,
+                   gconstpointer  user_data)
+{
+  g_autoptr (GFBGraphUser) me = NULL;
+  g_autoptr (GError) error = NULL;
+  gint64 start;
+
+  gfbgraph_mock_server_set_latency (fixture->server, 50, 50);
+
+  start = g_get_monotonic_time ();
+  me = gfbgraph_user_get_me (fixture->authorizer, &error);
+  g_assert_no_error (error);
+  g_assert_cmpint (g_get_monotonic_time () - start, >=, 50 * G_TIME_SPAN_MILLISECOND);
+}
+
+static void
+get_me_cancelled_cb (GObject      *source_object,
+                     GAsyncResult *result,
+                     gpointer      user_data)
+{
+  gboolean *cancelled = user_data;
+  g_autoptr (GFBGraphUser) me = NULL;
+  g_autoptr (GError) error = NULL;
+
+  me = gfbgraph_user_get_me_async_finish (GFBGRAPH_AUTHORIZER (source_object), result, &error);
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+  g_assert_null (me);
+  *cancelled = TRUE;
+}
+
+static void
+test_mock_retry (MockFixture   *fixture,
+                 gconstpointer  user_data)
+{
+  g_autoptr (GFBGraphRetryPolicy) policy = NULL;
+  g_autoptr (GFBGraphUser) me = NULL;
+  g_autoptr (GCancellable) cancellable = NULL;
+  GError *error = NULL;
+  gboolean exhausted = FALSE;
+  gboolean cancelled = FALSE;
+  guint n_requests, i;
+  gint64 start;
+
+  policy = gfbgraph_retry_policy_new ();
+  gfbgraph_retry_policy_set_rule (policy, GFBGRAPH_RETRY_CLASS_SERVER_ERROR, 2, 10, 50);
+  gfbgraph_retry_policy_set_rule (policy, GFBGRAPH_RETRY_CLASS_GRAPH_TRANSIENT, 2, 10, 50);
+  gfbgraph_context_set_retry_policy (fixture->context, policy);
+
+  /* Transient errors are retried up to the limit of their rule */
+  n_requests = gfbgraph_mock_server_get_n_requests (fixture->server);
+  gfbgraph_mock_server_fail_next (fixture->server, 2, 503, 0);
+  me = gfbgraph_user_get_me (fixture->authorizer, &error);
+  g_assert_no_error (error);
+  g_assert_nonnull (me);
+  g_assert_cmpuint (gfbgraph_mock_server_get_n_requests (fixture->server), ==, n_requests + 3);
+  g_clear_object (&me);
+
+  n_requests = gfbgraph_mock_server_get_n_requests (fixture->server);
+  gfbgraph_mock_server_fail_next (fixture->server, 3, 500, 2);
+  me = gfbgraph_user_get_me (fixture->authorizer, &error);
+  g_assert_error (error, REST_PROXY_ERROR, REST_PROXY_ERROR_HTTP_INTERNAL_SERVER_ERROR);
+  g_assert_null (me);
+  g_assert_cmpuint (gfbgraph_mock_server_get_n_requests (fixture->server), ==, n_requests + 3);
+  g_clear_error (&error);
+
+  /* The other errors aren't */
+  n_requests = gfbgraph_mock_server_get_n_requests (fixture->server);
+  gfbgraph_mock_server_fail_next (fixture->server, 1, 400, 100);
+  me = gfbgraph_user_get_me (fixture->authorizer, &error);
+  g_assert_nonnull (error);
+  g_assert_cmpuint (gfbgraph_mock_server_get_n_requests (fixture->server), ==, n_requests + 1);
+  g_clear_error (&error);
+
+  /* A call cancelled while waiting for a retry returns at once */
+  gfbgraph_retry_policy_set_rule (policy, GFBGRAPH_RETRY_CLASS_SERVER_ERROR, 2, 2000, 2000);
+  gfbgraph_mock_server_fail_next (fixture->server, 1, 503, 0);
+  cancellable = g_cancellable_new ();
+  g_timeout_add (100, cancel_cb, cancellable);
+  start = g_get_monotonic_time ();
+  gfbgraph_user_get_me_async (fixture->authorizer, cancellable, get_me_cancelled_cb, &cancelled);
+  while (!cancelled)
+    g_main_context_iteration (NULL, TRUE);
+  g_assert_cmpint (g_get_monotonic_time () - start, <, 1000 * G_TIME_SPAN_MILLISECOND);
+  gfbgraph_retry_policy_set_rule (policy, GFBGRAPH_RETRY_CLASS_SERVER_ERROR, 2, 10, 50);
+
+  /* Nor the ones beyond the budget, once it isn't refilled anymore */
+  gfbgraph_retry_policy_set_budget_ratio (policy, 0.0);
+  gfbgraph_retry_policy_set_min_retry_rate (policy, 0.0);
+  gfbgraph_mock_server_fail_next (fixture->server, G_MAXINT, 503, 0);
+  for (i = 0; i < 10 && !exhausted; i++) {
+    n_requests = gfbgraph_mock_server_get_n_requests (fixture->server);
+    me = gfbgraph_user_get_me (fixture->authorizer, &error);
+    g_assert_nonnull (error);
+    g_clear_error (&error);
+    exhausted = gfbgraph_mock_server_get_n_requests (fixture->server) == n_requests + 1;
+  }
+  g_assert_true (exhausted);
+}
+
+static void
+get_me_cb (GObject      *source_object,
+           GAsyncResult *result,
+           gpointer      user_data)
+{
+  GFBGraphUser **me = user_data;
+  g_autoptr (GError) error = NULL;
+
+  *me = gfbgraph_user_get_me_async_finish (GFBGRAPH_AUTHORIZER (source_object), result, &error);
+  g_assert_no_error (error);
+}
+
+static void
+test_mock_reauthorize (MockFixture   *fixture,
+                       gconstpointer  user_data)
+{
+  RotatingAuthorizer *authorizer;
+  g_autoptr (GFBGraphUser) me = NULL;
+  g_autoptr (GError) error = NULL;
+
+  authorizer = rotating_authorizer_new ("mock-token", "rotated-token");
+  gfbgraph_context_set_for_authorizer (fixture->context, GFBGRAPH_AUTHORIZER (authorizer));
+
+  /* The rejected request is sent again once with the refreshed token */
+  gfbgraph_mock_server_set_access_token (fixture->server, "rotated-token");
+  me = gfbgraph_user_get_me (GFBGRAPH_AUTHORIZER (authorizer), &error);
+  g_assert_no_error (error);
+  g_assert_nonnull (me);
+  g_assert_cmpint (authorizer->n_refreshes, ==, 1);
+  g_clear_object (&me);
+
+  gfbgraph_mock_server_set_access_token (fixture->server, "mock-token");
+  g_free (authorizer->next_token);
+  authorizer->next_token = g_strdup ("mock-token");
+  gfbgraph_user_get_me_async (GFBGRAPH_AUTHORIZER (authorizer), NULL, get_me_cb, &me);
+  while (me == NULL)
+    g_main_context_iteration (NULL, TRUE);
+  g_assert_cmpint (authorizer->n_refreshes, ==, 2);
+  g_clear_object (&me);
+
+  /* But only once, a token rejected after the refresh fails the request */
+  gfbgraph_mock_server_set_access_token (fixture->server, "revoked-token");
+  me = gfbgraph_user_get_me (GFBGRAPH_AUTHORIZER (authorizer), &error);
+  g_assert_error (error, REST_PROXY_ERROR, REST_PROXY_ERROR_HTTP_BAD_REQUEST);
+  g_assert_null (me);
+  g_assert_cmpint (authorizer->n_refreshes, ==, 3);
+
+  g_object_unref (authorizer);
+}
+
+static guint
+count_cache_entries (const gchar *directory)
+{
+  g_autoptr (GDir) dir = NULL;
+  guint n_entries = 0;
+
+  dir = g_dir_open (directory, 0, NULL);
+  g_assert_nonnull (dir);
+  while (g_dir_read_name (dir) != NULL)
+    n_entries++;
+
+  return n_entries;
+}
+
+static void
+test_mock_cache (MockFixture   *fixture,
+                 gconstpointer  user_data)
+{
+  RotatingAuthorizer *authorizer;
+  g_autoptr (GFBGraphCache) cache = NULL;
+  g_autoptr (GError) error = NULL;
+  g_autofree gchar *directory = NULL;
+  g_autofree gchar *old_entry = NULL;
+  g_autofree gchar *old_contents = NULL;
+  struct utimbuf old_time;
+  GFBGraphUser *me;
+  guint n_requests;
+
+  directory = g_dir_make_tmp ("gfbgraph-cache-XXXXXX", &error);
+  g_assert_no_error (error);
+  cache = gfbgraph_cache_new (directory, &error);
+  g_assert_no_error (error);
+  gfbgraph_context_set_cache (fixture->context, cache);
+
+  /* The response stored after refreshing the token is keyed by the account */
+  authorizer = rotating_authorizer_new ("expired-token", "mock-token");
+  gfbgraph_context_set_for_authorizer (fixture->context, GFBGRAPH_AUTHORIZER (authorizer));
+  me = gfbgraph_user_get_me (GFBGRAPH_AUTHORIZER (authorizer), &error);
+  g_assert_no_error (error);
+  g_assert_cmpint (authorizer->n_refreshes, ==, 1);
+  g_assert_cmpuint (count_cache_entries (directory), ==, 1);
+  g_clear_object (&me);
+
+  /* So it's revalidated with the ETag, even with another token */
+  gfbgraph_mock_server_set_access_token (fixture->server, "rotated-token");
+  g_free (authorizer->next_token);
+  authorizer->next_token = g_strdup ("rotated-token");
+  n_requests = gfbgraph_mock_server_get_n_requests (fixture->server);
+  me = gfbgraph_user_get_me (GFBGRAPH_AUTHORIZER (authorizer), &error);
+  g_assert_no_error (error);
+  g_assert_cmpint (authorizer->n_refreshes, ==, 2);
+  g_assert_cmpuint (gfbgraph_mock_server_get_n_requests (fixture->server), ==, n_requests + 2);
+  g_assert_cmpuint (gfbgraph_mock_server_get_n_not_modified (fixture->server), ==, 1);
+  g_assert_cmpstr (gfbgraph_user_get_email (me), ==, "mock.user@example.com");
+  g_clear_object (&me);
+
+  /* A changed node has a new ETag */
+  g_assert_true (gfbgraph_mock_server_update_node (fixture->server, fixture->me_id, "{\"email\":\"new@example.com\"}"));
+  me = gfbgraph_user_get_me (GFBGRAPH_AUTHORIZER (authorizer), &error);
+  g_assert_no_error (error);
+  g_assert_cmpuint (gfbgraph_mock_server_get_n_not_modified (fixture->server), ==, 1);
+  g_assert_cmpstr (gfbgraph_user_get_email (me), ==, "new@example.com");
+  g_clear_object (&me);
+
+  me = gfbgraph_user_get_me (GFBGRAPH_AUTHORIZER (authorizer), &error);
+  g_assert_no_error (error);
+  g_assert_cmpuint (gfbgraph_mock_server_get_n_not_modified (fixture->server), ==, 2);
+  g_assert_cmpstr (gfbgraph_user_get_email (me), ==, "new@example.com");
+  g_clear_object (&me);
+
+  /* Over the maximum size the entries are removed */
+  gfbgraph_cache_set_max_size (cache, 1);
+  g_assert_true (gfbgraph_mock_server_update_node (fixture->server, fixture->me_id, "{\"email\":\"other@example.com\"}"));
+  me = gfbgraph_user_get_me (GFBGRAPH_AUTHORIZER (authorizer), &error);
+  g_assert_no_error (error);
+  g_assert_cmpuint (count_cache_entries (directory), ==, 0);
+  g_clear_object (&me);
+
+  /* The entries already in the directory are counted when the cache is
+   * created, and the one used the longest time ago is removed first */
+  old_entry = g_build_filename (directory, "old.entry", NULL);
+  old_contents = g_strnfill (4000, 'x');
+  g_assert_true (g_file_set_contents (old_entry, old_contents, -1, &error));
+  g_assert_no_error (error);
+  old_time.actime = old_time.modtime = 1;
+  g_assert_cmpint (g_utime (old_entry, &old_time), ==, 0);
+
+  g_clear_object (&cache);
+  cache = gfbgraph_cache_new (directory, &error);
+  g_assert_no_error (error);
+  gfbgraph_cache_set_max_size (cache, 4096);
+  gfbgraph_context_set_cache (fixture->context, cache);
+  me = gfbgraph_user_get_me (GFBGRAPH_AUTHORIZER (authorizer), &error);
+  g_assert_no_error (error);
+  g_assert_false (g_file_test (old_entry, G_FILE_TEST_EXISTS));
+  g_assert_cmpuint (count_cache_entries (directory), ==, 1);
+  g_clear_object (&me);
+
+  g_assert_true (gfbgraph_cache_clear (cache, &error));
+  g_assert_no_error (error);
+  g_object_unref (authorizer);
+  g_assert_cmpint (g_rmdir (directory), ==, 0);
+}
+
+static void
+test_mock_identity_map (MockFixture   *fixture,
+                        gconstpointer  user_data)
+{
+  g_autoptr (GFBGraphIdentityMap) map = NULL;
+  g_autoptr (GFBGraphFieldSet) name_fields = NULL;
+  g_autoptr (GFBGraphFieldSet) images_fields = NULL;
+  g_autoptr (GError) error = NULL;
+  g_auto (GStrv) album_ids = NULL;
+  g_auto (GStrv) photo_ids = NULL;
+  GFBGraphAuthorizer *other;
+  GFBGraphNode *photo, *other_photo, *node;
+  guint n_requests;
+
+  map = gfbgraph_identity_map_new (100, 300);
+  gfbgraph_context_set_identity_map (fixture->context, map);
+  other = GFBGRAPH_AUTHORIZER (gfbgraph_simple_authorizer_new ("mock-token"));
+  gfbgraph_context_set_for_authorizer (fixture->context, other);
+
+  album_ids = gfbgraph_mock_server_get_connection (fixture->server, fixture->me_id, "albums");
+  photo_ids = gfbgraph_mock_server_get_connection (fixture->server, album_ids[0], "photos");
+  name_fields = gfbgraph_field_set_new ("id", "name", NULL);
+  images_fields = gfbgraph_field_set_new ("id", "images", NULL);
+
+  n_requests = gfbgraph_mock_server_get_n_requests (fixture->server);
+  photo = gfbgraph_node_new_from_id_with_fields (fixture->authorizer, photo_ids[0],
+                                                 GFBGRAPH_TYPE_PHOTO, name_fields, &error);
+  g_assert_no_error (error);
+
+  /* Another authorizer never gets the node of the first one */
+  other_photo = gfbgraph_node_new_from_id_with_fields (other, photo_ids[0],
+                                                       GFBGRAPH_TYPE_PHOTO, name_fields, &error);
+  g_assert_no_error (error);
+  g_assert_true (other_photo != photo);
+  g_assert_cmpuint (gfbgraph_mock_server_get_n_requests (fixture->server), ==, n_requests + 2);
+
+  /* While the same one gets it without a request */
+  node = gfbgraph_node_new_from_id_with_fields (fixture->authorizer, photo_ids[0],
+                                                GFBGRAPH_TYPE_PHOTO, name_fields, &error);
+  g_assert_no_error (error);
+  g_assert_true (node == photo);
+  g_assert_cmpuint (gfbgraph_mock_server_get_n_requests (fixture->server), ==, n_requests + 2);
+  g_object_unref (node);
+
+  node = gfbgraph_identity_map_lookup (map, other, photo_ids[0]);
+  g_assert_true (node == other_photo);
+  g_object_unref (node);
+  g_assert_null (gfbgraph_identity_map_lookup (map, NULL, photo_ids[0]));
+
+  /* Other fields are merged into the same instance, images included */
+  node = gfbgraph_node_new_from_id_with_fields (fixture->authorizer, photo_ids[0],
+                                                GFBGRAPH_TYPE_PHOTO, images_fields, &error);
+  g_assert_no_error (error);
+  g_assert_true (node == photo);
+  g_assert_nonnull (gfbgraph_photo_get_name (GFBGRAPH_PHOTO (photo)));
+  g_assert_cmpuint (g_list_length (gfbgraph_photo_get_images (GFBGRAPH_PHOTO (photo))), ==, 3);
+  g_object_unref (node);
+
+  /* The nodes of a finalized authorizer are dropped */
+  g_assert_cmpuint (gfbgraph_identity_map_get_size (map), ==, 2);
+  g_clear_object (&other);
+  g_assert_cmpuint (gfbgraph_identity_map_get_size (map), ==, 1);
+
+  g_object_unref (other_photo);
+  g_object_unref (photo);
+}
+
+static void
+test_mock_single_flight (MockFixture   *fixture,
+                         gconstpointer  user_data)
+{
+  GFBGraphUser *me[3] = { NULL, };
+  g_autoptr (GCancellable) cancellable = NULL;
+  gboolean cancelled = FALSE;
+  guint n_requests, i;
+
+  gfbgraph_mock_server_set_latency (fixture->server, 50, 50);
+  n_requests = gfbgraph_mock_server_get_n_requests (fixture->server);
+
+  /* The identical requests in progress are sent once, and a caller cancelling
+   * doesn't cancel the request of the other ones */
+  cancellable = g_cancellable_new ();
+  for (i = 0; i < G_N_ELEMENTS (me); i++)
+    gfbgraph_user_get_me_async (fixture->authorizer, NULL, get_me_cb, &me[i]);
+  gfbgraph_user_get_me_async (fixture->authorizer, cancellable, get_me_cancelled_cb, &cancelled);
+  g_cancellable_cancel (cancellable);
+
+  while (me[0] == NULL || me[1] == NULL || me[2] == NULL || !cancelled)
+    g_main_context_iteration (NULL, TRUE);
+
+  g_assert_cmpuint (gfbgraph_mock_server_get_n_requests (fixture->server), ==, n_requests + 1);
+  g_assert_true (me[0] == me[1]);
+  g_assert_true (me[0] == me[2]);
+
+  for (i = 0; i < G_N_ELEMENTS (me); i++)
+    g_object_unref (me[i]);
+}
+
+static void
+test_mock_single_flight_cancel (MockFixture   *fixture,
+                                gconstpointer  user_data)
+{
+  GFBGraphUser *me[2] = { NULL, };
+  g_autoptr (GFBGraphUser) again = NULL;
+  g_autoptr (GCancellable) cancellable = NULL;
+  g_autoptr (GError) error = NULL;
+  gboolean cancelled = FALSE;
+  guint n_requests, i;
+  gint64 start;
+
+  gfbgraph_mock_server_set_latency (fixture->server, 1000, 1000);
+  n_requests = gfbgraph_mock_server_get_n_requests (fixture->server);
+
+  /* A waiter cancelled while the request is pending returns at once, and
+   * the other ones still get the response */
+  cancellable = g_cancellable_new ();
+  for (i = 0; i < G_N_ELEMENTS (me); i++)
+    gfbgraph_user_get_me_async (fixture->authorizer, NULL, get_me_cb, &me[i]);
+  gfbgraph_user_get_me_async (fixture->authorizer, cancellable, get_me_cancelled_cb, &cancelled);
+  g_timeout_add (50, cancel_cb, cancellable);
+  start = g_get_monotonic_time ();
+  while (!cancelled)
+    g_main_context_iteration (NULL, TRUE);
+  g_assert_cmpint (g_get_monotonic_time () - start, <, 500 * G_TIME_SPAN_MILLISECOND);
+  g_assert_null (me[0]);
+  g_assert_null (me[1]);
+
+  while (me[0] == NULL || me[1] == NULL)
+    g_main_context_iteration (NULL, TRUE);
+  g_assert_cmpuint (gfbgraph_mock_server_get_n_requests (fixture->server), ==, n_requests + 1);
+  g_assert_true (me[0] == me[1]);
+
+  for (i = 0; i < G_N_ELEMENTS (me); i++)
+    g_object_unref (me[i]);
+
+  /* The request of a flight whose every waiter cancelled is cancelled, and
+   * the next identical call doesn't join it */
+  g_clear_object (&cancellable);
+  cancellable = g_cancellable_new ();
+  cancelled = FALSE;
+  gfbgraph_user_get_me_async (fixture->authorizer, cancellable, get_me_cancelled_cb, &cancelled);
+  g_timeout_add (50, cancel_cb, cancellable);
+  start = g_get_monotonic_time ();
+  while (!cancelled)
+    g_main_context_iteration (NULL, TRUE);
+  g_assert_cmpint (g_get_monotonic_time () - start, <, 500 * G_TIME_SPAN_MILLISECOND);
+
+  gfbgraph_mock_server_set_latency (fixture->server, 0, 0);
+  again = gfbgraph_user_get_me (fixture->authorizer, &error);
+  g_assert_no_error (error);
+  g_assert_nonnull (again);
+}
+
+static void
+new_from_ids_cb (GObject      *source_object,
+                 GAsyncResult *result,
+                 gpointer      user_data)
+{
+  GHashTable **nodes = user_data;
+  g_autoptr (GError) error = NULL;
+
+  *nodes = gfbgraph_node_new_from_ids_async_finish (GFBGRAPH_AUTHORIZER (source_object),
+                                                    result, NULL, &error);
+  g_assert_no_error (error);
+}
+
+static void
+test_mock_scheduler (MockFixture   *fixture,
+                     gconstpointer  user_data)
+{
+  GFBGraphScheduler *scheduler;
+  g_autoptr (GHashTable) photos = NULL;
+  g_autoptr (GFBGraphUser) me = NULL;
+  g_autoptr (GError) error = NULL;
+  g_auto (GStrv) album_ids = NULL;
+  g_auto (GStrv) photo_ids = NULL;
+
+  scheduler = gfbgraph_context_get_scheduler (fixture->context);
+  gfbgraph_scheduler_set_max_in_flight_per_authorizer (scheduler, 2);
+  gfbgraph_scheduler_set_max_rate_per_authorizer (scheduler, 100);
+  gfbgraph_mock_server_set_latency (fixture->server, 20, 20);
+
+  album_ids = gfbgraph_mock_server_get_connection (fixture->server, fixture->me_id, "albums");
+  photo_ids = gfbgraph_mock_server_get_connection (fixture->server, album_ids[0], "photos");
+
+  /* Every batch of one node is a request, only two of them at the same time */
+  gfbgraph_node_new_from_ids_async (fixture->authorizer,
+                                    (const gchar * const *) photo_ids,
+                                    GFBGRAPH_TYPE_PHOTO,
+                                    NULL,
+                                    1,
+                                    NULL,
+                                    new_from_ids_cb,
+                                    &photos);
+  while (photos == NULL)
+    g_main_context_iteration (NULL, TRUE);
+
+  g_assert_cmpuint (g_hash_table_size (photos), ==, N_PHOTOS);
+  g_assert_cmpuint (gfbgraph_mock_server_get_max_in_progress (fixture->server), ==, 2);
+  g_assert_cmpuint (gfbgraph_scheduler_get_in_flight (scheduler), ==, 0);
+  g_clear_pointer (&photos, g_hash_table_unref);
+
+  /* The asynchronous requests holding the slots need this main context to
+   * finish, so a synchronous request from it doesn't wait for them */
+  gfbgraph_node_new_from_ids_async (fixture->authorizer,
+                                    (const gchar * const *) photo_ids,
+                                    GFBGRAPH_TYPE_PHOTO,
+                                    NULL,
+                                    1,
+                                    NULL,
+                                    new_from_ids_cb,
+                                    &photos);
+  me = gfbgraph_user_get_me (fixture->authorizer, &error);
+  g_assert_no_error (error);
+  g_assert_true (GFBGRAPH_IS_USER (me));
+
+  while (photos == NULL)
+    g_main_context_iteration (NULL, TRUE);
+
+  g_assert_cmpuint (g_hash_table_size (photos), ==, N_PHOTOS);
+  g_assert_cmpuint (gfbgraph_scheduler_get_in_flight (scheduler), ==, 0);
+}
+
+static void
+test_mock_scheduler_usage (MockFixture   *fixture,
+                           gconstpointer  user_data)
+{
+  GFBGraphScheduler *scheduler;
+  g_autoptr (GError) error = NULL;
+  gint64 start;
+  guint i;
+
+  /* A burst of two requests, then one every half second at full speed */
+  scheduler = gfbgraph_context_get_scheduler (fixture->context);
+  gfbgraph_scheduler_set_max_rate (scheduler, 2);
+
+  /* 95% of the quota used slows down to a fifth of the rate */
+  gfbgraph_mock_server_set_app_usage (fixture->server, 95);
+  for (i = 0; i < 2; i++) {
+    g_autoptr (GFBGraphUser) me = NULL;
+
+    me = gfbgraph_user_get_me (fixture->authorizer, &error);
+    g_assert_no_error (error);
+  }
+
+  start = g_get_monotonic_time ();
+  g_object_unref (gfbgraph_user_get_me (fixture->authorizer, &error));
+  g_assert_no_error (error);
+  g_assert_cmpint (g_get_monotonic_time () - start, >=, 3 * G_USEC_PER_SEC / 2);
+}
+
+static void
+count_change (const GFBGraphSyncChange *change,
+              gpointer                  user_data)
+{
+  guint *counts = user_data;
+
+  counts[change->type]++;
+  if (change->type != GFBGRAPH_SYNC_CHANGE_REMOVED)
+    g_assert_true (GFBGRAPH_IS_NODE (change->node));
+}
+
+static void
+run_sync (GFBGraphSync *sync,
+          guint         added,
+          guint         updated,
+          guint         removed)
+{
+  g_autoptr (GError) error = NULL;
+  guint counts[3] = { 0, };
+
+  g_assert_true (gfbgraph_sync_run (sync, count_change, counts, NULL, &error));
+  g_assert_no_error (error);
+
+  g_assert_cmpuint (counts[GFBGRAPH_SYNC_CHANGE_ADDED], ==, added);
+  g_assert_cmpuint (counts[GFBGRAPH_SYNC_CHANGE_UPDATED], ==, updated);
+  g_assert_cmpuint (counts[GFBGRAPH_SYNC_CHANGE_REMOVED], ==, removed);
+}
+
+static void
+sync_run_cb (GObject      *source_object,
+             GAsyncResult *result,
+             gpointer      user_data)
+{
+  GAsyncResult **result_out = user_data;
+
+  *result_out = g_object_ref (result);
+}
+
+static void
+test_mock_sync_error (MockFixture   *fixture,
+                      gconstpointer  user_data)
+{
+  g_autoptr (GFBGraphUser) me = NULL;
+  g_autoptr (GFBGraphSync) sync = NULL;
+  g_autoptr (GAsyncResult) result = NULL;
+  g_autoptr (GPtrArray) changes = NULL;
+  g_autoptr (GError) error = NULL;
+  g_auto (GStrv) album_ids = NULL;
+  g_autofree gchar *first_photo_id = NULL;
+  g_autofree gchar *second_photo_id = NULL;
+  guint counts[3] = { 0, };
+
+  me = gfbgraph_user_get_me (fixture->authorizer, &error);
+  g_assert_no_error (error);
+  sync = gfbgraph_sync_new (me, fixture->authorizer);
+  run_sync (sync, N_ALBUMS + N_ALBUMS * N_PHOTOS, 0, 0);
+
+  /* A photo added to two albums. The listing of the photos of the second one
+   * fails, after the list of albums and the listing and retrieval of the first. */
+  album_ids = gfbgraph_mock_server_get_connection (fixture->server, fixture->me_id, "albums");
+  first_photo_id = gfbgraph_mock_server_add_node (fixture->server, album_ids[1], "photos", NULL);
+  second_photo_id = gfbgraph_mock_server_add_node (fixture->server, album_ids[3], "photos", NULL);
+
+  /* The async sync returns nothing on error, so nothing is committed */
+  gfbgraph_mock_server_fail_after (fixture->server, 3, 1, 400, 100);
+  gfbgraph_sync_run_async (sync, NULL, sync_run_cb, &result);
+  while (result == NULL)
+    g_main_context_iteration (NULL, TRUE);
+  changes = gfbgraph_sync_run_async_finish (sync, result, &error);
+  g_assert_nonnull (error);
+  g_assert_null (changes);
+  g_clear_error (&error);
+  g_clear_object (&result);
+
+  /* The sync one reports the changes of the first album before failing, so
+   * that album is committed */
+  gfbgraph_mock_server_fail_after (fixture->server, 3, 1, 400, 100);
+  g_assert_false (gfbgraph_sync_run (sync, count_change, counts, NULL, &error));
+  g_assert_nonnull (error);
+  g_clear_error (&error);
+  g_assert_cmpuint (counts[GFBGRAPH_SYNC_CHANGE_ADDED], ==, 1);
+  g_assert_cmpuint (counts[GFBGRAPH_SYNC_CHANGE_UPDATED], ==, 1);
+  g_assert_cmpuint (counts[GFBGRAPH_SYNC_CHANGE_REMOVED], ==, 0);
+
+  /* Only the second album is left */
+  gfbgraph_sync_run_async (sync, NULL, sync_run_cb, &result);
+  while (result == NULL)
+    g_main_context_iteration (NULL, TRUE);
+  changes = gfbgraph_sync_run_async_finish (sync, result, &error);
+  g_assert_no_error (error);
+  g_assert_cmpuint (changes->len, ==, 2);
+  g_assert_cmpstr (((GFBGraphSyncChange *) g_ptr_array_index (changes, 0))->id, ==, album_ids[3]);
+  g_assert_cmpstr (((GFBGraphSyncChange *) g_ptr_array_index (changes, 1))->id, ==, second_photo_id);
+
+  run_sync (sync, 0, 0, 0);
+}
+
+typedef struct {
+  GFBGraphMockServer *server;
+  goffset             change_at;  /* Offset where the images change, or -1 */
+  GCancellable       *cancellable;
+  goffset             cancel_at;  /* Offset where @cancellable is cancelled, or 0 */
+  goffset             size;
+  GError             *error;
+  gboolean            done;
+} DownloadData;
+
+static void
+download_progress_cb (goffset  current_num_bytes,
+                      goffset  total_num_bytes,
+                      gpointer user_data)
+{
+  DownloadData *data = user_data;
+
+  if (data->change_at >= 0 && current_num_bytes >= data->change_at) {
+    gfbgraph_mock_server_set_image_version (data->server, 1);
+    data->change_at = -1;
+  }
+  if (data->cancel_at > 0 && current_num_bytes >= data->cancel_at) {
+    g_cancellable_cancel (data->cancellable);
+    data->cancel_at = 0;
+  }
+}
+
+static void
+download_cb (GObject      *source_object,
+             GAsyncResult *result,
+             gpointer      user_data)
+{
+  DownloadData *data = user_data;
+
+  data->size = gfbgraph_downloader_download_finish (GFBGRAPH_DOWNLOADER (source_object),
+                                                    result, &data->error);
+  data->done = TRUE;
+}
+
+static void
+download_file (GFBGraphDownloader *downloader,
+               const gchar        *uri,
+               GFile              *file,
+               DownloadData       *data)
+{
+  data->done = FALSE;
+  gfbgraph_downloader_download_to_file_async (downloader, uri, file, data->cancellable,
+                                              download_progress_cb, data,
+                                              download_cb, data);
+  while (!data->done)
+    g_main_context_iteration (NULL, TRUE);
+}
+
+/* Checks that @file is a whole image, all made of @byte */
+static void
+assert_image_file (GFile  *file,
+                   guchar  byte)
+{
+  g_autofree gchar *contents = NULL;
+  gsize length, i;
+
+  g_assert_true (g_file_load_contents (file, NULL, &contents, &length, NULL, NULL));
+  g_assert_cmpuint (length, ==, GFBGRAPH_MOCK_SERVER_IMAGE_SIZE);
+  for (i = 0; i < length && (guchar) contents[i] == byte; i++);
+  g_assert_cmpuint (i, ==, length);
+}
+
+static void
+test_mock_download (MockFixture   *fixture,
+                    gconstpointer  user_data)
+{
+  g_autoptr (GFBGraphDownloader) downloader = NULL;
+  g_autoptr (GFile) file = NULL;
+  g_autoptr (GError) error = NULL;
+  g_autofree gchar *dir = NULL;
+  g_autofree gchar *path = NULL;
+  g_autofree gchar *uri = NULL;
+  DownloadData data = { fixture->server, -1, };
+  gchar partial[1000];
+  guint n_requests;
+
+  dir = g_dir_make_tmp ("gfbgraph-download-XXXXXX", &error);
+  g_assert_no_error (error);
+  path = g_build_filename (dir, "image.jpg", NULL);
+  file = g_file_new_for_path (path);
+  uri = g_strdup_printf ("%s/images/photo.jpg", gfbgraph_mock_server_get_endpoint (fixture->server));
+  downloader = gfbgraph_downloader_new (fixture->context, 2);
+
+  /* A partial file without the validator of a previous download can't be
+   * checked, so it's downloaded again from the start */
+  memset (partial, 0, sizeof (partial));
+  g_assert_true (g_file_set_contents (path, partial, sizeof (partial), &error));
+  n_requests = gfbgraph_mock_server_get_n_requests (fixture->server);
+  download_file (downloader, uri, file, &data);
+  g_assert_no_error (data.error);
+  g_assert_cmpint (data.size, ==, GFBGRAPH_MOCK_SERVER_IMAGE_SIZE);
+  g_assert_cmpuint (gfbgraph_mock_server_get_n_requests (fixture->server), ==, n_requests + 1);
+  assert_image_file (file, 0xAB);
+
+  /* A download cancelled after the first chunk leaves a partial file with
+   * its validator, which is completed with a range request later */
+  g_assert_true (g_file_delete (file, NULL, &error));
+  gfbgraph_mock_server_interrupt_next_image (fixture->server, sizeof (partial));
+  data.cancellable = g_cancellable_new ();
+  data.cancel_at = 1;
+  download_file (downloader, uri, file, &data);
+  g_assert_error (data.error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+  g_clear_error (&data.error);
+  g_clear_object (&data.cancellable);
+  g_assert_cmpuint (gfbgraph_mock_server_get_n_requests (fixture->server), ==, n_requests + 2);
+
+  download_file (downloader, uri, file, &data);
+  g_assert_no_error (data.error);
+  g_assert_cmpint (data.size, ==, GFBGRAPH_MOCK_SERVER_IMAGE_SIZE);
+  g_assert_cmpuint (gfbgraph_mock_server_get_n_requests (fixture->server), ==, n_requests + 3);
+  assert_image_file (file, 0xAB);
+
+  /* The same, cancelled once the whole image is written: the validator is
+   * still there, so the complete file gets a 416 and is left as it is */
+  g_assert_true (g_file_delete (file, NULL, &error));
+  data.cancellable = g_cancellable_new ();
+  data.cancel_at = GFBGRAPH_MOCK_SERVER_IMAGE_SIZE;
+  download_file (downloader, uri, file, &data);
+  g_assert_error (data.error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+  g_clear_error (&data.error);
+  g_clear_object (&data.cancellable);
+
+  download_file (downloader, uri, file, &data);
+  g_assert_no_error (data.error);
+  g_assert_cmpint (data.size, ==, GFBGRAPH_MOCK_SERVER_IMAGE_SIZE);
+  g_assert_cmpuint (gfbgraph_mock_server_get_n_requests (fixture->server), ==, n_requests + 5);
+  assert_image_file (file, 0xAB);
+
+  /* An interrupted download is resumed from the last written byte */
+  g_assert_true (g_file_delete (file, NULL, &error));
+  gfbgraph_mock_server_interrupt_next_image (fixture->server, sizeof (partial));
+  download_file (downloader, uri, file, &data);
+  g_assert_no_error (data.error);
+  g_assert_cmpint (data.size, ==, GFBGRAPH_MOCK_SERVER_IMAGE_SIZE);
+  g_assert_cmpuint (gfbgraph_mock_server_get_n_requests (fixture->server), ==, n_requests + 7);
+  assert_image_file (file, 0xAB);
+
+  /* Unless the image changed meanwhile: the If-Range doesn't match its new
+   * ETag, so the whole image is sent and the file is written again instead of
+   * mixing both versions */
+  g_assert_true (g_file_delete (file, NULL, &error));
+  gfbgraph_mock_server_interrupt_next_image (fixture->server, sizeof (partial));
+  data.change_at = 1;
+  download_file (downloader, uri, file, &data);
+  g_assert_no_error (data.error);
+  g_assert_cmpint (data.size, ==, GFBGRAPH_MOCK_SERVER_IMAGE_SIZE);
+  g_assert_cmpuint (gfbgraph_mock_server_get_n_requests (fixture->server), ==, n_requests + 9);
+  assert_image_file (file, 0xAB + 1);
+
+  g_assert_true (g_file_delete (file, NULL, &error));
+  g_assert_cmpint (g_rmdir (dir), ==, 0);
+}
+
+static void
+test_mock_download_cancel (MockFixture   *fixture,
+                           gconstpointer  user_data)
+{
+  g_autoptr (GFBGraphDownloader) downloader = NULL;
+  g_autoptr (GOutputStream) stream = NULL;
+  g_autoptr (GOutputStream) cancelled_stream = NULL;
+  g_autoptr (GCancellable) cancellable = NULL;
+  g_autofree gchar *uri = NULL;
+  DownloadData data[2] = { { fixture->server, -1, }, { fixture->server, -1, } };
+
+  gfbgraph_mock_server_set_latency (fixture->server, 100, 100);
+  uri = g_strdup_printf ("%s/images/photo.jpg", gfbgraph_mock_server_get_endpoint (fixture->server));
+  downloader = gfbgraph_downloader_new (fixture->context, 1);
+  stream = g_memory_output_stream_new_resizable ();
+  cancelled_stream = g_memory_output_stream_new_resizable ();
+
+  /* A download waiting for a slot returns as soon as it's cancelled, without
+   * waiting for the one in progress */
+  cancellable = g_cancellable_new ();
+  gfbgraph_downloader_download_to_stream_async (downloader, uri, stream, 0, NULL,
+                                                NULL, NULL, download_cb, &data[0]);
+  gfbgraph_downloader_download_to_stream_async (downloader, uri, cancelled_stream, 0, cancellable,
+                                                NULL, NULL, download_cb, &data[1]);
+  g_cancellable_cancel (cancellable);
+
+  while (!data[1].done)
+    g_main_context_iteration (NULL, TRUE);
+  g_assert_error (data[1].error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+  g_assert_cmpint (data[1].size, ==, -1);
+  g_assert_false (data[0].done);
+  g_clear_error (&data[1].error);
+
+  while (!data[0].done)
+    g_main_context_iteration (NULL, TRUE);
+  g_assert_no_error (data[0].error);
+  g_assert_cmpint (data[0].size, ==, GFBGRAPH_MOCK_SERVER_IMAGE_SIZE);
+  g_assert_cmpuint (g_memory_output_stream_get_data_size (G_MEMORY_OUTPUT_STREAM (stream)),
+                    ==, GFBGRAPH_MOCK_SERVER_IMAGE_SIZE);
+  g_assert_cmpuint (g_memory_output_stream_get_data_size (G_MEMORY_OUTPUT_STREAM (cancelled_stream)), ==, 0);
+}
+
+static void
+test_mock_sync (MockFixture   *fixture,
+                gconstpointer  user_data)
+{
+  g_autoptr (GFBGraphUser) me = NULL;
+  g_autoptr (GFBGraphSync) sync = NULL;
+  g_autoptr (GFBGraphSync) restored = NULL;
+  g_autoptr (GError) error = NULL;
+  g_autofree gchar *state = NULL;
+  g_autofree gchar *photo_id = NULL;
+  g_auto (GStrv) album_ids = NULL;
+  g_auto (GStrv) photo_ids = NULL;
+
+  me = gfbgraph_user_get_me (fixture->authorizer, &error);
+  g_assert_no_error (error);
+  sync = gfbgraph_sync_new (me, fixture->authorizer);
+
+  run_sync (sync, N_ALBUMS + N_ALBUMS * N_PHOTOS, 0, 0);
+  run_sync (sync, 0, 0, 0);
+
+  /* One photo updated, one added and one removed in the same album */
+  album_ids = gfbgraph_mock_server_get_connection (fixture->server, fixture->me_id, "albums");
+  photo_ids = gfbgraph_mock_server_get_connection (fixture->server, album_ids[1], "photos");
+  g_assert_true (gfbgraph_mock_server_update_node (fixture->server, photo_ids[0], "{\"name\":\"Renamed\"}"));
+  g_assert_true (gfbgraph_mock_server_remove_node (fixture->server, photo_ids[1]));
+  photo_id = gfbgraph_mock_server_add_node (fixture->server, album_ids[1], "photos", NULL);
+  run_sync (sync, 1, 2, 1);
+
+  /* A removed album reports its photos too */
+  g_assert_true (gfbgraph_mock_server_remove_node (fixture->server, album_ids[2]));
+  run_sync (sync, 0, 0, N_PHOTOS + 1);
+
+  state = gfbgraph_sync_save_state (sync);
+  restored = gfbgraph_sync_new (me, fixture->authorizer);
+  g_assert_true (gfbgraph_sync_load_state (restored, state, &error));
+  g_assert_no_error (error);
+  run_sync (restored, 0, 0, 0);
+}
+
+/* A GOA account exported on a private bus by a thread of its own, so the
+ * synchronous D-Bus calls of the authorizer can be answered while the test
+ * blocks. The refreshes are answered at once, or held until released. */
+#define MOCK_GOA_PATH   "/org/gnome/OnlineAccounts"
+#define MOCK_GOA_OBJECT "/org/gnome/OnlineAccounts/Accounts/mock"
+
+/* REFRESH_MARGIN of gfbgraph-goa-authorizer.c */
+#define MOCK_GOA_REFRESH_MARGIN 60
+
+typedef struct {
+  GTestDBus                *bus;
+  GDBusConnection          *connection;
+  GDBusObjectManager       *client;
+  GoaObject                *object;
+
+  GThread                  *thread;
+  GMainContext             *context;
+  GMainLoop                *loop;
+  GoaOAuth2Based           *oauth2_based;
+
+  GMutex                    mutex;
+  GCond                     cond;
+  gboolean                  ready;
+  gboolean                  hold;
+  gint                      expires_in;
+  guint                     n_refreshes;
+  GQueue                    invocations;  /* The held refreshes */
+} MockGoa;
+
+static gboolean
+mock_goa_ensure_credentials_cb (GoaAccount            *account,
+                                GDBusMethodInvocation *invocation,
+                                gpointer               user_data)
+{
+  goa_account_complete_ensure_credentials (account, invocation, 0);
+
+  return TRUE;
+}
+
+/* Must be called with the mutex locked */
+static void
+mock_goa_complete_locked (MockGoa               *goa,
+                          GDBusMethodInvocation *invocation)
+{
+  g_autofree gchar *token = NULL;
+
+  token = g_strdup_printf ("goa-token-%u", goa->n_refreshes);
+  goa_oauth2_based_complete_get_access_token (goa->oauth2_based, invocation, token, goa->expires_in);
+}
+
+static gboolean
+mock_goa_get_access_token_cb (GoaOAuth2Based        *oauth2_based,
+                              GDBusMethodInvocation *invocation,
+                              gpointer               user_data)
+{
+  MockGoa *goa = user_data;
+
+  g_mutex_lock (&goa->mutex);
+  goa->n_refreshes++;
+  if (goa->hold)
+    g_queue_push_tail (&goa->invocations, g_object_ref (invocation));
+  else
+    mock_goa_complete_locked (goa, invocation);
+  g_cond_broadcast (&goa->cond);
+  g_mutex_unlock (&goa->mutex);
+
+  return TRUE;
+}
+
+static gpointer
+mock_goa_thread (gpointer user_data)
+{
+  MockGoa *goa = user_data;
+  GDBusObjectManagerServer *manager;
+  GoaObjectSkeleton *object;
+  GoaAccount *account;
+
+  g_main_context_push_thread_default (goa->context);
+
+  account = goa_account_skeleton_new ();
+  goa_account_set_id (account, "mock-account");
+  goa_account_set_provider_type (account, "facebook");
+  g_signal_connect (account, "handle-ensure-credentials", G_CALLBACK (mock_goa_ensure_credentials_cb), goa);
+
+  goa->oauth2_based = goa_oauth2_based_skeleton_new ();
+  g_signal_connect (goa->oauth2_based, "handle-get-access-token", G_CALLBACK (mock_goa_get_access_token_cb), goa);
+
+  object = goa_object_skeleton_new (MOCK_GOA_OBJECT);
+  goa_object_skeleton_set_account (object, account);
+  goa_object_skeleton_set_oauth2_based (object, goa->oauth2_based);
+
+  manager = g_dbus_object_manager_server_new (MOCK_GOA_PATH);
+  g_dbus_object_manager_server_export (manager, G_DBUS_OBJECT_SKELETON (object));
+  g_dbus_object_manager_server_set_connection (manager, goa->connection);
+
+  g_mutex_lock (&goa->mutex);
+  goa->ready = TRUE;
+  g_cond_broadcast (&goa->cond);
+  g_mutex_unlock (&goa->mutex);
+
+  g_main_loop_run (goa->loop);
+
+  g_dbus_object_manager_server_set_connection (manager, NULL);
+  g_object_unref (manager);
+  g_object_unref (object);
+  g_object_unref (account);
+  g_clear_object (&goa->oauth2_based);
+  g_main_context_pop_thread_default (goa->context);
+
+  return NULL;
+}
+
+/* Returns %NULL, skipping the test, if there is no D-Bus daemon to run */
+static MockGoa *
+mock_goa_new (void)
+{
+  g_autofree gchar *daemon = NULL;
+  g_autoptr (GError) error = NULL;
+  g_autoptr (GDBusObject) object = NULL;
+  MockGoa *goa;
+
+  daemon = g_find_program_in_path ("dbus-daemon");
+  if (daemon == NULL) {
+    g_test_skip ("No dbus-daemon to export the mock GOA account");
+    return NULL;
+  }
+
+  goa = g_new0 (MockGoa, 1);
+  g_mutex_init (&goa->mutex);
+  g_cond_init (&goa->cond);
+  g_queue_init (&goa->invocations);
+  goa->expires_in = 3600;
+
+  goa->bus = g_test_dbus_new (G_TEST_DBUS_NONE);
+  g_test_dbus_up (goa->bus);
+  goa->connection = g_dbus_connection_new_for_address_sync (g_test_dbus_get_bus_address (goa->bus),
+                                                            G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT
+                                                            | G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION,
+                                                            NULL, NULL, &error);
+  g_assert_no_error (error);
+
+  goa->context = g_main_context_new ();
+  goa->loop = g_main_loop_new (goa->context, FALSE);
+  goa->thread = g_thread_new ("mock-goa", mock_goa_thread, goa);
+
+  g_mutex_lock (&goa->mutex);
+  while (!goa->ready)
+    g_cond_wait (&goa->cond, &goa->mutex);
+  g_mutex_unlock (&goa->mutex);
+
+  goa->client = goa_object_manager_client_new_sync (goa->connection,
+                                                    G_DBUS_OBJECT_MANAGER_CLIENT_FLAGS_NONE,
+                                                    g_dbus_connection_get_unique_name (goa->connection),
+                                                    MOCK_GOA_PATH,
+                                                    NULL, &error);
+  g_assert_no_error (error);
+  object = g_dbus_object_manager_get_object (goa->client, MOCK_GOA_OBJECT);
+  g_assert_nonnull (object);
+  goa->object = GOA_OBJECT (g_steal_pointer (&object));
+
+  return goa;
+}
+
+static void
+mock_goa_free (MockGoa *goa)
+{
+  g_object_unref (goa->object);
+  g_object_unref (goa->client);
+
+  g_main_loop_quit (goa->loop);
+  g_thread_join (goa->thread);
+  g_main_loop_unref (goa->loop);
+  g_main_context_unref (goa->context);
+
+  g_queue_foreach (&goa->invocations, (GFunc) g_object_unref, NULL);
+  g_queue_clear (&goa->invocations);
+  g_dbus_connection_close_sync (goa->connection, NULL, NULL);
+  g_object_unref (goa->connection);
+  g_test_dbus_down (goa->bus);
+  g_object_unref (goa->bus);
+
+  g_mutex_clear (&goa->mutex);
+  g_cond_clear (&goa->cond);
+  g_free (goa);
+}
+
+static void
+mock_goa_set_hold (MockGoa  *goa,
+                   gboolean  hold,
+                   gint      expires_in)
+{
+  g_mutex_lock (&goa->mutex);
+  goa->hold = hold;
+  goa->expires_in = expires_in;
+  g_mutex_unlock (&goa->mutex);
+}
+
+/* Answers the held refreshes */
+static void
+mock_goa_release (MockGoa *goa)
+{
+  GDBusMethodInvocation *invocation;
+
+  g_mutex_lock (&goa->mutex);
+  while ((invocation = g_queue_pop_head (&goa->invocations)) != NULL) {
+    mock_goa_complete_locked (goa, invocation);
+    g_object_unref (invocation);
+  }
+  g_mutex_unlock (&goa->mutex);
+}
+
+static guint
+mock_goa_get_n_refreshes (MockGoa *goa)
+{
+  guint n_refreshes;
+
+  g_mutex_lock (&goa->mutex);
+  n_refreshes = goa->n_refreshes;
+  g_mutex_unlock (&goa->mutex);
+
+  return n_refreshes;
+}
+
+/* Iterates the main context of the test for @msec milliseconds */
+static void
+iterate_main_context (guint msec)
+{
+  gint64 end_time = g_get_monotonic_time () + msec * 1000;
+
+  while (g_get_monotonic_time () < end_time) {
+    while (g_main_context_iteration (NULL, FALSE))
+      ;
+    g_usleep (1000);
+  }
+}
+
+static void
+mock_goa_wait_refreshes (MockGoa *goa,
+                         guint    n_refreshes)
+{
+  while (mock_goa_get_n_refreshes (goa) < n_refreshes)
+    iterate_main_context (1);
+}
+
+/* The token added to the requests by @authorizer */
+static gchar *
+dup_call_token (GFBGraphAuthorizer *authorizer)
+{
+  RestProxy *proxy;
+  RestProxyCall *call;
+  RestParam *param;
+  gchar *token = NULL;
+
+  proxy = rest_proxy_new ("http://localhost/", FALSE);
+  call = rest_proxy_new_call (proxy);
+  gfbgraph_authorizer_process_call (authorizer, call);
+  param = rest_proxy_call_lookup_param (call, "access_token");
+  if (param != NULL)
+    token = g_strdup (rest_param_get_content (param));
+
+  g_object_unref (call);
+  g_object_unref (proxy);
+
+  return token;
+}
+
+typedef struct {
+  GFBGraphAuthorizer *authorizer;
+  gint               *n_started;
+  gboolean            done;
+  gboolean            success;
+  GError             *error;
+} RefreshCaller;
+
+static gpointer
+refresh_thread (gpointer user_data)
+{
+  RefreshCaller *caller = user_data;
+
+  g_atomic_int_inc (caller->n_started);
+  caller->success = gfbgraph_authorizer_refresh_authorization (caller->authorizer, NULL, &caller->error);
+
+  return NULL;
+}
+
+static void
+refresh_cb (GObject      *source_object,
+            GAsyncResult *result,
+            gpointer      user_data)
+{
+  RefreshCaller *caller = user_data;
+
+  caller->success = gfbgraph_authorizer_refresh_authorization_async_finish (GFBGRAPH_AUTHORIZER (source_object),
+                                                                            result, &caller->error);
+  caller->done = TRUE;
+}
+
+#define N_REFRESH_CALLERS 4
+
+static void
+test_mock_goa_refresh (void)
+{
+  MockGoa *goa;
+  g_autoptr (GFBGraphGoaAuthorizer) goa_authorizer = NULL;
+  g_autoptr (GCancellable) cancellable = NULL;
+  GFBGraphAuthorizer *authorizer;
+  RefreshCaller async_callers[N_REFRESH_CALLERS] = { { 0, }, };
+  RefreshCaller sync_callers[N_REFRESH_CALLERS] = { { 0, }, };
+  GThread *threads[N_REFRESH_CALLERS];
+  RefreshCaller leader = { 0, }, follower = { 0, };
+  gint n_started = 0;
+  gchar *token;
+  guint i;
+
+  goa = mock_goa_new ();
+  if (goa == NULL)
+    return;
+
+  goa_authorizer = gfbgraph_goa_authorizer_new (goa->object);
+  authorizer = GFBGRAPH_AUTHORIZER (goa_authorizer);
+
+  /* The synchronous and asynchronous callers asking while a refresh is in
+   * progress share it */
+  mock_goa_set_hold (goa, TRUE, 3600);
+  for (i = 0; i < N_REFRESH_CALLERS; i++)
+    gfbgraph_authorizer_refresh_authorization_async (authorizer, NULL, refresh_cb, &async_callers[i]);
+  mock_goa_wait_refreshes (goa, 1);
+  for (i = 0; i < N_REFRESH_CALLERS; i++) {
+    sync_callers[i].authorizer = authorizer;
+    sync_callers[i].n_started = &n_started;
+    threads[i] = g_thread_new ("refresh", refresh_thread, &sync_callers[i]);
+  }
+  while (g_atomic_int_get (&n_started) < N_REFRESH_CALLERS)
+    iterate_main_context (1);
+  iterate_main_context (100);
+
+  mock_goa_release (goa);
+  for (i = 0; i < N_REFRESH_CALLERS; i++) {
+    g_thread_join (threads[i]);
+    g_assert_no_error (sync_callers[i].error);
+    g_assert_true (sync_callers[i].success);
+
+    while (!async_callers[i].done)
+      g_main_context_iteration (NULL, TRUE);
+    g_assert_no_error (async_callers[i].error);
+    g_assert_true (async_callers[i].success);
+  }
+  g_assert_cmpuint (mock_goa_get_n_refreshes (goa), ==, 1);
+  token = dup_call_token (authorizer);
+  g_assert_cmpstr (token, ==, "goa-token-1");
+  g_free (token);
+
+  /* A cancelled caller returns at once, and the refresh goes on for the others */
+  cancellable = g_cancellable_new ();
+  gfbgraph_authorizer_refresh_authorization_async (authorizer, cancellable, refresh_cb, &leader);
+  gfbgraph_authorizer_refresh_authorization_async (authorizer, NULL, refresh_cb, &follower);
+  mock_goa_wait_refreshes (goa, 2);
+  g_cancellable_cancel (cancellable);
+  while (!leader.done)
+    g_main_context_iteration (NULL, TRUE);
+  g_assert_error (leader.error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+  g_clear_error (&leader.error);
+  g_assert_false (follower.done);
+
+  mock_goa_release (goa);
+  while (!follower.done)
+    g_main_context_iteration (NULL, TRUE);
+  g_assert_no_error (follower.error);
+  g_assert_true (follower.success);
+  g_assert_cmpuint (mock_goa_get_n_refreshes (goa), ==, 2);
+  token = dup_call_token (authorizer);
+  g_assert_cmpstr (token, ==, "goa-token-2");
+  g_free (token);
+
+  /* The requests don't refresh a token before its last minute */
+  mock_goa_set_hold (goa, FALSE, MOCK_GOA_REFRESH_MARGIN + 30);
+  g_assert_true (gfbgraph_authorizer_refresh_authorization (authorizer, NULL, NULL));
+  g_assert_cmpuint (mock_goa_get_n_refreshes (goa), ==, 3);
+  token = dup_call_token (authorizer);
+  g_assert_cmpstr (token, ==, "goa-token-3");
+  g_free (token);
+  iterate_main_context (100);
+  g_assert_cmpuint (mock_goa_get_n_refreshes (goa), ==, 3);
+
+  /* But the first one in the last minute refreshes it in the background,
+   * still using the current token */
+  mock_goa_set_hold (goa, FALSE, MOCK_GOA_REFRESH_MARGIN);
+  g_assert_true (gfbgraph_authorizer_refresh_authorization (authorizer, NULL, NULL));
+  g_assert_cmpuint (mock_goa_get_n_refreshes (goa), ==, 4);
+  mock_goa_set_hold (goa, FALSE, 3600);
+  token = dup_call_token (authorizer);
+  g_assert_cmpstr (token, ==, "goa-token-4");
+  g_free (token);
+  mock_goa_wait_refreshes (goa, 5);
+  for (;;) {
+    token = dup_call_token (authorizer);
+    if (g_strcmp0 (token, "goa-token-5") == 0)
+      break;
+    g_free (token);
+    iterate_main_context (1);
+  }
+  g_free (token);
+  g_assert_cmpuint (mock_goa_get_n_refreshes (goa), ==, 5);
+
+  g_clear_object (&goa_authorizer);
+  mock_goa_free (goa);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add ("/GFBGraph/Mock/Me", MockFixture, NULL,
+              mock_fixture_setup, test_mock_me, mock_fixture_teardown);
+  g_test_add ("/GFBGraph/Mock/Paging", MockFixture, NULL,
+              mock_fixture_setup, test_mock_paging, mock_fixture_teardown);
+  g_test_add ("/GFBGraph/Mock/TimeRange", MockFixture, NULL,
+              mock_fixture_setup, test_mock_time_range, mock_fixture_teardown);
+  g_test_add ("/GFBGraph/Mock/PagingCancel", MockFixture, NULL,
+              mock_fixture_setup, test_mock_paging_cancel, mock_fixture_teardown);
+  g_test_add ("/GFBGraph/Mock/Batch", MockFixture, NULL,
+              mock_fixture_setup, test_mock_batch, mock_fixture_teardown);
+  g_test_add ("/GFBGraph/Mock/Errors", MockFixture, NULL,
+              mock_fixture_setup, test_mock_errors, mock_fixture_teardown);
+  g_test_add ("/GFBGraph/Mock/Latency", MockFixture, NULL,
+              mock_fixture_setup, test_mock_latency, mock_fixture_teardown);
+  g_test_add ("/GFBGraph/Mock/Reauthorize", MockFixture, NULL,
+              mock_fixture_setup, test_mock_reauthorize, mock_fixture_teardown);
+  g_test_add ("/GFBGraph/Mock/Cache", MockFixture, NULL,
+              mock_fixture_setup, test_mock_cache, mock_fixture_teardown);
+  g_test_add ("/GFBGraph/Mock/IdentityMap", MockFixture, NULL,
+              mock_fixture_setup, test_mock_identity_map, mock_fixture_teardown);
+  g_test_add ("/GFBGraph/Mock/Retry", MockFixture, NULL,
+              mock_fixture_setup, test_mock_retry, mock_fixture_teardown);
+  g_test_add ("/GFBGraph/Mock/SingleFlight", MockFixture, NULL,
+              mock_fixture_setup, test_mock_single_flight, mock_fixture_teardown);
+  g_test_add ("/GFBGraph/Mock/SingleFlightCancel", MockFixture, NULL,
+              mock_fixture_setup, test_mock_single_flight_cancel, mock_fixture_teardown);
+  g_test_add ("/GFBGraph/Mock/Scheduler", MockFixture, NULL,
+              mock_fixture_setup, test_mock_scheduler, mock_fixture_teardown);
+  g_test_add ("/GFBGraph/Mock/SchedulerUsage", MockFixture, NULL,
+              mock_fixture_setup, test_mock_scheduler_usage, mock_fixture_teardown);
+  g_test_add ("/GFBGraph/Mock/Sync", MockFixture, NULL,
+              mock_fixture_setup, test_mock_sync, mock_fixture_teardown);
+  g_test_add ("/GFBGraph/Mock/SyncError", MockFixture, NULL,
+              mock_fixture_setup, test_mock_sync_error, mock_fixture_teardown);
+  g_test_add ("/GFBGraph/Mock/Download", MockFixture, NULL,
+              mock_fixture_setup, test_mock_download, mock_fixture_teardown);
+  g_test_add ("/GFBGraph/Mock/DownloadCancel", MockFixture, NULL,
+              mock_fixture_setup, test_mock_download_cancel, mock_fixture_teardown);
+  g_test_add_func ("/GFBGraph/Mock/GoaRefresh", test_mock_goa_refresh);
+
+  return g_test_run ();
+}
@@ -0,0 +1,581 @@
+/* -*- Mode: C; indent-tabs-mode: nil; c-basic-offset: 2; tab-width: 2 -*-  */
+/*
+ * libgfbgraph - GObject library for Facebook Graph API
+ * Copyright (C) 2013 Álvaro Peña <alvaropg@gmail.com>
+ *               2020 Leesoo Ahn <yisooan@fedoraproject.org>
+ *
+ * GFBGraph is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * GFBGraph is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with GFBGraph.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Tests of the parts of the library that don't send requests. The token cell
+ * is internal, so its source is built into this test.
+ */
+
+#include <glib.h>
+#include <string.h>
+#include <json-glib/json-glib.h>
+
+#include <gfbgraph/gfbgraph.h>
+#include <gfbgraph/gfbgraph-simple-authorizer.h>
+#include <gfbgraph/gfbgraph-private.h>
+
+#define TOKEN_LENGTH       64
+#define N_TOKEN_READERS    4
+#define N_TOKEN_WRITES     2000
+
+static void
+test_field_set_expansions (void)
+{
+  g_autoptr (GFBGraphFieldSet) fields = NULL;
+  g_autoptr (GFBGraphFieldSet) copy = NULL;
+
+  fields = gfbgraph_field_set_new_from_string ("id, images{source,width},photos.limit(5){id,name{first,last}},name");
+  g_assert_cmpuint (gfbgraph_field_set_get_size (fields), ==, 4);
+  g_assert_true (gfbgraph_field_set_contains (fields, "id"));
+  g_assert_true (gfbgraph_field_set_contains (fields, "images{source,width}"));
+  g_assert_true (gfbgraph_field_set_contains (fields, "photos.limit(5){id,name{first,last}}"));
+  g_assert_true (gfbgraph_field_set_contains (fields, "name"));
+  g_assert_false (gfbgraph_field_set_contains (fields, "width}"));
+  g_assert_cmpstr (gfbgraph_field_set_to_string (fields), ==,
+                   "id,images{source,width},photos.limit(5){id,name{first,last}},name");
+
+  /* The string round trips */
+  copy = gfbgraph_field_set_new_from_string (gfbgraph_field_set_to_string (fields));
+  g_assert_cmpuint (gfbgraph_field_set_get_size (copy), ==, 4);
+  g_assert_cmpstr (gfbgraph_field_set_to_string (copy), ==, gfbgraph_field_set_to_string (fields));
+}
+
+static void
+test_node_timestamps (void)
+{
+  g_autoptr (GFBGraphNode) node = NULL;
+  g_autoptr (GFBGraphNode) fractional = NULL;
+  g_autoptr (GFBGraphNode) invalid = NULL;
+  g_autoptr (GError) error = NULL;
+
+  node = GFBGRAPH_NODE (json_gobject_from_data (GFBGRAPH_TYPE_NODE,
+                                                "{\"created_time\":\"2020-01-01T00:00:00+0000\","
+                                                "\"updated_time\":\"2020-01-01T02:00:00+0200\"}",
+                                                -1, &error));
+  g_assert_no_error (error);
+  g_assert_cmpint (gfbgraph_node_get_created_timestamp (node), ==, G_GINT64_CONSTANT (1577836800) * G_USEC_PER_SEC);
+  g_assert_cmpint (gfbgraph_node_get_updated_timestamp (node), ==, G_GINT64_CONSTANT (1577836800) * G_USEC_PER_SEC);
+  /* The Graph API format is formatted back, other ones are kept */
+  g_assert_cmpstr (gfbgraph_node_get_created_time (node), ==, "2020-01-01T00:00:00+0000");
+  g_assert_cmpstr (gfbgraph_node_get_updated_time (node), ==, "2020-01-01T02:00:00+0200");
+
+  /* Past 2038, with fractions of a second and without a time zone */
+  fractional = GFBGRAPH_NODE (json_gobject_from_data (GFBGRAPH_TYPE_NODE,
+                                                      "{\"created_time\":\"2040-02-29T12:00:00.25Z\","
+                                                      "\"updated_time\":\"2040-02-29T12:00:00\"}",
+                                                      -1, &error));
+  g_assert_no_error (error);
+  g_assert_cmpint (gfbgraph_node_get_created_timestamp (fractional), ==,
+                   G_GINT64_CONSTANT (2214129600) * G_USEC_PER_SEC + 250000);
+  g_assert_cmpint (gfbgraph_node_get_updated_timestamp (fractional), ==,
+                   G_GINT64_CONSTANT (2214129600) * G_USEC_PER_SEC);
+
+  invalid = GFBGRAPH_NODE (json_gobject_from_data (GFBGRAPH_TYPE_NODE,
+                                                   "{\"created_time\":\"yesterday\"}",
+                                                   -1, &error));
+  g_assert_no_error (error);
+  g_assert_cmpint (gfbgraph_node_get_created_timestamp (invalid), ==, 0);
+  g_assert_cmpstr (gfbgraph_node_get_created_time (invalid), ==, "yesterday");
+  g_assert_cmpint (gfbgraph_node_get_updated_timestamp (invalid), ==, 0);
+}
+
+/* The variants of a photo, in no particular order. By area the portrait one
+ * comes before the square 600x600 one, unlike by width. */
+#define PHOTO_JSON \
+  "{\"id\":\"1\",\"images\":[" \
+  "{\"width\":720,\"height\":540,\"source\":\"720.jpg\"}," \
+  "{\"width\":130,\"height\":130,\"source\":\"130.jpg\"}," \
+  "{\"width\":960,\"height\":720,\"source\":\"960.jpg\"}," \
+  "{\"width\":480,\"height\":640,\"source\":\"480.jpg\"}," \
+  "{\"width\":600,\"height\":600,\"source\":\"600.jpg\"}," \
+  "{\"width\":320,\"height\":240,\"source\":\"320.jpg\"}]}"
+
+typedef enum {
+  SELECT_NEAR_WIDTH,
+  SELECT_NEAR_HEIGHT,
+  SELECT_NEAR_AREA,
+  SELECT_NEAR_ASPECT_RATIO,
+  SELECT_FOR_SIZE
+} ImageSelector;
+
+static const struct {
+  ImageSelector selector;
+  guint         width;      /* Or the ratio * 100 for SELECT_NEAR_ASPECT_RATIO */
+  guint         height;
+  guint         expected;   /* Width of the expected image */
+} image_selections[] = {
+  /* Exact matches */
+  { SELECT_NEAR_WIDTH, 480, 0, 480 },
+  { SELECT_NEAR_HEIGHT, 600, 0, 600 },
+  { SELECT_NEAR_AREA, 480, 640, 480 },
+  { SELECT_NEAR_AREA, 600, 600, 600 },
+  { SELECT_NEAR_ASPECT_RATIO, 75, 0, 480 },
+  { SELECT_FOR_SIZE, 480, 640, 480 },
+  /* Between two sizes */
+  { SELECT_NEAR_WIDTH, 350, 0, 320 },
+  { SELECT_NEAR_WIDTH, 700, 0, 720 },
+  { SELECT_NEAR_HEIGHT, 560, 0, 720 },
+  { SELECT_NEAR_AREA, 340, 1000, 600 },
+  { SELECT_NEAR_ASPECT_RATIO, 110, 0, 600 },
+  { SELECT_NEAR_ASPECT_RATIO, 120, 0, 960 },
+  { SELECT_FOR_SIZE, 500, 500, 600 },
+  { SELECT_FOR_SIZE, 700, 500, 720 },
+  /* Below the smallest */
+  { SELECT_NEAR_WIDTH, 0, 0, 130 },
+  { SELECT_NEAR_HEIGHT, 10, 0, 130 },
+  { SELECT_NEAR_AREA, 10, 10, 130 },
+  { SELECT_NEAR_ASPECT_RATIO, 1, 0, 480 },
+  { SELECT_FOR_SIZE, 1, 1, 130 },
+  /* Above the biggest */
+  { SELECT_NEAR_WIDTH, 5000, 0, 960 },
+  { SELECT_NEAR_HEIGHT, 5000, 0, 960 },
+  { SELECT_NEAR_AREA, 2000, 2000, 960 },
+  { SELECT_NEAR_ASPECT_RATIO, 1000, 0, 960 },
+  { SELECT_FOR_SIZE, 2000, 10, 960 },
+  /* Ties go to the bigger image */
+  { SELECT_NEAR_WIDTH, 400, 0, 480 },
+  { SELECT_NEAR_HEIGHT, 570, 0, 600 },
+  { SELECT_NEAR_AREA, 556, 600, 600 },
+  { SELECT_NEAR_ASPECT_RATIO, 100, 0, 600 },
+  { SELECT_NEAR_ASPECT_RATIO, 133, 0, 960 },
+};
+
+static void
+test_photo_image_selection (void)
+{
+  g_autoptr (GFBGraphPhoto) photo = NULL;
+  g_autoptr (GError) error = NULL;
+  const GFBGraphPhotoImage *image;
+  guint i;
+
+  photo = GFBGRAPH_PHOTO (json_gobject_from_data (GFBGRAPH_TYPE_PHOTO, PHOTO_JSON, -1, &error));
+  g_assert_no_error (error);
+
+  /* The images are sorted by width, with their sources */
+  g_assert_cmpuint (gfbgraph_photo_get_n_images (photo), ==, 6);
+  g_assert_cmpuint (gfbgraph_photo_get_image (photo, 0)->width, ==, 130);
+  g_assert_cmpuint (gfbgraph_photo_get_image (photo, 3)->width, ==, 600);
+  g_assert_cmpstr (gfbgraph_photo_get_image (photo, 5)->source, ==, "960.jpg");
+  g_assert_cmpuint (gfbgraph_photo_get_image_hires (photo)->width, ==, 960);
+
+  for (i = 0; i < G_N_ELEMENTS (image_selections); i++) {
+    guint width = image_selections[i].width;
+    guint height = image_selections[i].height;
+
+    switch (image_selections[i].selector) {
+      case SELECT_NEAR_WIDTH:
+        image = gfbgraph_photo_get_image_near_width (photo, width);
+        break;
+      case SELECT_NEAR_HEIGHT:
+        image = gfbgraph_photo_get_image_near_height (photo, width);
+        break;
+      case SELECT_NEAR_AREA:
+        image = gfbgraph_photo_get_image_near_area (photo, width, height);
+        break;
+      case SELECT_NEAR_ASPECT_RATIO:
+        image = gfbgraph_photo_get_image_near_aspect_ratio (photo, width / 100.0);
+        break;
+      case SELECT_FOR_SIZE:
+        image = gfbgraph_photo_get_image_for_size (photo, width, height);
+        break;
+      default:
+        g_assert_not_reached ();
+    }
+
+    g_test_message ("Selection %u: %u, %u", i, width, height);
+    g_assert_nonnull (image);
+    g_assert_cmpuint (image->width, ==, image_selections[i].expected);
+  }
+}
+
+static void
+test_photo_no_images (void)
+{
+  g_autoptr (GFBGraphPhoto) photo = NULL;
+
+  photo = gfbgraph_photo_new ();
+  g_assert_cmpuint (gfbgraph_photo_get_n_images (photo), ==, 0);
+  g_assert_null (gfbgraph_photo_get_image_near_width (photo, 100));
+  g_assert_null (gfbgraph_photo_get_image_near_height (photo, 100));
+  g_assert_null (gfbgraph_photo_get_image_near_area (photo, 100, 100));
+  g_assert_null (gfbgraph_photo_get_image_near_aspect_ratio (photo, 1.0));
+  g_assert_null (gfbgraph_photo_get_image_for_size (photo, 100, 100));
+}
+
+static void
+test_node_merge_keeps_strings (void)
+{
+  g_autoptr (GFBGraphPhoto) photo = NULL;
+  g_autoptr (GFBGraphPhoto) same_time = NULL;
+  g_autoptr (GFBGraphPhoto) fresher = NULL;
+  g_autoptr (GError) error = NULL;
+  const GFBGraphPhotoImage *hires;
+  const gchar *created_time;
+  GList *images;
+
+  photo = GFBGRAPH_PHOTO (json_gobject_from_data (GFBGRAPH_TYPE_PHOTO, PHOTO_JSON, -1, &error));
+  g_assert_no_error (error);
+  g_object_set (photo, "created_time", "2020-01-01T00:00:00+0000", NULL);
+  created_time = gfbgraph_node_get_created_time (GFBGRAPH_NODE (photo));
+  images = gfbgraph_photo_get_images (photo);
+  hires = gfbgraph_photo_get_image_hires (photo);
+
+  /* The same time keeps the string formatted for it */
+  same_time = GFBGRAPH_PHOTO (json_gobject_from_data (GFBGRAPH_TYPE_PHOTO,
+                                                      "{\"id\":\"1\",\"created_time\":\"2020-01-01T00:00:00+0000\"}",
+                                                      -1, &error));
+  g_assert_no_error (error);
+  gfbgraph_node_merge (GFBGRAPH_NODE (photo), GFBGRAPH_NODE (same_time));
+  g_assert_true (gfbgraph_node_get_created_time (GFBGRAPH_NODE (photo)) == created_time);
+  g_assert_true (gfbgraph_photo_get_images (photo) == images);
+
+  /* The strings and images replaced stay valid while the photo is alive */
+  fresher = GFBGRAPH_PHOTO (json_gobject_from_data (GFBGRAPH_TYPE_PHOTO,
+                                                    "{\"id\":\"1\",\"created_time\":\"2021-01-01T00:00:00+0000\","
+                                                    "\"images\":[{\"width\":2048,\"height\":1536,\"source\":\"2048.jpg\"}]}",
+                                                    -1, &error));
+  g_assert_no_error (error);
+  gfbgraph_node_merge (GFBGRAPH_NODE (photo), GFBGRAPH_NODE (fresher));
+  g_assert_cmpstr (gfbgraph_node_get_created_time (GFBGRAPH_NODE (photo)), ==, "2021-01-01T00:00:00+0000");
+  g_assert_cmpuint (gfbgraph_photo_get_n_images (photo), ==, 1);
+  g_assert_cmpuint (gfbgraph_photo_get_image_hires (photo)->width, ==, 2048);
+  g_assert_cmpstr (created_time, ==, "2020-01-01T00:00:00+0000");
+  g_assert_cmpuint (g_list_length (images), ==, 6);
+  g_assert_cmpuint (hires->width, ==, 960);
+  g_assert_cmpstr (hires->source, ==, "960.jpg");
+}
+
+static void
+test_sync_load_state (void)
+{
+  static const gchar *invalid_states[] = {
+    "[]",
+    "{}",
+    "{\"version\":\"1\",\"albums\":[]}",
+    "{\"version\":2,\"albums\":[]}",
+    "{\"version\":1}",
+    "{\"version\":1,\"albums\":[{\"updated_time\":1,\"count\":0,\"photos\":[]}]}",
+    "{\"version\":1,\"albums\":[{\"id\":\"1\",\"count\":0,\"photos\":[]}]}",
+    "{\"version\":1,\"albums\":[{\"id\":\"1\",\"updated_time\":1,\"photos\":[]}]}",
+    "{\"version\":1,\"albums\":[{\"id\":\"1\",\"updated_time\":1,\"count\":-1,\"photos\":[]}]}",
+    "{\"version\":1,\"albums\":[{\"id\":\"1\",\"updated_time\":1,\"count\":1}]}",
+    "{\"version\":1,\"albums\":[{\"id\":\"1\",\"updated_time\":1,\"count\":1,\"photos\":[{\"id\":\"2\"}]}]}",
+    "{\"version\":1,\"albums\":[{\"id\":\"1\",\"updated_time\":1,\"count\":1,\"photos\":[{\"updated_time\":1}]}]}",
+    "{\"version\":1,\"albums\":[{\"id\":\"1\",\"updated_time\":1,\"count\":1,\"photos\":[2]}]}",
+  };
+  g_autoptr (GFBGraphUser) user = NULL;
+  g_autoptr (GFBGraphSync) sync = NULL;
+  GFBGraphSimpleAuthorizer *authorizer;
+  g_autoptr (GError) error = NULL;
+  g_autofree gchar *state = NULL;
+  guint i;
+
+  user = gfbgraph_user_new ();
+  authorizer = gfbgraph_simple_authorizer_new ("token");
+  sync = gfbgraph_sync_new (user, GFBGRAPH_AUTHORIZER (authorizer));
+  g_object_unref (authorizer);
+
+  /* Corrupt or incomplete states fail cleanly */
+  for (i = 0; i < G_N_ELEMENTS (invalid_states); i++) {
+    g_test_message ("State %u: %s", i, invalid_states[i]);
+    g_assert_false (gfbgraph_sync_load_state (sync, invalid_states[i], &error));
+    g_assert_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA);
+    g_clear_error (&error);
+  }
+
+  g_assert_false (gfbgraph_sync_load_state (sync, "{\"version\":", &error));
+  g_assert_nonnull (error);
+  g_clear_error (&error);
+
+  /* A valid one round trips */
+  g_assert_true (gfbgraph_sync_load_state (sync,
+                                           "{\"version\":1,\"albums\":[{\"id\":\"1\",\"updated_time\":5,"
+                                           "\"count\":1,\"photos\":[{\"id\":\"2\",\"updated_time\":3}]}]}",
+                                           &error));
+  g_assert_no_error (error);
+  state = gfbgraph_sync_save_state (sync);
+  g_assert_cmpstr (state, ==,
+                   "{\"version\":1,\"albums\":[{\"id\":\"1\",\"updated_time\":5,"
+                   "\"count\":1,\"photos\":[{\"id\":\"2\",\"updated_time\":3}]}]}");
+}
+
+static void
+test_identity_map (void)
+{
+  static const gchar *ids[] = { "1", "2", "3" };
+  g_autoptr (GFBGraphIdentityMap) map = NULL;
+  g_autoptr (GFBGraphNode) node = NULL;
+  GFBGraphSimpleAuthorizer *authorizer, *other;
+  GFBGraphNode *update, *added;
+  guint i;
+
+  map = gfbgraph_identity_map_new (2, 0);
+  authorizer = gfbgraph_simple_authorizer_new ("token");
+  other = gfbgraph_simple_authorizer_new ("other-token");
+
+  for (i = 0; i < G_N_ELEMENTS (ids); i++) {
+    GFBGraphNode *photo;
+
+    photo = g_object_new (GFBGRAPH_TYPE_PHOTO, "id", ids[i], NULL);
+    added = gfbgraph_identity_map_add (map, GFBGRAPH_AUTHORIZER (authorizer), photo);
+    g_assert_true (added == photo);
+    g_object_unref (added);
+    g_object_unref (photo);
+  }
+
+  /* Only the most recently used nodes are kept alive by the map */
+  g_assert_cmpuint (gfbgraph_identity_map_get_size (map), ==, 2);
+  g_assert_null (gfbgraph_identity_map_lookup (map, GFBGRAPH_AUTHORIZER (authorizer), "1"));
+  node = gfbgraph_identity_map_lookup (map, GFBGRAPH_AUTHORIZER (authorizer), "3");
+  g_assert_nonnull (node);
+
+  /* A node with the same ID is merged into the existing instance */
+  update = g_object_new (GFBGRAPH_TYPE_PHOTO, "id", "3", "name", "Updated", NULL);
+  added = gfbgraph_identity_map_add (map, GFBGRAPH_AUTHORIZER (authorizer), update);
+  g_assert_true (added == node);
+  g_assert_cmpstr (gfbgraph_photo_get_name (GFBGRAPH_PHOTO (node)), ==, "Updated");
+  g_object_unref (added);
+  g_object_unref (update);
+
+  /* The nodes of an authorizer are never returned for another one */
+  g_assert_null (gfbgraph_identity_map_lookup (map, GFBGRAPH_AUTHORIZER (other), "3"));
+  g_assert_null (gfbgraph_identity_map_lookup (map, NULL, "3"));
+
+  /* The nodes only kept alive by the application are still returned */
+  gfbgraph_identity_map_set_max_size (map, 0);
+  added = gfbgraph_identity_map_lookup (map, GFBGRAPH_AUTHORIZER (authorizer), "3");
+  g_assert_true (added == node);
+  g_object_unref (added);
+  g_assert_cmpuint (gfbgraph_identity_map_get_size (map), ==, 1);
+
+  gfbgraph_identity_map_remove (map, "3");
+  g_assert_null (gfbgraph_identity_map_lookup (map, GFBGRAPH_AUTHORIZER (authorizer), "3"));
+  g_assert_cmpuint (gfbgraph_identity_map_get_size (map), ==, 0);
+
+  g_object_unref (other);
+  g_object_unref (authorizer);
+}
+
+static void
+test_retry_policy_rules (void)
+{
+  g_autoptr (GFBGraphRetryPolicy) policy = NULL;
+  GFBGraphRetryClass retry_class;
+  guint max_retries, base_delay, max_delay;
+
+  policy = gfbgraph_retry_policy_new ();
+
+  /* The rules of the classes are independent */
+  for (retry_class = GFBGRAPH_RETRY_CLASS_NETWORK; retry_class <= GFBGRAPH_RETRY_CLASS_GRAPH_THROTTLED; retry_class++)
+    gfbgraph_retry_policy_set_rule (policy, retry_class, retry_class, retry_class * 10, retry_class * 100);
+  for (retry_class = GFBGRAPH_RETRY_CLASS_NETWORK; retry_class <= GFBGRAPH_RETRY_CLASS_GRAPH_THROTTLED; retry_class++) {
+    gfbgraph_retry_policy_get_rule (policy, retry_class, &max_retries, &base_delay, &max_delay);
+    g_assert_cmpuint (max_retries, ==, retry_class);
+    g_assert_cmpuint (base_delay, ==, retry_class * 10);
+    g_assert_cmpuint (max_delay, ==, retry_class * 100);
+  }
+
+  gfbgraph_retry_policy_set_budget_ratio (policy, 0.5);
+  g_assert_cmpfloat (gfbgraph_retry_policy_get_budget_ratio (policy), ==, 0.5);
+  gfbgraph_retry_policy_set_min_retry_rate (policy, 0.0);
+  g_assert_cmpfloat (gfbgraph_retry_policy_get_min_retry_rate (policy), ==, 0.0);
+}
+
+static void
+test_context_for_authorizer (void)
+{
+  g_autoptr (GFBGraphContext) context = NULL;
+  g_autoptr (GFBGraphIdentityMap) map = NULL;
+  GFBGraphSimpleAuthorizer *authorizer;
+
+  context = gfbgraph_context_new ("http://localhost:1/");
+  g_assert_cmpstr (gfbgraph_context_get_endpoint (context), ==, "http://localhost:1/");
+  g_assert_nonnull (gfbgraph_context_get_scheduler (context));
+  g_assert_null (gfbgraph_context_get_identity_map (context));
+
+  /* The authorizers use the default context until another one is set */
+  authorizer = gfbgraph_simple_authorizer_new ("token");
+  g_assert_true (gfbgraph_context_get_for_authorizer (GFBGRAPH_AUTHORIZER (authorizer)) == gfbgraph_context_get_default ());
+  gfbgraph_context_set_for_authorizer (context, GFBGRAPH_AUTHORIZER (authorizer));
+  g_assert_true (gfbgraph_context_get_for_authorizer (GFBGRAPH_AUTHORIZER (authorizer)) == context);
+  gfbgraph_context_set_for_authorizer (NULL, GFBGRAPH_AUTHORIZER (authorizer));
+  g_assert_true (gfbgraph_context_get_for_authorizer (GFBGRAPH_AUTHORIZER (authorizer)) == gfbgraph_context_get_default ());
+
+  map = gfbgraph_identity_map_new (10, 60);
+  gfbgraph_context_set_identity_map (context, map);
+  g_assert_true (gfbgraph_context_get_identity_map (context) == map);
+  gfbgraph_context_set_identity_map (context, NULL);
+  g_assert_null (gfbgraph_context_get_identity_map (context));
+
+  g_object_unref (authorizer);
+}
+
+/* Every token is TOKEN_LENGTH times the same letter, so a torn or freed one
+ * is very unlikely to look valid */
+static gboolean
+token_is_valid (const gchar *token)
+{
+  guint i;
+
+  if (token == NULL || token[0] < 'a' || token[0] > 'z')
+    return FALSE;
+
+  for (i = 1; i < TOKEN_LENGTH; i++) {
+    if (token[i] != token[0])
+      return FALSE;
+  }
+
+  return token[TOKEN_LENGTH] == '\0';
+}
+
+typedef struct {
+  GFBGraphTokenCell  cell;
+  const gchar       *held[N_TOKEN_READERS];  /* The token of every reader, between read_begin and read_end */
+  gint               stop;
+  gint               n_invalid;
+  gint               n_reads;
+} TokenCellData;
+
+typedef struct {
+  TokenCellData *data;
+  guint          index;
+} TokenReader;
+
+static gpointer
+token_reader_thread (gpointer user_data)
+{
+  TokenReader *reader = user_data;
+  TokenCellData *data = reader->data;
+
+  while (!g_atomic_int_get (&data->stop)) {
+    const gchar *token;
+    guint slot;
+
+    token = gfbgraph_token_cell_read_begin (&data->cell, &slot);
+    g_atomic_pointer_set (&data->held[reader->index], token);
+    if (!token_is_valid (token))
+      g_atomic_int_inc (&data->n_invalid);
+    g_thread_yield ();
+    if (!token_is_valid (token))
+      g_atomic_int_inc (&data->n_invalid);
+    g_atomic_pointer_set (&data->held[reader->index], NULL);
+    gfbgraph_token_cell_read_end (&data->cell, slot);
+
+    g_atomic_int_inc (&data->n_reads);
+  }
+
+  return NULL;
+}
+
+static gpointer
+token_writer_thread (gpointer user_data)
+{
+  TokenCellData *data = user_data;
+  gchar token[TOKEN_LENGTH + 1];
+
+  memset (token, 'z', TOKEN_LENGTH);
+  token[TOKEN_LENGTH] = '\0';
+  gfbgraph_token_cell_set (&data->cell, token);
+  g_atomic_int_set (&data->stop, TRUE);
+
+  return NULL;
+}
+
+static void
+test_token_cell (void)
+{
+  TokenCellData data = { 0, };
+  TokenReader readers[N_TOKEN_READERS];
+  GThread *threads[N_TOKEN_READERS];
+  GThread *writer;
+  gchar token[TOKEN_LENGTH + 1];
+  const gchar *held;
+  guint i, j, slot;
+
+  gfbgraph_token_cell_init (&data.cell);
+  g_assert_null (gfbgraph_token_cell_dup (&data.cell));
+
+  memset (token, 'a', TOKEN_LENGTH);
+  token[TOKEN_LENGTH] = '\0';
+  gfbgraph_token_cell_set (&data.cell, token);
+
+  for (i = 0; i < N_TOKEN_READERS; i++) {
+    readers[i].data = &data;
+    readers[i].index = i;
+    threads[i] = g_thread_new ("token-reader", token_reader_thread, &readers[i]);
+  }
+
+  /* Once set() returns, no reader holds the replaced token anymore */
+  for (i = 0; i < N_TOKEN_WRITES; i++) {
+    const gchar *old_token;
+
+    old_token = gfbgraph_token_cell_read_begin (&data.cell, &slot);
+    gfbgraph_token_cell_read_end (&data.cell, slot);
+
+    memset (token, 'a' + i % 26, TOKEN_LENGTH);
+    gfbgraph_token_cell_set (&data.cell, token);
+
+    for (j = 0; j < N_TOKEN_READERS; j++)
+      g_assert_true (g_atomic_pointer_get (&data.held[j]) != old_token);
+  }
+
+  g_atomic_int_set (&data.stop, TRUE);
+  for (i = 0; i < N_TOKEN_READERS; i++)
+    g_thread_join (threads[i]);
+
+  g_assert_cmpint (data.n_invalid, ==, 0);
+  g_assert_cmpint (data.n_reads, >, 0);
+
+  /* set() waits until the readers of the old token are done */
+  g_atomic_int_set (&data.stop, FALSE);
+  held = gfbgraph_token_cell_read_begin (&data.cell, &slot);
+  writer = g_thread_new ("token-writer", token_writer_thread, &data);
+  g_usleep (G_USEC_PER_SEC / 10);
+  g_assert_false (g_atomic_int_get (&data.stop));
+  g_assert_true (token_is_valid (held));
+  gfbgraph_token_cell_read_end (&data.cell, slot);
+  g_thread_join (writer);
+  g_assert_true (g_atomic_int_get (&data.stop));
+  held = gfbgraph_token_cell_read_begin (&data.cell, &slot);
+  g_assert_cmpint (held[0], ==, 'z');
+  gfbgraph_token_cell_read_end (&data.cell, slot);
+
+  gfbgraph_token_cell_clear (&data.cell);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/GFBGraph/Unit/FieldSetExpansions", test_field_set_expansions);
+  g_test_add_func ("/GFBGraph/Unit/NodeTimestamps", test_node_timestamps);
+  g_test_add_func ("/GFBGraph/Unit/PhotoImageSelection", test_photo_image_selection);
+  g_test_add_func ("/GFBGraph/Unit/PhotoNoImages", test_photo_no_images);
+  g_test_add_func ("/GFBGraph/Unit/NodeMergeKeepsStrings", test_node_merge_keeps_strings);
+  g_test_add_func ("/GFBGraph/Unit/SyncLoadState", test_sync_load_state);
+  g_test_add_func ("/GFBGraph/Unit/IdentityMap", test_identity_map);
+  g_test_add_func ("/GFBGraph/Unit/RetryPolicyRules", test_retry_policy_rules);
+  g_test_add_func ("/GFBGraph/Unit/ContextForAuthorizer", test_context_for_authorizer);
+  g_test_add_func ("/GFBGraph/Unit/TokenCell", test_token_cell);
+
+  return g_test_run ();
+}